@@ -26,6 +26,8 @@
 #include <CCTypes.h>
 #include <GeometricalAnalysisTools.h>
 #include <Garbage.h>
+#include <CloudSamplingTools.h>
+#include <PointCloud.h>
 #include <ccHObjectCaster.h>
 #include <GenericIndexedCloudPersist.h>
 #include <ccGenericMesh.h>
@@ -41,6 +43,7 @@
 #include <ccRasterGrid.h>
 #include <ccRasterizeTool.h>
 #include <ccClipBox.h>
+#include <ccOctree.h>
 #include <ManualSegmentationTools.h>
 #include <SimpleMesh.h>
 #include <ccMaterialSet.h>
@@ -62,12 +65,18 @@
 
 //system
 #include <unordered_set>
+#include <unordered_map>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <limits>
 #include <cmath>
 #include <string.h>
 #include <vector>
 #include <exception>
 #include <set>
 #include <sstream>
+#include <algorithm>
 
 //Qt
 #include <QApplication>
@@ -76,9 +85,17 @@
 #include <QString>
 #include <QObject>
 #include <QMessageBox>
+#include <QThread>
+#include <QElapsedTimer>
 
 #include "optdefines.h"
 
+#ifdef CC_CORE_LIB_USES_TBB
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_sort.h>
+#include <tbb/task_arena.h>
+#endif
+
 #ifdef PLUGIN_IO_QFBX
 #include <FBXFilter.h>
 #endif
@@ -1098,940 +1115,2770 @@ PointCoordinateType pyCC_GetDefaultCloudKernelSize(ccGenericPointCloud* cloud, u
     return -CCCoreLib::PC_ONE;
 }
 
-bool ICP(
-    ccHObject* data,
-    ccHObject* model,
-    ccGLMatrix& transMat,
-    double& finalScale,
-    double& finalRMS,
-    unsigned& finalPointCount,
-    double minRMSDecrease,
-    unsigned maxIterationCount,
-    unsigned randomSamplingLimit,
-    bool removeFarthestPoints,
-    CCCoreLib::ICPRegistrationTools::CONVERGENCE_TYPE method,
-    bool adjustScale,
-    double finalOverlapRatio,
-    bool useDataSFAsWeights,
-    bool useModelSFAsWeights,
-    int transformationFilters,
-    int maxThreadCount)
+//! Model of the ICP variants of RegisterPlane_: cloud, octree and normals, shared by all the pyramid levels or registrations
+class ICPPlaneModel_
 {
-    // TODO duplicated code from qCC / ccRegistrationTools::ICP
-
-    // Default number of points sampled on the 'data' mesh (if any)
-    const unsigned s_defaultSampledPointsOnDataMesh = 50000;
-    // Default temporary registration scalar field
-    const char REGISTRATION_DISTS_SF[] = "RegistrationDistances";
-
-    bool restoreColorState = false;
-    bool restoreSFState = false;
-
-    CCCoreLib::Garbage<CCCoreLib::GenericIndexedCloudPersist> cloudGarbage;
+public:
+    ~ICPPlaneModel_()
+    {
+        if (m_normalCodes)
+            m_normalCodes->release();
+    }
 
-    //if the 'model' entity is a mesh, we need to sample points on it
-    CCCoreLib::GenericIndexedCloudPersist* modelCloud = nullptr;
-    ccGenericMesh* modelMesh = nullptr;
-    if (model->isKindOf(CC_TYPES::MESH))
+    //! Builds the octree and gets (or computes) the normals (not thread safe: creates entities)
+    bool init(CCCoreLib::GenericIndexedCloudPersist* modelCloud, bool withNormals = true)
     {
-        modelMesh = ccHObjectCaster::ToGenericMesh(model);
-        modelCloud = modelMesh->getAssociatedCloud();
+        if (!prepare(modelCloud, withNormals))
+        {
+            return false;
+        }
+        if (!build())
+        {
+            ccLog::Error("[ICP] Failed to compute the model octree or normals (not enough memory?)");
+            return false;
+        }
+        return true;
     }
-    else
+
+    //! Checks the model and allocates the normals table if necessary (not thread safe: creates entities)
+    bool prepare(CCCoreLib::GenericIndexedCloudPersist* modelCloud, bool withNormals = true)
     {
-        modelCloud = ccHObjectCaster::ToGenericPointCloud(model);
+        m_cloud = modelCloud;
+        if (!withNormals)
+        {
+            return true;
+        }
+
+        m_genericCloud = dynamic_cast<ccGenericPointCloud*>(modelCloud);
+        if (!m_genericCloud)
+        {
+            ccLog::Error("[ICP] The model must be a point cloud or a mesh to use its normals");
+            return false;
+        }
+        if (!m_genericCloud->hasNormals())
+        {
+            m_normalCodes = new NormsIndexesTableType;
+            m_normalCodes->link();
+        }
+        return true;
     }
 
-    //if the 'data' entity is a mesh, we need to sample points on it
-    CCCoreLib::GenericIndexedCloudPersist* dataCloud = nullptr;
-    if (data->isKindOf(CC_TYPES::MESH))
+    //! Builds the octree and computes the missing normals (after prepare, may run concurrently for different models)
+    bool build()
     {
-        dataCloud = CCCoreLib::MeshSamplingTools::samplePointsOnMesh(ccHObjectCaster::ToGenericMesh(data), s_defaultSampledPointsOnDataMesh);
-        if (!dataCloud)
+        m_octree.reset(new CCCoreLib::DgmOctree(m_cloud));
+        if (m_octree->build() <= 0)
         {
-            ccLog::Error("[ICP] Failed to sample points on 'data' mesh!");
             return false;
         }
-        cloudGarbage.add(dataCloud);
+        m_level = m_octree->findBestLevelForAGivenPopulationPerCell(4);
+
+        if (m_normalCodes)
+        {
+            PointCoordinateType radius = pyCC_GetDefaultCloudKernelSize(m_genericCloud, 12);
+            if (!ccNormalVectors::ComputeCloudNormals(m_genericCloud, *m_normalCodes, CCCoreLib::LS, radius, ccNormalVectors::UNDEFINED, nullptr, m_octree.get()))
+            {
+                return false;
+            }
+        }
+        return true;
     }
-    else
+
+    //! Returns the model normal at a given point (may be called concurrently)
+    inline CCVector3d normal(unsigned index) const
     {
-        dataCloud = ccHObjectCaster::ToGenericPointCloud(data);
+        const CCVector3& N = (m_normalCodes ? ccNormalVectors::GetNormal(m_normalCodes->getValue(index)) : m_genericCloud->getPointNormal(index));
+        return CCVector3d(N.x, N.y, N.z);
     }
 
-    //we activate a temporary scalar field for registration distances computation
-    CCCoreLib::ScalarField* dataDisplayedSF = nullptr;
-    int oldDataSfIdx = -1;
-    int dataSfIdx = -1;
+    CCCoreLib::GenericIndexedCloudPersist* m_cloud = nullptr;
+    ccGenericPointCloud* m_genericCloud = nullptr;
+    std::unique_ptr<CCCoreLib::DgmOctree> m_octree;
+    unsigned char m_level = 0;
+    NormsIndexesTableType* m_normalCodes = nullptr;
+};
 
-    //if the 'data' entity is a real ccPointCloud, we can even create a proper temporary SF for registration distances
-    if (data->isA(CC_TYPES::POINT_CLOUD))
+//! Normal equations of the linearized point-to-plane objectives, accumulated per chunk of data points
+struct ICPNormalEquations_
+{
+    double ATA[6][6] = {};
+    double ATb[6] = {};
+    double sumSquareDist = 0;
+    unsigned count = 0;
+
+    void add(const ICPNormalEquations_& other)
     {
-        ccPointCloud* pc = static_cast<ccPointCloud*>(data);
-        restoreColorState = pc->colorsShown();
-        restoreSFState = pc->sfShown();
-        dataDisplayedSF = pc->getCurrentDisplayedScalarField();
-        oldDataSfIdx = pc->getCurrentInScalarFieldIndex();
-        dataSfIdx = pc->getScalarFieldIndexByName(REGISTRATION_DISTS_SF);
-        if (dataSfIdx < 0)
-            dataSfIdx = pc->addScalarField(REGISTRATION_DISTS_SF);
-        if (dataSfIdx >= 0)
-            pc->setCurrentScalarField(dataSfIdx);
-        else
+        for (int i = 0; i < 6; ++i)
         {
-            ccLog::Error("[ICP] Couldn't create temporary scalar field! Not enough memory?");
-            return false;
+            for (int j = 0; j < 6; ++j)
+                ATA[i][j] += other.ATA[i][j];
+            ATb[i] += other.ATb[i];
         }
+        sumSquareDist += other.sumSquareDist;
+        count += other.count;
     }
-    else
+
+    //! Solves ATA.x = ATb (Gaussian elimination with partial pivoting)
+    bool solve(double x[6]) const
     {
-        if (!dataCloud->enableScalarField())
+        double M[6][7];
+        double maxDiag = 0;
+        for (int i = 0; i < 6; ++i)
         {
-            ccLog::Error("[ICP] Couldn't create temporary scalar field! Not enough memory?");
-            return false;
+            for (int j = 0; j < 6; ++j)
+                M[i][j] = ATA[i][j];
+            M[i][6] = ATb[i];
+            maxDiag = std::max(maxDiag, std::abs(ATA[i][i]));
+        }
+        for (int c = 0; c < 6; ++c)
+        {
+            int pivot = c;
+            for (int r = c + 1; r < 6; ++r)
+                if (std::abs(M[r][c]) > std::abs(M[pivot][c]))
+                    pivot = r;
+            if (std::abs(M[pivot][c]) <= 1.0e-12 * maxDiag)
+                return false; //degenerate configuration
+            if (pivot != c)
+                for (int j = 0; j < 7; ++j)
+                    std::swap(M[c][j], M[pivot][j]);
+            for (int r = c + 1; r < 6; ++r)
+            {
+                double f = M[r][c] / M[c][c];
+                for (int j = c; j < 7; ++j)
+                    M[r][j] -= f * M[c][j];
+            }
+        }
+        for (int r = 5; r >= 0; --r)
+        {
+            double v = M[r][6];
+            for (int j = r + 1; j < 6; ++j)
+                v -= M[r][j] * x[j];
+            x[r] = v / M[r][r];
         }
+        return true;
     }
+};
 
-    //add a 'safety' margin to input ratio
-    static double s_overlapMarginRatio = 0.2;
-    finalOverlapRatio = std::max(finalOverlapRatio, 0.01); //1% minimum
-    //do we need to reduce the input point cloud (so as to be close
-    //to the theoretical number of overlapping points - but not too
-    //low so as we are not registered yet ;)
-    if (finalOverlapRatio < 1.0 - s_overlapMarginRatio)
+//! Data normals of the symmetric ICP objective, by local plane fitting on 12 neighbours (may be called concurrently)
+void ComputeICPDataNormals_(const CCCoreLib::DgmOctree& dataOctree,
+                            unsigned char dataLevel,
+                            CCCoreLib::GenericIndexedCloudPersist* dataCloud,
+                            CCCoreLib::GenericIndexedCloud* points,
+                            unsigned first,
+                            unsigned last,
+                            std::vector<CCVector3d>& normals)
+{
+    CCCoreLib::ReferenceCloud neighbours(dataCloud);
+    for (unsigned i = first; i < last; ++i)
     {
-        //DGM we can now use 'approximate' distances as SAITO algorithm is exact (but with a coarse resolution)
-        //level = 7 if < 1.000.000
-        //level = 8 if < 10.000.000
-        //level = 9 if > 10.000.000
-        int gridLevel = static_cast<int>(std::floor(std::log10(static_cast<long double>(std::max(dataCloud->size(), modelCloud->size()))))) + 2;
-            gridLevel = std::min(std::max(gridLevel, 7), 9);
-        int result = -1;
-        if (modelMesh)
+        double maxSquareDist = 0;
+        neighbours.clear();
+        normals[i] = CCVector3d(0, 0, 0);
+        if (dataOctree.findPointNeighbourhood(points->getPoint(i), &neighbours, 12, dataLevel, maxSquareDist) >= 3)
         {
-            CCCoreLib::DistanceComputationTools::Cloud2MeshDistancesComputationParams c2mParams;
-            c2mParams.octreeLevel = gridLevel;
-            c2mParams.maxSearchDist = 0;
-            c2mParams.useDistanceMap = true;
-            c2mParams.signedDistances = false;
-            c2mParams.flipNormals = false;
-            c2mParams.multiThread = false;
-            result = CCCoreLib::DistanceComputationTools::computeCloud2MeshDistances(dataCloud, modelMesh, c2mParams);
+            CCCoreLib::Neighbourhood Z(&neighbours);
+            const CCVector3* N = Z.getLSPlaneNormal();
+            if (N)
+                normals[i] = CCVector3d(N->x, N->y, N->z);
         }
-        else
+    }
+}
+
+//! Point-to-plane or symmetric ICP (see ICP), or linearized point-to-point ICP (see ICP pyramid)
+/** Point-to-plane minimizes the distances of the data points to the tangent planes of their nearest model points.
+    The symmetric objective (Rusinkiewicz, 2019) uses the sum of the data and model normals, and splits the rotation
+    between the data and the model. Point-to-point uses the 3 axes instead of the normal, and does not need the
+    model normals. The correspondences and the normal equations are computed in parallel.
+    The convergence criteria, sampling limit, overlap ratio, farthest points filtering and transformation filters
+    have the same meaning as with ICPRegistrationTools::Register (the scale and the weights are not supported).
+    'dataNormals' are optional precomputed normals of the data points (symmetric objective, without sampling).
+**/
+CCCoreLib::ICPRegistrationTools::RESULT_TYPE RegisterPlane_(const ICPPlaneModel_& model,
+                                                            CCCoreLib::GenericIndexedCloudPersist* dataCloud,
+                                                            const CCCoreLib::ICPRegistrationTools::Parameters& params,
+                                                            ICP_OBJECTIVE objective,
+                                                            ccGLMatrixd& totalTrans,
+                                                            double& finalRMS,
+                                                            unsigned& finalPointCount,
+                                                            const std::vector<CCVector3d>* precomputedDataNormals = nullptr)
+{
+    totalTrans.toIdentity();
+    const bool symmetric = (objective == SYMMETRIC_POINT_TO_PLANE);
+    const bool pointToPoint = (objective == POINT_TO_POINT);
+
+    //data points (randomly subsampled if necessary)
+    CCCoreLib::ReferenceCloud* sampledData = nullptr;
+    if (params.samplingLimit != 0 && dataCloud->size() > params.samplingLimit)
+    {
+        sampledData = CCCoreLib::CloudSamplingTools::subsampleCloudRandomly(dataCloud, params.samplingLimit);
+    }
+    else
+    {
+        sampledData = new CCCoreLib::ReferenceCloud(dataCloud);
+        if (!sampledData->addPointIndex(0, dataCloud->size()))
         {
-            result = CCCoreLib::DistanceComputationTools::computeApproxCloud2CloudDistance( dataCloud,
-                                                                                        modelCloud,
-                                                                                        gridLevel,
-                                                                                        -1);
+            delete sampledData;
+            sampledData = nullptr;
         }
+    }
+    if (!sampledData || sampledData->size() < 6)
+    {
+        delete sampledData;
+        ccLog::Error("[ICP] Not enough data points (or not enough memory)");
+        return CCCoreLib::ICPRegistrationTools::ICP_ERROR_INVALID_INPUT;
+    }
+    const unsigned pointCount = sampledData->size();
 
-        if (result < 0)
+    std::vector<CCVector3d> dataPoints;
+    std::vector<CCVector3d> dataNormals;
+    std::vector<unsigned> matches;
+    std::vector<double> squareDists;
+    try
+    {
+        dataPoints.resize(pointCount);
+        matches.resize(pointCount);
+        squareDists.resize(pointCount);
+        if (symmetric)
+            dataNormals.resize(pointCount);
+    }
+    catch (const std::bad_alloc&)
+    {
+        delete sampledData;
+        ccLog::Error("[ICP] Not enough memory!");
+        return CCCoreLib::ICPRegistrationTools::ICP_ERROR_NOT_ENOUGH_MEMORY;
+    }
+    for (unsigned i = 0; i < pointCount; ++i)
+    {
+        const CCVector3* P = sampledData->getPoint(i);
+        dataPoints[i] = CCVector3d(P->x, P->y, P->z);
+    }
+
+    //chunks of data points (one partial result per chunk)
+    unsigned chunkCount = 1;
+#ifdef CC_CORE_LIB_USES_TBB
+    unsigned threadCount = (params.maxThreadCount > 0 ? static_cast<unsigned>(params.maxThreadCount) : static_cast<unsigned>(std::max(QThread::idealThreadCount(), 1)));
+    chunkCount = std::min(threadCount * 4, std::max(pointCount / 256, 1u));
+#endif
+    const unsigned chunkSize = (pointCount + chunkCount - 1) / chunkCount;
+    auto forEachChunk = [&](const std::function<void(unsigned, unsigned, unsigned)>& processChunk)
+    {
+        auto runChunk = [&](unsigned c)
         {
-            ccLog::Error("Failed to determine the max (overlap) distance (not enough memory?)");
-            return false;
+            processChunk(c, c * chunkSize, std::min(pointCount, (c + 1) * chunkSize));
+        };
+#ifdef CC_CORE_LIB_USES_TBB
+        tbb::parallel_for(static_cast<unsigned>(0), chunkCount, runChunk);
+#else
+        for (unsigned c = 0; c < chunkCount; ++c)
+            runChunk(c);
+#endif
+    };
+
+    //data normals (symmetric objective only), by local plane fitting
+    if (symmetric && precomputedDataNormals && precomputedDataNormals->size() == pointCount && pointCount == dataCloud->size())
+    {
+        dataNormals = *precomputedDataNormals;
+    }
+    else if (symmetric)
+    {
+        CCCoreLib::DgmOctree dataOctree(dataCloud);
+        if (dataOctree.build() <= 0)
+        {
+            delete sampledData;
+            ccLog::Error("[ICP] Failed to compute the data octree (not enough memory?)");
+            return CCCoreLib::ICPRegistrationTools::ICP_ERROR_NOT_ENOUGH_MEMORY;
         }
+        unsigned char dataLevel = dataOctree.findBestLevelForAGivenPopulationPerCell(4);
+        forEachChunk([&](unsigned, unsigned first, unsigned last)
+        {
+            ComputeICPDataNormals_(dataOctree, dataLevel, dataCloud, sampledData, first, last, dataNormals);
+        });
+    }
+    delete sampledData;
+    sampledData = nullptr;
 
-        //determine the max distance that (roughly) corresponds to the input overlap ratio
-        ScalarType maxSearchDist = 0;
+    const bool convergeOnError = (params.convType == CCCoreLib::ICPRegistrationTools::MAX_ERROR_CONVERGENCE);
+    const unsigned maxIterations = (convergeOnError ? 1000 : std::max(params.nbMaxIterations, 1u));
+    double lastRMS = -1.0;
+    for (unsigned iteration = 0; iteration < maxIterations; ++iteration)
+    {
+        //correspondences (nearest model points)
+        std::vector<CCVector3d> chunkSums(chunkCount, CCVector3d(0, 0, 0));
+        forEachChunk([&](unsigned c, unsigned first, unsigned last)
         {
-            unsigned count = dataCloud->size();
-            std::vector<ScalarType> distances;
-            try
+            CCCoreLib::ReferenceCloud nearest(model.m_cloud);
+            for (unsigned i = first; i < last; ++i)
             {
-                distances.resize(count);
+                const CCVector3d& Pd = dataPoints[i];
+                CCVector3 P(static_cast<PointCoordinateType>(Pd.x), static_cast<PointCoordinateType>(Pd.y), static_cast<PointCoordinateType>(Pd.z));
+                double maxSquareDist = 0;
+                nearest.clear();
+                if (model.m_octree->findPointNeighbourhood(&P, &nearest, 1, model.m_level, maxSquareDist) == 1)
+                {
+                    matches[i] = nearest.getPointGlobalIndex(0);
+                    const CCVector3* Q = model.m_cloud->getPoint(matches[i]);
+                    squareDists[i] = (CCVector3d(Q->x, Q->y, Q->z) - Pd).norm2();
+                }
+                else
+                {
+                    squareDists[i] = -1.0;
+                }
+                chunkSums[c] += Pd;
             }
-            catch (const std::bad_alloc&)
+        });
+        CCVector3d center(0, 0, 0);
+        for (const CCVector3d& s : chunkSums)
+            center += s;
+        center /= static_cast<double>(pointCount);
+
+        //rejection of the farthest pairs (overlap ratio, then mean + 3 std. dev. if required)
+        double maxSquareDist = std::numeric_limits<double>::max();
+        {
+            std::vector<double> validDists;
+            validDists.reserve(pointCount);
+            for (double d2 : squareDists)
+                if (d2 >= 0)
+                    validDists.push_back(d2);
+            if (validDists.size() < 6)
             {
-                ccLog::Error("Not enough memory!");
-                return false;
+                ccLog::Error("[ICP] Not enough correspondences");
+                return CCCoreLib::ICPRegistrationTools::ICP_ERROR_REGISTRATION_STEP;
             }
-            for (unsigned i=0; i<count; ++i)
+            if (params.finalOverlapRatio < 1.0)
             {
-                distances[i] = dataCloud->getPointScalarValue(i);
+                size_t keptCount = std::max(static_cast<size_t>(validDists.size() * params.finalOverlapRatio), static_cast<size_t>(6));
+                std::nth_element(validDists.begin(), validDists.begin() + (keptCount - 1), validDists.end());
+                maxSquareDist = validDists[keptCount - 1];
+                validDists.resize(keptCount);
+            }
+            if (params.filterOutFarthestPoints)
+            {
+                double sum = 0;
+                double sum2 = 0;
+                for (double d2 : validDists)
+                {
+                    double d = std::sqrt(d2);
+                    sum += d;
+                    sum2 += d2;
+                }
+                double mean = sum / validDists.size();
+                double stdDev = std::sqrt(std::max(0.0, sum2 / validDists.size() - mean * mean));
+                double maxDist = mean + 3.0 * stdDev;
+                maxSquareDist = std::min(maxSquareDist, maxDist * maxDist);
             }
-
-            ParallelSort(distances.begin(), distances.end());
-
-            //now look for the max value at 'finalOverlapRatio+margin' percent
-            maxSearchDist = distances[static_cast<size_t>(std::max(1.0,count*(finalOverlapRatio+s_overlapMarginRatio)))-1];
         }
 
-        //evntually select the points with distance below 'maxSearchDist'
-        //(should roughly correspond to 'finalOverlapRatio + margin' percent)
+        //normal equations
+        std::vector<ICPNormalEquations_> chunkEquations(chunkCount);
+        forEachChunk([&](unsigned c, unsigned first, unsigned last)
         {
-            CCCoreLib::ReferenceCloud* refCloud = new CCCoreLib::ReferenceCloud(dataCloud);
-            cloudGarbage.add(refCloud);
-            unsigned countBefore = dataCloud->size();
-            unsigned baseIncrement = static_cast<unsigned>(std::max(100.0,countBefore*finalOverlapRatio*0.05));
-            for (unsigned i=0; i<countBefore; ++i)
+            ICPNormalEquations_& eq = chunkEquations[c];
+            for (unsigned i = first; i < last; ++i)
             {
-                if (dataCloud->getPointScalarValue(i) <= maxSearchDist)
+                if (squareDists[i] < 0 || squareDists[i] > maxSquareDist)
+                    continue;
+                CCVector3d nq = (pointToPoint ? CCVector3d(0, 0, 0) : model.normal(matches[i]));
+                CCVector3d n = nq;
+                const CCVector3* Qf = model.m_cloud->getPoint(matches[i]);
+                CCVector3d p = dataPoints[i] - center;
+                CCVector3d q = CCVector3d(Qf->x, Qf->y, Qf->z) - center;
+                CCVector3d lever = p;
+                if (symmetric)
+                {
+                    CCVector3d np = dataNormals[i];
+                    n = (np.dot(nq) < 0 ? nq - np : nq + np);
+                    lever = p + q;
+                }
+                auto addRow = [&](const CCVector3d& N)
                 {
-                    if (    refCloud->size() == refCloud->capacity()
-                        &&  !refCloud->reserve(refCloud->size() + baseIncrement) )
+                    CCVector3d r = lever.cross(N);
+                    double J[6] = { r.x, r.y, r.z, N.x, N.y, N.z };
+                    double b = (q - p).dot(N);
+                    for (int k = 0; k < 6; ++k)
                     {
-                        ccLog::Error("Not enough memory!");
-                        return false;
+                        for (int l = k; l < 6; ++l)
+                            eq.ATA[k][l] += J[k] * J[l];
+                        eq.ATb[k] += J[k] * b;
                     }
-                    refCloud->addPointIndex(i);
+                };
+                if (pointToPoint)
+                {
+                    addRow(CCVector3d(1, 0, 0));
+                    addRow(CCVector3d(0, 1, 0));
+                    addRow(CCVector3d(0, 0, 1));
+                }
+                else
+                {
+                    addRow(n);
                 }
+                eq.sumSquareDist += squareDists[i];
+                ++eq.count;
             }
-            refCloud->resize(refCloud->size());
-            dataCloud = refCloud;
+        });
+        ICPNormalEquations_ equations;
+        for (const ICPNormalEquations_& eq : chunkEquations)
+            equations.add(eq);
+        for (int k = 0; k < 6; ++k)
+            for (int l = 0; l < k; ++l)
+                equations.ATA[k][l] = equations.ATA[l][k];
+
+        finalPointCount = equations.count;
+        finalRMS = std::sqrt(equations.sumSquareDist / std::max(equations.count, 1u));
+
+        //convergence
+        if (convergeOnError && lastRMS >= 0 && lastRMS - finalRMS < params.minRMSDecrease)
+            break;
+        lastRMS = finalRMS;
 
-            unsigned countAfter = dataCloud->size();
-            double keptRatio = static_cast<double>(countAfter)/countBefore;
-            ccLog::Print(QString("[ICP][Partial overlap] Selecting %1 points out of %2 (%3%) for registration").arg(countAfter).arg(countBefore).arg(static_cast<int>(100*keptRatio)));
+        double x[6];
+        if (!equations.solve(x))
+        {
+            ccLog::Warning("[ICP] Degenerate configuration, registration stopped");
+            break;
+        }
 
-            //update the relative 'final overlap' ratio
-            finalOverlapRatio /= keptRatio;
+        //transformation filters
+        int filters = params.transformationFilters;
+        if (filters & CCCoreLib::RegistrationTools::SKIP_RYZ) x[0] = 0;
+        if (filters & CCCoreLib::RegistrationTools::SKIP_RXZ) x[1] = 0;
+        if (filters & CCCoreLib::RegistrationTools::SKIP_RXY) x[2] = 0;
+        if (filters & CCCoreLib::RegistrationTools::SKIP_TX) x[3] = 0;
+        if (filters & CCCoreLib::RegistrationTools::SKIP_TY) x[4] = 0;
+        if (filters & CCCoreLib::RegistrationTools::SKIP_TZ) x[5] = 0;
+
+        //incremental transformation (around the data center)
+        CCVector3d a(x[0], x[1], x[2]);
+        CCVector3d t(x[3], x[4], x[5]);
+        double angle = a.norm();
+        ccGLMatrixd rotation;
+        if (angle > 0)
+            rotation.initFromParameters(angle, a / angle, CCVector3d(0, 0, 0));
+        ccGLMatrixd increment;
+        if (symmetric)
+        {
+            //R.R.(P - C) + R.t + C
+            increment = rotation * rotation;
+            increment.setTranslation(rotation * t + center - increment * center);
+        }
+        else
+        {
+            //R.(P - C) + t + C
+            increment = rotation;
+            increment.setTranslation(t + center - rotation * center);
         }
-    }
 
-    //weights
-    CCCoreLib::ScalarField* modelWeights = nullptr;
-    CCCoreLib::ScalarField* dataWeights = nullptr;
-    {
-        if (!modelMesh && useModelSFAsWeights)
+        forEachChunk([&](unsigned, unsigned first, unsigned last)
         {
-            if (modelCloud == dynamic_cast<CCCoreLib::GenericIndexedCloudPersist*>(model) && model->isA(CC_TYPES::POINT_CLOUD))
+            for (unsigned i = first; i < last; ++i)
             {
-                ccPointCloud* pc = static_cast<ccPointCloud*>(model);
-                modelWeights = pc->getCurrentDisplayedScalarField();
-                if (!modelWeights)
-                    ccLog::Warning("[ICP] 'useDataSFAsWeights' is true but model has no displayed scalar field!");
+                dataPoints[i] = increment * dataPoints[i];
+                if (symmetric)
+                    increment.applyRotation(dataNormals[i]);
             }
-            else
+        });
+        totalTrans = increment * totalTrans;
+    }
+
+    return CCCoreLib::ICPRegistrationTools::ICP_APPLY_TRANSFO;
+}
+
+//! Registers the data cloud coarse to fine (see ICP)
+/** The levels (except the last one) are voxel subsamplings of the data, i.e. one point per cell of its octree,
+    with about 4 times more points at each level. The last level is the full resolution data (randomly
+    subsampled if necessary, as ICPRegistrationTools::Register does). Each level is registered on a copy of
+    its points, moved by the transformation accumulated so far. With a model index (octree, and normals for the
+    point-to-plane objectives, built once by the caller), the levels are registered with RegisterPlane_.
+    With 'lastLevelWithCCLib', the full resolution level is registered with ICPRegistrationTools::Register instead
+    (point-to-point objective with a mesh model, scale adjustment or weights).
+**/
+CCCoreLib::ICPRegistrationTools::RESULT_TYPE RegisterPyramid_(  CCCoreLib::GenericIndexedCloudPersist* modelCloud,
+                                                                CCCoreLib::GenericIndexedMesh* modelMesh,
+                                                                CCCoreLib::GenericIndexedCloudPersist* dataCloud,
+                                                                const CCCoreLib::ICPRegistrationTools::Parameters& params,
+                                                                int pyramidLevels,
+                                                                ccGLMatrixd& totalTrans,
+                                                                double& totalScale,
+                                                                double& finalRMS,
+                                                                unsigned& finalPointCount,
+                                                                std::vector<ICPLevelInfo>& levelInfos,
+                                                                const ICPPlaneModel_* planeModel = nullptr,
+                                                                ICP_OBJECTIVE objective = POINT_TO_POINT,
+                                                                bool lastLevelWithCCLib = false)
+{
+    totalTrans.toIdentity();
+    totalScale = 1.0;
+
+    //the data octree is shared by all the subsampled levels
+    CCCoreLib::DgmOctree dataOctree(dataCloud);
+    if (dataOctree.build() <= 0)
+    {
+        ccLog::Error("[ICP] Failed to compute the data octree (not enough memory?)");
+        return CCCoreLib::ICPRegistrationTools::ICP_ERROR_NOT_ENOUGH_MEMORY;
+    }
+    unsigned samplingLimit = (params.samplingLimit != 0 ? params.samplingLimit : dataCloud->size());
+    int finestLevel = static_cast<int>(dataOctree.findBestLevelForAGivenCellNumber(samplingLimit));
+    finestLevel = std::max(finestLevel, pyramidLevels - 1);
+
+    for (int k = 0; k < pyramidLevels; ++k)
+    {
+        QElapsedTimer timer;
+        timer.start();
+
+        //data points at this level
+        ICPLevelInfo info;
+        CCCoreLib::ReferenceCloud* levelPoints = nullptr;
+        if (k + 1 < pyramidLevels)
+        {
+            info.octreeLevel = static_cast<unsigned char>(finestLevel - (pyramidLevels - 2 - k));
+            levelPoints = CCCoreLib::CloudSamplingTools::subsampleCloudWithOctreeAtLevel(dataCloud,
+                                                                                         info.octreeLevel,
+                                                                                         CCCoreLib::CloudSamplingTools::NEAREST_POINT_TO_CELL_CENTER,
+                                                                                         nullptr,
+                                                                                         &dataOctree);
+        }
+        else if (dataCloud->size() > samplingLimit)
+        {
+            levelPoints = CCCoreLib::CloudSamplingTools::subsampleCloudRandomly(dataCloud, samplingLimit);
+        }
+        else
+        {
+            levelPoints = new CCCoreLib::ReferenceCloud(dataCloud);
+            if (!levelPoints->addPointIndex(0, dataCloud->size()))
             {
-                ccLog::Warning("[ICP] 'useDataSFAsWeights' is true but only point cloud scalar fields can be used as weights!");
+                delete levelPoints;
+                levelPoints = nullptr;
             }
         }
+        if (!levelPoints)
+        {
+            ccLog::Error("[ICP] Failed to subsample the data (not enough memory?)");
+            return CCCoreLib::ICPRegistrationTools::ICP_ERROR_NOT_ENOUGH_MEMORY;
+        }
 
-        if (useDataSFAsWeights)
+        //copy of the points (with the transformation of the previous levels) and of their weights
+        CCCoreLib::PointCloud levelCloud;
+        CCCoreLib::ScalarField* levelWeights = nullptr;
+        bool success = levelCloud.reserve(levelPoints->size()) && levelCloud.enableScalarField();
+        if (success && params.dataWeights)
         {
-            if (!dataDisplayedSF)
+            levelWeights = new CCCoreLib::ScalarField("weights");
+            levelWeights->link();
+            success = levelWeights->reserveSafe(levelPoints->size());
+        }
+        if (success)
+        {
+            for (unsigned i = 0; i < levelPoints->size(); ++i)
             {
-                if (dataCloud == ccHObjectCaster::ToPointCloud(data))
-                    ccLog::Warning("[ICP] 'useDataSFAsWeights' is true but data has no displayed scalar field!");
-                else
-                    ccLog::Warning("[ICP] 'useDataSFAsWeights' is true but only point cloud scalar fields can be used as weights!");
+                const CCVector3* P = levelPoints->getPoint(i);
+                CCVector3d Pd = totalTrans * CCVector3d(P->x, P->y, P->z);
+                levelCloud.addPoint(CCVector3(static_cast<PointCoordinateType>(Pd.x), static_cast<PointCoordinateType>(Pd.y), static_cast<PointCoordinateType>(Pd.z)));
+                if (levelWeights)
+                {
+                    levelWeights->addElement(params.dataWeights->getValue(levelPoints->getPointGlobalIndex(i)));
+                }
+            }
+            if (levelWeights)
+            {
+                levelWeights->computeMinAndMax();
+            }
+        }
+        delete levelPoints;
+        levelPoints = nullptr;
+        if (!success)
+        {
+            if (levelWeights)
+                levelWeights->release();
+            ccLog::Error("[ICP] Not enough memory!");
+            return CCCoreLib::ICPRegistrationTools::ICP_ERROR_NOT_ENOUGH_MEMORY;
+        }
+
+        CCCoreLib::ICPRegistrationTools::Parameters levelParams = params;
+        levelParams.samplingLimit = std::max(samplingLimit, levelCloud.size()); //already subsampled
+        levelParams.dataWeights = levelWeights;
+
+        CCCoreLib::PointProjectionTools::Transformation transform;
+        ccGLMatrixd planeTrans;
+        double levelRMS = 0;
+        unsigned levelPointCount = 0;
+        CCCoreLib::ICPRegistrationTools::RESULT_TYPE result;
+        const bool useModelIndex = (planeModel && !(lastLevelWithCCLib && k + 1 == pyramidLevels));
+        if (useModelIndex)
+        {
+            result = RegisterPlane_(*planeModel, &levelCloud, levelParams, objective, planeTrans, levelRMS, levelPointCount);
+        }
+        else
+        {
+            result = CCCoreLib::ICPRegistrationTools::Register(modelCloud,
+                                                               modelMesh,
+                                                               &levelCloud,
+                                                               levelParams,
+                                                               transform,
+                                                               levelRMS,
+                                                               levelPointCount);
+        }
+        if (levelWeights)
+        {
+            levelWeights->release();
+            levelWeights = nullptr;
+        }
+        if (result >= CCCoreLib::ICPRegistrationTools::ICP_ERROR)
+        {
+            ccLog::Error(QString("[ICP] Registration failed at pyramid level %1 (code %2)").arg(k).arg(result));
+            return result;
+        }
+        if (result == CCCoreLib::ICPRegistrationTools::ICP_APPLY_TRANSFO)
+        {
+            if (useModelIndex)
+            {
+                totalTrans = planeTrans * totalTrans;
             }
             else
             {
-                dataWeights = dataDisplayedSF;
+                totalTrans = FromCCLibMatrix<double, double>(transform.R, transform.T, transform.s) * totalTrans;
+                totalScale *= transform.s;
             }
         }
+
+        info.pointCount = levelCloud.size();
+        info.rms = levelRMS;
+        info.duration = timer.elapsed() / 1000.0;
+        levelInfos.push_back(info);
+        CCTRACE("ICP pyramid level " << k << " octree level: " << static_cast<int>(info.octreeLevel) << " points: " << info.pointCount
+                << " RMS: " << info.rms << " duration: " << info.duration);
+
+        finalRMS = levelRMS;
+        finalPointCount = levelPointCount;
     }
 
-    CCCoreLib::ICPRegistrationTools::RESULT_TYPE result;
-    CCCoreLib::PointProjectionTools::Transformation transform;
-    CCCoreLib::ICPRegistrationTools::Parameters params;
+    return CCCoreLib::ICPRegistrationTools::ICP_APPLY_TRANSFO;
+}
+
+//! Selects the data points closer to the model than a given quantile of their distances (partial overlap, see ICP)
+/** The distances are the current scalar values of the cloud. The quantile is found with nth_element (no full sort)
+    and the selected indexes are compacted in parallel, in one allocation, in the cloud order.
+    \param quantile ratio of the points to select (between 0 and 1)
+    \return the selection, or nullptr on error (not enough memory)
+**/
+CCCoreLib::ReferenceCloud* SelectOverlapPoints_(CCCoreLib::GenericIndexedCloudPersist* dataCloud,
+                                                double quantile,
+                                                int maxThreadCount)
+{
+    unsigned count = dataCloud->size();
+    unsigned chunkCount = 1;
+#ifdef CC_CORE_LIB_USES_TBB
+    unsigned threadCount = (maxThreadCount > 0 ? static_cast<unsigned>(maxThreadCount) : static_cast<unsigned>(std::max(QThread::idealThreadCount(), 1)));
+    chunkCount = std::min(threadCount * 4, std::max(count / 4096, 1u));
+#endif
+    const unsigned chunkSize = (count + chunkCount - 1) / chunkCount;
+
+    std::vector<ScalarType> distances;
+    std::vector<unsigned> chunkStarts;
+    try
     {
-        params.convType = method;
-        params.minRMSDecrease = minRMSDecrease;
-        params.nbMaxIterations = maxIterationCount;
-        params.adjustScale = adjustScale;
-        params.filterOutFarthestPoints = removeFarthestPoints;
-        params.samplingLimit = randomSamplingLimit;
-        params.finalOverlapRatio = finalOverlapRatio;
-        params.modelWeights = modelWeights;
-        params.dataWeights = dataWeights;
-        params.transformationFilters = transformationFilters;
-        params.maxThreadCount = maxThreadCount;
+        distances.resize(count);
+        chunkStarts.resize(chunkCount + 1, 0);
+    }
+    catch (const std::bad_alloc&)
+    {
+        ccLog::Error("Not enough memory!");
+        return nullptr;
     }
 
-    result = CCCoreLib::ICPRegistrationTools::Register( modelCloud,
-                                                    modelMesh,
-                                                    dataCloud,
-                                                    params,
-                                                    transform,
-                                                    finalRMS,
-                                                    finalPointCount);
+    auto copyChunk = [&](unsigned c)
+    {
+        unsigned last = std::min(count, (c + 1) * chunkSize);
+        for (unsigned i = c * chunkSize; i < last; ++i)
+            distances[i] = dataCloud->getPointScalarValue(i);
+    };
+#ifdef CC_CORE_LIB_USES_TBB
+    tbb::parallel_for(static_cast<unsigned>(0), chunkCount, copyChunk);
+#else
+    for (unsigned c = 0; c < chunkCount; ++c)
+        copyChunk(c);
+#endif
 
-    if (result >= CCCoreLib::ICPRegistrationTools::ICP_ERROR)
+    //max distance at 'quantile' percent (invalid distances are ignored)
+    auto validEnd = std::partition(distances.begin(), distances.end(), [](ScalarType d) { return CCCoreLib::ScalarField::ValidValue(d); });
+    size_t validCount = static_cast<size_t>(validEnd - distances.begin());
+    if (validCount == 0)
     {
-        ccLog::Error("Registration failed: an error occurred (code %i)",result);
+        ccLog::Error("[ICP] No valid distance between data and model");
+        return nullptr;
+    }
+    size_t rank = std::min(static_cast<size_t>(std::max(1.0, count * quantile)), validCount) - 1;
+    std::nth_element(distances.begin(), distances.begin() + rank, validEnd);
+    ScalarType maxSearchDist = distances[rank];
+    distances.clear();
+    distances.shrink_to_fit();
+
+    //selection: count per chunk, then fill (one allocation)
+    auto countChunk = [&](unsigned c)
+    {
+        unsigned last = std::min(count, (c + 1) * chunkSize);
+        unsigned n = 0;
+        for (unsigned i = c * chunkSize; i < last; ++i)
+            if (dataCloud->getPointScalarValue(i) <= maxSearchDist)
+                ++n;
+        chunkStarts[c + 1] = n;
+    };
+#ifdef CC_CORE_LIB_USES_TBB
+    tbb::parallel_for(static_cast<unsigned>(0), chunkCount, countChunk);
+#else
+    for (unsigned c = 0; c < chunkCount; ++c)
+        countChunk(c);
+#endif
+    for (unsigned c = 0; c < chunkCount; ++c)
+        chunkStarts[c + 1] += chunkStarts[c];
+
+    //the indexes are written in a plain vector (ReferenceCloud is not thread safe, even with distinct indexes)
+    std::vector<unsigned> indexes;
+    try
+    {
+        indexes.resize(chunkStarts[chunkCount]);
     }
-    else if (result == CCCoreLib::ICPRegistrationTools::ICP_APPLY_TRANSFO)
+    catch (const std::bad_alloc&)
     {
-        transMat = FromCCLibMatrix<double, float>(transform.R, transform.T, transform.s);
-        finalScale = transform.s;
+        ccLog::Error("Not enough memory!");
+        return nullptr;
     }
+    auto fillChunk = [&](unsigned c)
+    {
+        unsigned last = std::min(count, (c + 1) * chunkSize);
+        unsigned pos = chunkStarts[c];
+        for (unsigned i = c * chunkSize; i < last; ++i)
+            if (dataCloud->getPointScalarValue(i) <= maxSearchDist)
+                indexes[pos++] = i;
+    };
+#ifdef CC_CORE_LIB_USES_TBB
+    tbb::parallel_for(static_cast<unsigned>(0), chunkCount, fillChunk);
+#else
+    for (unsigned c = 0; c < chunkCount; ++c)
+        fillChunk(c);
+#endif
 
-    //remove temporary SF (if any)
-    if (dataSfIdx >= 0)
+    CCCoreLib::ReferenceCloud* refCloud = new CCCoreLib::ReferenceCloud(dataCloud);
+    if (!refCloud->reserve(static_cast<unsigned>(indexes.size())))
     {
-        assert(data->isA(CC_TYPES::POINT_CLOUD));
-        ccPointCloud* pc = static_cast<ccPointCloud*>(data);
-        pc->setCurrentScalarField(oldDataSfIdx);
-        pc->deleteScalarField(dataSfIdx);
-        pc->showColors(restoreColorState);
-        pc->showSF(restoreSFState);
+        delete refCloud;
+        ccLog::Error("Not enough memory!");
+        return nullptr;
     }
+    for (unsigned index : indexes)
+        refCloud->addPointIndex(index);
 
-    return (result < CCCoreLib::ICPRegistrationTools::ICP_ERROR);
+    return refCloud;
 }
 
-bool computeNormals(std::vector<ccHObject*> selectedEntities,
-                    CCCoreLib::LOCAL_MODEL_TYPES model,
-                    bool useScanGridsForComputation,
-                    PointCoordinateType defaultRadius,
-                    double minGridAngle_deg,
-                    bool orientNormals,
-                    bool useScanGridsForOrientation,
-                    bool useSensorsForOrientation,
-                    ccNormalVectors::Orientation preferredOrientation,
-                    bool orientNormalsMST,
-                    int mstNeighbors,
-                    bool computePerVertexNormals)
+bool ICP(
+    ccHObject* data,
+    ccHObject* model,
+    ccGLMatrix& transMat,
+    double& finalScale,
+    double& finalRMS,
+    unsigned& finalPointCount,
+    double minRMSDecrease,
+    unsigned maxIterationCount,
+    unsigned randomSamplingLimit,
+    bool removeFarthestPoints,
+    CCCoreLib::ICPRegistrationTools::CONVERGENCE_TYPE method,
+    bool adjustScale,
+    double finalOverlapRatio,
+    bool useDataSFAsWeights,
+    bool useModelSFAsWeights,
+    int transformationFilters,
+    int maxThreadCount,
+    int pyramidLevels,
+    std::vector<ICPLevelInfo>* levelInfos,
+    ICP_OBJECTIVE objective)
 {
-    if (selectedEntities.empty())
-    {
-        ccLog::Error(QObject::tr("Select at least one point cloud"));
-        CCTRACE("Select at least one point cloud");
-        return false;
-    }
+    // TODO duplicated code from qCC / ccRegistrationTools::ICP
 
-    static const QString s_NormalScaleKey("Normal scale");
+    // Default number of points sampled on the 'data' mesh (if any)
+    const unsigned s_defaultSampledPointsOnDataMesh = 50000;
+    // Default temporary registration scalar field
+    const char REGISTRATION_DISTS_SF[] = "RegistrationDistances";
 
-    //look for clouds and meshes
-    std::vector<ccPointCloud*> clouds;
-    bool withScanGrid = false;
-    bool withSensor = false;
-    std::vector<ccMesh*> meshes;
+    bool restoreColorState = false;
+    bool restoreSFState = false;
 
-    try
-    {
-        for (const auto entity : selectedEntities)
-        {
-            if (entity->isA(CC_TYPES::POINT_CLOUD))
-            {
-                ccPointCloud* cloud = static_cast<ccPointCloud*>(entity);
-                clouds.push_back(cloud);
+    CCCoreLib::Garbage<CCCoreLib::GenericIndexedCloudPersist> cloudGarbage;
 
-                if (!withScanGrid)
-                {
-                    withScanGrid = (cloud->gridCount() > 0);
-                }
+    //if the 'model' entity is a mesh, we need to sample points on it
+    CCCoreLib::GenericIndexedCloudPersist* modelCloud = nullptr;
+    ccGenericMesh* modelMesh = nullptr;
+    if (model->isKindOf(CC_TYPES::MESH))
+    {
+        modelMesh = ccHObjectCaster::ToGenericMesh(model);
+        modelCloud = modelMesh->getAssociatedCloud();
+    }
+    else
+    {
+        modelCloud = ccHObjectCaster::ToGenericPointCloud(model);
+    }
 
-                if (!withSensor)
-                {
-                    for (unsigned i = 0; i < cloud->getChildrenNumber(); ++i)
-                    {
-                        if (cloud->hasSensor())
-                        {
-                            withSensor = true;
-                            break; //no need to look anyfurther
-                        }
-                    }
-                }
+    //if the 'data' entity is a mesh, we need to sample points on it
+    CCCoreLib::GenericIndexedCloudPersist* dataCloud = nullptr;
+    if (data->isKindOf(CC_TYPES::MESH))
+    {
+        dataCloud = CCCoreLib::MeshSamplingTools::samplePointsOnMesh(ccHObjectCaster::ToGenericMesh(data), s_defaultSampledPointsOnDataMesh);
+        if (!dataCloud)
+        {
+            ccLog::Error("[ICP] Failed to sample points on 'data' mesh!");
+            return false;
+        }
+        cloudGarbage.add(dataCloud);
+    }
+    else
+    {
+        dataCloud = ccHObjectCaster::ToGenericPointCloud(data);
+    }
 
-                //does the cloud have a former radius value saved as meta-data?
-                if (cloud->hasMetaData(s_NormalScaleKey))
-                {
-                    bool ok = false;
-                    double formerRadius = cloud->getMetaData(s_NormalScaleKey).toDouble(&ok);
-                    if (ok)
-                    {
-                        //remember the largest radius
-                        defaultRadius = std::max(defaultRadius, static_cast<PointCoordinateType>(formerRadius));
-                    }
-                    else
-                    {
-                        assert(false);
-                    }
-                }
+    //we activate a temporary scalar field for registration distances computation
+    CCCoreLib::ScalarField* dataDisplayedSF = nullptr;
+    int oldDataSfIdx = -1;
+    int dataSfIdx = -1;
 
-                if (defaultRadius == 0.0)
-                {
-                    //default radius
-                    defaultRadius = ccOctree::GuessNaiveRadius(cloud);
-                }
-            }
-            else if (entity->isKindOf(CC_TYPES::MESH))
-            {
-                if (entity->isA(CC_TYPES::MESH))
-                {
-                    ccMesh* mesh = ccHObjectCaster::ToMesh(entity);
-                    meshes.push_back(mesh);
-                }
-                else
-                {
-                    ccLog::Error(QObject::tr("Can't compute normals on sub-meshes! Select the parent mesh instead"));
-                    CCTRACE("Can't compute normals on sub-meshes! Select the parent mesh instead");
-                    return false;
-                }
-            }
+    //if the 'data' entity is a real ccPointCloud, we can even create a proper temporary SF for registration distances
+    if (data->isA(CC_TYPES::POINT_CLOUD))
+    {
+        ccPointCloud* pc = static_cast<ccPointCloud*>(data);
+        restoreColorState = pc->colorsShown();
+        restoreSFState = pc->sfShown();
+        dataDisplayedSF = pc->getCurrentDisplayedScalarField();
+        oldDataSfIdx = pc->getCurrentInScalarFieldIndex();
+        dataSfIdx = pc->getScalarFieldIndexByName(REGISTRATION_DISTS_SF);
+        if (dataSfIdx < 0)
+            dataSfIdx = pc->addScalarField(REGISTRATION_DISTS_SF);
+        if (dataSfIdx >= 0)
+            pc->setCurrentScalarField(dataSfIdx);
+        else
+        {
+            ccLog::Error("[ICP] Couldn't create temporary scalar field! Not enough memory?");
+            return false;
         }
-    } catch (const std::bad_alloc&)
+    }
+    else
     {
-        ccLog::Error(QObject::tr("Not enough memory!"));
-        CCTRACE("Not enough memory!");
-        return false;
+        if (!dataCloud->enableScalarField())
+        {
+            ccLog::Error("[ICP] Couldn't create temporary scalar field! Not enough memory?");
+            return false;
+        }
     }
 
-    //compute normals for each selected cloud
-    if (!clouds.empty())
-    {
-//        static CCCoreLib::LOCAL_MODEL_TYPES s_lastModelType = CCCoreLib::LS;
-//        static ccNormalVectors::Orientation s_lastNormalOrientation = ccNormalVectors::UNDEFINED;
-//        static int s_lastMSTNeighborCount = 6;
-//        static double s_lastMinGridAngle_deg = 1.0;
-
-//        ccNormalComputationDlg ncDlg(withScanGrid, withSensor, nullptr);
-//        ncDlg.setLocalModel(s_lastModelType);
-//        ncDlg.setRadius(defaultRadius);
-//        ncDlg.setPreferredOrientation(s_lastNormalOrientation);
-//        ncDlg.setMSTNeighborCount(s_lastMSTNeighborCount);
-//        ncDlg.setMinGridAngle_deg(s_lastMinGridAngle_deg);
-//        if (clouds.size() == 1)
-//        {
-//            ncDlg.setCloud(clouds.front());
-//        }
-//
-//        if (!ncDlg.exec())
-//            return false;
+    //add a 'safety' margin to input ratio
+    static double s_overlapMarginRatio = 0.2;
+    finalOverlapRatio = std::max(finalOverlapRatio, 0.01); //1% minimum
+    //do we need to reduce the input point cloud (so as to be close
+    //to the theoretical number of overlapping points - but not too
+    //low so as we are not registered yet ;)
+    if (finalOverlapRatio < 1.0 - s_overlapMarginRatio)
+    {
+        //DGM we can now use 'approximate' distances as SAITO algorithm is exact (but with a coarse resolution)
+        //level = 7 if < 1.000.000
+        //level = 8 if < 10.000.000
+        //level = 9 if > 10.000.000
+        int gridLevel = static_cast<int>(std::floor(std::log10(static_cast<long double>(std::max(dataCloud->size(), modelCloud->size()))))) + 2;
+            gridLevel = std::min(std::max(gridLevel, 7), 9);
+        int result = -1;
+        if (modelMesh)
+        {
+            CCCoreLib::DistanceComputationTools::Cloud2MeshDistancesComputationParams c2mParams;
+            c2mParams.octreeLevel = gridLevel;
+            c2mParams.maxSearchDist = 0;
+            c2mParams.useDistanceMap = true;
+            c2mParams.signedDistances = false;
+            c2mParams.flipNormals = false;
+            c2mParams.multiThread = true;
+            c2mParams.maxThreadCount = maxThreadCount;
+            result = CCCoreLib::DistanceComputationTools::computeCloud2MeshDistances(dataCloud, modelMesh, c2mParams);
+        }
+        else
+        {
+            //the approximate distances are kept (far cheaper on the far, non overlapping points); only the
+            //selection below is parallel
+            result = CCCoreLib::DistanceComputationTools::computeApproxCloud2CloudDistance( dataCloud,
+                                                                                        modelCloud,
+                                                                                        gridLevel,
+                                                                                        -1);
+        }
 
-        //normals computation
-        bool useGridStructure = withScanGrid && useScanGridsForComputation;
-//        double minGridAngle_deg = s_lastMinGridAngle_deg = ncDlg.getMinGridAngle_deg();
+        if (result < 0)
+        {
+            ccLog::Error("Failed to determine the max (overlap) distance (not enough memory?)");
+            return false;
+        }
 
-        //normals orientation
-//        bool orientNormals = ncDlg.orientNormals();
-        bool orientNormalsWithGrids = withScanGrid && useScanGridsForOrientation;
-        bool orientNormalsWithSensors = withSensor && useSensorsForOrientation;
-//        ccNormalVectors::Orientation preferredOrientation = s_lastNormalOrientation = ncDlg.getPreferredOrientation();
-//        bool orientNormalsMST = ncDlg.useMSTOrientation();
-//        int mstNeighbors = s_lastMSTNeighborCount = ncDlg.getMSTNeighborCount();
+        //select the points with distance below the distance at 'finalOverlapRatio + margin' percent
+        {
+            unsigned countBefore = dataCloud->size();
+            CCCoreLib::ReferenceCloud* refCloud = SelectOverlapPoints_(dataCloud, finalOverlapRatio + s_overlapMarginRatio, maxThreadCount);
+            if (!refCloud)
+            {
+                return false;
+            }
+            cloudGarbage.add(refCloud);
+            dataCloud = refCloud;
 
-//        ccProgressDialog pDlg(true, parent);
-//        pDlg.setAutoClose(false);
+            unsigned countAfter = dataCloud->size();
+            double keptRatio = static_cast<double>(countAfter)/countBefore;
+            ccLog::Print(QString("[ICP][Partial overlap] Selecting %1 points out of %2 (%3%) for registration").arg(countAfter).arg(countBefore).arg(static_cast<int>(100*keptRatio)));
 
-        size_t errors = 0;
+            //update the relative 'final overlap' ratio
+            finalOverlapRatio /= keptRatio;
+        }
+    }
 
-        for (auto cloud : clouds)
+    //weights
+    CCCoreLib::ScalarField* modelWeights = nullptr;
+    CCCoreLib::ScalarField* dataWeights = nullptr;
+    {
+        if (!modelMesh && useModelSFAsWeights)
         {
-            Q_ASSERT(cloud != nullptr);
-
-            bool result = false;
-            bool normalsAlreadyOriented = false;
-
-            if (useGridStructure && cloud->gridCount())
+            if (modelCloud == dynamic_cast<CCCoreLib::GenericIndexedCloudPersist*>(model) && model->isA(CC_TYPES::POINT_CLOUD))
             {
-                //compute normals with the associated scan grid(s)
-                normalsAlreadyOriented = true;
-                result = cloud->computeNormalsWithGrids(minGridAngle_deg, nullptr);
+                ccPointCloud* pc = static_cast<ccPointCloud*>(model);
+                modelWeights = pc->getCurrentDisplayedScalarField();
+                if (!modelWeights)
+                    ccLog::Warning("[ICP] 'useDataSFAsWeights' is true but model has no displayed scalar field!");
             }
             else
             {
-                //compute normals with the octree
-                normalsAlreadyOriented = orientNormals && (preferredOrientation != ccNormalVectors::UNDEFINED);
-                result = cloud->computeNormalsWithOctree(
-                        model, orientNormals ? preferredOrientation : ccNormalVectors::UNDEFINED, defaultRadius, nullptr);
-                if (result)
-                {
-                    //save the normal computation radius as meta-data
-                    cloud->setMetaData(s_NormalScaleKey, defaultRadius);
-                }
-            }
-
-            //do we need to orient the normals? (this may have been already done if 'orientNormalsForThisCloud' is true)
-            if (result && orientNormals && !normalsAlreadyOriented)
-            {
-                if (cloud->gridCount() && orientNormalsWithGrids)
-                {
-                    //we can still use the grid structure(s) to orient the normals!
-                    result = cloud->orientNormalsWithGrids();
-                }
-                else if (cloud->hasSensor() && orientNormalsWithSensors)
-                {
-                    result = false;
-
-                    // RJ: TODO: the issue here is that a cloud can have multiple sensors.
-                    // As the association to sensor is not explicit in CC, given a cloud
-                    // some points can belong to one sensor and some others can belongs to others sensors.
-                    // so it's why here grid orientation has precedence over sensor orientation because in this
-                    // case association is more explicit.
-                    // Here we take the first valid viewpoint for now even if it's not a really good...
-                    CCVector3 sensorPosition;
-                    for (size_t i = 0; i < cloud->getChildrenNumber(); ++i)
-                    {
-                        ccHObject* child = cloud->getChild(static_cast<unsigned>(i));
-                        if (child && child->isKindOf(CC_TYPES::SENSOR))
-                        {
-                            ccSensor* sensor = ccHObjectCaster::ToSensor(child);
-                            if (sensor->getActiveAbsoluteCenter(sensorPosition))
-                            {
-                                result = cloud->orientNormalsTowardViewPoint(sensorPosition, nullptr);
-                                break;
-                            }
-                        }
-                    }
-                }
-                else if (orientNormalsMST)
-                {
-                    //use Minimum Spanning Tree to resolve normals direction
-                    result = cloud->orientNormalsWithMST(mstNeighbors, nullptr);
-                }
-            }
-
-            if (!result)
-            {
-                ++errors;
+                ccLog::Warning("[ICP] 'useDataSFAsWeights' is true but only point cloud scalar fields can be used as weights!");
             }
-
-            cloud->prepareDisplayForRefresh();
         }
 
-        if (errors != 0)
+        if (useDataSFAsWeights)
         {
-            if (errors < clouds.size())
+            if (!dataDisplayedSF)
             {
-                ccLog::Error(QObject::tr("Failed to compute or orient the normals on some clouds! (see console)"));
-                CCTRACE("Failed to compute or orient the normals on some clouds! (see console)");
+                if (dataCloud == ccHObjectCaster::ToPointCloud(data))
+                    ccLog::Warning("[ICP] 'useDataSFAsWeights' is true but data has no displayed scalar field!");
+                else
+                    ccLog::Warning("[ICP] 'useDataSFAsWeights' is true but only point cloud scalar fields can be used as weights!");
             }
             else
             {
-                ccLog::Error(QObject::tr("Failed to compute or orient the normals! (see console)"));
-                CCTRACE("Failed to compute or orient the normals! (see console)");
+                dataWeights = dataDisplayedSF;
             }
         }
     }
 
-    //compute normals for each selected mesh
-    if (!meshes.empty())
+    CCCoreLib::ICPRegistrationTools::RESULT_TYPE result;
+    CCCoreLib::PointProjectionTools::Transformation transform;
+    CCCoreLib::ICPRegistrationTools::Parameters params;
     {
-//        QMessageBox question(QMessageBox::Question, QObject::tr("Mesh normals"),
-//                             QObject::tr("Compute per-vertex normals (smooth) or per-triangle (faceted)?"),
-//                             QMessageBox::NoButton, parent);
-//
-//        QPushButton* perVertexButton = question.addButton(QObject::tr("Per-vertex"), QMessageBox::YesRole);
-//        QPushButton* perTriangleButton = question.addButton(QObject::tr("Per-triangle"), QMessageBox::NoRole);
-//
-//        question.exec();
-//
-//        bool computePerVertexNormals = (question.clickedButton() == perVertexButton);
+        params.convType = method;
+        params.minRMSDecrease = minRMSDecrease;
+        params.nbMaxIterations = maxIterationCount;
+        params.adjustScale = adjustScale;
+        params.filterOutFarthestPoints = removeFarthestPoints;
+        params.samplingLimit = randomSamplingLimit;
+        params.finalOverlapRatio = finalOverlapRatio;
+        params.modelWeights = modelWeights;
+        params.dataWeights = dataWeights;
+        params.transformationFilters = transformationFilters;
+        params.maxThreadCount = maxThreadCount;
+    }
 
-        for (auto mesh : meshes)
+    //point-to-plane objectives: model octree and normals (shared by all the pyramid levels)
+    std::unique_ptr<ICPPlaneModel_> planeModel;
+    if (objective != POINT_TO_POINT)
+    {
+        if (adjustScale || modelWeights || dataWeights)
         {
-            Q_ASSERT(mesh != nullptr);
+            ccLog::Warning("[ICP] scale adjustment and weights are not supported with the point-to-plane objectives (ignored)");
+        }
+        planeModel.reset(new ICPPlaneModel_);
+        if (!planeModel->init(modelCloud))
+        {
+            planeModel.reset();
+            result = CCCoreLib::ICPRegistrationTools::ICP_ERROR_INVALID_INPUT;
+        }
+    }
 
-//            //we remove temporarily the mesh as its normals may be removed (and they can be a child object)
-//            ccMainAppInterface* instance = dynamic_cast<ccMainAppInterface*>(parent);
-//            ccMainAppInterface::ccHObjectContext objContext;
-//            if (instance)
-//                objContext = instance->removeObjectTemporarilyFromDBTree(mesh);
-//            mesh->clearTriNormals();
-//            mesh->showNormals(false);
-            bool result = mesh->computeNormals(computePerVertexNormals);
-//            if (instance)
-//                instance->putObjectBackIntoDBTree(mesh, objContext);
+    //point-to-point pyramid: the model octree is built once, and shared by the levels (linearized point-to-point
+    //objective). The full resolution level uses CCCoreLib ICP if it needs the mesh, the scale or the weights.
+    bool lastLevelWithCCLib = false;
+    if (objective == POINT_TO_POINT && pyramidLevels > 1)
+    {
+        planeModel.reset(new ICPPlaneModel_);
+        if (!planeModel->init(modelCloud, false))
+        {
+            planeModel.reset(); //each level will use CCCoreLib ICP
+        }
+        lastLevelWithCCLib = (modelMesh || adjustScale || modelWeights || dataWeights);
+    }
 
-            if (!result)
+    std::vector<ICPLevelInfo> levels;
+    if (objective != POINT_TO_POINT && !planeModel)
+    {
+        //error already logged
+    }
+    else if (pyramidLevels > 1)
+    {
+        ccGLMatrixd totalTrans;
+        double totalScale = 1.0;
+        result = RegisterPyramid_(  modelCloud,
+                                    modelMesh,
+                                    dataCloud,
+                                    params,
+                                    pyramidLevels,
+                                    totalTrans,
+                                    totalScale,
+                                    finalRMS,
+                                    finalPointCount,
+                                    levels,
+                                    planeModel.get(),
+                                    objective,
+                                    lastLevelWithCCLib);
+        if (result == CCCoreLib::ICPRegistrationTools::ICP_APPLY_TRANSFO)
+        {
+            transMat = ccGLMatrix(totalTrans.data());
+            finalScale = totalScale;
+        }
+    }
+    else
+    {
+        QElapsedTimer timer;
+        timer.start();
+        if (planeModel)
+        {
+            ccGLMatrixd planeTrans;
+            result = RegisterPlane_(*planeModel, dataCloud, params, objective, planeTrans, finalRMS, finalPointCount);
+            if (result == CCCoreLib::ICPRegistrationTools::ICP_APPLY_TRANSFO)
             {
-                ccLog::Error(QObject::tr("Failed to compute normals on mesh '%1'").arg(mesh->getName()));
-                CCTRACE("Failed to compute normals on mesh " << mesh->getName().toStdString());
-                continue;
+                transMat = ccGLMatrix(planeTrans.data());
+                finalScale = 1.0;
+            }
+        }
+        else
+        {
+            result = CCCoreLib::ICPRegistrationTools::Register( modelCloud,
+                                                            modelMesh,
+                                                            dataCloud,
+                                                            params,
+                                                            transform,
+                                                            finalRMS,
+                                                            finalPointCount);
+            if (result == CCCoreLib::ICPRegistrationTools::ICP_APPLY_TRANSFO)
+            {
+                transMat = FromCCLibMatrix<double, float>(transform.R, transform.T, transform.s);
+                finalScale = transform.s;
             }
-            mesh->prepareDisplayForRefresh_recursive();
         }
+        ICPLevelInfo info;
+        info.pointCount = std::min(dataCloud->size(), params.samplingLimit != 0 ? params.samplingLimit : dataCloud->size());
+        info.rms = finalRMS;
+        info.duration = timer.elapsed() / 1000.0;
+        levels.push_back(info);
     }
 
-    return true;
+    if (result >= CCCoreLib::ICPRegistrationTools::ICP_ERROR)
+    {
+        ccLog::Error("Registration failed: an error occurred (code %i)",result);
+    }
+    if (levelInfos)
+    {
+        *levelInfos = levels;
+    }
+
+    //remove temporary SF (if any)
+    if (dataSfIdx >= 0)
+    {
+        assert(data->isA(CC_TYPES::POINT_CLOUD));
+        ccPointCloud* pc = static_cast<ccPointCloud*>(data);
+        pc->setCurrentScalarField(oldDataSfIdx);
+        pc->deleteScalarField(dataSfIdx);
+        pc->showColors(restoreColorState);
+        pc->showSF(restoreSFState);
+    }
+
+    return (result < CCCoreLib::ICPRegistrationTools::ICP_ERROR);
 }
 
-bool invertNormals(std::vector<ccHObject*> selectedEntities)
+//! Global poses from the pairwise registrations (see ICPMultiView)
+/** The poses are first propagated along a breadth first spanning tree of the pair graph, from the first cloud
+    of each connected component (which keeps its position). They are then relaxed: each pose is replaced by the
+    weighted mean (weights 1/RMS^2) of the poses given by its pairs, the rotations being averaged around the current pose.
+**/
+void RefinePoseGraph_(size_t cloudCount, const std::vector<ICPPairInfo>& pairs, std::vector<ccGLMatrixd>& poses, unsigned maxIterations = 100)
 {
-    for (ccHObject* ent : selectedEntities)
+    poses.assign(cloudCount, ccGLMatrixd());
+    std::vector<std::vector<size_t>> cloudPairs(cloudCount);
+    for (size_t k = 0; k < pairs.size(); ++k)
     {
-        // is it a mesh?
-        ccMesh* mesh = ccHObjectCaster::ToMesh(ent);
-        if (mesh && mesh->hasNormals())
+        if (pairs[k].success)
         {
-            mesh->invertNormals();
+            cloudPairs[pairs[k].modelIndex].push_back(k);
+            cloudPairs[pairs[k].dataIndex].push_back(k);
+        }
+    }
+
+    //pose of a cloud given by one of its pairs: pose(data) = pose(model) * transMat
+    auto poseFromPair = [&](size_t cloudIndex, const ICPPairInfo& pair)
+    {
+        if (cloudIndex == pair.dataIndex)
+            return ccGLMatrixd(poses[pair.modelIndex] * pair.transMat);
+        return ccGLMatrixd(poses[pair.dataIndex] * pair.transMat.inverse());
+    };
+
+    //spanning trees
+    std::vector<bool> isRoot(cloudCount, false);
+    std::vector<bool> reached(cloudCount, false);
+    for (size_t root = 0; root < cloudCount; ++root)
+    {
+        if (reached[root])
             continue;
+        isRoot[root] = true;
+        reached[root] = true;
+        std::vector<size_t> queue(1, root);
+        for (size_t q = 0; q < queue.size(); ++q)
+        {
+            size_t u = queue[q];
+            for (size_t k : cloudPairs[u])
+            {
+                size_t v = (pairs[k].modelIndex == u ? pairs[k].dataIndex : pairs[k].modelIndex);
+                if (!reached[v])
+                {
+                    reached[v] = true;
+                    poses[v] = poseFromPair(v, pairs[k]);
+                    queue.push_back(v);
+                }
+            }
         }
+    }
 
-        // is it a cloud?
-        ccPointCloud* cloud = ccHObjectCaster::ToPointCloud(ent);
-        if (cloud && cloud->hasNormals())
+    //relaxation
+    for (unsigned iteration = 0; iteration < maxIterations; ++iteration)
+    {
+        double maxChange = 0;
+        for (size_t v = 0; v < cloudCount; ++v)
         {
-            cloud->invertNormals();
+            if (isRoot[v] || cloudPairs[v].empty())
+                continue;
+            ccGLMatrixd inversePose = poses[v].inverse();
+            CCVector3d sumRotation(0, 0, 0);
+            CCVector3d sumTranslation(0, 0, 0);
+            double sumWeights = 0;
+            for (size_t k : cloudPairs[v])
+            {
+                ccGLMatrixd candidate = poseFromPair(v, pairs[k]);
+                double weight = 1.0 / std::max(pairs[k].rms * pairs[k].rms, 1.0e-12);
+                double alpha = 0;
+                CCVector3d axis;
+                CCVector3d t;
+                (inversePose * candidate).getParameters(alpha, axis, t);
+                sumRotation += axis * (alpha * weight);
+                sumTranslation += candidate.getTranslationAsVec3D() * weight;
+                sumWeights += weight;
+            }
+            CCVector3d meanRotation = sumRotation / sumWeights;
+            CCVector3d meanTranslation = sumTranslation / sumWeights;
+            double angle = meanRotation.norm();
+            ccGLMatrixd rotation;
+            if (angle > 0)
+                rotation.initFromParameters(angle, meanRotation / angle, CCVector3d(0, 0, 0));
+            double change = angle + (meanTranslation - poses[v].getTranslationAsVec3D()).norm();
+            poses[v] = poses[v] * rotation;
+            poses[v].setTranslation(meanTranslation);
+            maxChange = std::max(maxChange, change);
         }
+        if (maxChange < 1.0e-9)
+            break;
     }
-    return true;
 }
 
-//! TODO: Copied/adpated from qCC/ccVolumeCalcTool::ComputeVolume
-bool ComputeVolume_(    ccRasterGrid& grid,
-                        ccGenericPointCloud* ground,
-                        ccGenericPointCloud* ceil,
-                        const ccBBox& gridBox,
-                        unsigned char vertDim,
-                        double gridStep,
-                        unsigned gridWidth,
-                        unsigned gridHeight,
-                        ccRasterGrid::ProjectionType projectionType,
-                        ccRasterGrid::EmptyCellFillOption groundEmptyCellFillStrategy,
-                        double groundMaxEdgeLength,
-                        ccRasterGrid::EmptyCellFillOption ceilEmptyCellFillStrategy,
-                        double ceilMaxEdgeLength,
-                        ReportInfoVol* reportInfo,
-                        double groundHeight = std::numeric_limits<double>::quiet_NaN(),
-                        double ceilHeight = std::numeric_limits<double>::quiet_NaN())
+bool ICPMultiView(const std::vector<ccPointCloud*>& clouds,
+                  std::vector<ICPPairInfo>& pairs,
+                  std::vector<ccGLMatrixd>* globalTransforms,
+                  double minRMSDecrease,
+                  unsigned maxIterationCount,
+                  unsigned randomSamplingLimit,
+                  bool removeFarthestPoints,
+                  CCCoreLib::ICPRegistrationTools::CONVERGENCE_TYPE method,
+                  double finalOverlapRatio,
+                  int transformationFilters,
+                  int maxThreadCount,
+                  ICP_OBJECTIVE objective)
 {
-    if (    gridStep <= 1.0e-8
-        ||  gridWidth == 0
-        ||  gridHeight == 0
-        ||  vertDim > 2)
-    {
-        ccLog::Warning("[Volume] Invalid input parameters");
-        CCTRACE("[Volume] Invalid input parameters");
-        return false;
-    }
-
-    if (!ground && !ceil)
-    {
-        ccLog::Warning("[Volume] No valid input cloud");
-        CCTRACE("[Volume] No valid input cloud");
-        return false;
-    }
-
-    if (!gridBox.isValid())
+    size_t cloudCount = clouds.size();
+    if (cloudCount < 2 || std::find(clouds.begin(), clouds.end(), nullptr) != clouds.end())
     {
-        ccLog::Warning("[Volume] Invalid bounding-box");
-        CCTRACE("[Volume] Invalid bounding-box");
+        ccLog::Error("[ICPMultiView] At least two valid clouds are required");
         return false;
     }
 
-    //grid size
-    unsigned gridTotalSize = gridWidth * gridHeight;
-
-    //memory allocation
-    CCVector3d minCorner = gridBox.minCorner();
-    if (!grid.init(gridWidth, gridHeight, gridStep, minCorner))
+    //pair graph: clouds with overlapping bounding boxes, if not given
+    if (pairs.empty())
     {
-        //not enough memory
-        ccLog::Error(QObject::tr("Not enough memory!"));
-        CCTRACE("Not enough memory!");
-        return false;
+        std::vector<ccBBox> boxes(cloudCount);
+        for (size_t i = 0; i < cloudCount; ++i)
+            boxes[i] = clouds[i]->getOwnBB();
+        for (size_t i = 0; i < cloudCount; ++i)
+        {
+            for (size_t j = i + 1; j < cloudCount; ++j)
+            {
+                bool overlap = true;
+                for (unsigned d = 0; d < 3; ++d)
+                    overlap = overlap && boxes[i].minCorner().u[d] <= boxes[j].maxCorner().u[d] && boxes[j].minCorner().u[d] <= boxes[i].maxCorner().u[d];
+                if (overlap)
+                {
+                    ICPPairInfo pair;
+                    pair.modelIndex = static_cast<unsigned>(i);
+                    pair.dataIndex = static_cast<unsigned>(j);
+                    pairs.push_back(pair);
+                }
+            }
+        }
+        CCTRACE("ICPMultiView: " << pairs.size() << " overlapping pairs");
     }
 
-    //progress dialog
-    QScopedPointer<ccProgressDialog> pDlg(nullptr);
-
-    ccRasterGrid groundRaster;
-    if (ground)
+    //per cloud cache: octree and normals (as a model), sampled points and their normals (as data, symmetric objective)
+    //all the objectives use RegisterPlane_ on the cached model (without normals for the linearized point-to-point
+    //objective, as the pyramid does), so that each model octree is built once
+    const bool withNormals = (objective != POINT_TO_POINT);
+    const bool symmetric = (objective == SYMMETRIC_POINT_TO_PLANE);
+    std::vector<std::unique_ptr<ICPPlaneModel_>> models(cloudCount);
+    std::vector<std::unique_ptr<CCCoreLib::ReferenceCloud>> samples(cloudCount);
+    std::vector<std::vector<CCVector3d>> sampleNormals(cloudCount);
+    std::vector<char> isData(cloudCount, 0);
+    for (ICPPairInfo& pair : pairs)
     {
-        if (!groundRaster.init(gridWidth, gridHeight, gridStep, minCorner))
+        pair.success = false;
+        if (pair.modelIndex >= cloudCount || pair.dataIndex >= cloudCount || pair.modelIndex == pair.dataIndex)
         {
-            //not enough memory
-            ccLog::Error(QObject::tr("Not enough memory!"));
-            CCTRACE("Not enough memory!");
+            ccLog::Error("[ICPMultiView] Invalid pair (%u, %u)", pair.modelIndex, pair.dataIndex);
             return false;
         }
-
-        ccRasterGrid::InterpolationType interpolationType = ccRasterGrid::InterpolationTypeFromEmptyCellFillOption(groundEmptyCellFillStrategy);
-        ccRasterGrid::DelaunayInterpolationParams dInterpParams;
-        void* interpolationParams = nullptr;
-        switch (interpolationType)
-        {
-        case ccRasterGrid::InterpolationType::DELAUNAY:
-            dInterpParams.maxEdgeLength = groundMaxEdgeLength;
-            interpolationParams = (void*)&dInterpParams;
-            break;
-        case ccRasterGrid::InterpolationType::KRIGING:
-            // not supported yet
-            assert(false);
-            break;
-        default:
-            // do nothing
-            break;
-        }
-
-        if (groundRaster.fillWith(  ground,
-                                    vertDim,
-                                    projectionType,
-                                    interpolationType,
-                                    interpolationParams,
-                                    ccRasterGrid::INVALID_PROJECTION_TYPE,
-                                    pDlg.data()))
-        {
-            groundRaster.fillEmptyCells(groundEmptyCellFillStrategy, groundHeight);
-            ccLog::Print(QString("[Volume] Ground raster grid: size: %1 x %2 / heights: [%3 ; %4]").arg(groundRaster.width).arg(groundRaster.height).arg(groundRaster.minHeight).arg(groundRaster.maxHeight));
-        }
-        else
+        if (!models[pair.modelIndex])
         {
-            return false;
+            //the entities (normals tables) are created here, sequentially
+            models[pair.modelIndex].reset(new ICPPlaneModel_);
+            if (!models[pair.modelIndex]->prepare(clouds[pair.modelIndex], withNormals))
+                return false;
         }
+        isData[pair.dataIndex] = 1;
     }
 
-    //ceil
-    ccRasterGrid ceilRaster;
-    if (ceil)
+    //the octrees, normals and samplings of the clouds are computed in parallel
+    std::vector<char> setupFailed(cloudCount, 0);
+    auto setupCloud = [&](size_t i)
     {
-        if (!ceilRaster.init(gridWidth, gridHeight, gridStep, minCorner))
+        if (models[i] && !models[i]->build())
         {
-            //not enough memory
-            ccLog::Error(QObject::tr("Not enough memory!"));
-            CCTRACE("Not enough memory!");
-            return false;
+            setupFailed[i] = 1;
+            return;
         }
-
-        ccRasterGrid::InterpolationType interpolationType = ccRasterGrid::InterpolationTypeFromEmptyCellFillOption(ceilEmptyCellFillStrategy);
-        ccRasterGrid::DelaunayInterpolationParams dInterpParams;
-        void* interpolationParams = nullptr;
-        switch (interpolationType)
+        if (isData[i])
         {
-        case ccRasterGrid::InterpolationType::DELAUNAY:
-            dInterpParams.maxEdgeLength = ceilMaxEdgeLength;
-            interpolationParams = (void*)&dInterpParams;
-            break;
-        case ccRasterGrid::InterpolationType::KRIGING:
-            // not supported yet
-            assert(false);
-            break;
-        default:
-            // do nothing
-            break;
-        }
+            ccPointCloud* dataCloud = clouds[i];
+            CCCoreLib::ReferenceCloud* sample = nullptr;
+            if (randomSamplingLimit != 0 && dataCloud->size() > randomSamplingLimit)
+            {
+                sample = CCCoreLib::CloudSamplingTools::subsampleCloudRandomly(dataCloud, randomSamplingLimit);
+            }
+            else
+            {
+                sample = new CCCoreLib::ReferenceCloud(dataCloud);
+                if (!sample->addPointIndex(0, dataCloud->size()))
+                {
+                    delete sample;
+                    sample = nullptr;
+                }
+            }
+            if (!sample)
+            {
+                setupFailed[i] = 1;
+                return;
+            }
+            samples[i].reset(sample);
 
-        if (ceilRaster.fillWith(ceil,
-                                vertDim,
-                                projectionType,
-                                interpolationType,
-                                interpolationParams,
-                                ccRasterGrid::INVALID_PROJECTION_TYPE,
-                                pDlg.data()))
-        {
-            ceilRaster.fillEmptyCells(ceilEmptyCellFillStrategy, ceilHeight);
-            ccLog::Print(QString("[Volume] Ceil raster grid: size: %1 x %2 / heights: [%3 ; %4]").arg(ceilRaster.width).arg(ceilRaster.height).arg(ceilRaster.minHeight).arg(ceilRaster.maxHeight));
+            if (symmetric)
+            {
+                //data normals: the octree of the cloud is shared with its model role, if any
+                std::unique_ptr<CCCoreLib::DgmOctree> ownOctree;
+                const CCCoreLib::DgmOctree* octree = (models[i] ? models[i]->m_octree.get() : nullptr);
+                if (!octree)
+                {
+                    ownOctree.reset(new CCCoreLib::DgmOctree(dataCloud));
+                    if (ownOctree->build() <= 0)
+                    {
+                        setupFailed[i] = 1;
+                        return;
+                    }
+                    octree = ownOctree.get();
+                }
+                try
+                {
+                    sampleNormals[i].resize(sample->size());
+                }
+                catch (const std::bad_alloc&)
+                {
+                    setupFailed[i] = 1;
+                    return;
+                }
+                ComputeICPDataNormals_(*octree, octree->findBestLevelForAGivenPopulationPerCell(4), dataCloud, sample, 0, sample->size(), sampleNormals[i]);
+            }
         }
-        else
+    };
+#ifdef CC_CORE_LIB_USES_TBB
+    tbb::parallel_for(static_cast<size_t>(0), cloudCount, setupCloud);
+#else
+    for (size_t i = 0; i < cloudCount; ++i)
+        setupCloud(i);
+#endif
+    for (size_t i = 0; i < cloudCount; ++i)
+    {
+        if (setupFailed[i])
         {
+            ccLog::Error(QString("[ICPMultiView] Failed to compute the octree, normals or sampling of cloud %1 (not enough memory?)").arg(i));
             return false;
         }
     }
 
-    //update grid and compute volume
+    CCCoreLib::ICPRegistrationTools::Parameters params;
+    {
+        params.convType = method;
+        params.minRMSDecrease = minRMSDecrease;
+        params.nbMaxIterations = maxIterationCount;
+        params.filterOutFarthestPoints = removeFarthestPoints;
+        params.samplingLimit = 0; //already sampled
+        params.finalOverlapRatio = std::max(finalOverlapRatio, 0.01);
+        params.transformationFilters = transformationFilters;
+        params.maxThreadCount = maxThreadCount;
+    }
+
+    //pairwise registrations
+    auto registerPair = [&](size_t k)
+    {
+        ICPPairInfo& pair = pairs[k];
+        CCCoreLib::ICPRegistrationTools::RESULT_TYPE result = RegisterPlane_(*models[pair.modelIndex],
+                                                                             samples[pair.dataIndex].get(),
+                                                                             params,
+                                                                             objective,
+                                                                             pair.transMat,
+                                                                             pair.rms,
+                                                                             pair.pointCount,
+                                                                             symmetric ? &sampleNormals[pair.dataIndex] : nullptr);
+        pair.success = (result == CCCoreLib::ICPRegistrationTools::ICP_APPLY_TRANSFO);
+    };
+#ifdef CC_CORE_LIB_USES_TBB
+    tbb::parallel_for(static_cast<size_t>(0), pairs.size(), registerPair);
+#else
+    for (size_t k = 0; k < pairs.size(); ++k)
+        registerPair(k);
+#endif
+    for (const ICPPairInfo& pair : pairs)
     {
+        CCTRACE("ICPMultiView pair (" << pair.modelIndex << ", " << pair.dataIndex << ") success: " << pair.success << " RMS: " << pair.rms);
+    }
 
-        size_t ceilNonMatchingCount = 0;
-        size_t groundNonMatchingCount = 0;
-        size_t cellCount = 0;
+    if (globalTransforms)
+    {
+        RefinePoseGraph_(cloudCount, pairs, *globalTransforms);
+    }
+    return true;
+}
 
-        //at least one of the grid is based on a cloud
-        grid.nonEmptyCellCount = 0;
-        for (unsigned i = 0; i < grid.height; ++i)
+//! Computes the normals with a per point scale (see computeNormals)
+/** The k nearest neighbours of each point are searched once (shared neighbourhood cache). In fixed-k mode,
+    the normal is the least squares plane normal of the point and its neighbours, and the scale is the distance
+    to the farthest neighbour. In density adaptive mode, the scale is the mean of this distance over the
+    neighbours (smoothed local spacing), and the plane is fitted on the points within this radius.
+    Points with less than 3 neighbours get a null normal and a NaN scale.
+**/
+bool ComputeNormalsKNN_(ccPointCloud* cloud,
+                        CCCoreLib::DgmOctree* octree,
+                        unsigned knn,
+                        bool adaptiveRadius,
+                        ccNormalVectors::Orientation preferredOrientation,
+                        NormsIndexesTableType& normsCodes,
+                        std::vector<ScalarType>* scales)
+{
+    const unsigned pointCount = cloud->size();
+    std::vector<unsigned> neighbourCache; //k slots per point
+    std::vector<ScalarType> spacings;
+    if (!normsCodes.resizeSafe(pointCount))
+    {
+        ccLog::Error("[computeNormals] Not enough memory!");
+        return false;
+    }
+    try
+    {
+        spacings.resize(pointCount, CCCoreLib::NAN_VALUE);
+        if (adaptiveRadius)
+            neighbourCache.resize(static_cast<size_t>(pointCount) * knn, std::numeric_limits<unsigned>::max());
+        if (scales)
+            scales->resize(pointCount, CCCoreLib::NAN_VALUE);
+    }
+    catch (const std::bad_alloc&)
+    {
+        ccLog::Error("[computeNormals] Not enough memory!");
+        return false;
+    }
+
+    unsigned chunkCount = 1;
+#ifdef CC_CORE_LIB_USES_TBB
+    chunkCount = std::min(static_cast<unsigned>(std::max(QThread::idealThreadCount(), 1)) * 8, std::max(pointCount / 1024, 1u));
+#endif
+    const unsigned chunkSize = (pointCount + chunkCount - 1) / chunkCount;
+    auto forEachChunk = [&](const std::function<void(unsigned, unsigned)>& processChunk)
+    {
+        auto runChunk = [&](unsigned c)
         {
-            for (unsigned j = 0; j < grid.width; ++j)
-            {
-                ccRasterCell& cell = grid.rows[i][j];
+            processChunk(c * chunkSize, std::min(pointCount, (c + 1) * chunkSize));
+        };
+#ifdef CC_CORE_LIB_USES_TBB
+        tbb::parallel_for(static_cast<unsigned>(0), chunkCount, runChunk);
+#else
+        for (unsigned c = 0; c < chunkCount; ++c)
+            runChunk(c);
+#endif
+    };
+    const CompressedNormType nullNormal = ccNormalVectors::GetNormIndex(CCVector3(0, 0, 0));
+    auto planeNormal = [&](CCCoreLib::ReferenceCloud& points)
+    {
+        if (points.size() < 3)
+            return nullNormal;
+        CCCoreLib::Neighbourhood Z(&points);
+        const CCVector3* N = Z.getLSPlaneNormal();
+        return (N ? ccNormalVectors::GetNormIndex(*N) : nullNormal);
+    };
 
-                bool validGround = true;
-                cell.minHeight = groundHeight;
-                if (ground)
+    //k nearest neighbours (and fixed-k normals)
+    unsigned char knnLevel = octree->findBestLevelForAGivenPopulationPerCell(std::max(knn, 3u));
+    forEachChunk([&](unsigned first, unsigned last)
+    {
+        CCCoreLib::ReferenceCloud Yk(cloud);
+        for (unsigned i = first; i < last; ++i)
+        {
+            double maxSquareDist = 0;
+            Yk.clear();
+            unsigned found = octree->findPointNeighbourhood(cloud->getPoint(i), &Yk, knn + 1, knnLevel, maxSquareDist);
+            if (found > 1)
+                spacings[i] = static_cast<ScalarType>(std::sqrt(maxSquareDist));
+            if (adaptiveRadius)
+            {
+                unsigned slot = 0;
+                for (unsigned n = 0; n < found && slot < knn; ++n)
                 {
-                    cell.minHeight = groundRaster.rows[i][j].h;
-                    validGround = std::isfinite(cell.minHeight);
+                    unsigned j = Yk.getPointGlobalIndex(n);
+                    if (j != i)
+                        neighbourCache[static_cast<size_t>(i) * knn + slot++] = j;
                 }
+            }
+            else
+            {
+                normsCodes[i] = planeNormal(Yk);
+                if (scales)
+                    (*scales)[i] = spacings[i];
+            }
+        }
+    });
 
-                bool validCeil = true;
-                cell.maxHeight = ceilHeight;
-                if (ceil)
+    //density adaptive radius: smoothed spacing, then plane fitting within the radius
+    if (adaptiveRadius)
+    {
+        forEachChunk([&](unsigned first, unsigned last)
+        {
+            CCCoreLib::ReferenceCloud Yr(cloud);
+            CCCoreLib::DgmOctree::NeighboursSet neighbours;
+            for (unsigned i = first; i < last; ++i)
+            {
+                double sum = 0;
+                unsigned count = 0;
+                if (CCCoreLib::ScalarField::ValidValue(spacings[i]))
                 {
-                    cell.maxHeight = ceilRaster.rows[i][j].h;
-                    validCeil = std::isfinite(cell.maxHeight);
+                    sum = spacings[i];
+                    count = 1;
                 }
-
-                if (validGround && validCeil)
+                for (unsigned s = 0; s < knn; ++s)
                 {
-                    cell.h = cell.maxHeight - cell.minHeight;
-                    cell.nbPoints = 1;
-
-                    reportInfo->volume += cell.h;
-                    if (cell.h < 0)
-                    {
-                        reportInfo->removedVolume -= cell.h;
-                    }
-                    else if (cell.h > 0)
+                    unsigned j = neighbourCache[static_cast<size_t>(i) * knn + s];
+                    if (j != std::numeric_limits<unsigned>::max() && CCCoreLib::ScalarField::ValidValue(spacings[j]))
                     {
-                        reportInfo->addedVolume += cell.h;
+                        sum += spacings[j];
+                        ++count;
                     }
-                    reportInfo->surface += 1.0;
-                    ++grid.nonEmptyCellCount; // matching count
-                    ++cellCount;
                 }
-                else
+                if (count == 0)
                 {
-                    if (validGround)
-                    {
-                        ++cellCount;
-                        ++groundNonMatchingCount;
-                    }
-                    else if (validCeil)
-                    {
-                        ++cellCount;
-                        ++ceilNonMatchingCount;
-                    }
-                    cell.h = std::numeric_limits<double>::quiet_NaN();
-                    cell.nbPoints = 0;
+                    normsCodes[i] = nullNormal;
+                    continue;
                 }
+                PointCoordinateType radius = static_cast<PointCoordinateType>(sum / count);
+                neighbours.clear();
+                Yr.clear();
+                unsigned char level = octree->findBestLevelForAGivenNeighbourhoodSizeExtraction(radius);
+                octree->getPointsInSphericalNeighbourhood(*cloud->getPoint(i), radius, neighbours, level);
+                for (const CCCoreLib::DgmOctree::PointDescriptor& P : neighbours)
+                    Yr.addPointIndex(P.pointIndex);
+                normsCodes[i] = planeNormal(Yr);
+                if (scales)
+                    (*scales)[i] = radius;
             }
-        }
-        grid.validCellCount = grid.nonEmptyCellCount;
+        });
+    }
 
-        //count the average number of valid neighbors
+    if (preferredOrientation != ccNormalVectors::UNDEFINED)
+    {
+        return ccNormalVectors::UpdateNormalOrientations(cloud, normsCodes, preferredOrientation);
+    }
+    return true;
+}
+
+bool computeNormals(std::vector<ccHObject*> selectedEntities,
+                    CCCoreLib::LOCAL_MODEL_TYPES model,
+                    bool useScanGridsForComputation,
+                    PointCoordinateType defaultRadius,
+                    double minGridAngle_deg,
+                    bool orientNormals,
+                    bool useScanGridsForOrientation,
+                    bool useSensorsForOrientation,
+                    ccNormalVectors::Orientation preferredOrientation,
+                    bool orientNormalsMST,
+                    int mstNeighbors,
+                    bool computePerVertexNormals,
+                    unsigned adaptiveKnn,
+                    bool adaptiveRadius,
+                    bool exportScaleSF)
+{
+    if (selectedEntities.empty())
+    {
+        ccLog::Error(QObject::tr("Select at least one point cloud"));
+        CCTRACE("Select at least one point cloud");
+        return false;
+    }
+
+    static const QString s_NormalScaleKey("Normal scale");
+
+    //look for clouds and meshes
+    std::vector<ccPointCloud*> clouds;
+    bool withScanGrid = false;
+    bool withSensor = false;
+    std::vector<ccMesh*> meshes;
+
+    try
+    {
+        for (const auto entity : selectedEntities)
         {
-            size_t validNeighborsCount = 0;
-            size_t count = 0;
-            for (unsigned i = 1; i < grid.height - 1; ++i)
+            if (entity->isA(CC_TYPES::POINT_CLOUD))
             {
-                for (unsigned j = 1; j < grid.width - 1; ++j)
+                ccPointCloud* cloud = static_cast<ccPointCloud*>(entity);
+                clouds.push_back(cloud);
+
+                if (!withScanGrid)
                 {
-                    ccRasterCell& cell = grid.rows[i][j];
-                    if (std::isfinite(cell.h))
+                    withScanGrid = (cloud->gridCount() > 0);
+                }
+
+                if (!withSensor)
+                {
+                    for (unsigned i = 0; i < cloud->getChildrenNumber(); ++i)
                     {
-                        for (unsigned k = i - 1; k <= i + 1; ++k)
+                        if (cloud->hasSensor())
                         {
-                            for (unsigned l = j - 1; l <= j + 1; ++l)
-                            {
-                                if (k != i || l != j)
-                                {
-                                    ccRasterCell& otherCell = grid.rows[k][l];
-                                    if (std::isfinite(otherCell.h))
-                                    {
-                                        ++validNeighborsCount;
-                                    }
-                                }
-                            }
+                            withSensor = true;
+                            break; //no need to look anyfurther
                         }
+                    }
+                }
 
-                        ++count;
+                //does the cloud have a former radius value saved as meta-data?
+                if (cloud->hasMetaData(s_NormalScaleKey))
+                {
+                    bool ok = false;
+                    double formerRadius = cloud->getMetaData(s_NormalScaleKey).toDouble(&ok);
+                    if (ok)
+                    {
+                        //remember the largest radius
+                        defaultRadius = std::max(defaultRadius, static_cast<PointCoordinateType>(formerRadius));
+                    }
+                    else
+                    {
+                        assert(false);
                     }
                 }
-            }
 
-            if (count)
+                if (defaultRadius == 0.0)
+                {
+                    //default radius
+                    defaultRadius = ccOctree::GuessNaiveRadius(cloud);
+                }
+            }
+            else if (entity->isKindOf(CC_TYPES::MESH))
             {
-                reportInfo->averageNeighborsPerCell = static_cast<double>(validNeighborsCount) / count;
+                if (entity->isA(CC_TYPES::MESH))
+                {
+                    ccMesh* mesh = ccHObjectCaster::ToMesh(entity);
+                    meshes.push_back(mesh);
+                }
+                else
+                {
+                    ccLog::Error(QObject::tr("Can't compute normals on sub-meshes! Select the parent mesh instead"));
+                    CCTRACE("Can't compute normals on sub-meshes! Select the parent mesh instead");
+                    return false;
+                }
             }
         }
-
-        reportInfo->matchingPercent = static_cast<float>(grid.validCellCount * 100) / cellCount;
-        reportInfo->groundNonMatchingPercent = static_cast<float>(groundNonMatchingCount * 100) / cellCount;
-        reportInfo->ceilNonMatchingPercent = static_cast<float>(ceilNonMatchingCount * 100) / cellCount;
-        float cellArea = static_cast<float>(grid.gridStep * grid.gridStep);
-        reportInfo->volume *= cellArea;
-        reportInfo->addedVolume *= cellArea;
-        reportInfo->removedVolume *= cellArea;
-        reportInfo->surface *= cellArea;
+    } catch (const std::bad_alloc&)
+    {
+        ccLog::Error(QObject::tr("Not enough memory!"));
+        CCTRACE("Not enough memory!");
+        return false;
     }
 
-    grid.setValid(true);
+    //compute normals for each selected cloud
+    if (!clouds.empty())
+    {
+//        static CCCoreLib::LOCAL_MODEL_TYPES s_lastModelType = CCCoreLib::LS;
+//        static ccNormalVectors::Orientation s_lastNormalOrientation = ccNormalVectors::UNDEFINED;
+//        static int s_lastMSTNeighborCount = 6;
+//        static double s_lastMinGridAngle_deg = 1.0;
 
-    return true;
-}
+//        ccNormalComputationDlg ncDlg(withScanGrid, withSensor, nullptr);
+//        ncDlg.setLocalModel(s_lastModelType);
+//        ncDlg.setRadius(defaultRadius);
+//        ncDlg.setPreferredOrientation(s_lastNormalOrientation);
+//        ncDlg.setMSTNeighborCount(s_lastMSTNeighborCount);
+//        ncDlg.setMinGridAngle_deg(s_lastMinGridAngle_deg);
+//        if (clouds.size() == 1)
+//        {
+//            ncDlg.setCloud(clouds.front());
+//        }
+//
+//        if (!ncDlg.exec())
+//            return false;
 
-bool ComputeVolume25D(  ReportInfoVol* reportInfo,
-                        ccGenericPointCloud* ground,
-                        ccGenericPointCloud* ceil,
-                        unsigned char vertDim,
-                        double gridStep,
-                        double groundHeight,
-                        double ceilHeight)
-{
-    ccRasterGrid grid;
-    ccBBox gridBBox = ceil ? ceil->getOwnBB() : ccBBox();
-    if (ground)
-    {
-        gridBBox += ground->getOwnBB();
-    }
-    //compute the grid size
-    unsigned gridWidth = 0;
-    unsigned gridHeight = 0;
-    if (!ccRasterGrid::ComputeGridSize(vertDim, gridBBox, gridStep, gridWidth, gridHeight))
-    {
-        ccLog::Error(QObject::tr("Failed to compute the grid dimensions (check input cloud(s) bounding-box)"));
-        CCTRACE("Failed to compute the grid dimensions (check input cloud(s) bounding-box)");
-    }
+        //normals computation
+        bool useGridStructure = withScanGrid && useScanGridsForComputation;
+//        double minGridAngle_deg = s_lastMinGridAngle_deg = ncDlg.getMinGridAngle_deg();
 
-    bool ret = ComputeVolume_( grid,
-                               ground,
-                               ceil,
-                               gridBBox,
-                               vertDim,
-                               gridStep,
-                               gridWidth,
-                               gridHeight,
-                               ccRasterGrid::PROJ_AVERAGE_VALUE,
-                               ccRasterGrid::LEAVE_EMPTY,
-                               0.0,
-                               ccRasterGrid::LEAVE_EMPTY,
-                               0.0,
-                               reportInfo,
-                               groundHeight,
-                               ceilHeight);
-    return ret;
-}
+        //normals orientation
+//        bool orientNormals = ncDlg.orientNormals();
+        bool orientNormalsWithGrids = withScanGrid && useScanGridsForOrientation;
+        bool orientNormalsWithSensors = withSensor && useSensorsForOrientation;
+//        ccNormalVectors::Orientation preferredOrientation = s_lastNormalOrientation = ncDlg.getPreferredOrientation();
+//        bool orientNormalsMST = ncDlg.useMSTOrientation();
+//        int mstNeighbors = s_lastMSTNeighborCount = ncDlg.getMSTNeighborCount();
 
-ReportInfoVol::ReportInfoVol() :
-    volume(0), addedVolume(0), removedVolume(0), surface(0),
-    matchingPercent(0), ceilNonMatchingPercent(0), groundNonMatchingPercent(0),
-    averageNeighborsPerCell(0)
-{
-}
+//        ccProgressDialog pDlg(true, parent);
+//        pDlg.setAutoClose(false);
 
-ccPointCloud* RasterizeToCloud(
-	ccGenericPointCloud* cloud,
-	double gridStep,
-	CC_DIRECTION vertDir,
-	bool outputRasterZ,
-	bool outputRasterSFs,
-	bool outputRasterRGB,
-	std::string pathToImages,
-	bool resample,
-	ccRasterGrid::ProjectionType projectionType,
-	ccRasterGrid::ProjectionType sfProjectionType,
-	ccRasterGrid::EmptyCellFillOption emptyCellFillStrategy,
-    double DelaunayMaxEdgeLength,
-    int KrigingParamsKNN,
-	double customHeight,
-	ccBBox gridBBox,
-    bool export_perCellCount,
-    bool export_perCellMinHeight,
-    bool export_perCellMaxHeight,
-    bool export_perCellAvgHeight,
-    bool export_perCellHeightStdDev,
-    bool export_perCellHeightRange)
-{
-	CCTRACE("RasterizeToCloud");
-    std::vector<ccRasterGrid::ExportableFields> extraScalarFields = {};
-    if (export_perCellCount) extraScalarFields.push_back(ccRasterGrid::PER_CELL_COUNT);
-    if (export_perCellMinHeight) extraScalarFields.push_back(ccRasterGrid::PER_CELL_MIN_VALUE);
-    if (export_perCellMaxHeight) extraScalarFields.push_back(ccRasterGrid::PER_CELL_MAX_VALUE);
-    if (export_perCellAvgHeight) extraScalarFields.push_back(ccRasterGrid::PER_CELL_AVG_VALUE);
-    if (export_perCellHeightStdDev) extraScalarFields.push_back(ccRasterGrid::PER_CELL_VALUE_STD_DEV);
-    if (export_perCellHeightRange) extraScalarFields.push_back(ccRasterGrid::PER_CELL_VALUE_RANGE);
-	ccHObject* entity = Rasterize_(cloud, gridStep, vertDir, 1,
-			outputRasterZ, outputRasterSFs, outputRasterRGB, pathToImages, resample,
-			projectionType, sfProjectionType, emptyCellFillStrategy,
-			DelaunayMaxEdgeLength, KrigingParamsKNN,
-			customHeight, gridBBox, extraScalarFields);
-	CCTRACE("entity:" << entity);
-	ccPointCloud* rcloud = ccHObjectCaster::ToPointCloud(entity);
-	return rcloud;
-}
+        //The octree based normals of the clouds are computed concurrently: the entities (octrees, normals tables)
+        //are created and attached to the clouds in the main thread, as the ccObject unique IDs are not thread safe.
+        //The workers only build the octrees and fill their own normals tables (one cloud octree may be built while
+        //the normals of another cloud are computed). Nested parallel loops share the same thread pool.
+        //The scan grid normals and the orientations (grids, sensors, MST) modify the clouds and log messages:
+        //they run afterwards, in the main thread, cloud after cloud (the MST orientation is parallel internally).
+        struct CloudNormalsJob
+        {
+            bool withGrids = false;
+            bool hadNormals = false;
+            bool newOctree = false;
+            bool octreeFailed = false;
+            ccOctree::Shared octree;
+            NormsIndexesTableType* normsCodes = nullptr;
+            std::vector<ScalarType> scales;
+            bool normalsAlreadyOriented = false;
+            bool result = false;
+        };
+        std::vector<CloudNormalsJob> jobs(clouds.size());
 
-ccMesh* RasterizeToMesh(
-	ccGenericPointCloud* cloud,
-	double gridStep,
-	CC_DIRECTION vertDir,
-	bool outputRasterZ,
-	bool outputRasterSFs,
-	bool outputRasterRGB,
-	std::string pathToImages,
+        //preparation (main thread)
+        for (size_t k = 0; k < clouds.size(); ++k)
+        {
+            ccPointCloud* cloud = clouds[k];
+            Q_ASSERT(cloud != nullptr);
+            CloudNormalsJob& job = jobs[k];
+            job.hadNormals = cloud->hasNormals();
+            job.withGrids = (useGridStructure && cloud->gridCount());
+            if (job.withGrids)
+            {
+                //compute normals with the associated scan grid(s)
+                job.normalsAlreadyOriented = true;
+                job.result = cloud->resizeTheNormsTable();
+            }
+            else
+            {
+                //compute normals with the octree
+                job.normalsAlreadyOriented = orientNormals && (preferredOrientation != ccNormalVectors::UNDEFINED);
+                job.octree = cloud->getOctree();
+                if (!job.octree)
+                {
+                    job.octree = ccOctree::Shared(new ccOctree(cloud));
+                    job.newOctree = true;
+                }
+                job.normsCodes = new NormsIndexesTableType;
+                job.normsCodes->link();
+                job.result = true;
+            }
+        }
+
+        //octrees and normals computation
+        auto computeCloudNormals = [&](size_t k)
+        {
+            ccPointCloud* cloud = clouds[k];
+            CloudNormalsJob& job = jobs[k];
+            if (!job.result || job.withGrids)
+                return;
+            if (job.newOctree && job.octree->build(nullptr) <= 0)
+            {
+                job.octreeFailed = true;
+                job.result = false;
+                return;
+            }
+            if (adaptiveKnn != 0)
+            {
+                job.result = ComputeNormalsKNN_(cloud,
+                                                job.octree.data(),
+                                                adaptiveKnn,
+                                                adaptiveRadius,
+                                                orientNormals ? preferredOrientation : ccNormalVectors::UNDEFINED,
+                                                *job.normsCodes,
+                                                exportScaleSF ? &job.scales : nullptr);
+                return;
+            }
+            job.result = ccNormalVectors::ComputeCloudNormals(cloud,
+                                                              *job.normsCodes,
+                                                              model,
+                                                              defaultRadius,
+                                                              orientNormals ? preferredOrientation : ccNormalVectors::UNDEFINED,
+                                                              nullptr,
+                                                              job.octree.data());
+        };
+#ifdef CC_CORE_LIB_USES_TBB
+        tbb::parallel_for(static_cast<size_t>(0), clouds.size(), computeCloudNormals);
+#else
+        for (size_t k = 0; k < clouds.size(); ++k)
+            computeCloudNormals(k);
+#endif
+
+        //octrees and normals attached to the clouds, scan grid normals (main thread)
+        for (size_t k = 0; k < clouds.size(); ++k)
+        {
+            ccPointCloud* cloud = clouds[k];
+            CloudNormalsJob& job = jobs[k];
+            if (job.withGrids && job.result)
+            {
+                job.result = cloud->computeNormalsWithGrids(minGridAngle_deg, nullptr);
+            }
+            if (job.octreeFailed)
+            {
+                ccLog::Warning(QObject::tr("Failed to compute the octree of cloud '%1'").arg(cloud->getName()));
+            }
+            if (job.newOctree && job.result)
+            {
+                cloud->setOctree(job.octree);
+            }
+            job.octree.clear();
+            if (job.normsCodes)
+            {
+                if (job.result)
+                {
+                    job.result = cloud->resizeTheNormsTable();
+                    if (job.result)
+                    {
+                        for (unsigned i = 0; i < job.normsCodes->currentSize(); ++i)
+                        {
+                            cloud->setPointNormalIndex(i, job.normsCodes->getValue(i));
+                        }
+                        cloud->showNormals(true);
+                        if (adaptiveKnn == 0)
+                        {
+                            //save the normal computation radius as meta-data
+                            cloud->setMetaData(s_NormalScaleKey, defaultRadius);
+                        }
+                        else if (!job.scales.empty())
+                        {
+                            //per point scale
+                            int sfIdx = cloud->getScalarFieldIndexByName("Normal scale");
+                            if (sfIdx < 0)
+                                sfIdx = cloud->addScalarField("Normal scale");
+                            if (sfIdx >= 0)
+                            {
+                                CCCoreLib::ScalarField* sf = cloud->getScalarField(sfIdx);
+                                std::copy(job.scales.begin(), job.scales.end(), sf->begin());
+                                sf->computeMinAndMax();
+                            }
+                            else
+                            {
+                                ccLog::Warning(QObject::tr("Not enough memory to export the normal scale of cloud '%1'").arg(cloud->getName()));
+                            }
+                        }
+                    }
+                }
+                job.normsCodes->release();
+                job.normsCodes = nullptr;
+                std::vector<ScalarType>().swap(job.scales);
+            }
+            if (!job.result && !job.hadNormals && cloud->hasNormals())
+            {
+                cloud->unallocateNorms();
+            }
+        }
+
+        //do we need to orient the normals? (this may have been already done if 'normalsAlreadyOriented' is true)
+        for (size_t k = 0; k < clouds.size(); ++k)
+        {
+            ccPointCloud* cloud = clouds[k];
+            CloudNormalsJob& job = jobs[k];
+            if (!job.result || !orientNormals || job.normalsAlreadyOriented)
+                continue;
+            if (cloud->gridCount() && orientNormalsWithGrids)
+            {
+                //we can still use the grid structure(s) to orient the normals!
+                job.result = cloud->orientNormalsWithGrids();
+            }
+            else if (cloud->hasSensor() && orientNormalsWithSensors)
+            {
+                job.result = false;
+
+                // RJ: TODO: the issue here is that a cloud can have multiple sensors.
+                // As the association to sensor is not explicit in CC, given a cloud
+                // some points can belong to one sensor and some others can belongs to others sensors.
+                // so it's why here grid orientation has precedence over sensor orientation because in this
+                // case association is more explicit.
+                // Here we take the first valid viewpoint for now even if it's not a really good...
+                CCVector3 sensorPosition;
+                for (size_t i = 0; i < cloud->getChildrenNumber(); ++i)
+                {
+                    ccHObject* child = cloud->getChild(static_cast<unsigned>(i));
+                    if (child && child->isKindOf(CC_TYPES::SENSOR))
+                    {
+                        ccSensor* sensor = ccHObjectCaster::ToSensor(child);
+                        if (sensor->getActiveAbsoluteCenter(sensorPosition))
+                        {
+                            job.result = cloud->orientNormalsTowardViewPoint(sensorPosition, nullptr);
+                            break;
+                        }
+                    }
+                }
+            }
+            else if (orientNormalsMST)
+            {
+                //use Minimum Spanning Tree to resolve normals direction
+                job.result = OrientNormalsWithMSTParallel(cloud, static_cast<unsigned>(std::max(mstNeighbors, 1)));
+            }
+        }
+
+        size_t errors = 0;
+        for (size_t k = 0; k < clouds.size(); ++k)
+        {
+            if (!jobs[k].result)
+            {
+                ++errors;
+            }
+            clouds[k]->prepareDisplayForRefresh();
+        }
+
+        if (errors != 0)
+        {
+            if (errors < clouds.size())
+            {
+                ccLog::Error(QObject::tr("Failed to compute or orient the normals on some clouds! (see console)"));
+                CCTRACE("Failed to compute or orient the normals on some clouds! (see console)");
+            }
+            else
+            {
+                ccLog::Error(QObject::tr("Failed to compute or orient the normals! (see console)"));
+                CCTRACE("Failed to compute or orient the normals! (see console)");
+            }
+        }
+    }
+
+    //compute normals for each selected mesh
+    if (!meshes.empty())
+    {
+//        QMessageBox question(QMessageBox::Question, QObject::tr("Mesh normals"),
+//                             QObject::tr("Compute per-vertex normals (smooth) or per-triangle (faceted)?"),
+//                             QMessageBox::NoButton, parent);
+//
+//        QPushButton* perVertexButton = question.addButton(QObject::tr("Per-vertex"), QMessageBox::YesRole);
+//        QPushButton* perTriangleButton = question.addButton(QObject::tr("Per-triangle"), QMessageBox::NoRole);
+//
+//        question.exec();
+//
+//        bool computePerVertexNormals = (question.clickedButton() == perVertexButton);
+
+        for (auto mesh : meshes)
+        {
+            Q_ASSERT(mesh != nullptr);
+
+//            //we remove temporarily the mesh as its normals may be removed (and they can be a child object)
+//            ccMainAppInterface* instance = dynamic_cast<ccMainAppInterface*>(parent);
+//            ccMainAppInterface::ccHObjectContext objContext;
+//            if (instance)
+//                objContext = instance->removeObjectTemporarilyFromDBTree(mesh);
+//            mesh->clearTriNormals();
+//            mesh->showNormals(false);
+            bool result = mesh->computeNormals(computePerVertexNormals);
+//            if (instance)
+//                instance->putObjectBackIntoDBTree(mesh, objContext);
+
+            if (!result)
+            {
+                ccLog::Error(QObject::tr("Failed to compute normals on mesh '%1'").arg(mesh->getName()));
+                CCTRACE("Failed to compute normals on mesh " << mesh->getName().toStdString());
+                continue;
+            }
+            mesh->prepareDisplayForRefresh_recursive();
+        }
+    }
+
+    return true;
+}
+
+bool invertNormals(std::vector<ccHObject*> selectedEntities)
+{
+    for (ccHObject* ent : selectedEntities)
+    {
+        // is it a mesh?
+        ccMesh* mesh = ccHObjectCaster::ToMesh(ent);
+        if (mesh && mesh->hasNormals())
+        {
+            mesh->invertNormals();
+            continue;
+        }
+
+        // is it a cloud?
+        ccPointCloud* cloud = ccHObjectCaster::ToPointCloud(ent);
+        if (cloud && cloud->hasNormals())
+        {
+            cloud->invertNormals();
+        }
+    }
+    return true;
+}
+
+//! TODO: Copied/adpated from qCC/ccVolumeCalcTool::ComputeVolume
+bool ComputeVolume_(    ccRasterGrid& grid,
+                        ccGenericPointCloud* ground,
+                        ccGenericPointCloud* ceil,
+                        const ccBBox& gridBox,
+                        unsigned char vertDim,
+                        double gridStep,
+                        unsigned gridWidth,
+                        unsigned gridHeight,
+                        ccRasterGrid::ProjectionType projectionType,
+                        ccRasterGrid::EmptyCellFillOption groundEmptyCellFillStrategy,
+                        double groundMaxEdgeLength,
+                        ccRasterGrid::EmptyCellFillOption ceilEmptyCellFillStrategy,
+                        double ceilMaxEdgeLength,
+                        ReportInfoVol* reportInfo,
+                        double groundHeight = std::numeric_limits<double>::quiet_NaN(),
+                        double ceilHeight = std::numeric_limits<double>::quiet_NaN())
+{
+    if (    gridStep <= 1.0e-8
+        ||  gridWidth == 0
+        ||  gridHeight == 0
+        ||  vertDim > 2)
+    {
+        ccLog::Warning("[Volume] Invalid input parameters");
+        CCTRACE("[Volume] Invalid input parameters");
+        return false;
+    }
+
+    if (!ground && !ceil)
+    {
+        ccLog::Warning("[Volume] No valid input cloud");
+        CCTRACE("[Volume] No valid input cloud");
+        return false;
+    }
+
+    if (!gridBox.isValid())
+    {
+        ccLog::Warning("[Volume] Invalid bounding-box");
+        CCTRACE("[Volume] Invalid bounding-box");
+        return false;
+    }
+
+    //grid size
+    unsigned gridTotalSize = gridWidth * gridHeight;
+
+    //memory allocation
+    CCVector3d minCorner = gridBox.minCorner();
+    if (!grid.init(gridWidth, gridHeight, gridStep, minCorner))
+    {
+        //not enough memory
+        ccLog::Error(QObject::tr("Not enough memory!"));
+        CCTRACE("Not enough memory!");
+        return false;
+    }
+
+    //progress dialog
+    QScopedPointer<ccProgressDialog> pDlg(nullptr);
+
+    ccRasterGrid groundRaster;
+    if (ground)
+    {
+        if (!groundRaster.init(gridWidth, gridHeight, gridStep, minCorner))
+        {
+            //not enough memory
+            ccLog::Error(QObject::tr("Not enough memory!"));
+            CCTRACE("Not enough memory!");
+            return false;
+        }
+
+        ccRasterGrid::InterpolationType interpolationType = ccRasterGrid::InterpolationTypeFromEmptyCellFillOption(groundEmptyCellFillStrategy);
+        ccRasterGrid::DelaunayInterpolationParams dInterpParams;
+        void* interpolationParams = nullptr;
+        switch (interpolationType)
+        {
+        case ccRasterGrid::InterpolationType::DELAUNAY:
+            dInterpParams.maxEdgeLength = groundMaxEdgeLength;
+            interpolationParams = (void*)&dInterpParams;
+            break;
+        case ccRasterGrid::InterpolationType::KRIGING:
+            // not supported yet
+            assert(false);
+            break;
+        default:
+            // do nothing
+            break;
+        }
+
+        if (groundRaster.fillWith(  ground,
+                                    vertDim,
+                                    projectionType,
+                                    interpolationType,
+                                    interpolationParams,
+                                    ccRasterGrid::INVALID_PROJECTION_TYPE,
+                                    pDlg.data()))
+        {
+            groundRaster.fillEmptyCells(groundEmptyCellFillStrategy, groundHeight);
+            ccLog::Print(QString("[Volume] Ground raster grid: size: %1 x %2 / heights: [%3 ; %4]").arg(groundRaster.width).arg(groundRaster.height).arg(groundRaster.minHeight).arg(groundRaster.maxHeight));
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    //ceil
+    ccRasterGrid ceilRaster;
+    if (ceil)
+    {
+        if (!ceilRaster.init(gridWidth, gridHeight, gridStep, minCorner))
+        {
+            //not enough memory
+            ccLog::Error(QObject::tr("Not enough memory!"));
+            CCTRACE("Not enough memory!");
+            return false;
+        }
+
+        ccRasterGrid::InterpolationType interpolationType = ccRasterGrid::InterpolationTypeFromEmptyCellFillOption(ceilEmptyCellFillStrategy);
+        ccRasterGrid::DelaunayInterpolationParams dInterpParams;
+        void* interpolationParams = nullptr;
+        switch (interpolationType)
+        {
+        case ccRasterGrid::InterpolationType::DELAUNAY:
+            dInterpParams.maxEdgeLength = ceilMaxEdgeLength;
+            interpolationParams = (void*)&dInterpParams;
+            break;
+        case ccRasterGrid::InterpolationType::KRIGING:
+            // not supported yet
+            assert(false);
+            break;
+        default:
+            // do nothing
+            break;
+        }
+
+        if (ceilRaster.fillWith(ceil,
+                                vertDim,
+                                projectionType,
+                                interpolationType,
+                                interpolationParams,
+                                ccRasterGrid::INVALID_PROJECTION_TYPE,
+                                pDlg.data()))
+        {
+            ceilRaster.fillEmptyCells(ceilEmptyCellFillStrategy, ceilHeight);
+            ccLog::Print(QString("[Volume] Ceil raster grid: size: %1 x %2 / heights: [%3 ; %4]").arg(ceilRaster.width).arg(ceilRaster.height).arg(ceilRaster.minHeight).arg(ceilRaster.maxHeight));
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    //update grid and compute volume
+    {
+
+        size_t ceilNonMatchingCount = 0;
+        size_t groundNonMatchingCount = 0;
+        size_t cellCount = 0;
+
+        //at least one of the grid is based on a cloud
+        grid.nonEmptyCellCount = 0;
+        for (unsigned i = 0; i < grid.height; ++i)
+        {
+            for (unsigned j = 0; j < grid.width; ++j)
+            {
+                ccRasterCell& cell = grid.rows[i][j];
+
+                bool validGround = true;
+                cell.minHeight = groundHeight;
+                if (ground)
+                {
+                    cell.minHeight = groundRaster.rows[i][j].h;
+                    validGround = std::isfinite(cell.minHeight);
+                }
+
+                bool validCeil = true;
+                cell.maxHeight = ceilHeight;
+                if (ceil)
+                {
+                    cell.maxHeight = ceilRaster.rows[i][j].h;
+                    validCeil = std::isfinite(cell.maxHeight);
+                }
+
+                if (validGround && validCeil)
+                {
+                    cell.h = cell.maxHeight - cell.minHeight;
+                    cell.nbPoints = 1;
+
+                    reportInfo->volume += cell.h;
+                    if (cell.h < 0)
+                    {
+                        reportInfo->removedVolume -= cell.h;
+                    }
+                    else if (cell.h > 0)
+                    {
+                        reportInfo->addedVolume += cell.h;
+                    }
+                    reportInfo->surface += 1.0;
+                    ++grid.nonEmptyCellCount; // matching count
+                    ++cellCount;
+                }
+                else
+                {
+                    if (validGround)
+                    {
+                        ++cellCount;
+                        ++groundNonMatchingCount;
+                    }
+                    else if (validCeil)
+                    {
+                        ++cellCount;
+                        ++ceilNonMatchingCount;
+                    }
+                    cell.h = std::numeric_limits<double>::quiet_NaN();
+                    cell.nbPoints = 0;
+                }
+            }
+        }
+        grid.validCellCount = grid.nonEmptyCellCount;
+
+        //count the average number of valid neighbors
+        {
+            size_t validNeighborsCount = 0;
+            size_t count = 0;
+            for (unsigned i = 1; i < grid.height - 1; ++i)
+            {
+                for (unsigned j = 1; j < grid.width - 1; ++j)
+                {
+                    ccRasterCell& cell = grid.rows[i][j];
+                    if (std::isfinite(cell.h))
+                    {
+                        for (unsigned k = i - 1; k <= i + 1; ++k)
+                        {
+                            for (unsigned l = j - 1; l <= j + 1; ++l)
+                            {
+                                if (k != i || l != j)
+                                {
+                                    ccRasterCell& otherCell = grid.rows[k][l];
+                                    if (std::isfinite(otherCell.h))
+                                    {
+                                        ++validNeighborsCount;
+                                    }
+                                }
+                            }
+                        }
+
+                        ++count;
+                    }
+                }
+            }
+
+            if (count)
+            {
+                reportInfo->averageNeighborsPerCell = static_cast<double>(validNeighborsCount) / count;
+            }
+        }
+
+        reportInfo->matchingPercent = static_cast<float>(grid.validCellCount * 100) / cellCount;
+        reportInfo->groundNonMatchingPercent = static_cast<float>(groundNonMatchingCount * 100) / cellCount;
+        reportInfo->ceilNonMatchingPercent = static_cast<float>(ceilNonMatchingCount * 100) / cellCount;
+        float cellArea = static_cast<float>(grid.gridStep * grid.gridStep);
+        reportInfo->volume *= cellArea;
+        reportInfo->addedVolume *= cellArea;
+        reportInfo->removedVolume *= cellArea;
+        reportInfo->surface *= cellArea;
+    }
+
+    grid.setValid(true);
+
+    return true;
+}
+
+bool ComputeVolume25D(  ReportInfoVol* reportInfo,
+                        ccGenericPointCloud* ground,
+                        ccGenericPointCloud* ceil,
+                        unsigned char vertDim,
+                        double gridStep,
+                        double groundHeight,
+                        double ceilHeight)
+{
+    ccRasterGrid grid;
+    ccBBox gridBBox = ceil ? ceil->getOwnBB() : ccBBox();
+    if (ground)
+    {
+        gridBBox += ground->getOwnBB();
+    }
+    //compute the grid size
+    unsigned gridWidth = 0;
+    unsigned gridHeight = 0;
+    if (!ccRasterGrid::ComputeGridSize(vertDim, gridBBox, gridStep, gridWidth, gridHeight))
+    {
+        ccLog::Error(QObject::tr("Failed to compute the grid dimensions (check input cloud(s) bounding-box)"));
+        CCTRACE("Failed to compute the grid dimensions (check input cloud(s) bounding-box)");
+    }
+
+    bool ret = ComputeVolume_( grid,
+                               ground,
+                               ceil,
+                               gridBBox,
+                               vertDim,
+                               gridStep,
+                               gridWidth,
+                               gridHeight,
+                               ccRasterGrid::PROJ_AVERAGE_VALUE,
+                               ccRasterGrid::LEAVE_EMPTY,
+                               0.0,
+                               ccRasterGrid::LEAVE_EMPTY,
+                               0.0,
+                               reportInfo,
+                               groundHeight,
+                               ceilHeight);
+    return ret;
+}
+
+ReportInfoVol::ReportInfoVol() :
+    volume(0), addedVolume(0), removedVolume(0), surface(0),
+    matchingPercent(0), ceilNonMatchingPercent(0), groundNonMatchingPercent(0),
+    averageNeighborsPerCell(0)
+{
+}
+
+ccPointCloud* RasterizeToCloud(
+	ccGenericPointCloud* cloud,
+	double gridStep,
+	CC_DIRECTION vertDir,
+	bool outputRasterZ,
+	bool outputRasterSFs,
+	bool outputRasterRGB,
+	std::string pathToImages,
+	bool resample,
+	ccRasterGrid::ProjectionType projectionType,
+	ccRasterGrid::ProjectionType sfProjectionType,
+	ccRasterGrid::EmptyCellFillOption emptyCellFillStrategy,
+    double DelaunayMaxEdgeLength,
+    int KrigingParamsKNN,
+	double customHeight,
+	ccBBox gridBBox,
+    bool export_perCellCount,
+    bool export_perCellMinHeight,
+    bool export_perCellMaxHeight,
+    bool export_perCellAvgHeight,
+    bool export_perCellHeightStdDev,
+    bool export_perCellHeightRange)
+{
+	CCTRACE("RasterizeToCloud");
+    std::vector<ccRasterGrid::ExportableFields> extraScalarFields = {};
+    if (export_perCellCount) extraScalarFields.push_back(ccRasterGrid::PER_CELL_COUNT);
+    if (export_perCellMinHeight) extraScalarFields.push_back(ccRasterGrid::PER_CELL_MIN_VALUE);
+    if (export_perCellMaxHeight) extraScalarFields.push_back(ccRasterGrid::PER_CELL_MAX_VALUE);
+    if (export_perCellAvgHeight) extraScalarFields.push_back(ccRasterGrid::PER_CELL_AVG_VALUE);
+    if (export_perCellHeightStdDev) extraScalarFields.push_back(ccRasterGrid::PER_CELL_VALUE_STD_DEV);
+    if (export_perCellHeightRange) extraScalarFields.push_back(ccRasterGrid::PER_CELL_VALUE_RANGE);
+	ccHObject* entity = Rasterize_(cloud, gridStep, vertDir, 1,
+			outputRasterZ, outputRasterSFs, outputRasterRGB, pathToImages, resample,
+			projectionType, sfProjectionType, emptyCellFillStrategy,
+			DelaunayMaxEdgeLength, KrigingParamsKNN,
+			customHeight, gridBBox, extraScalarFields);
+	CCTRACE("entity:" << entity);
+	ccPointCloud* rcloud = ccHObjectCaster::ToPointCloud(entity);
+	return rcloud;
+}
+
+ccMesh* RasterizeToMesh(
+	ccGenericPointCloud* cloud,
+	double gridStep,
+	CC_DIRECTION vertDir,
+	bool outputRasterZ,
+	bool outputRasterSFs,
+	bool outputRasterRGB,
+	std::string pathToImages,
+	bool resample,
+	ccRasterGrid::ProjectionType projectionType,
+	ccRasterGrid::ProjectionType sfProjectionType,
+	ccRasterGrid::EmptyCellFillOption emptyCellFillStrategy,
+    double DelaunayMaxEdgeLength,
+    int KrigingParamsKNN,
+	double customHeight,
+	ccBBox gridBBox,
+    bool export_perCellCount,
+    bool export_perCellMinHeight,
+    bool export_perCellMaxHeight,
+    bool export_perCellAvgHeight,
+    bool export_perCellHeightStdDev,
+    bool export_perCellHeightRange)
+{
+    CCTRACE("RasterizeToMesh");
+    std::vector<ccRasterGrid::ExportableFields> extraScalarFields = {};
+    if (export_perCellCount) extraScalarFields.push_back(ccRasterGrid::PER_CELL_COUNT);
+    if (export_perCellMinHeight) extraScalarFields.push_back(ccRasterGrid::PER_CELL_MIN_VALUE);
+    if (export_perCellMaxHeight) extraScalarFields.push_back(ccRasterGrid::PER_CELL_MAX_VALUE);
+    if (export_perCellAvgHeight) extraScalarFields.push_back(ccRasterGrid::PER_CELL_AVG_VALUE);
+    if (export_perCellHeightStdDev) extraScalarFields.push_back(ccRasterGrid::PER_CELL_VALUE_STD_DEV);
+    if (export_perCellHeightRange) extraScalarFields.push_back(ccRasterGrid::PER_CELL_VALUE_RANGE);
+	ccHObject* entity = Rasterize_(cloud, gridStep, vertDir, 2,
+			outputRasterZ, outputRasterSFs, outputRasterRGB, pathToImages, resample,
+			projectionType, sfProjectionType, emptyCellFillStrategy,
+            DelaunayMaxEdgeLength, KrigingParamsKNN,
+			customHeight, gridBBox, extraScalarFields);
+	CCTRACE("entity:" << entity);
+	ccMesh* mesh = ccHObjectCaster::ToMesh(entity);
+	return mesh;
+}
+
+ccHObject* RasterizeGeoTiffOnly(
+	ccGenericPointCloud* cloud,
+	double gridStep,
+	CC_DIRECTION vertDir,
+	bool outputRasterZ,
+	bool outputRasterSFs,
+	bool outputRasterRGB,
+	std::string pathToImages,
+	bool resample,
+	ccRasterGrid::ProjectionType projectionType,
+	ccRasterGrid::ProjectionType sfProjectionType,
+	ccRasterGrid::EmptyCellFillOption emptyCellFillStrategy,
+    double DelaunayMaxEdgeLength,
+    int KrigingParamsKNN,
+	double customHeight,
+	ccBBox gridBBox,
+    bool export_perCellCount,
+    bool export_perCellMinHeight,
+    bool export_perCellMaxHeight,
+    bool export_perCellAvgHeight,
+    bool export_perCellHeightStdDev,
+    bool export_perCellHeightRange)
+{
+    CCTRACE("RasterizeGeoTiffOnly");
+    std::vector<ccRasterGrid::ExportableFields> extraScalarFields = {};
+    if (export_perCellCount) extraScalarFields.push_back(ccRasterGrid::PER_CELL_COUNT);
+    if (export_perCellMinHeight) extraScalarFields.push_back(ccRasterGrid::PER_CELL_MIN_VALUE);
+    if (export_perCellMaxHeight) extraScalarFields.push_back(ccRasterGrid::PER_CELL_MAX_VALUE);
+    if (export_perCellAvgHeight) extraScalarFields.push_back(ccRasterGrid::PER_CELL_AVG_VALUE);
+    if (export_perCellHeightStdDev) extraScalarFields.push_back(ccRasterGrid::PER_CELL_VALUE_STD_DEV);
+    if (export_perCellHeightRange) extraScalarFields.push_back(ccRasterGrid::PER_CELL_VALUE_RANGE);
+	ccHObject* entity = Rasterize_(cloud, gridStep, vertDir, 2,
+			outputRasterZ, outputRasterSFs, outputRasterRGB, pathToImages, resample,
+			projectionType, sfProjectionType, emptyCellFillStrategy,
+            DelaunayMaxEdgeLength, KrigingParamsKNN,
+			customHeight, gridBBox, extraScalarFields);
+	return nullptr; // only image files created, no object returned
+}
+
+//! clone of ccRasterizeTool::ExportGeoTiff
+bool ExportGeoTiff_(const QString& outputFilename,
+					const ccRasterizeTool::ExportBands& exportBands,
+					ccRasterGrid::EmptyCellFillOption fillEmptyCellsStrategy,
+					const ccRasterGrid& grid,
+					const ccBBox& gridBBox,
+					unsigned char Z,
+					double customHeightForEmptyCells/*=std::numeric_limits<double>::quiet_NaN()*/,
+					ccGenericPointCloud* originCloud/*=0*/,
+					int visibleSfIndex=-1)
+{
+	CCTRACE("fillEmptyCellsStrategy:" << fillEmptyCellsStrategy);
+#ifdef CC_GDAL_SUPPORT
+
+	if (exportBands.visibleSF && visibleSfIndex < 0)
+	{
+		assert(false);
+		return false;
+	}
+
+	//vertical dimension
+	assert(Z <= 2);
+	const unsigned char X = Z == 2 ? 0 : Z + 1;
+	const unsigned char Y = X == 2 ? 0 : X + 1;
+
+    double stepX = grid.gridStep;
+    double stepY = grid.gridStep;
+
+    //global shift
+    assert(gridBBox.isValid());
+    double shiftX = gridBBox.minCorner().u[X] - stepX / 2; //we will declare the raster grid as 'Pixel-is-area'!
+    double shiftY = gridBBox.maxCorner().u[Y] + stepY / 2; //we will declare the raster grid as 'Pixel-is-area'!
+    double shiftZ = 0.0;
+
+	if (originCloud)
+	{
+		const CCVector3d& shift = originCloud->getGlobalShift();
+		shiftX -= shift.u[X];
+		shiftY -= shift.u[Y];
+		shiftZ -= shift.u[Z];
+
+		double scale = originCloud->getGlobalScale();
+		assert(scale != 0);
+		stepX /= scale;
+		stepY /= scale;
+	}
+
+	int totalBands = 0;
+	bool onlyRGBA = true;
+
+	if (exportBands.height)
+	{
+		++totalBands;
+		onlyRGBA = false;
+	}
+
+	bool rgbaMode = false;
+	if (exportBands.rgb)
+	{
+		totalBands += 3; //one per component
+		if (fillEmptyCellsStrategy == ccRasterGrid::LEAVE_EMPTY && grid.validCellCount < grid.height * grid.width)
+		{
+			rgbaMode = true;
+			++totalBands; //alpha
+		}
+	}
+	else
+	{
+		onlyRGBA = false;
+	}
+
+	if (exportBands.density)
+	{
+		++totalBands;
+		onlyRGBA = false;
+	}
+
+	if (exportBands.allSFs)
+	{
+		for (const auto & scalarField : grid.scalarFields)
+		{
+			if (!scalarField.empty())
+			{
+				++totalBands;
+				onlyRGBA = false;
+			}
+		}
+	}
+	else if (exportBands.visibleSF && visibleSfIndex >= 0)
+	{
+		++totalBands;
+		onlyRGBA = false;
+	}
+
+	if (totalBands == 0)
+	{
+		CCTRACE("Can't output a raster with no band! (check export parameters)");
+		return false;
+	}
+
+	GDALAllRegister();
+	CCTRACE("GDAL drivers: " << GetGDALDriverManager()->GetDriverCount());
+
+	const char pszFormat[] = "GTiff";
+	GDALDriver *poDriver = GetGDALDriverManager()->GetDriverByName(pszFormat);
+	if (!poDriver)
+	{
+		CCTRACE("[GDAL] Driver is not supported " << pszFormat);
+		return false;
+	}
+
+	char** papszMetadata = poDriver->GetMetadata();
+	if (!CSLFetchBoolean(papszMetadata, GDAL_DCAP_CREATE, FALSE))
+	{
+		CCTRACE("[GDAL] Driver doesn't support Create() method " << pszFormat);
+		return false;
+	}
+
+	char **papszOptions = nullptr;
+	GDALDataset* poDstDS = poDriver->Create(qPrintable(outputFilename),
+											static_cast<int>(grid.width),
+											static_cast<int>(grid.height),
+											totalBands,
+											onlyRGBA ? GDT_Byte : GDT_Float64,
+											papszOptions);
+
+	if (!poDstDS)
+	{
+		ccLog::Error("[GDAL] Failed to create output raster (not enough memory?)");
+		return false;
+	}
+
+	poDstDS->SetMetadataItem("AREA_OR_POINT", "AREA");
+
+	double adfGeoTransform[6] = {	shiftX,		//top left x
+									stepX,		//w-e pixel resolution (can be negative)
+									0,			//0
+									shiftY,		//top left y
+									0,			//0
+									-stepY		//n-s pixel resolution (can be negative)
+	};
+
+	poDstDS->SetGeoTransform( adfGeoTransform );
+
+	//OGRSpatialReference oSRS;
+	//oSRS.SetUTM( 11, TRUE );
+	//oSRS.SetWellKnownGeogCS( "NAD27" );
+	//char *pszSRS_WKT = nullptr;
+	//oSRS.exportToWkt( &pszSRS_WKT );
+	//poDstDS->SetProjection( pszSRS_WKT );
+	//CPLFree( pszSRS_WKT );
+
+	int currentBand = 0;
+
+	//exort RGB band?
+	if (exportBands.rgb)
+	{
+		GDALRasterBand* rgbBands[3] = { poDstDS->GetRasterBand(++currentBand),
+										poDstDS->GetRasterBand(++currentBand),
+										poDstDS->GetRasterBand(++currentBand) };
+		rgbBands[0]->SetColorInterpretation(GCI_RedBand);
+		rgbBands[1]->SetColorInterpretation(GCI_GreenBand);
+		rgbBands[2]->SetColorInterpretation(GCI_BlueBand);
+
+		unsigned char* cLine = static_cast<unsigned char*>(CPLMalloc(sizeof(unsigned char)*grid.width));
+		if (!cLine)
+		{
+			CCTRACE("[GDAL] Not enough memory");
+			GDALClose(poDstDS);
+			return false;
+		}
+
+		bool error = false;
+
+		//export the R, G and B components
+		for (unsigned k = 0; k < 3; ++k)
+		{
+			rgbBands[k]->SetStatistics(0, 255, 128, 0); //warning: arbitrary average and std. dev. values
+
+			for (unsigned j = 0; j<grid.height; ++j)
+			{
+				const ccRasterGrid::Row& row = grid.rows[grid.height - 1 - j]; //the first row is the northest one (i.e. Ymax)
+				for (unsigned i = 0; i<grid.width; ++i)
+				{
+					cLine[i] = (std::isfinite(row[i].h) ? static_cast<unsigned char>(std::max(0.0, std::min(255.0, row[i].color.u[k]))) : 0);
+				}
+
+				if (rgbBands[k]->RasterIO(GF_Write, 0, static_cast<int>(j), static_cast<int>(grid.width), 1, cLine, static_cast<int>(grid.width), 1, GDT_Byte, 0, 0) != CE_None)
+				{
+					error = true;
+					k = 3; //early stop
+					break;
+				}
+			}
+		}
+
+		//export the alpha band (if necessary)
+		if (!error && rgbaMode)
+		{
+			GDALRasterBand* aBand = poDstDS->GetRasterBand(++currentBand);
+			aBand->SetColorInterpretation(GCI_AlphaBand);
+			aBand->SetStatistics(0, 255, 255, 0); //warning: arbitrary average and std. dev. values
+
+			for (unsigned j = 0; j<grid.height; ++j)
+			{
+				const ccRasterGrid::Row& row = grid.rows[grid.height - 1 - j];
+				for (unsigned i = 0; i<grid.width; ++i)
+				{
+					cLine[i] = (std::isfinite(row[i].h) ? 255 : 0);
+				}
+
+				if (aBand->RasterIO(GF_Write, 0, static_cast<int>(j), static_cast<int>(grid.width), 1, cLine, static_cast<int>(grid.width), 1, GDT_Byte, 0, 0) != CE_None)
+				{
+					error = true;
+					break;
+				}
+			}
+		}
+
+		CPLFree(cLine);
+
+		if (error)
+		{
+			CCTRACE("[GDAL] An error occurred while writing the color bands!");
+			GDALClose(poDstDS);
+			return false;
+		}
+	}
+
+	double* scanline = static_cast<double*>(CPLMalloc(sizeof(double)*grid.width));
+	if (!scanline)
+	{
+		CCTRACE("[GDAL] Not enough memory");
+		GDALClose(poDstDS);
+		return false;
+	}
+
+	//exort height band?
+	if (exportBands.height)
+	{
+		GDALRasterBand* poBand = poDstDS->GetRasterBand(++currentBand);
+		assert(poBand);
+		poBand->SetColorInterpretation(GCI_Undefined);
+
+		double emptyCellHeight = 0;
+		switch (fillEmptyCellsStrategy)
+		{
+		case ccRasterGrid::LEAVE_EMPTY:
+			emptyCellHeight = grid.minHeight - 1.0;
+			poBand->SetNoDataValue(emptyCellHeight); //should be transparent!
+			break;
+		case ccRasterGrid::FILL_MINIMUM_HEIGHT:
+			emptyCellHeight = grid.minHeight;
+			break;
+		case ccRasterGrid::FILL_MAXIMUM_HEIGHT:
+			emptyCellHeight = grid.maxHeight;
+			break;
+		case ccRasterGrid::FILL_CUSTOM_HEIGHT:
+		case ccRasterGrid::INTERPOLATE_DELAUNAY:
+			emptyCellHeight = customHeightForEmptyCells;
+			break;
+		case ccRasterGrid::FILL_AVERAGE_HEIGHT:
+			emptyCellHeight = grid.meanHeight;
+			break;
+		default:
+			assert(false);
+		}
+
+		emptyCellHeight += shiftZ;
+
+		for (unsigned j = 0; j < grid.height; ++j)
+		{
+			const ccRasterGrid::Row& row = grid.rows[grid.height - 1 - j];
+			for (unsigned i = 0; i<grid.width; ++i)
+			{
+				scanline[i] = std::isfinite(row[i].h) ? row[i].h + shiftZ : emptyCellHeight;
+			}
+
+			if (poBand->RasterIO(GF_Write, 0, static_cast<int>(j), static_cast<int>(grid.width), 1, scanline, static_cast<int>(grid.width), 1, GDT_Float64, 0, 0) != CE_None)
+			{
+				CCTRACE("[GDAL] An error occurred while writing the height band!");
+				if (scanline)
+					CPLFree(scanline);
+				GDALClose(poDstDS);
+				return false;
+			}
+		}
+	}
+
+	//export density band
+	if (exportBands.density)
+	{
+		GDALRasterBand* poBand = poDstDS->GetRasterBand(++currentBand);
+		assert(poBand);
+		poBand->SetColorInterpretation(GCI_Undefined);
+		for (unsigned j = 0; j < grid.height; ++j)
+		{
+			const ccRasterGrid::Row& row = grid.rows[grid.height - 1 - j];
+			for (unsigned i = 0; i < grid.width; ++i)
+			{
+				scanline[i] = row[i].nbPoints;
+			}
+
+			if (poBand->RasterIO(GF_Write, 0, static_cast<int>(j), static_cast<int>(grid.width), 1, scanline, static_cast<int>(grid.width), 1, GDT_Float64, 0, 0) != CE_None)
+			{
+				CCTRACE("[GDAL] An error occurred while writing the height band!");
+				if (scanline)
+					CPLFree(scanline);
+				GDALClose(poDstDS);
+				return false;
+			}
+		}
+	}
+
+	//export SF bands
+	if (exportBands.allSFs || (exportBands.visibleSF && visibleSfIndex >= 0))
+	{
+		for (size_t k = 0; k < grid.scalarFields.size(); ++k)
+		{
+			assert(!grid.scalarFields[k].empty());
+			if (exportBands.allSFs || (exportBands.visibleSF && visibleSfIndex == static_cast<int>(k)))
+			{
+				const double* sfGrid = grid.scalarFields[k].data();
+				GDALRasterBand* poBand = poDstDS->GetRasterBand(++currentBand);
+
+				double sfNanValue = std::numeric_limits<ccRasterGrid::SF::value_type>::quiet_NaN();
+				poBand->SetNoDataValue(sfNanValue); //should be transparent!
+				assert(poBand);
+				poBand->SetColorInterpretation(GCI_Undefined);
+
+				for (unsigned j = 0; j < grid.height; ++j)
+				{
+					const ccRasterGrid::Row& row = grid.rows[grid.height - 1 - j];
+					const double* sfRow = sfGrid + (grid.height - 1 - j) * grid.width;
+					for (unsigned i = 0; i < grid.width; ++i)
+					{
+						scanline[i] = row[i].nbPoints ? sfRow[i] : sfNanValue;
+					}
+
+					if (poBand->RasterIO(	GF_Write,
+											0,
+											static_cast<int>(j),
+											static_cast<int>(grid.width),
+											1,
+											scanline,
+											static_cast<int>(grid.width),
+											1,
+											GDT_Float64, 0, 0 ) != CE_None)
+					{
+						//the corresponding SF should exist on the input cloud
+						CCTRACE("[GDAL] An error occurred while writing a scalar field band!");
+						k = grid.scalarFields.size(); //quick stop
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	if (scanline)
+		CPLFree(scanline);
+	scanline = nullptr;
+
+	/* Once we're done, close properly the dataset */
+	GDALClose(poDstDS);
+
+	CCTRACE("[Rasterize] Raster successfully saved");
+	return true;
+
+#else
+	assert(false);
+	CCTRACE("[Rasterize] GDAL not supported by this version! Can't generate a raster...");
+	return false;
+#endif
+}
+
+//! see CommandRasterize::process
+ccHObject* Rasterize_(
+	ccGenericPointCloud* cloud,
+	double gridStep,
+	unsigned short vertDir,
+	unsigned short outputCloudOrMesh, //0,1,2
+	bool outputRasterZ,
+	bool outputRasterSFs,
+	bool outputRasterRGB,
+	std::string pathToImages,
 	bool resample,
 	ccRasterGrid::ProjectionType projectionType,
 	ccRasterGrid::ProjectionType sfProjectionType,
@@ -2040,2470 +3887,4384 @@ ccMesh* RasterizeToMesh(
     int KrigingParamsKNN,
 	double customHeight,
 	ccBBox gridBBox,
-    bool export_perCellCount,
-    bool export_perCellMinHeight,
-    bool export_perCellMaxHeight,
-    bool export_perCellAvgHeight,
-    bool export_perCellHeightStdDev,
-    bool export_perCellHeightRange)
+    const std::vector<ccRasterGrid::ExportableFields>& extraScalarFields)
+{
+	CCTRACE("Rasterize_");
+	CCTRACE("Cloud:" << cloud);
+    ccRasterGrid::DelaunayInterpolationParams dInterpParams;
+    ccRasterGrid::KrigingParams krigingParams;
+    // force auto-guess
+    krigingParams.autoGuess = true;
+	ccHObject* entity = nullptr;
+	bool isCellCount = false;
+	if (gridStep <= 0)
+	{
+		CCTRACE("Invalid grid step value!");
+		return nullptr;
+	}
+	if (vertDir > 2)
+	{
+		CCTRACE("Invalid direction!");
+		return nullptr;
+	}
+	if (outputCloudOrMesh > 2)
+	{
+		CCTRACE("Invalid output option!");
+		return nullptr;
+	}
+	if (emptyCellFillStrategy == ccRasterGrid::FILL_CUSTOM_HEIGHT && std::isnan(customHeight))
+	{
+		CCTRACE("[Rasterize] The filling strategy is set to 'fill with custom height' but no custom height was defined...");
+		return nullptr;
+	}
+    if ((gridBBox.minCorner().norm2() < 1.e-12) && (gridBBox.maxCorner().norm2() < 1.e-12))
+    {
+    	gridBBox = cloud->getOwnBB();
+    }
+	//compute the grid size
+	unsigned gridWidth = 0;
+	unsigned gridHeight = 0;
+	if (!ccRasterGrid::ComputeGridSize(vertDir, gridBBox, gridStep, gridWidth, gridHeight))
+	{
+		CCTRACE("Failed to compute the grid dimensions (check input cloud(s) bounding-box)");
+		return nullptr;
+	}
+
+	if (gridWidth * gridHeight > (1 << 26)) //64 million of cells
+	{
+		CCTRACE("WARNING, Huge grid detected!");
+	}
+
+	ccRasterGrid grid;
+	{
+		//memory allocation
+		CCVector3d minCorner = gridBBox.minCorner();
+		if (!grid.init(gridWidth, gridHeight, gridStep, minCorner))
+		{
+			//not enough memory
+			CCTRACE("Not enough memory");
+			return nullptr;
+		}
+
+        ccRasterGrid::InterpolationType interpolationType = ccRasterGrid::InterpolationTypeFromEmptyCellFillOption(emptyCellFillStrategy);
+        void* interpolationParams = nullptr;
+        switch (interpolationType)
+        {
+        case ccRasterGrid::InterpolationType::DELAUNAY:
+            interpolationParams = (void*)&dInterpParams;
+            break;
+        case ccRasterGrid::InterpolationType::KRIGING:
+            interpolationParams = (void*)&krigingParams;
+            break;
+        default:
+            // do nothing
+            break;
+        }
+
+		if (grid.fillWith(cloud,
+		                  vertDir,
+		                  projectionType,
+                          interpolationType,
+                          interpolationParams,
+                          sfProjectionType))
+		{
+			grid.fillEmptyCells(emptyCellFillStrategy, customHeight);
+		}
+		else
+		{
+			CCTRACE("Rasterize process failed");
+			return nullptr;
+		}
+
+		//generate the result entity (cloud by default)
+		bool outputCloud = (outputCloudOrMesh == 1);
+		bool outputMesh = (outputCloudOrMesh == 2);
+		if (outputCloud || outputMesh)
+		{
+		    CCTRACE("--- outputCloud:" << outputCloud << " outputMesh:"<< outputMesh);
+            ccPointCloud* rasterCloud = nullptr;
+            try
+            {
+                //we always compute the default 'height' layer
+                std::vector<ccRasterGrid::ExportableFields> exportedStatistics(1);
+                exportedStatistics.back() = ccRasterGrid::PER_CELL_VALUE;
+
+                rasterCloud = grid.convertToCloud(  true,
+                                                    false,
+                                                    exportedStatistics,
+                                                    true,
+                                                    true,
+                                                    resample,
+                                                    resample,
+                                                    cloud,
+                                                    vertDir,
+                                                    gridBBox,
+                                                    0.0,
+                                                    true,
+                                                    nullptr
+                                                );
+
+            }
+            catch (const std::bad_alloc&)
+//			std::vector<ccRasterGrid::ExportableFields> exportedFields;
+//			try
+//			{
+//				//we always compute the default 'height' layer
+//				exportedFields.push_back(ccRasterGrid::PER_CELL_VALUE);
+//				for(auto & item : extraScalarFields)
+//				{
+//				    exportedFields.push_back(item);
+//				    if (item == ccRasterGrid::PER_CELL_COUNT)
+//				        isCellCount = true;
+//				}
+//			}
+//			catch (const std::bad_alloc&)
+			{
+				CCTRACE("Not enough memory");
+				return nullptr;
+			}
+
+//			ccPointCloud* rasterCloud = grid.convertToCloud(
+//			                                exportedFields,
+//			                                true,
+//			                                true,
+//			                                resample,
+//			                                resample,
+//			                                cloud,
+//			                                vertDir,
+//			                                gridBBox,
+//			                                emptyCellFillStrategy == ccRasterGrid::FILL_CUSTOM_HEIGHT,
+//			                                customHeight,
+//			                                true
+//			                                );
+
+			if (!rasterCloud)
+			{
+				CCTRACE("Failed to output the raster grid as a cloud");
+				return nullptr;
+			}
+
+			rasterCloud->showColors(cloud->hasColors());
+			if (rasterCloud->hasScalarFields())
+			{
+				rasterCloud->showSF(!cloud->hasColors());
+				rasterCloud->setCurrentDisplayedScalarField(0);
+			}
+			//don't forget the original shift
+			rasterCloud->copyGlobalShiftAndScale(*cloud);
+
+			if (outputCloud)
+			{
+				rasterCloud->setName(cloud->getName() += QString("_RASTER"));
+				entity = rasterCloud;
+				CCTRACE("entity:" << entity);
+			}
+			else if (outputMesh)
+			{
+				CCTRACE("--- outputMesh");
+				std::string errorStr;
+				CCCoreLib::GenericIndexedMesh* baseMesh =
+					CCCoreLib::PointProjectionTools::computeTriangulation(rasterCloud,
+																		  CCCoreLib::DELAUNAY_2D_AXIS_ALIGNED,
+																		  CCCoreLib::PointProjectionTools::IGNORE_MAX_EDGE_LENGTH,
+																		  vertDir,
+																		  errorStr);
+
+				if (baseMesh)
+				{
+					ccMesh* rasterMesh = new ccMesh(baseMesh, rasterCloud);
+					delete baseMesh;
+					baseMesh = nullptr;
+
+					rasterCloud->setEnabled(false);
+					rasterCloud->setVisible(true);
+					rasterMesh->addChild(rasterCloud);
+					rasterMesh->setName(rasterCloud->getName());
+					//rasterCloud->setName("vertices");
+					rasterMesh->showSF(rasterCloud->sfShown());
+					rasterMesh->showColors(rasterCloud->colorsShown());
+					rasterCloud = nullptr; //to avoid deleting it later
+					CCTRACE("[Rasterize] Mesh successfully generated " << rasterMesh->getName().toStdString());
+					entity = rasterMesh;
+					CCTRACE("entity:" << entity);
+				}
+				else
+				{
+					CCTRACE("[Rasterize] Failed to create output mesh " << errorStr);
+				}
+				if (rasterCloud)
+				{
+					delete rasterCloud;
+					rasterCloud = nullptr;
+				}
+			}
+		}
+
+		CCTRACE("entity:" << entity);
+		if (outputRasterZ)
+		{
+			CCTRACE("outputRasterZ");
+			ccRasterizeTool::ExportBands bands;
+			{
+				bands.height = true;
+				bands.rgb = false; //not a good idea to mix RGB and height values!
+				bands.allSFs = outputRasterSFs;
+				bands.density = isCellCount;
+			}
+			QString exportFilename = QString(pathToImages.c_str()) + "/" + cloud->getName() + "_RASTER_Z";
+			if (outputRasterSFs)
+			{
+				CCTRACE("outputRasterSFs");
+				exportFilename += "_AND_SF";
+			}
+			exportFilename += ".tif";
+
+			ExportGeoTiff_(	exportFilename, bands, emptyCellFillStrategy, grid,
+							gridBBox, vertDir, customHeight, cloud);
+		}
+
+		if (outputRasterRGB)
+		{
+			CCTRACE("outputRasterRGB");
+			ccRasterizeTool::ExportBands bands;
+			{
+				bands.rgb = true;
+				bands.height = false; //not a good idea to mix RGB and height values!
+				bands.allSFs = outputRasterSFs;
+                bands.density = isCellCount;
+			}
+			QString exportFilename = QString(pathToImages.c_str()) + "/" + cloud->getName() + "_RASTER_RGB.tif";
+
+			ExportGeoTiff_(	exportFilename, bands, emptyCellFillStrategy, grid,
+							gridBBox, vertDir, customHeight, cloud);
+		}
+	}
+    CCTRACE(entity->getName().toStdString());
+	return entity;
+}
+
+// ===========================================================================
+// ==== following used for ExtractSlicesAndContours (copy/adaptation from qCC)
+
+//list of already used point to avoid hull's inner loops
+enum HullPointFlags {   POINT_NOT_USED  = 0,
+                        POINT_USED      = 1,
+                        POINT_IGNORED   = 2,
+                        POINT_FROZEN    = 3,
+};
+
+using Vertex2D = CCCoreLib::PointProjectionTools::IndexedCCVector2;
+using VertexIterator = std::list<Vertex2D *>::iterator;
+using ConstVertexIterator = std::list<Vertex2D *>::const_iterator;
+using Hull2D = std::list<Vertex2D *>;
+
+namespace
+{
+    struct Edge_
+    {
+        Edge_() : nearestPointIndex(0), nearestPointSquareDist(-1.0f) {}
+
+        Edge_(const VertexIterator& A, unsigned _nearestPointIndex, float _nearestPointSquareDist)
+        : itA(A)
+        , nearestPointIndex(_nearestPointIndex)
+        , nearestPointSquareDist(_nearestPointSquareDist)
+    {}
+
+        //operator
+        inline bool operator< (const Edge_& e) const { return nearestPointSquareDist < e.nearestPointSquareDist; }
+
+        VertexIterator itA;
+        unsigned nearestPointIndex;
+        float nearestPointSquareDist;
+    };
+}
+
+namespace
+{
+    //Last envelope or contour unique ID
+    //std::vector<unsigned> s_lastContourUniqueIDs_;
+
+    //Envelope extraction parameters (global)
+    //double s_maxEnvelopeEdgeLength_ = -1.0;
+
+    //Meta-data key: origin entity UUID
+    constexpr char s_originEntityUUID_[] = "OriginEntityUUID";
+    //Meta-data key: slice (unique) ID
+    constexpr char s_sliceID_[] = "SliceID";
+}
+
+#ifndef CC_GDAL_SUPPORT
+#include "ccIsolines.h" //old alternative code to generate contour lines (doesn't work very well :( )
+#include <QCoreApplication>
+#else
+//GDAL
+#include <cpl_string.h>
+#include <gdal.h>
+#include <gdal_alg.h>
+
+//! Contour line piece, in raster coordinates, as produced by a GDAL contour generator
+/** The ccPolyline instances are only created afterwards, in the calling thread
+    (the generators may run concurrently, see ccContourLinesGenerator_::GenerateContourLines).
+**/
+struct RawContourLine_
+{
+    double level = 0.0;
+    unsigned subIndex = 0;
+    unsigned emissionRow = 0; //scan line being fed (or the grid height, when flushed) when the generator emitted this line
+    std::vector<CCVector3> vertices;
+};
+
+struct ContourGenerationParameters_
+{
+    std::vector<RawContourLine_> contourLines;
+    const ccRasterGrid* grid = nullptr;
+    bool projectContourOnAltitudes = false;
+    bool failed = false;
+    unsigned currentRow = 0; //scan line currently fed to the generator
+};
+
+CPLErr ContourWriter_(  double dfLevel,
+                        int nPoints,
+                        double *padfX,
+                        double *padfY,
+                        void * userData);
+#endif //CC_GDAL_SUPPORT
+
+class ccContourLinesGenerator_
+{
+public:
+//! Contour lines generation parameters
+    struct Parameters
+    {
+        double startAltitude = 0.0;
+        double maxAltitude = 0.0;
+        double step = 0.0; //gap between levels
+        ccScalarField* altitudes = nullptr; //optional scalar field that stores the 'altitudes' (may be null, in which case the grid 'h' values are used directly)
+        int minVertexCount = 3; //minimum number of vertices per contour line
+        bool projectContourOnAltitudes = false;
+        double emptyCellsValue = std::numeric_limits<double>::quiet_NaN();
+
+        /* The parameters below are only required if GDAL is not required */
+        QWidget* parentWidget = nullptr; //for progress dialog
+        bool ignoreBorders = false;
+
+        int maxThreadCount = 0; //max number of concurrent GDAL generators (0 = all the available threads, 1 = a single generator)
+    };
+
+    //! Additional meta-data key for generated polylines (see ccPolyline)
+    static const char* MetaKeySubIndex() { return "SubIndex"; }
+
+#ifdef CC_GDAL_SUPPORT
+    //! Generates the contour lines with GDAL, in raster coordinates
+    /** No CC entity is created here, so this method can be called concurrently
+        (see ConvertRawContourLines to get the corresponding polylines).
+    **/
+    static bool GenerateRawContourLines(const ccRasterGrid* rasterGrid,
+                                        const Parameters& params,
+                                        std::vector<RawContourLine_>& rawLines)
+    {
+        bool sparseLayer = (params.altitudes && params.altitudes->currentSize() != rasterGrid->height * rasterGrid->width);
+
+        try
+        {
+            //fill the grid of values once (shared by all the contour generators)
+            std::vector<double> values;
+            values.resize(static_cast<size_t>(rasterGrid->width) * rasterGrid->height);
+            {
+                unsigned layerIndex = 0;
+
+                for (unsigned j = 0; j < rasterGrid->height; ++j)
+                {
+                    const ccRasterGrid::Row& cellRow = rasterGrid->rows[j];
+                    double* scanline = values.data() + static_cast<size_t>(j) * rasterGrid->width;
+                    for (unsigned i = 0; i < rasterGrid->width; ++i)
+                    {
+                        if (cellRow[i].nbPoints || !sparseLayer)
+                        {
+                            if (params.altitudes)
+                            {
+                                ScalarType value = params.altitudes->getValue(layerIndex++);
+                                scanline[i] = ccScalarField::ValidValue(value) ? value : params.emptyCellsValue;
+                            }
+                            else
+                            {
+                                scanline[i] = std::isfinite(cellRow[i].h) ? cellRow[i].h : params.emptyCellsValue;
+                            }
+                        }
+                        else
+                        {
+                            scanline[i] = params.emptyCellsValue;
+                        }
+                    }
+                }
+            }
+
+            //runs a GDAL 'Contour Generator' on the shared grid
+            auto generateContours = [&](ContourGenerationParameters_& generatorParams, double interval, double base)
+            {
+                generatorParams.grid = rasterGrid;
+                generatorParams.projectContourOnAltitudes = params.projectContourOnAltitudes;
+                GDALContourGeneratorH hCG = GDAL_CG_Create( rasterGrid->width,
+                                                            rasterGrid->height,
+                                                            std::isnan(params.emptyCellsValue) ? FALSE : TRUE,
+                                                            params.emptyCellsValue,
+                                                            interval,
+                                                            base,
+                                                            ContourWriter_,
+                                                            &generatorParams);
+                if (!hCG)
+                {
+                    generatorParams.grid = nullptr;
+                    return;
+                }
+
+                //feed the scan lines
+                for (unsigned j = 0; j < rasterGrid->height; ++j)
+                {
+                    generatorParams.currentRow = j;
+                    CPLErr error = GDAL_CG_FeedLine(hCG, values.data() + static_cast<size_t>(j) * rasterGrid->width);
+                    if (error != CE_None)
+                    {
+                        generatorParams.failed = true;
+                        break;
+                    }
+                }
+
+                //the remaining lines are flushed at destruction
+                generatorParams.currentRow = rasterGrid->height;
+                GDAL_CG_Destroy(hCG);
+            };
+
+            //in parallel, each level gets its own generator: its base is the level value, computed exactly as GDAL does
+            //for a single generator (n * step + startAltitude), and its interval is wider than the range of values,
+            //so that this level is the only one generated. The level values and the lines of each level are then
+            //the same as with a single generator. As each generator scans the whole grid, this is only done when
+            //there are no more levels than threads (otherwise a single generator is faster).
+            std::vector<ContourGenerationParameters_> gdalParams;
+            bool perLevel = false;
+    #ifdef CC_CORE_LIB_USES_TBB
+            int threadCount = (params.maxThreadCount > 0 ? params.maxThreadCount : std::max(QThread::idealThreadCount(), 1));
+            if (    CCCoreLib::GreaterThanEpsilon(params.step)
+                &&  threadCount > 1 )
+            {
+                double minValue = std::numeric_limits<double>::max();
+                double maxValue = -std::numeric_limits<double>::max();
+                for (double v : values)
+                {
+                    if (std::isfinite(v) && (std::isnan(params.emptyCellsValue) || v != params.emptyCellsValue))
+                    {
+                        minValue = std::min(minValue, v);
+                        maxValue = std::max(maxValue, v);
+                    }
+                }
+
+                if (minValue <= maxValue)
+                {
+                    //all the levels GDAL would generate from the values (plus a safety margin)
+                    long long firstLevel = static_cast<long long>(std::ceil((minValue - params.startAltitude) / params.step)) - 1;
+                    long long lastLevel = static_cast<long long>(std::floor((maxValue - params.startAltitude) / params.step)) + 1;
+                    if (    lastLevel >= firstLevel + 1
+                        &&  lastLevel - firstLevel + 1 <= threadCount )
+                    {
+                        perLevel = true;
+                        gdalParams.resize(static_cast<size_t>(lastLevel - firstLevel + 1));
+                        tbb::parallel_for(static_cast<size_t>(0), gdalParams.size(), [&](size_t k)
+                        {
+                            double level = static_cast<double>(firstLevel + static_cast<long long>(k)) * params.step + params.startAltitude;
+                            double interval = (maxValue - minValue) + std::abs(level - minValue) + std::abs(level - maxValue) + 1.0;
+                            generateContours(gdalParams[k], interval, level);
+                        });
+                    }
+                }
+            }
+    #endif
+            if (!perLevel)
+            {
+                gdalParams.resize(1);
+                generateContours(gdalParams.front(), params.step, params.startAltitude);
+            }
+
+            for (ContourGenerationParameters_& generatorParams : gdalParams)
+            {
+                if (!generatorParams.grid)
+                {
+                    CCTRACE("[GDAL] Failed to create contour generator");
+                    return false;
+                }
+                if (generatorParams.failed)
+                {
+                    CCTRACE("[GDAL] An error occurred during contour lines generation");
+                }
+                size_t firstIndex = rawLines.size();
+                rawLines.resize(firstIndex + generatorParams.contourLines.size());
+                std::move(generatorParams.contourLines.begin(), generatorParams.contourLines.end(), rawLines.begin() + firstIndex);
+                generatorParams.contourLines.clear();
+            }
+            if (perLevel)
+            {
+                //restore the emission order of a single generator: after each scan line, GDAL emits the finished
+                //lines level by level (lower levels first), and the lines of a level in their emission order.
+                //The generators are stored by increasing level, so a stable sort by (row, level) is enough.
+                std::stable_sort(rawLines.begin(), rawLines.end(), [](const RawContourLine_& a, const RawContourLine_& b)
+                {
+                    return (a.emissionRow != b.emissionRow ? a.emissionRow < b.emissionRow : a.level < b.level);
+                });
+            }
+        }
+        catch (const std::bad_alloc&)
+        {
+            CCTRACE("[GDAL] Not enough memory");
+            return false;
+        }
+
+        return true;
+    }
+
+    //! Converts raw contour lines (see GenerateRawContourLines) into polylines, in the cloud C.S.
+    /** Lines with less than params.minVertexCount vertices are ignored.
+    **/
+    static bool ConvertRawContourLines( const std::vector<RawContourLine_>& rawLines,
+                                        const ccRasterGrid* rasterGrid,
+                                        const CCVector2d& gridMinCornerXY,
+                                        const Parameters& params,
+                                        std::vector<ccPolyline*>& contourLines)
+    {
+        try
+        {
+            //have we generated any contour line?
+            for (const RawContourLine_& line : rawLines)
+            {
+                //we drop the too small lines before creating any polyline
+                if (static_cast<int>(line.vertices.size()) < params.minVertexCount)
+                {
+                    continue;
+                }
+
+                unsigned vertCount = static_cast<unsigned>(line.vertices.size());
+                ccPointCloud* vertices = new ccPointCloud("vertices");
+                vertices->setEnabled(false);
+                ccPolyline* poly = new ccPolyline(vertices);
+                poly->addChild(vertices);
+                poly->setMetaData(ccContourLinesGenerator_::MetaKeySubIndex(), line.subIndex);
+                poly->setClosed(false);
+
+                //add the 'const altitude' meta-data as well
+                poly->setMetaData(ccPolyline::MetaKeyConstAltitude(), QVariant(line.level));
+
+                if (!vertices->reserve(vertCount) || !poly->reserve(vertCount))
+                {
+                    delete poly;
+                    poly = nullptr;
+                    CCTRACE("[GDAL] Not enough memory");
+                    return false;
+                }
+
+                //reproject contour lines from raster C.S. to the cloud C.S.
+                for (const CCVector3& P2D : line.vertices)
+                {
+                    CCVector3 P(    static_cast<PointCoordinateType>((P2D.x - 0.5) * rasterGrid->gridStep + gridMinCornerXY.x),
+                                    static_cast<PointCoordinateType>((P2D.y - 0.5) * rasterGrid->gridStep + gridMinCornerXY.y),
+                                    P2D.z );
+                    vertices->addPoint(P);
+                }
+                poly->addPointIndex(0, vertCount);
+
+                //add contour
+                double height = line.vertices.front().z;
+                poly->setName(QString("Contour line value = %1 (#%2)").arg(height).arg(line.subIndex));
+                contourLines.push_back(poly);
+            }
+        }
+        catch (const std::bad_alloc&)
+        {
+            CCTRACE("[GDAL] Not enough memory");
+            return false;
+        }
+
+        return true;
+    }
+#endif //CC_GDAL_SUPPORT
+
+    static bool GenerateContourLines(   ccRasterGrid* rasterGrid,
+                                        const CCVector2d& gridMinCornerXY,
+                                        const Parameters& params,
+                                        std::vector<ccPolyline*>& contourLines)
+    {
+        CCTRACE("GenerateContourLines");
+        if (!rasterGrid || !rasterGrid->isValid())
+        {
+            CCTRACE("Need a valid raster/cloud to compute contours!");
+            assert(false);
+            return false;
+        }
+        if (params.startAltitude > params.maxAltitude)
+        {
+            CCTRACE("Start value is above the layer maximum value!");
+            assert(false);
+            return false;
+        }
+        if (params.step < 0)
+        {
+            CCTRACE("Invalid step value");
+            assert(false);
+            return false;
+        }
+        if (params.minVertexCount < 3)
+        {
+            CCTRACE("Invalid input parameter: can't have less than 3 vertices per contour line");
+            assert(false);
+            return false;
+        }
+
+        bool sparseLayer = (params.altitudes && params.altitudes->currentSize() != rasterGrid->height * rasterGrid->width);
+        if (sparseLayer && !std::isfinite(params.emptyCellsValue))
+        {
+            CCTRACE("Invalid empty cell value (sparse layer)");
+            assert(false);
+            return false;
+        }
+
+        unsigned levelCount = 1;
+        if (CCCoreLib::GreaterThanEpsilon(params.step))
+        {
+            levelCount += static_cast<unsigned>(floor((params.maxAltitude - params.startAltitude) / params.step));
+        }
+
+        try
+        {
+    #ifdef CC_GDAL_SUPPORT //use GDAL (more robust) - otherwise we will use an old code found on the Internet (with a strange behavior)
+
+            std::vector<RawContourLine_> rawLines;
+            if (    !GenerateRawContourLines(rasterGrid, params, rawLines)
+                ||  !ConvertRawContourLines(rawLines, rasterGrid, gridMinCornerXY, params, contourLines))
+            {
+                return false;
+            }
+    #else
+            unsigned xDim = rasterGrid->width;
+            unsigned yDim = rasterGrid->height;
+
+            int margin = 0;
+            if (!params.ignoreBorders)
+            {
+                margin = 1;
+                xDim += 2;
+                yDim += 2;
+            }
+            std::vector<double> grid(xDim * yDim, 0);
+
+            //fill grid
+            {
+                unsigned layerIndex = 0;
+                for (unsigned j = 0; j < rasterGrid->height; ++j)
+                {
+                    const ccRasterGrid::Row& cellRow = rasterGrid->rows[j];
+                    double* row = &(grid[(j + margin)*xDim + margin]);
+                    for (unsigned i = 0; i < rasterGrid->width; ++i)
+                    {
+                        if (cellRow[i].nbPoints || !sparseLayer)
+                        {
+                            if (params.altitudes)
+                            {
+                                ScalarType value = params.altitudes->getValue(layerIndex++);
+                                row[i] = ccScalarField::ValidValue(value) ? value : params.emptyCellsValue;
+                            }
+                            else
+                            {
+                                row[i] = std::isfinite(cellRow[i].h) ? cellRow[i].h : params.emptyCellsValue;
+                            }
+                        }
+                        else
+                        {
+                            row[i] = params.emptyCellsValue;
+                        }
+                    }
+                }
+            }
+
+            //generate contour lines
+            {
+                Isolines<double> iso(static_cast<int>(xDim), static_cast<int>(yDim));
+                if (!params.ignoreBorders)
+                {
+                    iso.createOnePixelBorder(grid.data(), params.startAltitude - 1.0);
+                }
+
+                ccProgressDialog pDlg(true, params.parentWidget);
+                pDlg.setMethodTitle(QObject::tr("Contour plot"));
+                pDlg.setInfo(QObject::tr("Levels: %1\nCells: %2 x %3").arg(levelCount).arg(rasterGrid->width).arg(rasterGrid->height));
+                pDlg.start();
+                pDlg.show();
+                QCoreApplication::processEvents();
+                CCCoreLib::NormalizedProgress nProgress(&pDlg, levelCount);
+
+                for (double v = params.startAltitude; v <= params.maxAltitude; v += params.step)
+                {
+                    //extract contour lines for the current level
+                    iso.setThreshold(v);
+                    int lineCount = iso.find(grid.data());
+
+                    ccLog::PrintDebug(QString("[Rasterize][Isolines] value=%1 : %2 lines").arg(v).arg(lineCount));
+                    CCTRACE("[Rasterize][Isolines] value=" << v << " : " << lineCount << "lines");
+
+                    //convert them to poylines
+                    int realCount = 0;
+                    for (int i = 0; i < lineCount; ++i)
+                    {
+                        int vertCount = iso.getContourLength(i);
+                        if (vertCount >= params.minVertexCount)
+                        {
+                            int startVi = 0; //we may have to split the polyline in multiple chunks
+                            while (startVi < vertCount)
+                            {
+                                ccPointCloud* vertices = new ccPointCloud("vertices");
+                                ccPolyline* poly = new ccPolyline(vertices);
+                                poly->addChild(vertices);
+                                bool isClosed = (startVi == 0 ? iso.isContourClosed(i) : false);
+                                if (poly->reserve(vertCount - startVi) && vertices->reserve(vertCount - startVi))
+                                {
+                                    unsigned localIndex = 0;
+                                    for (int vi = startVi; vi < vertCount; ++vi)
+                                    {
+                                        ++startVi;
+
+                                        double x = iso.getContourX(i, vi) - margin;
+                                        double y = iso.getContourY(i, vi) - margin;
+
+                                        CCVector3 P;
+                                        //DGM: we will only do the dimension mapping at export time
+                                        //(otherwise the contour lines appear in the wrong orientation compared to the grid/raster which
+                                        // is in the XY plane by default!)
+                                        /*P.u[X] = */P.x = static_cast<PointCoordinateType>((x + 0.5) * rasterGrid->gridStep + gridMinCornerXY.x);
+                                        /*P.u[Y] = */P.y = static_cast<PointCoordinateType>((y + 0.5) * rasterGrid->gridStep + gridMinCornerXY.y);
+                                        if (params.projectContourOnAltitudes)
+                                        {
+                                            int xi = std::min(std::max(static_cast<int>(x), 0), static_cast<int>(rasterGrid->width) - 1);
+                                            int yi = std::min(std::max(static_cast<int>(y), 0), static_cast<int>(rasterGrid->height) - 1);
+                                            double h = rasterGrid->rows[yi][xi].h;
+                                            if (std::isfinite(h))
+                                            {
+                                                /*P.u[Z] = */P.z = static_cast<PointCoordinateType>(h);
+                                            }
+                                            else
+                                            {
+                                                //DGM: we stop the current polyline
+                                                isClosed = false;
+                                                break;
+                                            }
+                                        }
+                                        else
+                                        {
+                                            /*P.u[Z] = */P.z = static_cast<PointCoordinateType>(v);
+                                        }
+
+                                        vertices->addPoint(P);
+                                        assert(localIndex < vertices->size());
+                                        poly->addPointIndex(localIndex++);
+                                    }
+
+                                    assert(poly);
+                                    if (poly->size() > 1)
+                                    {
+                                        poly->setClosed(isClosed); //if we have less vertices, it means we have 'chopped' the original contour
+                                        vertices->setEnabled(false);
+
+                                        ++realCount;
+                                        poly->setMetaData(ccContourLinesGenerator::MetaKeySubIndex(), realCount);
+
+                                        //add the 'const altitude' meta-data as well
+                                        poly->setMetaData(ccPolyline::MetaKeyConstAltitude(), QVariant(v));
+
+                                        //add contour
+                                        poly->setName(QString("Contour line value = %1 (#%2)").arg(v).arg(realCount));
+                                        try
+                                        {
+                                            contourLines.push_back(poly);
+                                        }
+                                        catch (const std::bad_alloc&)
+                                        {
+                                            CCTRACE("[ccContourLinesGenerator] Not enough memory");
+                                            return false;
+                                        }
+                                    }
+                                    else
+                                    {
+                                        delete poly;
+                                        poly = nullptr;
+                                    }
+                                }
+                                else
+                                {
+                                    delete poly;
+                                    poly = nullptr;
+                                    CCTRACE("Not enough memory!");
+                                    return false;
+                                }
+                            }
+                        }
+                    }
+
+                    if (!nProgress.oneStep())
+                    {
+                        //process cancelled by user
+                        break;
+                    }
+                }
+            }
+    #endif
+        }
+        catch (const std::bad_alloc&)
+        {
+            CCTRACE("[ccContourLinesGenerator] Not enough memory");
+            return false;
+        }
+
+        ccLog::Print(QString("[ccContourLinesGenerator] %1 iso-lines generated (%2 levels)").arg(contourLines.size()).arg(levelCount));
+        CCTRACE("[ccContourLinesGenerator] " <<  contourLines.size() << " iso-lines generated (" << levelCount << " levels)");
+        return true;
+    };
+};
+
+
+#ifdef CC_GDAL_SUPPORT
+CPLErr ContourWriter_(  double dfLevel,
+                        int nPoints,
+                        double *padfX,
+                        double *padfY,
+                        void * userData)
 {
-    CCTRACE("RasterizeToMesh");
-    std::vector<ccRasterGrid::ExportableFields> extraScalarFields = {};
-    if (export_perCellCount) extraScalarFields.push_back(ccRasterGrid::PER_CELL_COUNT);
-    if (export_perCellMinHeight) extraScalarFields.push_back(ccRasterGrid::PER_CELL_MIN_VALUE);
-    if (export_perCellMaxHeight) extraScalarFields.push_back(ccRasterGrid::PER_CELL_MAX_VALUE);
-    if (export_perCellAvgHeight) extraScalarFields.push_back(ccRasterGrid::PER_CELL_AVG_VALUE);
-    if (export_perCellHeightStdDev) extraScalarFields.push_back(ccRasterGrid::PER_CELL_VALUE_STD_DEV);
-    if (export_perCellHeightRange) extraScalarFields.push_back(ccRasterGrid::PER_CELL_VALUE_RANGE);
-	ccHObject* entity = Rasterize_(cloud, gridStep, vertDir, 2,
-			outputRasterZ, outputRasterSFs, outputRasterRGB, pathToImages, resample,
-			projectionType, sfProjectionType, emptyCellFillStrategy,
-            DelaunayMaxEdgeLength, KrigingParamsKNN,
-			customHeight, gridBBox, extraScalarFields);
-	CCTRACE("entity:" << entity);
-	ccMesh* mesh = ccHObjectCaster::ToMesh(entity);
-	return mesh;
+    //CCTRACE("ContourWriter_");
+    if (nPoints < 2)
+    {
+        //nothing to do
+        assert(false);
+        return CE_None;
+    }
+
+    ContourGenerationParameters_* params = reinterpret_cast<ContourGenerationParameters_*>(userData);
+    if (!params || !params->grid)
+    {
+        assert(false);
+        return CE_Failure;
+    }
+
+    RawContourLine_* line = nullptr;
+
+    unsigned subIndex = 0;
+    try
+    {
+        for (int i = 0; i < nPoints; ++i)
+        {
+            CCVector3 P(padfX[i], padfY[i], dfLevel);
+
+            if (params->projectContourOnAltitudes)
+            {
+                int xi = std::min(std::max(static_cast<int>(padfX[i]), 0), static_cast<int>(params->grid->width) - 1);
+                int yi = std::min(std::max(static_cast<int>(padfY[i]), 0), static_cast<int>(params->grid->height) - 1);
+                double h = params->grid->rows[yi][xi].h;
+                if (std::isfinite(h))
+                {
+                    P.z = static_cast<PointCoordinateType>(h);
+                }
+                else
+                {
+                    //DGM: we stop the current polyline
+                    if (line)
+                    {
+                        if (line->vertices.size() < 2)
+                        {
+                            params->contourLines.pop_back();
+                        }
+                        line = nullptr;
+                    }
+                    continue;
+                }
+            }
+
+            if (!line)
+            {
+                //we need to start a new line (always the last one of the list)
+                params->contourLines.emplace_back();
+                line = &params->contourLines.back();
+                line->level = dfLevel;
+                line->subIndex = ++subIndex;
+                line->emissionRow = params->currentRow;
+                line->vertices.reserve(nPoints - i);
+            }
+
+            line->vertices.push_back(P);
+        }
+    }
+    catch (const std::bad_alloc&)
+    {
+        //not enough memory
+        return CE_Failure;
+    }
+
+    return CE_None;
 }
+#endif //CC_GDAL_SUPPORT
 
-ccHObject* RasterizeGeoTiffOnly(
-	ccGenericPointCloud* cloud,
-	double gridStep,
-	CC_DIRECTION vertDir,
-	bool outputRasterZ,
-	bool outputRasterSFs,
-	bool outputRasterRGB,
-	std::string pathToImages,
-	bool resample,
-	ccRasterGrid::ProjectionType projectionType,
-	ccRasterGrid::ProjectionType sfProjectionType,
-	ccRasterGrid::EmptyCellFillOption emptyCellFillStrategy,
-    double DelaunayMaxEdgeLength,
-    int KrigingParamsKNN,
-	double customHeight,
-	ccBBox gridBBox,
-    bool export_perCellCount,
-    bool export_perCellMinHeight,
-    bool export_perCellMaxHeight,
-    bool export_perCellAvgHeight,
-    bool export_perCellHeightStdDev,
-    bool export_perCellHeightRange)
+//! Checks if a point is a valid candidate to split the edge AB
+/** \return The square distance of the point to the edge (or -1 if the point is not a valid candidate)
+**/
+inline PointCoordinateType CandidateSquareDist_(const Vertex2D& P,
+                                                const Vertex2D& A,
+                                                const Vertex2D& B,
+                                                const std::vector<HullPointFlags>& pointFlags,
+                                                PointCoordinateType minSquareEdgeLength,
+                                                bool allowLongerChunks,
+                                                double minCosAngle)
 {
-    CCTRACE("RasterizeGeoTiffOnly");
-    std::vector<ccRasterGrid::ExportableFields> extraScalarFields = {};
-    if (export_perCellCount) extraScalarFields.push_back(ccRasterGrid::PER_CELL_COUNT);
-    if (export_perCellMinHeight) extraScalarFields.push_back(ccRasterGrid::PER_CELL_MIN_VALUE);
-    if (export_perCellMaxHeight) extraScalarFields.push_back(ccRasterGrid::PER_CELL_MAX_VALUE);
-    if (export_perCellAvgHeight) extraScalarFields.push_back(ccRasterGrid::PER_CELL_AVG_VALUE);
-    if (export_perCellHeightStdDev) extraScalarFields.push_back(ccRasterGrid::PER_CELL_VALUE_STD_DEV);
-    if (export_perCellHeightRange) extraScalarFields.push_back(ccRasterGrid::PER_CELL_VALUE_RANGE);
-	ccHObject* entity = Rasterize_(cloud, gridStep, vertDir, 2,
-			outputRasterZ, outputRasterSFs, outputRasterRGB, pathToImages, resample,
-			projectionType, sfProjectionType, emptyCellFillStrategy,
-            DelaunayMaxEdgeLength, KrigingParamsKNN,
-			customHeight, gridBBox, extraScalarFields);
-	return nullptr; // only image files created, no object returned
+    if (pointFlags[P.index] != POINT_NOT_USED)
+        return -1;
+
+    //skip the edge vertices!
+    if (P.index == A.index || P.index == B.index)
+        return -1;
+
+    //we only consider 'inner' points
+    const CCVector2 AB = B - A;
+    const CCVector2 AP = P - A;
+    if (AB.x * AP.y - AB.y * AP.x < 0)
+        return -1;
+
+    //check the angle
+    if (minCosAngle > -1.0)
+    {
+        const CCVector2 PB = B - P;
+        const PointCoordinateType dotProd = AP.x * PB.x + AP.y * PB.y;
+        const PointCoordinateType minDotProd = static_cast<PointCoordinateType>(minCosAngle * std::sqrt(AP.norm2() * PB.norm2()));
+        if (dotProd < minDotProd)
+            return -1;
+    }
+
+    const PointCoordinateType squareLengthAB = AB.norm2();
+    const PointCoordinateType dot = AB.dot(AP); // = cos(PAB) * ||AP|| * ||AB||
+    if (dot < 0 || dot > squareLengthAB)
+        return -1;
+
+    //the 'nearest' point must also be a valid candidate
+    //(i.e. at least one of the created edges is smaller than the original one
+    //and we don't create too small edges!)
+    const PointCoordinateType squareLengthAP = AP.norm2();
+    const PointCoordinateType squareLengthBP = (P - B).norm2();
+    if (    squareLengthAP < minSquareEdgeLength
+        ||  squareLengthBP < minSquareEdgeLength
+        ||  (!allowLongerChunks && squareLengthAP >= squareLengthAB && squareLengthBP >= squareLengthAB)
+        )
+        return -1;
+
+    const CCVector2 HP = AP - AB * (dot / squareLengthAB);
+    return HP.norm2();
 }
 
-//! clone of ccRasterizeTool::ExportGeoTiff
-bool ExportGeoTiff_(const QString& outputFilename,
-					const ccRasterizeTool::ExportBands& exportBands,
-					ccRasterGrid::EmptyCellFillOption fillEmptyCellsStrategy,
-					const ccRasterGrid& grid,
-					const ccBBox& gridBBox,
-					unsigned char Z,
-					double customHeightForEmptyCells/*=std::numeric_limits<double>::quiet_NaN()*/,
-					ccGenericPointCloud* originCloud/*=0*/,
-					int visibleSfIndex=-1)
+//! Uniform 2D grid over the hull candidate points, to look only at the points near an edge (see FindNearestCandidate_)
+class HullCandidateGrid_
 {
-	CCTRACE("fillEmptyCellsStrategy:" << fillEmptyCellsStrategy);
-#ifdef CC_GDAL_SUPPORT
+public:
+    bool init(const std::vector<Vertex2D>& points)
+    {
+        if (points.empty())
+        {
+            return false;
+        }
+        CCVector2 minP = points.front();
+        CCVector2 maxP = points.front();
+        for (const Vertex2D& P : points)
+        {
+            minP.x = std::min(P.x, minP.x);
+            minP.y = std::min(P.y, minP.y);
+            maxP.x = std::max(P.x, maxP.x);
+            maxP.y = std::max(P.y, maxP.y);
+        }
+        const CCVector2 diag = maxP - minP;
 
-	if (exportBands.visibleSF && visibleSfIndex < 0)
-	{
-		assert(false);
-		return false;
-	}
+        //roughly 2 points per cell (with a reasonable number of cells)
+        double targetCellCount = std::max(points.size() / 2.0, 1.0);
+        double cellSize = 0;
+        if (diag.x > 0 && diag.y > 0)
+            cellSize = std::sqrt(static_cast<double>(diag.x) * diag.y / targetCellCount);
+        else
+            cellSize = std::max(diag.x, diag.y) / targetCellCount;
+        if (cellSize <= 0)
+        {
+            //all points are the same
+            return false;
+        }
+        m_origin = minP;
+        m_dims[0] = std::max(static_cast<int>(std::min(std::ceil(diag.x / cellSize), 4096.0)), 1);
+        m_dims[1] = std::max(static_cast<int>(std::min(std::ceil(diag.y / cellSize), 4096.0)), 1);
+        m_cellSize[0] = std::max(diag.x / m_dims[0], std::numeric_limits<PointCoordinateType>::epsilon());
+        m_cellSize[1] = std::max(diag.y / m_dims[1], std::numeric_limits<PointCoordinateType>::epsilon());
+
+        //CSR storage of the points indexes per cell
+        size_t cellCount = static_cast<size_t>(m_dims[0]) * m_dims[1];
+        try
+        {
+            m_cellStarts.assign(cellCount + 1, 0);
+            m_pointIndexes.resize(points.size());
+        }
+        catch (const std::bad_alloc&)
+        {
+            return false;
+        }
+        for (const Vertex2D& P : points)
+        {
+            ++m_cellStarts[getCellIndex(P) + 1];
+        }
+        for (size_t c = 0; c < cellCount; ++c)
+        {
+            m_cellStarts[c + 1] += m_cellStarts[c];
+        }
+        std::vector<unsigned> fillPos(m_cellStarts.begin(), m_cellStarts.end() - 1);
+        for (size_t i = 0; i < points.size(); ++i)
+        {
+            m_pointIndexes[fillPos[getCellIndex(points[i])]++] = static_cast<unsigned>(i);
+        }
+        return true;
+    }
 
-	//vertical dimension
-	assert(Z <= 2);
-	const unsigned char X = Z == 2 ? 0 : Z + 1;
-	const unsigned char Y = X == 2 ? 0 : X + 1;
+    //! Finds the nearest candidate to the edge AB (same result as an exhaustive search, see CandidateSquareDist_)
+    /** The cells are visited ring by ring around the cells of the edge, until the next ring can't contain a nearer point.
+        \return The nearest point square distance (or -1 if no point was found!)
+    **/
+    PointCoordinateType findNearest(unsigned& minIndex,
+                                    const Vertex2D& A,
+                                    const Vertex2D& B,
+                                    const std::vector<Vertex2D>& points,
+                                    const std::vector<HullPointFlags>& pointFlags,
+                                    PointCoordinateType minSquareEdgeLength,
+                                    bool allowLongerChunks,
+                                    double minCosAngle) const
+    {
+        PointCoordinateType minDist2 = -1;
+        const CCVector2 AB = B - A;
+        const PointCoordinateType squareLengthAB = AB.norm2();
+
+        auto visitCell = [&](int i, int j)
+        {
+            size_t cellIndex = static_cast<size_t>(j) * m_dims[0] + i;
+            if (m_cellStarts[cellIndex] == m_cellStarts[cellIndex + 1])
+                return;
+
+            //skip the cells entirely on the outer side, outside of the edge 'band' or farther than the current candidate
+            bool allOuter = true;
+            bool allBefore = true;
+            bool allAfter = true;
+            PointCoordinateType minCross = std::numeric_limits<PointCoordinateType>::max();
+            for (int c = 0; c < 4; ++c)
+            {
+                CCVector2 corner(m_origin.x + (i + (c & 1)) * m_cellSize[0], m_origin.y + (j + (c >> 1)) * m_cellSize[1]);
+                CCVector2 AC = corner - A;
+                PointCoordinateType cross = AB.x * AC.y - AB.y * AC.x;
+                PointCoordinateType dot = AB.dot(AC);
+                allOuter &= (cross < 0);
+                allBefore &= (dot < 0);
+                allAfter &= (dot > squareLengthAB);
+                minCross = std::min(minCross, cross);
+            }
+            if (allOuter || allBefore || allAfter)
+                return;
+            if (minDist2 >= 0 && minCross > 0 && minCross * minCross > minDist2 * squareLengthAB)
+                return;
+
+            for (unsigned k = m_cellStarts[cellIndex]; k < m_cellStarts[cellIndex + 1]; ++k)
+            {
+                unsigned index = m_pointIndexes[k];
+                PointCoordinateType dist2 = CandidateSquareDist_(points[index], A, B, pointFlags, minSquareEdgeLength, allowLongerChunks, minCosAngle);
+                if (dist2 >= 0 && (minDist2 < 0 || dist2 < minDist2 || (dist2 == minDist2 && index < minIndex)))
+                {
+                    minDist2 = dist2;
+                    minIndex = index;
+                }
+            }
+        };
 
-    double stepX = grid.gridStep;
-    double stepY = grid.gridStep;
+        int i0, j0, i1, j1;
+        getCellPos(CCVector2(std::min(A.x, B.x), std::min(A.y, B.y)), i0, j0);
+        getCellPos(CCVector2(std::max(A.x, B.x), std::max(A.y, B.y)), i1, j1);
+        for (int k = 0; ; ++k)
+        {
+            int loI = i0 - k, hiI = i1 + k;
+            int loJ = j0 - k, hiJ = j1 + k;
+            if (k == 0)
+            {
+                for (int j = j0; j <= j1; ++j)
+                    for (int i = i0; i <= i1; ++i)
+                        visitCell(i, j);
+            }
+            else
+            {
+                int fromI = std::max(loI, 0), toI = std::min(hiI, m_dims[0] - 1);
+                if (loJ >= 0)
+                    for (int i = fromI; i <= toI; ++i)
+                        visitCell(i, loJ);
+                if (hiJ < m_dims[1])
+                    for (int i = fromI; i <= toI; ++i)
+                        visitCell(i, hiJ);
+                int fromJ = std::max(loJ + 1, 0), toJ = std::min(hiJ - 1, m_dims[1] - 1);
+                if (loI >= 0)
+                    for (int j = fromJ; j <= toJ; ++j)
+                        visitCell(loI, j);
+                if (hiI < m_dims[0])
+                    for (int j = fromJ; j <= toJ; ++j)
+                        visitCell(hiI, j);
+            }
 
-    //global shift
-    assert(gridBBox.isValid());
-    double shiftX = gridBBox.minCorner().u[X] - stepX / 2; //we will declare the raster grid as 'Pixel-is-area'!
-    double shiftY = gridBBox.maxCorner().u[Y] + stepY / 2; //we will declare the raster grid as 'Pixel-is-area'!
-    double shiftZ = 0.0;
+            bool coveredI = (loI <= 0 && hiI >= m_dims[0] - 1);
+            bool coveredJ = (loJ <= 0 && hiJ >= m_dims[1] - 1);
+            if (coveredI && coveredJ)
+                break;
+            if (minDist2 >= 0)
+            {
+                //the points not visited yet are at least at this distance from the edge
+                PointCoordinateType reach = std::numeric_limits<PointCoordinateType>::max();
+                if (!coveredI)
+                    reach = std::min(reach, k * m_cellSize[0]);
+                if (!coveredJ)
+                    reach = std::min(reach, k * m_cellSize[1]);
+                if (reach * reach > minDist2)
+                    break;
+            }
+        }
 
-	if (originCloud)
-	{
-		const CCVector3d& shift = originCloud->getGlobalShift();
-		shiftX -= shift.u[X];
-		shiftY -= shift.u[Y];
-		shiftZ -= shift.u[Z];
+        return minDist2;
+    }
 
-		double scale = originCloud->getGlobalScale();
-		assert(scale != 0);
-		stepX /= scale;
-		stepY /= scale;
-	}
+protected:
+    void getCellPos(const CCVector2& P, int& i, int& j) const
+    {
+        i = std::max(0, std::min(static_cast<int>((P.x - m_origin.x) / m_cellSize[0]), m_dims[0] - 1));
+        j = std::max(0, std::min(static_cast<int>((P.y - m_origin.y) / m_cellSize[1]), m_dims[1] - 1));
+    }
+    size_t getCellIndex(const CCVector2& P) const
+    {
+        int i, j;
+        getCellPos(P, i, j);
+        return static_cast<size_t>(j) * m_dims[0] + i;
+    }
 
-	int totalBands = 0;
-	bool onlyRGBA = true;
+    CCVector2 m_origin;
+    int m_dims[2] = { 1, 1 };
+    PointCoordinateType m_cellSize[2] = { 1, 1 };
+    std::vector<unsigned> m_cellStarts;
+    std::vector<unsigned> m_pointIndexes;
+};
 
-	if (exportBands.height)
-	{
-		++totalBands;
-		onlyRGBA = false;
-	}
+//! Finds the nearest (available) point to an edge
+/** Uses the candidate grid if available, or scans all the points otherwise.
+    \return The nearest point distance (or -1 if no point was found!)
+**/
+PointCoordinateType FindNearestCandidate_(  unsigned& minIndex,
+                                            const VertexIterator& itA,
+                                            const VertexIterator& itB,
+                                            const std::vector<Vertex2D>& points,
+                                            const std::vector<HullPointFlags>& pointFlags,
+                                            const HullCandidateGrid_* grid,
+                                            PointCoordinateType minSquareEdgeLength,
+                                            bool allowLongerChunks = false,
+                                            double minCosAngle = -1.0)
+{
+    //CCTRACE("FindNearestCandidate_");
+    //look for the nearest point in the input set
+    PointCoordinateType minDist2 = -1;
+    const Vertex2D& A = **itA;
+    const Vertex2D& B = **itB;
+    const PointCoordinateType squareLengthAB = (B - A).norm2();
 
-	bool rgbaMode = false;
-	if (exportBands.rgb)
-	{
-		totalBands += 3; //one per component
-		if (fillEmptyCellsStrategy == ccRasterGrid::LEAVE_EMPTY && grid.validCellCount < grid.height * grid.width)
-		{
-			rgbaMode = true;
-			++totalBands; //alpha
-		}
-	}
-	else
-	{
-		onlyRGBA = false;
-	}
+    if (grid)
+    {
+        minDist2 = grid->findNearest(minIndex, A, B, points, pointFlags, minSquareEdgeLength, allowLongerChunks, minCosAngle);
+    }
+    else
+    {
+        const unsigned pointCount = static_cast<unsigned>(points.size());
+        for (unsigned i = 0; i < pointCount; ++i)
+        {
+            PointCoordinateType dist2 = CandidateSquareDist_(points[i], A, B, pointFlags, minSquareEdgeLength, allowLongerChunks, minCosAngle);
+            if (dist2 >= 0 && (minDist2 < 0 || dist2 < minDist2))
+            {
+                minDist2 = dist2;
+                minIndex = i;
+            }
+        }
+    }
 
-	if (exportBands.density)
-	{
-		++totalBands;
-		onlyRGBA = false;
-	}
+    return (minDist2 < 0 ? minDist2 : minDist2/squareLengthAB);
+}
 
-	if (exportBands.allSFs)
-	{
-		for (const auto & scalarField : grid.scalarFields)
-		{
-			if (!scalarField.empty())
-			{
-				++totalBands;
-				onlyRGBA = false;
-			}
-		}
-	}
-	else if (exportBands.visibleSF && visibleSfIndex >= 0)
-	{
-		++totalBands;
-		onlyRGBA = false;
-	}
+bool ExtractConcaveHull2D_( std::vector<Vertex2D>& points,
+                            std::list<Vertex2D*>& hullPoints,
+                            Envelope_Type envelopeType,
+                            bool allowMultiPass,
+                            PointCoordinateType maxSquareEdgeLength=0,
+                            bool enableVisualDebugMode=false,
+                            double maxAngleDeg=0.0)
+{
+    CCTRACE("ExtractConcaveHull2D_");
+    //first compute the Convex hull
+    if (!CCCoreLib::PointProjectionTools::extractConvexHull2D(points,hullPoints))
+        return false;
 
-	if (totalBands == 0)
-	{
-		CCTRACE("Can't output a raster with no band! (check export parameters)");
-		return false;
-	}
+    //do we really need to compute the concave hull?
+    if (hullPoints.size() < 2 || maxSquareEdgeLength < 0)
+        return true;
 
-	GDALAllRegister();
-	CCTRACE("GDAL drivers: " << GetGDALDriverManager()->GetDriverCount());
+    unsigned pointCount = static_cast<unsigned>(points.size());
 
-	const char pszFormat[] = "GTiff";
-	GDALDriver *poDriver = GetGDALDriverManager()->GetDriverByName(pszFormat);
-	if (!poDriver)
-	{
-		CCTRACE("[GDAL] Driver is not supported " << pszFormat);
-		return false;
-	}
+    std::vector<HullPointFlags> pointFlags;
+    try
+    {
+        pointFlags.resize(pointCount, POINT_NOT_USED);
+    }
+    catch(...)
+    {
+        //not enough memory
+        return false;
+    }
 
-	char** papszMetadata = poDriver->GetMetadata();
-	if (!CSLFetchBoolean(papszMetadata, GDAL_DCAP_CREATE, FALSE))
-	{
-		CCTRACE("[GDAL] Driver doesn't support Create() method " << pszFormat);
-		return false;
-	}
+    double minCosAngle = maxAngleDeg <= 0 ? -1.0 : std::cos(maxAngleDeg * M_PI / 180.0);
 
-	char **papszOptions = nullptr;
-	GDALDataset* poDstDS = poDriver->Create(qPrintable(outputFilename),
-											static_cast<int>(grid.width),
-											static_cast<int>(grid.height),
-											totalBands,
-											onlyRGBA ? GDT_Byte : GDT_Float64,
-											papszOptions);
+    //grid of the candidate points (we fall back to the exhaustive search if it can't be built)
+    HullCandidateGrid_ candidateGrid;
+    const HullCandidateGrid_* grid = candidateGrid.init(points) ? &candidateGrid : nullptr;
 
-	if (!poDstDS)
-	{
-		ccLog::Error("[GDAL] Failed to create output raster (not enough memory?)");
-		return false;
-	}
+    //hack: compute the theoretical 'minimal' edge length
+    PointCoordinateType minSquareEdgeLength = 0;
+    {
+        CCVector2 minP;
+        CCVector2 maxP;
+        for (size_t i=0; i<pointCount; ++i)
+        {
+            const Vertex2D& P = points[i];
+            if (i)
+            {
+                minP.x = std::min(P.x,minP.x);
+                minP.y = std::min(P.y,minP.y);
+                maxP.x = std::max(P.x,maxP.x);
+                maxP.y = std::max(P.y,maxP.y);
+            }
+            else
+            {
+                minP = maxP = P;
+            }
+        }
+        minSquareEdgeLength = (maxP - minP).norm2() / static_cast<PointCoordinateType>(1.0e7); //10^-7 of the max bounding rectangle side
+        minSquareEdgeLength = std::min(minSquareEdgeLength, maxSquareEdgeLength / 10);
 
-	poDstDS->SetMetadataItem("AREA_OR_POINT", "AREA");
+        //we remove very small edges
+        for (VertexIterator itA = hullPoints.begin(); itA != hullPoints.end(); ++itA)
+        {
+            VertexIterator itB = itA; ++itB;
+            if (itB == hullPoints.end())
+                itB = hullPoints.begin();
+            if ((**itB-**itA).norm2() < minSquareEdgeLength)
+            {
+                pointFlags[(*itB)->index] = POINT_FROZEN;
+                hullPoints.erase(itB);
+            }
+        }
 
-	double adfGeoTransform[6] = {	shiftX,		//top left x
-									stepX,		//w-e pixel resolution (can be negative)
-									0,			//0
-									shiftY,		//top left y
-									0,			//0
-									-stepY		//n-s pixel resolution (can be negative)
-	};
+        if (envelopeType != FULL)
+        {
+            //we will now try to determine which part of the envelope is the 'upper' one and which one is the 'lower' one
 
-	poDstDS->SetGeoTransform( adfGeoTransform );
+            //search for the min and max vertices
+            VertexIterator itLeft = hullPoints.begin();
+            VertexIterator itRight = hullPoints.begin();
+            {
+                for (VertexIterator it = hullPoints.begin(); it != hullPoints.end(); ++it)
+                {
+                    if ((*it)->x < (*itLeft)->x || ((*it)->x == (*itLeft)->x && (*it)->y < (*itLeft)->y))
+                    {
+                        itLeft = it;
+                    }
+                    if ((*it)->x > (*itRight)->x || ((*it)->x == (*itRight)->x && (*it)->y < (*itRight)->y))
+                    {
+                        itRight = it;
+                    }
+                }
+            }
+            assert(itLeft != itRight);
+            //find the right way to go
+            {
+                VertexIterator itBefore = itLeft;
+                if (itBefore == hullPoints.begin())
+                    itBefore = hullPoints.end(); --itBefore;
+                VertexIterator itAfter = itLeft; ++itAfter;
+                if (itAfter == hullPoints.end())
+                    itAfter = hullPoints.begin();
 
-	//OGRSpatialReference oSRS;
-	//oSRS.SetUTM( 11, TRUE );
-	//oSRS.SetWellKnownGeogCS( "NAD27" );
-	//char *pszSRS_WKT = nullptr;
-	//oSRS.exportToWkt( &pszSRS_WKT );
-	//poDstDS->SetProjection( pszSRS_WKT );
-	//CPLFree( pszSRS_WKT );
+                bool forward = ((**itBefore - **itLeft).cross(**itAfter - **itLeft) < 0 && envelopeType == LOWER);
+                if (!forward)
+                    std::swap(itLeft,itRight);
+            }
+
+            //copy the right part
+            std::list<Vertex2D*> halfHullPoints;
+            try
+            {
+                for (VertexIterator it = itLeft; ; ++it)
+                {
+                    if (it == hullPoints.end())
+                        it = hullPoints.begin();
+                    halfHullPoints.push_back(*it);
+                    if (it == itRight)
+                        break;
+                }
+            }
+            catch (const std::bad_alloc&)
+            {
+                //not enough memory
+                return false;
+            }
+            //replace the input hull by the selected part
+            hullPoints = halfHullPoints;
+        }
 
-	int currentBand = 0;
+        if (hullPoints.size() < 2)
+        {
+            //no more edges?!
+            return false;
+        }
+    }
 
-	//exort RGB band?
-	if (exportBands.rgb)
-	{
-		GDALRasterBand* rgbBands[3] = { poDstDS->GetRasterBand(++currentBand),
-										poDstDS->GetRasterBand(++currentBand),
-										poDstDS->GetRasterBand(++currentBand) };
-		rgbBands[0]->SetColorInterpretation(GCI_RedBand);
-		rgbBands[1]->SetColorInterpretation(GCI_GreenBand);
-		rgbBands[2]->SetColorInterpretation(GCI_BlueBand);
 
-		unsigned char* cLine = static_cast<unsigned char*>(CPLMalloc(sizeof(unsigned char)*grid.width));
-		if (!cLine)
-		{
-			CCTRACE("[GDAL] Not enough memory");
-			GDALClose(poDstDS);
-			return false;
-		}
+    //DEBUG MECHANISM
+    ccPointCloud* debugCloud = nullptr;
+    ccPolyline* debugEnvelope = nullptr;
+    ccPointCloud* debugEnvelopeVertices = nullptr;
 
-		bool error = false;
+    //Warning: high STL containers usage ahead ;)
+    unsigned step = 0;
+    bool somethingHasChanged = true;
+    while (somethingHasChanged)
+    {
+        try
+        {
+            somethingHasChanged = false;
+            ++step;
 
-		//export the R, G and B components
-		for (unsigned k = 0; k < 3; ++k)
-		{
-			rgbBands[k]->SetStatistics(0, 255, 128, 0); //warning: arbitrary average and std. dev. values
+            //build the initial edge list & flag the convex hull points
+            std::multiset<Edge_> edges;
+            //initial number of edges
+            assert(hullPoints.size() >= 2);
+            size_t initEdgeCount = hullPoints.size();
+            if (envelopeType != FULL)
+                --initEdgeCount;
 
-			for (unsigned j = 0; j<grid.height; ++j)
-			{
-				const ccRasterGrid::Row& row = grid.rows[grid.height - 1 - j]; //the first row is the northest one (i.e. Ymax)
-				for (unsigned i = 0; i<grid.width; ++i)
-				{
-					cLine[i] = (std::isfinite(row[i].h) ? static_cast<unsigned char>(std::max(0.0, std::min(255.0, row[i].color.u[k]))) : 0);
-				}
+            VertexIterator itB = hullPoints.begin();
+            for (size_t i = 0; i < initEdgeCount; ++i)
+            {
+                VertexIterator itA = itB; ++itB;
+                if (itB == hullPoints.end())
+                    itB = hullPoints.begin();
 
-				if (rgbBands[k]->RasterIO(GF_Write, 0, static_cast<int>(j), static_cast<int>(grid.width), 1, cLine, static_cast<int>(grid.width), 1, GDT_Byte, 0, 0) != CE_None)
-				{
-					error = true;
-					k = 3; //early stop
-					break;
-				}
-			}
-		}
+                //we will only process the edges that are longer than the maximum specified length
+                if ((**itB - **itA).norm2() > maxSquareEdgeLength)
+                {
+                    unsigned nearestPointIndex = 0;
+                    PointCoordinateType minSquareDist = FindNearestCandidate_(
+                        nearestPointIndex,
+                        itA,
+                        itB,
+                        points,
+                        pointFlags,
+                        grid,
+                        minSquareEdgeLength,
+                        step > 1,
+                        minCosAngle);
 
-		//export the alpha band (if necessary)
-		if (!error && rgbaMode)
-		{
-			GDALRasterBand* aBand = poDstDS->GetRasterBand(++currentBand);
-			aBand->SetColorInterpretation(GCI_AlphaBand);
-			aBand->SetStatistics(0, 255, 255, 0); //warning: arbitrary average and std. dev. values
+                    if (minSquareDist >= 0)
+                    {
+                        Edge_ e(itA, nearestPointIndex, minSquareDist);
+                        edges.insert(e);
+                    }
+                }
 
-			for (unsigned j = 0; j<grid.height; ++j)
-			{
-				const ccRasterGrid::Row& row = grid.rows[grid.height - 1 - j];
-				for (unsigned i = 0; i<grid.width; ++i)
-				{
-					cLine[i] = (std::isfinite(row[i].h) ? 255 : 0);
-				}
+                pointFlags[(*itA)->index] = POINT_USED;
+            }
 
-				if (aBand->RasterIO(GF_Write, 0, static_cast<int>(j), static_cast<int>(grid.width), 1, cLine, static_cast<int>(grid.width), 1, GDT_Byte, 0, 0) != CE_None)
-				{
-					error = true;
-					break;
-				}
-			}
-		}
+            //flag the last vertex as well for non closed envelopes!
+            if (envelopeType != FULL)
+                pointFlags[(*hullPoints.rbegin())->index] = POINT_USED;
 
-		CPLFree(cLine);
+            while (!edges.empty())
+            {
+                //current edge (AB)
+                //this should be the edge with the nearest 'candidate'
+                Edge_ e = *edges.begin();
+                edges.erase(edges.begin());
 
-		if (error)
-		{
-			CCTRACE("[GDAL] An error occurred while writing the color bands!");
-			GDALClose(poDstDS);
-			return false;
-		}
-	}
+                VertexIterator itA = e.itA;
+                VertexIterator itB = itA; ++itB;
+                if (itB == hullPoints.end())
+                {
+                    assert(envelopeType == FULL);
+                    itB = hullPoints.begin();
+                }
 
-	double* scanline = static_cast<double*>(CPLMalloc(sizeof(double)*grid.width));
-	if (!scanline)
-	{
-		CCTRACE("[GDAL] Not enough memory");
-		GDALClose(poDstDS);
-		return false;
-	}
+                //nearest point
+                const Vertex2D& P = points[e.nearestPointIndex];
+                assert(pointFlags[P.index] == POINT_NOT_USED); //we don't consider already used points!
 
-	//exort height band?
-	if (exportBands.height)
-	{
-		GDALRasterBand* poBand = poDstDS->GetRasterBand(++currentBand);
-		assert(poBand);
-		poBand->SetColorInterpretation(GCI_Undefined);
+                //create labels
+                cc2DLabel* edgeLabel = nullptr;
+                cc2DLabel* label = nullptr;
 
-		double emptyCellHeight = 0;
-		switch (fillEmptyCellsStrategy)
-		{
-		case ccRasterGrid::LEAVE_EMPTY:
-			emptyCellHeight = grid.minHeight - 1.0;
-			poBand->SetNoDataValue(emptyCellHeight); //should be transparent!
-			break;
-		case ccRasterGrid::FILL_MINIMUM_HEIGHT:
-			emptyCellHeight = grid.minHeight;
-			break;
-		case ccRasterGrid::FILL_MAXIMUM_HEIGHT:
-			emptyCellHeight = grid.maxHeight;
-			break;
-		case ccRasterGrid::FILL_CUSTOM_HEIGHT:
-		case ccRasterGrid::INTERPOLATE_DELAUNAY:
-			emptyCellHeight = customHeightForEmptyCells;
-			break;
-		case ccRasterGrid::FILL_AVERAGE_HEIGHT:
-			emptyCellHeight = grid.meanHeight;
-			break;
-		default:
-			assert(false);
-		}
+                //last check: the new segments must not intersect with the actual hull!
+                bool intersect = false;
+                //if (false)
+                {
+                    for (VertexIterator itJ = hullPoints.begin(), itI = itJ++; itI != hullPoints.end(); ++itI, ++itJ)
+                    {
+                        if (itJ == hullPoints.end())
+                        {
+                            if (envelopeType == FULL)
+                                itJ = hullPoints.begin();
+                            else
+                                break;
+                        }
 
-		emptyCellHeight += shiftZ;
+                        if (    ((*itI)->index != (*itA)->index && (*itJ)->index != (*itA)->index && CCCoreLib::PointProjectionTools::segmentIntersect(**itI,**itJ,**itA,P))
+                            ||  ((*itI)->index != (*itB)->index && (*itJ)->index != (*itB)->index && CCCoreLib::PointProjectionTools::segmentIntersect(**itI,**itJ,P,**itB)) )
+                        {
+                            intersect = true;
+                            break;
+                        }
+                    }
+                }
+                if (!intersect)
+                {
+                    //add point to concave hull
+                    VertexIterator itP = hullPoints.insert(itB == hullPoints.begin() ? hullPoints.end() : itB, &points[e.nearestPointIndex]);
 
-		for (unsigned j = 0; j < grid.height; ++j)
-		{
-			const ccRasterGrid::Row& row = grid.rows[grid.height - 1 - j];
-			for (unsigned i = 0; i<grid.width; ++i)
-			{
-				scanline[i] = std::isfinite(row[i].h) ? row[i].h + shiftZ : emptyCellHeight;
-			}
+                    //we won't use P anymore!
+                    pointFlags[P.index] = POINT_USED;
 
-			if (poBand->RasterIO(GF_Write, 0, static_cast<int>(j), static_cast<int>(grid.width), 1, scanline, static_cast<int>(grid.width), 1, GDT_Float64, 0, 0) != CE_None)
-			{
-				CCTRACE("[GDAL] An error occurred while writing the height band!");
-				if (scanline)
-					CPLFree(scanline);
-				GDALClose(poDstDS);
-				return false;
-			}
-		}
-	}
+                    somethingHasChanged = true;
 
-	//export density band
-	if (exportBands.density)
-	{
-		GDALRasterBand* poBand = poDstDS->GetRasterBand(++currentBand);
-		assert(poBand);
-		poBand->SetColorInterpretation(GCI_Undefined);
-		for (unsigned j = 0; j < grid.height; ++j)
-		{
-			const ccRasterGrid::Row& row = grid.rows[grid.height - 1 - j];
-			for (unsigned i = 0; i < grid.width; ++i)
-			{
-				scanline[i] = row[i].nbPoints;
-			}
+                    //update all edges that were having 'P' as their nearest candidate as well
+                    if (!edges.empty())
+                    {
+                        std::vector<VertexIterator> removed;
+                        std::multiset<Edge_>::const_iterator lastValidIt = edges.end();
+                        for (std::multiset<Edge_>::const_iterator it = edges.begin(); it != edges.end(); ++it)
+                        {
+                            if ((*it).nearestPointIndex == e.nearestPointIndex)
+                            {
+                                //we'll have to put them back afterwards!
+                                removed.push_back((*it).itA);
 
-			if (poBand->RasterIO(GF_Write, 0, static_cast<int>(j), static_cast<int>(grid.width), 1, scanline, static_cast<int>(grid.width), 1, GDT_Float64, 0, 0) != CE_None)
-			{
-				CCTRACE("[GDAL] An error occurred while writing the height band!");
-				if (scanline)
-					CPLFree(scanline);
-				GDALClose(poDstDS);
-				return false;
-			}
-		}
-	}
+                                edges.erase(it);
+                                if (edges.empty())
+                                    break;
+                                if (lastValidIt != edges.end())
+                                    it = lastValidIt;
+                                else
+                                    it = edges.begin();
+                            }
+                            else
+                            {
+                                lastValidIt = it;
+                            }
+                        }
 
-	//export SF bands
-	if (exportBands.allSFs || (exportBands.visibleSF && visibleSfIndex >= 0))
-	{
-		for (size_t k = 0; k < grid.scalarFields.size(); ++k)
-		{
-			assert(!grid.scalarFields[k].empty());
-			if (exportBands.allSFs || (exportBands.visibleSF && visibleSfIndex == static_cast<int>(k)))
-			{
-				const double* sfGrid = grid.scalarFields[k].data();
-				GDALRasterBand* poBand = poDstDS->GetRasterBand(++currentBand);
+                        //update the removed edges info and put them back in the main list
+                        for (size_t i = 0; i < removed.size(); ++i)
+                        {
+                            VertexIterator itC = removed[i];
+                            VertexIterator itD = itC; ++itD;
+                            if (itD == hullPoints.end())
+                                itD = hullPoints.begin();
 
-				double sfNanValue = std::numeric_limits<ccRasterGrid::SF::value_type>::quiet_NaN();
-				poBand->SetNoDataValue(sfNanValue); //should be transparent!
-				assert(poBand);
-				poBand->SetColorInterpretation(GCI_Undefined);
+                            unsigned nearestPointIndex = 0;
+                            PointCoordinateType minSquareDist = FindNearestCandidate_(
+                                nearestPointIndex,
+                                itC,
+                                itD,
+                                points,
+                                pointFlags,
+                                grid,
+                                minSquareEdgeLength,
+                                false,
+                                minCosAngle);
 
-				for (unsigned j = 0; j < grid.height; ++j)
-				{
-					const ccRasterGrid::Row& row = grid.rows[grid.height - 1 - j];
-					const double* sfRow = sfGrid + (grid.height - 1 - j) * grid.width;
-					for (unsigned i = 0; i < grid.width; ++i)
-					{
-						scanline[i] = row[i].nbPoints ? sfRow[i] : sfNanValue;
-					}
+                            if (minSquareDist >= 0)
+                            {
+                                Edge_ e(itC, nearestPointIndex, minSquareDist);
+                                edges.insert(e);
+                            }
+                        }
+                    }
 
-					if (poBand->RasterIO(	GF_Write,
-											0,
-											static_cast<int>(j),
-											static_cast<int>(grid.width),
-											1,
-											scanline,
-											static_cast<int>(grid.width),
-											1,
-											GDT_Float64, 0, 0 ) != CE_None)
-					{
-						//the corresponding SF should exist on the input cloud
-						CCTRACE("[GDAL] An error occurred while writing a scalar field band!");
-						k = grid.scalarFields.size(); //quick stop
-						break;
-					}
-				}
-			}
-		}
-	}
+                    //we'll inspect the two new segments later (if necessary)
+                    if ((P-**itA).norm2() > maxSquareEdgeLength)
+                    {
+                        unsigned nearestPointIndex = 0;
+                        PointCoordinateType minSquareDist = FindNearestCandidate_(
+                            nearestPointIndex,
+                            itA,
+                            itP,
+                            points,
+                            pointFlags,
+                            grid,
+                            minSquareEdgeLength,
+                            false,
+                            minCosAngle);
 
-	if (scanline)
-		CPLFree(scanline);
-	scanline = nullptr;
+                        if (minSquareDist >= 0)
+                        {
+                            Edge_ e(itA,nearestPointIndex,minSquareDist);
+                            edges.insert(e);
+                        }
+                    }
+                    if ((**itB-P).norm2() > maxSquareEdgeLength)
+                    {
+                        unsigned nearestPointIndex = 0;
+                        PointCoordinateType minSquareDist = FindNearestCandidate_(
+                            nearestPointIndex,
+                            itP,
+                            itB,
+                            points,
+                            pointFlags,
+                            grid,
+                            minSquareEdgeLength,
+                            false,
+                            minCosAngle);
 
-	/* Once we're done, close properly the dataset */
-	GDALClose(poDstDS);
+                        if (minSquareDist >= 0)
+                        {
+                            Edge_ e(itP,nearestPointIndex,minSquareDist);
+                            edges.insert(e);
+                        }
+                    }
+                }
+            }
+        }
+        catch (...)
+        {
+            //not enough memory
+            return false;
+        }
 
-	CCTRACE("[Rasterize] Raster successfully saved");
-	return true;
+        if (!allowMultiPass)
+            break;
+    }
 
-#else
-	assert(false);
-	CCTRACE("[Rasterize] GDAL not supported by this version! Can't generate a raster...");
-	return false;
-#endif
+    return true;
 }
 
-//! see CommandRasterize::process
-ccHObject* Rasterize_(
-	ccGenericPointCloud* cloud,
-	double gridStep,
-	unsigned short vertDir,
-	unsigned short outputCloudOrMesh, //0,1,2
-	bool outputRasterZ,
-	bool outputRasterSFs,
-	bool outputRasterRGB,
-	std::string pathToImages,
-	bool resample,
-	ccRasterGrid::ProjectionType projectionType,
-	ccRasterGrid::ProjectionType sfProjectionType,
-	ccRasterGrid::EmptyCellFillOption emptyCellFillStrategy,
-    double DelaunayMaxEdgeLength,
-    int KrigingParamsKNN,
-	double customHeight,
-	ccBBox gridBBox,
-    const std::vector<ccRasterGrid::ExportableFields>& extraScalarFields)
+//! Creates the envelope polyline from its vertices (see ComputeFlatEnvelopeVertices_)
+ccPolyline* CreateFlatEnvelopePolyline_(const std::vector<CCVector3>& hullVertices, Envelope_Type envelopeType)
 {
-	CCTRACE("Rasterize_");
-	CCTRACE("Cloud:" << cloud);
-    ccRasterGrid::DelaunayInterpolationParams dInterpParams;
-    ccRasterGrid::KrigingParams krigingParams;
-    // force auto-guess
-    krigingParams.autoGuess = true;
-	ccHObject* entity = nullptr;
-	bool isCellCount = false;
-	if (gridStep <= 0)
-	{
-		CCTRACE("Invalid grid step value!");
-		return nullptr;
-	}
-	if (vertDir > 2)
-	{
-		CCTRACE("Invalid direction!");
-		return nullptr;
-	}
-	if (outputCloudOrMesh > 2)
-	{
-		CCTRACE("Invalid output option!");
-		return nullptr;
-	}
-	if (emptyCellFillStrategy == ccRasterGrid::FILL_CUSTOM_HEIGHT && std::isnan(customHeight))
-	{
-		CCTRACE("[Rasterize] The filling strategy is set to 'fill with custom height' but no custom height was defined...");
-		return nullptr;
-	}
-    if ((gridBBox.minCorner().norm2() < 1.e-12) && (gridBBox.maxCorner().norm2() < 1.e-12))
+    unsigned hullPtsCount = static_cast<unsigned>(hullVertices.size());
+
+    //create vertices
+    ccPointCloud* envelopeVertices = new ccPointCloud();
     {
-    	gridBBox = cloud->getOwnBB();
+        if (!envelopeVertices->reserve(hullPtsCount))
+        {
+            delete envelopeVertices;
+            envelopeVertices = nullptr;
+            CCTRACE("[ExtractFlatEnvelope] Not enough memory!");
+            return nullptr;
+        }
+
+        for (const CCVector3& P : hullVertices)
+        {
+            envelopeVertices->addPoint(P);
+        }
+
+        envelopeVertices->setName("vertices");
+        envelopeVertices->setEnabled(false);
     }
-	//compute the grid size
-	unsigned gridWidth = 0;
-	unsigned gridHeight = 0;
-	if (!ccRasterGrid::ComputeGridSize(vertDir, gridBBox, gridStep, gridWidth, gridHeight))
-	{
-		CCTRACE("Failed to compute the grid dimensions (check input cloud(s) bounding-box)");
-		return nullptr;
-	}
 
-	if (gridWidth * gridHeight > (1 << 26)) //64 million of cells
-	{
-		CCTRACE("WARNING, Huge grid detected!");
-	}
+    //we create the corresponding (3D) polyline
+    ccPolyline* envelopePolyline = new ccPolyline(envelopeVertices);
+    if (envelopePolyline->reserve(hullPtsCount))
+    {
+        envelopePolyline->addPointIndex(0, hullPtsCount);
+        envelopePolyline->setClosed(envelopeType == FULL);
+        envelopePolyline->setVisible(true);
+        envelopePolyline->setName("envelope");
+        envelopePolyline->addChild(envelopeVertices);
+    }
+    else
+    {
+        delete envelopePolyline;
+        envelopePolyline = nullptr;
+        CCTRACE("[ExtractFlatEnvelope] Not enough memory to create the envelope polyline!");
+    }
 
-	ccRasterGrid grid;
-	{
-		//memory allocation
-		CCVector3d minCorner = gridBBox.minCorner();
-		if (!grid.init(gridWidth, gridHeight, gridStep, minCorner))
-		{
-			//not enough memory
-			CCTRACE("Not enough memory");
-			return nullptr;
-		}
+    return envelopePolyline;
+}
+
+//! Computes the (3D) vertices of the flat envelope of a set of points
+/** No CC entity is created here, so this function can be called concurrently
+    (see ExtractFlatEnvelope__ for the polyline creation).
+**/
+bool ComputeFlatEnvelopeVertices_(  CCCoreLib::GenericIndexedCloudPersist* points,
+                                    bool allowMultiPass,
+                                    PointCoordinateType maxEdgeLength,
+                                    const PointCoordinateType* preferredNormDim,
+                                    const PointCoordinateType* preferredUpDir,
+                                    Envelope_Type envelopeType,
+                                    std::vector<CCVector3>& envelopeVertices,
+                                    std::vector<unsigned>* originalPointIndexes=nullptr,
+                                    bool enableVisualDebugMode=false,
+                                    double maxAngleDeg=0.0)
+{
+    assert(points);
+    envelopeVertices.clear();
 
-        ccRasterGrid::InterpolationType interpolationType = ccRasterGrid::InterpolationTypeFromEmptyCellFillOption(emptyCellFillStrategy);
-        void* interpolationParams = nullptr;
-        switch (interpolationType)
-        {
-        case ccRasterGrid::InterpolationType::DELAUNAY:
-            interpolationParams = (void*)&dInterpParams;
-            break;
-        case ccRasterGrid::InterpolationType::KRIGING:
-            interpolationParams = (void*)&krigingParams;
-            break;
-        default:
-            // do nothing
-            break;
-        }
+    if (!points)
+        return false;
 
-		if (grid.fillWith(cloud,
-		                  vertDir,
-		                  projectionType,
-                          interpolationType,
-                          interpolationParams,
-                          sfProjectionType))
-		{
-			grid.fillEmptyCells(emptyCellFillStrategy, customHeight);
-		}
-		else
-		{
-			CCTRACE("Rasterize process failed");
-			return nullptr;
-		}
+    unsigned ptsCount = points->size();
 
-		//generate the result entity (cloud by default)
-		bool outputCloud = (outputCloudOrMesh == 1);
-		bool outputMesh = (outputCloudOrMesh == 2);
-		if (outputCloud || outputMesh)
-		{
-		    CCTRACE("--- outputCloud:" << outputCloud << " outputMesh:"<< outputMesh);
-            ccPointCloud* rasterCloud = nullptr;
-            try
-            {
-                //we always compute the default 'height' layer
-                std::vector<ccRasterGrid::ExportableFields> exportedStatistics(1);
-                exportedStatistics.back() = ccRasterGrid::PER_CELL_VALUE;
+    if (ptsCount < 3)
+        return false;
 
-                rasterCloud = grid.convertToCloud(  true,
-                                                    false,
-                                                    exportedStatistics,
-                                                    true,
-                                                    true,
-                                                    resample,
-                                                    resample,
-                                                    cloud,
-                                                    vertDir,
-                                                    gridBBox,
-                                                    0.0,
-                                                    true,
-                                                    nullptr
-                                                );
+    CCCoreLib::Neighbourhood Yk(points);
 
-            }
-            catch (const std::bad_alloc&)
-//			std::vector<ccRasterGrid::ExportableFields> exportedFields;
-//			try
-//			{
-//				//we always compute the default 'height' layer
-//				exportedFields.push_back(ccRasterGrid::PER_CELL_VALUE);
-//				for(auto & item : extraScalarFields)
-//				{
-//				    exportedFields.push_back(item);
-//				    if (item == ccRasterGrid::PER_CELL_COUNT)
-//				        isCellCount = true;
-//				}
-//			}
-//			catch (const std::bad_alloc&)
-			{
-				CCTRACE("Not enough memory");
-				return nullptr;
-			}
+    //local base
+    CCVector3 O;
+    CCVector3 X;
+    CCVector3 Y;
 
-//			ccPointCloud* rasterCloud = grid.convertToCloud(
-//			                                exportedFields,
-//			                                true,
-//			                                true,
-//			                                resample,
-//			                                resample,
-//			                                cloud,
-//			                                vertDir,
-//			                                gridBBox,
-//			                                emptyCellFillStrategy == ccRasterGrid::FILL_CUSTOM_HEIGHT,
-//			                                customHeight,
-//			                                true
-//			                                );
+    CCCoreLib::Neighbourhood::InputVectorsUsage vectorsUsage = CCCoreLib::Neighbourhood::None;
 
-			if (!rasterCloud)
-			{
-				CCTRACE("Failed to output the raster grid as a cloud");
-				return nullptr;
-			}
+    //we project the input points on a plane
+    std::vector<Vertex2D> points2D;
+    PointCoordinateType* planeEq = nullptr;
 
-			rasterCloud->showColors(cloud->hasColors());
-			if (rasterCloud->hasScalarFields())
-			{
-				rasterCloud->showSF(!cloud->hasColors());
-				rasterCloud->setCurrentDisplayedScalarField(0);
-			}
-			//don't forget the original shift
-			rasterCloud->copyGlobalShiftAndScale(*cloud);
+    if (preferredUpDir != nullptr)
+    {
+        Y = CCVector3(preferredUpDir);
+        vectorsUsage = CCCoreLib::Neighbourhood::UseYAsUpDir;
+    }
 
-			if (outputCloud)
-			{
-				rasterCloud->setName(cloud->getName() += QString("_RASTER"));
-				entity = rasterCloud;
-				CCTRACE("entity:" << entity);
-			}
-			else if (outputMesh)
-			{
-				CCTRACE("--- outputMesh");
-				std::string errorStr;
-				CCCoreLib::GenericIndexedMesh* baseMesh =
-					CCCoreLib::PointProjectionTools::computeTriangulation(rasterCloud,
-																		  CCCoreLib::DELAUNAY_2D_AXIS_ALIGNED,
-																		  CCCoreLib::PointProjectionTools::IGNORE_MAX_EDGE_LENGTH,
-																		  vertDir,
-																		  errorStr);
+    //if the user has specified a default direction, we'll use it as 'projecting plane'
+    PointCoordinateType preferredPlaneEq[4] = { 0, 0, 1, 0 };
 
-				if (baseMesh)
-				{
-					ccMesh* rasterMesh = new ccMesh(baseMesh, rasterCloud);
-					delete baseMesh;
-					baseMesh = nullptr;
+    if (preferredNormDim != nullptr)
+    {
+        const CCVector3* G = points->getPoint(0); //any point through which the plane passes is ok
+        preferredPlaneEq[0] = preferredNormDim[0];
+        preferredPlaneEq[1] = preferredNormDim[1];
+        preferredPlaneEq[2] = preferredNormDim[2];
+        CCVector3::vnormalize(preferredPlaneEq);
+        preferredPlaneEq[3] = CCVector3::vdot(G->u, preferredPlaneEq);
+        planeEq = preferredPlaneEq;
 
-					rasterCloud->setEnabled(false);
-					rasterCloud->setVisible(true);
-					rasterMesh->addChild(rasterCloud);
-					rasterMesh->setName(rasterCloud->getName());
-					//rasterCloud->setName("vertices");
-					rasterMesh->showSF(rasterCloud->sfShown());
-					rasterMesh->showColors(rasterCloud->colorsShown());
-					rasterCloud = nullptr; //to avoid deleting it later
-					CCTRACE("[Rasterize] Mesh successfully generated " << rasterMesh->getName().toStdString());
-					entity = rasterMesh;
-					CCTRACE("entity:" << entity);
-				}
-				else
-				{
-					CCTRACE("[Rasterize] Failed to create output mesh " << errorStr);
-				}
-				if (rasterCloud)
-				{
-					delete rasterCloud;
-					rasterCloud = nullptr;
-				}
-			}
-		}
+        if (preferredUpDir != nullptr)
+        {
+            O = *G;
+            //Y = CCVector3(preferredUpDir); //already done above
+            X = Y.cross(CCVector3(preferredNormDim));
+            vectorsUsage = CCCoreLib::Neighbourhood::UseOXYasBase;
+        }
+    }
 
-		CCTRACE("entity:" << entity);
-		if (outputRasterZ)
-		{
-			CCTRACE("outputRasterZ");
-			ccRasterizeTool::ExportBands bands;
-			{
-				bands.height = true;
-				bands.rgb = false; //not a good idea to mix RGB and height values!
-				bands.allSFs = outputRasterSFs;
-				bands.density = isCellCount;
-			}
-			QString exportFilename = QString(pathToImages.c_str()) + "/" + cloud->getName() + "_RASTER_Z";
-			if (outputRasterSFs)
-			{
-				CCTRACE("outputRasterSFs");
-				exportFilename += "_AND_SF";
-			}
-			exportFilename += ".tif";
+    if (!Yk.projectPointsOn2DPlane<Vertex2D>(points2D, planeEq, &O, &X, &Y, vectorsUsage))
+    {
+        CCTRACE("[ExtractFlatEnvelope] Failed to project the points on the LS plane (not enough memory?)!");
+        return false;
+    }
 
-			ExportGeoTiff_(	exportFilename, bands, emptyCellFillStrategy, grid,
-							gridBBox, vertDir, customHeight, cloud);
-		}
+    //update the points indexes (not done by Neighbourhood::projectPointsOn2DPlane)
+    {
+        for (unsigned i = 0; i < ptsCount; ++i)
+        {
+            points2D[i].index = i;
+        }
+    }
 
-		if (outputRasterRGB)
-		{
-			CCTRACE("outputRasterRGB");
-			ccRasterizeTool::ExportBands bands;
-			{
-				bands.rgb = true;
-				bands.height = false; //not a good idea to mix RGB and height values!
-				bands.allSFs = outputRasterSFs;
-                bands.density = isCellCount;
-			}
-			QString exportFilename = QString(pathToImages.c_str()) + "/" + cloud->getName() + "_RASTER_RGB.tif";
+    //try to get the points on the convex/concave hull to build the envelope and the polygon
+    Hull2D hullPoints;
+    if (!ExtractConcaveHull2D_( points2D,
+                                hullPoints,
+                                envelopeType,
+                                allowMultiPass,
+                                maxEdgeLength*maxEdgeLength,
+                                enableVisualDebugMode,
+                                maxAngleDeg))
+    {
+        CCTRACE("[ExtractFlatEnvelope] Failed to compute the convex hull of the input points!");
+        return false;
+    }
+
+    if (originalPointIndexes)
+    {
+        try
+        {
+            originalPointIndexes->resize(hullPoints.size(), 0);
+        }
+        catch (const std::bad_alloc&)
+        {
+            //not enough memory
+            CCTRACE("[ExtractFlatEnvelope] Not enough memory!");
+            return false;
+        }
 
-			ExportGeoTiff_(	exportFilename, bands, emptyCellFillStrategy, grid,
-							gridBBox, vertDir, customHeight, cloud);
-		}
-	}
-    CCTRACE(entity->getName().toStdString());
-	return entity;
+        unsigned i = 0;
+        for (Hull2D::const_iterator it = hullPoints.begin(); it != hullPoints.end(); ++it, ++i)
+        {
+            (*originalPointIndexes)[i] = (*it)->index;
+        }
+    }
+
+    //projection on the LS plane (in 3D)
+    try
+    {
+        envelopeVertices.reserve(hullPoints.size());
+    }
+    catch (const std::bad_alloc&)
+    {
+        CCTRACE("[ExtractFlatEnvelope] Not enough memory!");
+        return false;
+    }
+    for (Hull2D::const_iterator it = hullPoints.begin(); it != hullPoints.end(); ++it)
+    {
+        envelopeVertices.push_back(O + X*(*it)->x + Y*(*it)->y);
+    }
+
+    return true;
 }
 
-// ===========================================================================
-// ==== following used for ExtractSlicesAndContours (copy/adaptation from qCC)
+ccPolyline* ExtractFlatEnvelope__(  CCCoreLib::GenericIndexedCloudPersist* points,
+                                    bool allowMultiPass,
+                                    PointCoordinateType maxEdgeLength=0,
+                                    const PointCoordinateType* preferredNormDim=nullptr,
+                                    const PointCoordinateType* preferredUpDir=nullptr,
+                                    Envelope_Type envelopeType=FULL,
+                                    std::vector<unsigned>* originalPointIndexes=nullptr,
+                                    bool enableVisualDebugMode=false,
+                                    double maxAngleDeg=0.0)
+{
+    CCTRACE("ExtractFlatEnvelope__");
 
-//list of already used point to avoid hull's inner loops
-enum HullPointFlags {   POINT_NOT_USED  = 0,
-                        POINT_USED      = 1,
-                        POINT_IGNORED   = 2,
-                        POINT_FROZEN    = 3,
-};
+    std::vector<CCVector3> hullVertices;
+    if (!ComputeFlatEnvelopeVertices_(  points,
+                                        allowMultiPass,
+                                        maxEdgeLength,
+                                        preferredNormDim,
+                                        preferredUpDir,
+                                        envelopeType,
+                                        hullVertices,
+                                        originalPointIndexes,
+                                        enableVisualDebugMode,
+                                        maxAngleDeg))
+    {
+        return nullptr;
+    }
 
-using Vertex2D = CCCoreLib::PointProjectionTools::IndexedCCVector2;
-using VertexIterator = std::list<Vertex2D *>::iterator;
-using ConstVertexIterator = std::list<Vertex2D *>::const_iterator;
-using Hull2D = std::list<Vertex2D *>;
+    return CreateFlatEnvelopePolyline_(hullVertices, envelopeType);
+}
 
-namespace
+//! Splits an envelope polyline if necessary (takes the ownership of basePoly)
+bool SplitFlatEnvelope_(ccPolyline* basePoly,
+                        bool allowSplitting,
+                        PointCoordinateType maxEdgeLength,
+                        std::vector<ccPolyline*>& parts)
 {
-    struct Edge_
+    if (!basePoly)
     {
-        Edge_() : nearestPointIndex(0), nearestPointSquareDist(-1.0f) {}
+        return false;
+    }
+    else if (!allowSplitting)
+    {
+        parts.push_back(basePoly);
+        return true;
+    }
 
-        Edge_(const VertexIterator& A, unsigned _nearestPointIndex, float _nearestPointSquareDist)
-        : itA(A)
-        , nearestPointIndex(_nearestPointIndex)
-        , nearestPointSquareDist(_nearestPointSquareDist)
-    {}
+    bool success = basePoly->split(maxEdgeLength, parts);
 
-        //operator
-        inline bool operator< (const Edge_& e) const { return nearestPointSquareDist < e.nearestPointSquareDist; }
+    delete basePoly;
+    basePoly = nullptr;
 
-        VertexIterator itA;
-        unsigned nearestPointIndex;
-        float nearestPointSquareDist;
-    };
+    return success;
 }
 
-namespace
+bool ExtractFlatEnvelope_(  CCCoreLib::GenericIndexedCloudPersist* points,
+                            bool allowMultiPass,
+                            PointCoordinateType maxEdgeLength,
+                            std::vector<ccPolyline*>& parts,
+                            Envelope_Type envelopeType=FULL,
+                            bool allowSplitting=true,
+                            const PointCoordinateType* preferredNormDir=nullptr,
+                            const PointCoordinateType* preferredUpDir=nullptr,
+                            bool enableVisualDebugMode=false)
 {
-    //Last envelope or contour unique ID
-    //std::vector<unsigned> s_lastContourUniqueIDs_;
+    CCTRACE("ExtractFlatEnvelope_");
+    parts.clear();
 
-    //Envelope extraction parameters (global)
-    //double s_maxEnvelopeEdgeLength_ = -1.0;
+    //extract whole envelope
+    ccPolyline* basePoly = ExtractFlatEnvelope__(points, allowMultiPass, maxEdgeLength, preferredNormDir,
+                                                 preferredUpDir, envelopeType, nullptr, enableVisualDebugMode);
 
-    //Meta-data key: origin entity UUID
-    constexpr char s_originEntityUUID_[] = "OriginEntityUUID";
-    //Meta-data key: slice (unique) ID
-    constexpr char s_sliceID_[] = "SliceID";
+    //and split it if necessary
+    return SplitFlatEnvelope_(basePoly, allowSplitting, maxEdgeLength, parts);
 }
 
-#ifndef CC_GDAL_SUPPORT
-#include "ccIsolines.h" //old alternative code to generate contour lines (doesn't work very well :( )
-#include <QCoreApplication>
-#else
-//GDAL
-#include <cpl_string.h>
-#include <gdal.h>
-#include <gdal_alg.h>
-
-struct ContourGenerationParameters_
+//! Status of an octree cell with respect to a selection (see SelectPoints_)
+enum CellSelectionStatus_
 {
-    std::vector<ccPolyline*> contourLines;
-    const ccRasterGrid* grid = nullptr;
-    bool projectContourOnAltitudes = false;
+    CELL_OUTSIDE = 0, CELL_INSIDE = 1, CELL_PARTIAL = 2
 };
 
-CPLErr ContourWriter_(  double dfLevel,
-                        int nPoints,
-                        double *padfX,
-                        double *padfY,
-                        void * userData);
-#endif //CC_GDAL_SUPPORT
-
-class ccContourLinesGenerator_
+//! Selects the points of a cloud satisfying a predicate (in parallel)
+/** The points outside of 'region' all have the same status ('outsideSelected'): only the octree cells meeting
+    the region are visited. Their cells are classified first ('classifyCell' is called with the
+    cell min and max corners, slightly enlarged), so that only the points of the cells crossing the
+    selection border are tested individually. The octree is computed (and kept with the cloud) if necessary.
+    The selected points keep their original order.
+    'classifyCell' and 'isSelected' may be called concurrently.
+**/
+template <class CellClassifier, class PointPredicate>
+CCCoreLib::ReferenceCloud* SelectPoints_(   ccGenericPointCloud* cloud,
+                                            const ccBBox& region,
+                                            bool outsideSelected,
+                                            const CellClassifier& classifyCell,
+                                            const PointPredicate& isSelected)
 {
-public:
-//! Contour lines generation parameters
-    struct Parameters
+    unsigned count = cloud->size();
+    std::vector<char> selected;
+    try
     {
-        double startAltitude = 0.0;
-        double maxAltitude = 0.0;
-        double step = 0.0; //gap between levels
-        ccScalarField* altitudes = nullptr; //optional scalar field that stores the 'altitudes' (may be null, in which case the grid 'h' values are used directly)
-        int minVertexCount = 3; //minimum number of vertices per contour line
-        bool projectContourOnAltitudes = false;
-        double emptyCellsValue = std::numeric_limits<double>::quiet_NaN();
-
-        /* The parameters below are only required if GDAL is not required */
-        QWidget* parentWidget = nullptr; //for progress dialog
-        bool ignoreBorders = false;
-    };
-
-    //! Additional meta-data key for generated polylines (see ccPolyline)
-    static const char* MetaKeySubIndex() { return "SubIndex"; }
+        selected.resize(count, outsideSelected ? 1 : 0);
+    }
+    catch (const std::bad_alloc&)
+    {
+        CCTRACE("Not enough memory");
+        return nullptr;
+    }
 
-    static bool GenerateContourLines(   ccRasterGrid* rasterGrid,
-                                        const CCVector2d& gridMinCornerXY,
-                                        const Parameters& params,
-                                        std::vector<ccPolyline*>& contourLines)
+    bool done = false;
+    ccOctree::Shared octree = cloud->getOctree();
+    if (!octree)
     {
-        CCTRACE("GenerateContourLines");
-        if (!rasterGrid || !rasterGrid->isValid())
-        {
-            CCTRACE("Need a valid raster/cloud to compute contours!");
-            assert(false);
-            return false;
-        }
-        if (params.startAltitude > params.maxAltitude)
-        {
-            CCTRACE("Start value is above the layer maximum value!");
-            assert(false);
-            return false;
-        }
-        if (params.step < 0)
+        octree = cloud->computeOctree();
+    }
+    if (octree)
+    {
+        unsigned char level = octree->findBestLevelForAGivenPopulationPerCell(256);
+        PointCoordinateType cellSize = static_cast<PointCoordinateType>(octree->getCellSize(level));
+        PointCoordinateType halfSize = cellSize / 2 + cellSize * static_cast<PointCoordinateType>(1.0e-4); //margin for rounding errors
+        CCVector3 halfDiag(halfSize, halfSize, halfSize);
+
+        //sets the status of the points of a cell meeting the region
+        auto processCell = [&](const CCVector3& center, CCCoreLib::ReferenceCloud& cellPoints)
         {
-            CCTRACE("Invalid step value");
-            assert(false);
-            return false;
-        }
-        if (params.minVertexCount < 3)
+            int status = classifyCell(center - halfDiag, center + halfDiag);
+            for (unsigned k = 0; k < cellPoints.size(); ++k)
+            {
+                unsigned index = cellPoints.getPointGlobalIndex(k);
+                bool isIn = (status == CELL_INSIDE || (status == CELL_PARTIAL && isSelected(*cloud->getPoint(index))));
+                selected[index] = isIn ? 1 : 0;
+            }
+        };
+        auto meetsRegion = [&](const CCVector3& center)
         {
-            CCTRACE("Invalid input parameter: can't have less than 3 vertices per contour line");
-            assert(false);
-            return false;
-        }
-
-        bool sparseLayer = (params.altitudes && params.altitudes->currentSize() != rasterGrid->height * rasterGrid->width);
-        if (sparseLayer && !std::isfinite(params.emptyCellsValue))
+            CCVector3 cellMin = center - halfDiag;
+            CCVector3 cellMax = center + halfDiag;
+            return !(   cellMax.x < region.minCorner().x || cellMax.y < region.minCorner().y || cellMax.z < region.minCorner().z
+                     || cellMin.x > region.maxCorner().x || cellMin.y > region.maxCorner().y || cellMin.z > region.maxCorner().z);
+        };
+
+        //range of the cell positions meeting the region
+        Tuple3i minPos;
+        Tuple3i maxPos;
+        octree->getTheCellPosWhichIncludesThePoint(&region.minCorner(), minPos, level);
+        octree->getTheCellPosWhichIncludesThePoint(&region.maxCorner(), maxPos, level);
+        const int maxCellPos = static_cast<int>(CCCoreLib::DgmOctree::OCTREE_LENGTH(level)) - 1;
+        size_t positionCount = 1;
+        for (unsigned d = 0; d < 3; ++d)
         {
-            CCTRACE("Invalid empty cell value (sparse layer)");
-            assert(false);
-            return false;
+            minPos.u[d] = std::min(std::max(minPos.u[d], 0), maxCellPos);
+            maxPos.u[d] = std::min(std::max(maxPos.u[d], 0), maxCellPos);
+            positionCount *= static_cast<size_t>(maxPos.u[d] - minPos.u[d] + 1);
         }
 
-        unsigned levelCount = 1;
-        if (CCCoreLib::GreaterThanEpsilon(params.step))
+        if (!region.isValid())
         {
-            levelCount += static_cast<unsigned>(floor((params.maxAltitude - params.startAltitude) / params.step));
+            done = true; //nothing meets the region
         }
-
-        try
+        else if (positionCount <= 8 * static_cast<size_t>(octree->getCellNumber(level)))
         {
-    #ifdef CC_GDAL_SUPPORT //use GDAL (more robust) - otherwise we will use an old code found on the Internet (with a strange behavior)
-
-            //invoke the GDAL 'Contour Generator'
-            ContourGenerationParameters_ gdalParams;
-            gdalParams.grid = rasterGrid;
-            gdalParams.projectContourOnAltitudes = params.projectContourOnAltitudes;
-            GDALContourGeneratorH hCG = GDAL_CG_Create( rasterGrid->width,
-                                                        rasterGrid->height,
-                                                        std::isnan(params.emptyCellsValue) ? FALSE : TRUE,
-                                                        params.emptyCellsValue,
-                                                        params.step,
-                                                        params.startAltitude,
-                                                        ContourWriter_,
-                                                        &gdalParams);
-            if (!hCG)
-            {
-                CCTRACE("[GDAL] Failed to create contour generator");
-                return false;
-            }
-
-            //feed the scan lines
+            //we visit the cell positions of the region (empty positions are skipped by the octree search)
+            const int dx = maxPos.x - minPos.x + 1;
+            const int dy = maxPos.y - minPos.y + 1;
+            auto processPosition = [&](size_t p)
             {
-                double* scanline = static_cast<double*>(CPLMalloc(sizeof(double) * rasterGrid->width));
-                if (!scanline)
-                {
-                    CCTRACE("[GDAL] Not enough memory");
-                    return false;
-                }
-
-                unsigned layerIndex = 0;
-
-                for (unsigned j = 0; j < rasterGrid->height; ++j)
-                {
-                    const ccRasterGrid::Row& cellRow = rasterGrid->rows[j];
-                    for (unsigned i = 0; i < rasterGrid->width; ++i)
-                    {
-                        if (cellRow[i].nbPoints || !sparseLayer)
-                        {
-                            if (params.altitudes)
-                            {
-                                ScalarType value = params.altitudes->getValue(layerIndex++);
-                                scanline[i] = ccScalarField::ValidValue(value) ? value : params.emptyCellsValue;
-                            }
-                            else
-                            {
-                                scanline[i] = std::isfinite(cellRow[i].h) ? cellRow[i].h : params.emptyCellsValue;
-                            }
-                        }
-                        else
-                        {
-                            scanline[i] = params.emptyCellsValue;
-                        }
-                    }
-
-                    CPLErr error = GDAL_CG_FeedLine(hCG, scanline);
-                    if (error != CE_None)
-                    {
-                        CCTRACE("[GDAL] An error occurred during contour lines generation");
-                        break;
-                    }
-                }
-
-                if (scanline)
-                {
-                    CPLFree(scanline);
-                }
-                scanline = nullptr;
-
-                //have we generated any contour line?
-                if (!gdalParams.contourLines.empty())
+                Tuple3i pos(minPos.x + static_cast<int>(p % dx),
+                            minPos.y + static_cast<int>((p / dx) % dy),
+                            minPos.z + static_cast<int>(p / (static_cast<size_t>(dx) * dy)));
+                CCCoreLib::DgmOctree::CellCode code = CCCoreLib::DgmOctree::GenerateTruncatedCellCode(pos, level);
+                CCCoreLib::ReferenceCloud cellPoints(cloud);
+                if (!octree->getPointsInCell(code, level, &cellPoints, true) || cellPoints.size() == 0)
                 {
-                    //reproject contour lines from raster C.S. to the cloud C.S.
-                    for (ccPolyline*& poly : gdalParams.contourLines)
-                    {
-                        if (static_cast<int>(poly->size()) < params.minVertexCount)
-                        {
-                            delete poly;
-                            poly = nullptr;
-                            continue;
-                        }
-
-                        double height = std::numeric_limits<double>::quiet_NaN();
-                        for (unsigned i = 0; i < poly->size(); ++i)
-                        {
-                            CCVector3* P2D = const_cast<CCVector3*>(poly->getAssociatedCloud()->getPoint(i));
-                            if (i == 0)
-                            {
-                                height = P2D->z;
-                            }
-
-                            CCVector3 P(    static_cast<PointCoordinateType>((P2D->x - 0.5) * rasterGrid->gridStep + gridMinCornerXY.x),
-                                            static_cast<PointCoordinateType>((P2D->y - 0.5) * rasterGrid->gridStep + gridMinCornerXY.y),
-                                            P2D->z );
-                            *P2D = P;
-                        }
-
-                        //add contour
-                        poly->setName(QString("Contour line value = %1 (#%2)").arg(height).arg(poly->getMetaData(ccContourLinesGenerator_::MetaKeySubIndex()).toUInt()));
-                        contourLines.push_back(poly);
-                    }
-
-                    gdalParams.contourLines.clear(); //just in case
+                    return;
                 }
-            }
-
-            GDAL_CG_Destroy(hCG);
-    #else
-            unsigned xDim = rasterGrid->width;
-            unsigned yDim = rasterGrid->height;
-
-            int margin = 0;
-            if (!params.ignoreBorders)
+                CCVector3 center;
+                octree->computeCellCenter(pos, level, center);
+                processCell(center, cellPoints);
+            };
+#ifdef CC_CORE_LIB_USES_TBB
+            tbb::parallel_for(static_cast<size_t>(0), positionCount, processPosition);
+#else
+            for (size_t p = 0; p < positionCount; ++p)
             {
-                margin = 1;
-                xDim += 2;
-                yDim += 2;
+                processPosition(p);
             }
-            std::vector<double> grid(xDim * yDim, 0);
-
-            //fill grid
+#endif
+            done = true;
+        }
+        else
+        {
+            //large region: we scan the occupied cells
+            std::vector<CCCoreLib::DgmOctree::IndexAndCode> cells;
+            if (octree->getCellCodesAndIndexes(level, cells, false))
             {
-                unsigned layerIndex = 0;
-                for (unsigned j = 0; j < rasterGrid->height; ++j)
+                auto processOccupiedCell = [&](size_t c)
                 {
-                    const ccRasterGrid::Row& cellRow = rasterGrid->rows[j];
-                    double* row = &(grid[(j + margin)*xDim + margin]);
-                    for (unsigned i = 0; i < rasterGrid->width; ++i)
+                    CCVector3 center;
+                    octree->computeCellCenter(cells[c].theCode, level, center, false);
+                    if (!meetsRegion(center))
                     {
-                        if (cellRow[i].nbPoints || !sparseLayer)
-                        {
-                            if (params.altitudes)
-                            {
-                                ScalarType value = params.altitudes->getValue(layerIndex++);
-                                row[i] = ccScalarField::ValidValue(value) ? value : params.emptyCellsValue;
-                            }
-                            else
-                            {
-                                row[i] = std::isfinite(cellRow[i].h) ? cellRow[i].h : params.emptyCellsValue;
-                            }
-                        }
-                        else
-                        {
-                            row[i] = params.emptyCellsValue;
-                        }
+                        return;
                     }
+                    CCCoreLib::ReferenceCloud cellPoints(cloud);
+                    octree->getPointsInCellByCellIndex(&cellPoints, cells[c].theIndex, level);
+                    processCell(center, cellPoints);
+                };
+#ifdef CC_CORE_LIB_USES_TBB
+                tbb::parallel_for(static_cast<size_t>(0), cells.size(), processOccupiedCell);
+#else
+                for (size_t c = 0; c < cells.size(); ++c)
+                {
+                    processOccupiedCell(c);
                 }
+#endif
+                done = true;
             }
+        }
+    }
 
-            //generate contour lines
-            {
-                Isolines<double> iso(static_cast<int>(xDim), static_cast<int>(yDim));
-                if (!params.ignoreBorders)
-                {
-                    iso.createOnePixelBorder(grid.data(), params.startAltitude - 1.0);
-                }
+    if (!done)
+    {
+        //no octree: we test all the points
+#ifdef CC_CORE_LIB_USES_TBB
+        tbb::parallel_for(static_cast<unsigned>(0), count, [&](unsigned i) {
+            selected[i] = isSelected(*cloud->getPoint(i)) ? 1 : 0;
+        });
+#else
+        for (unsigned i = 0; i < count; ++i)
+        {
+            selected[i] = isSelected(*cloud->getPoint(i)) ? 1 : 0;
+        }
+#endif
+    }
 
-                ccProgressDialog pDlg(true, params.parentWidget);
-                pDlg.setMethodTitle(QObject::tr("Contour plot"));
-                pDlg.setInfo(QObject::tr("Levels: %1\nCells: %2 x %3").arg(levelCount).arg(rasterGrid->width).arg(rasterGrid->height));
-                pDlg.start();
-                pDlg.show();
-                QCoreApplication::processEvents();
-                CCCoreLib::NormalizedProgress nProgress(&pDlg, levelCount);
+    unsigned selectedCount = static_cast<unsigned>(std::count(selected.begin(), selected.end(), 1));
+    CCCoreLib::ReferenceCloud* ref = new CCCoreLib::ReferenceCloud(cloud);
+    if (!ref->reserve(selectedCount))
+    {
+        CCTRACE("Not enough memory");
+        delete ref;
+        return nullptr;
+    }
+    for (unsigned i = 0; i < count; ++i)
+    {
+        if (selected[i])
+        {
+            ref->addPointIndex(i);
+        }
+    }
 
-                for (double v = params.startAltitude; v <= params.maxAltitude; v += params.step)
-                {
-                    //extract contour lines for the current level
-                    iso.setThreshold(v);
-                    int lineCount = iso.find(grid.data());
+    return ref;
+}
 
-                    ccLog::PrintDebug(QString("[Rasterize][Isolines] value=%1 : %2 lines").arg(v).arg(lineCount));
-                    CCTRACE("[Rasterize][Isolines] value=" << v << " : " << lineCount << "lines");
+//! Projects the vertices of a polyline in 2D (see ccPointCloud::crop2D: only the x and y coordinates are used)
+std::vector<CCVector2> GetPolylineVertices2D_(const ccPolyline* poly, CCVector2& polyMin, CCVector2& polyMax)
+{
+    std::vector<CCVector2> vertices;
+    vertices.reserve(poly->size());
+    for (unsigned i = 0; i < poly->size(); ++i)
+    {
+        const CCVector3* V = poly->getPoint(i);
+        CCVector2 V2D(V->x, V->y);
+        if (i == 0)
+        {
+            polyMin = polyMax = V2D;
+        }
+        else
+        {
+            polyMin.x = std::min(polyMin.x, V2D.x);
+            polyMin.y = std::min(polyMin.y, V2D.y);
+            polyMax.x = std::max(polyMax.x, V2D.x);
+            polyMax.y = std::max(polyMax.y, V2D.y);
+        }
+        vertices.push_back(V2D);
+    }
+    return vertices;
+}
 
-                    //convert them to poylines
-                    int realCount = 0;
-                    for (int i = 0; i < lineCount; ++i)
-                    {
-                        int vertCount = iso.getContourLength(i);
-                        if (vertCount >= params.minVertexCount)
-                        {
-                            int startVi = 0; //we may have to split the polyline in multiple chunks
-                            while (startVi < vertCount)
-                            {
-                                ccPointCloud* vertices = new ccPointCloud("vertices");
-                                ccPolyline* poly = new ccPolyline(vertices);
-                                poly->addChild(vertices);
-                                bool isClosed = (startVi == 0 ? iso.isContourClosed(i) : false);
-                                if (poly->reserve(vertCount - startVi) && vertices->reserve(vertCount - startVi))
-                                {
-                                    unsigned localIndex = 0;
-                                    for (int vi = startVi; vi < vertCount; ++vi)
-                                    {
-                                        ++startVi;
+CCCoreLib::ReferenceCloud* CropCloud(ccGenericPointCloud* cloud, const ccBBox& box, bool inside/*=true*/)
+{
+    if (!cloud || !box.isValid())
+    {
+        CCTRACE("Invalid input cloud or box");
+        return nullptr;
+    }
 
-                                        double x = iso.getContourX(i, vi) - margin;
-                                        double y = iso.getContourY(i, vi) - margin;
+    const CCVector3& bbMin = box.minCorner();
+    const CCVector3& bbMax = box.maxCorner();
 
-                                        CCVector3 P;
-                                        //DGM: we will only do the dimension mapping at export time
-                                        //(otherwise the contour lines appear in the wrong orientation compared to the grid/raster which
-                                        // is in the XY plane by default!)
-                                        /*P.u[X] = */P.x = static_cast<PointCoordinateType>((x + 0.5) * rasterGrid->gridStep + gridMinCornerXY.x);
-                                        /*P.u[Y] = */P.y = static_cast<PointCoordinateType>((y + 0.5) * rasterGrid->gridStep + gridMinCornerXY.y);
-                                        if (params.projectContourOnAltitudes)
-                                        {
-                                            int xi = std::min(std::max(static_cast<int>(x), 0), static_cast<int>(rasterGrid->width) - 1);
-                                            int yi = std::min(std::max(static_cast<int>(y), 0), static_cast<int>(rasterGrid->height) - 1);
-                                            double h = rasterGrid->rows[yi][xi].h;
-                                            if (std::isfinite(h))
-                                            {
-                                                /*P.u[Z] = */P.z = static_cast<PointCoordinateType>(h);
-                                            }
-                                            else
-                                            {
-                                                //DGM: we stop the current polyline
-                                                isClosed = false;
-                                                break;
-                                            }
-                                        }
-                                        else
-                                        {
-                                            /*P.u[Z] = */P.z = static_cast<PointCoordinateType>(v);
-                                        }
+    auto classifyCell = [&](const CCVector3& cellMin, const CCVector3& cellMax) -> int
+    {
+        if (    cellMax.x < bbMin.x || cellMax.y < bbMin.y || cellMax.z < bbMin.z
+            ||  cellMin.x > bbMax.x || cellMin.y > bbMax.y || cellMin.z > bbMax.z)
+        {
+            return inside ? CELL_OUTSIDE : CELL_INSIDE;
+        }
+        if (    cellMin.x >= bbMin.x && cellMin.y >= bbMin.y && cellMin.z >= bbMin.z
+            &&  cellMax.x <= bbMax.x && cellMax.y <= bbMax.y && cellMax.z <= bbMax.z)
+        {
+            return inside ? CELL_INSIDE : CELL_OUTSIDE;
+        }
+        return CELL_PARTIAL;
+    };
 
-                                        vertices->addPoint(P);
-                                        assert(localIndex < vertices->size());
-                                        poly->addPointIndex(localIndex++);
-                                    }
+    auto isSelected = [&](const CCVector3& P)
+    {
+        return box.contains(P) == inside;
+    };
 
-                                    assert(poly);
-                                    if (poly->size() > 1)
-                                    {
-                                        poly->setClosed(isClosed); //if we have less vertices, it means we have 'chopped' the original contour
-                                        vertices->setEnabled(false);
+    return SelectPoints_(cloud, box, !inside, classifyCell, isSelected);
+}
 
-                                        ++realCount;
-                                        poly->setMetaData(ccContourLinesGenerator::MetaKeySubIndex(), realCount);
+CCCoreLib::ReferenceCloud* Crop2DCloud(ccGenericPointCloud* cloud, const ccPolyline* poly, unsigned char orthoDim, bool inside/*=true*/)
+{
+    if (!cloud || !poly || orthoDim > 2)
+    {
+        CCTRACE("Invalid input parameters");
+        return nullptr;
+    }
 
-                                        //add the 'const altitude' meta-data as well
-                                        poly->setMetaData(ccPolyline::MetaKeyConstAltitude(), QVariant(v));
+    unsigned char X = ((orthoDim + 1) % 3);
+    unsigned char Y = ((X + 1) % 3);
 
-                                        //add contour
-                                        poly->setName(QString("Contour line value = %1 (#%2)").arg(v).arg(realCount));
-                                        try
-                                        {
-                                            contourLines.push_back(poly);
-                                        }
-                                        catch (const std::bad_alloc&)
-                                        {
-                                            CCTRACE("[ccContourLinesGenerator] Not enough memory");
-                                            return false;
-                                        }
-                                    }
-                                    else
-                                    {
-                                        delete poly;
-                                        poly = nullptr;
-                                    }
-                                }
-                                else
-                                {
-                                    delete poly;
-                                    poly = nullptr;
-                                    CCTRACE("Not enough memory!");
-                                    return false;
-                                }
-                            }
-                        }
-                    }
+    CCVector2 polyMin(0, 0);
+    CCVector2 polyMax(0, 0);
+    std::vector<CCVector2> polyVertices;
+    try
+    {
+        polyVertices = GetPolylineVertices2D_(poly, polyMin, polyMax);
+    }
+    catch (const std::bad_alloc&)
+    {
+        CCTRACE("Not enough memory");
+        return nullptr;
+    }
 
-                    if (!nProgress.oneStep())
-                    {
-                        //process cancelled by user
-                        break;
-                    }
-                }
-            }
-    #endif
-        }
-        catch (const std::bad_alloc&)
+    //only the cells outside of the polyline bounding box can be classified without testing their points
+    auto classifyCell = [&](const CCVector3& cellMin, const CCVector3& cellMax) -> int
+    {
+        if (    polyVertices.empty()
+            ||  cellMax.u[X] < polyMin.x || cellMax.u[Y] < polyMin.y
+            ||  cellMin.u[X] > polyMax.x || cellMin.u[Y] > polyMax.y)
         {
-            CCTRACE("[ccContourLinesGenerator] Not enough memory");
-            return false;
+            return inside ? CELL_OUTSIDE : CELL_INSIDE;
         }
-
-        ccLog::Print(QString("[ccContourLinesGenerator] %1 iso-lines generated (%2 levels)").arg(contourLines.size()).arg(levelCount));
-        CCTRACE("[ccContourLinesGenerator] " <<  contourLines.size() << " iso-lines generated (" << levelCount << " levels)");
-        return true;
+        return CELL_PARTIAL;
     };
-};
 
-
-#ifdef CC_GDAL_SUPPORT
-CPLErr ContourWriter_(  double dfLevel,
-                        int nPoints,
-                        double *padfX,
-                        double *padfY,
-                        void * userData)
-{
-    //CCTRACE("ContourWriter_");
-    if (nPoints < 2)
+    auto isSelected = [&](const CCVector3& P)
     {
-        //nothing to do
-        assert(false);
-        return CE_None;
-    }
+        CCVector2 P2D(P.u[X], P.u[Y]);
+        return CCCoreLib::ManualSegmentationTools::isPointInsidePoly(P2D, polyVertices) == inside;
+    };
 
-    ContourGenerationParameters_* params = reinterpret_cast<ContourGenerationParameters_*>(userData);
-    if (!params || !params->grid)
+    //the polyline bounding box, extruded along the orthogonal dimension
+    ccBBox region;
+    if (!polyVertices.empty())
     {
-        assert(false);
-        return CE_Failure;
+        CCVector3 cloudMin, cloudMax;
+        cloud->getBoundingBox(cloudMin, cloudMax);
+        CCVector3 regionMin = cloudMin;
+        CCVector3 regionMax = cloudMax;
+        regionMin.u[X] = polyMin.x;
+        regionMin.u[Y] = polyMin.y;
+        regionMax.u[X] = polyMax.x;
+        regionMax.u[Y] = polyMax.y;
+        region = ccBBox(regionMin, regionMax, true);
     }
 
-    ccPointCloud* vertices = nullptr;
-    ccPolyline* poly = nullptr;
+    return SelectPoints_(cloud, region, !inside, classifyCell, isSelected);
+}
 
-    unsigned subIndex = 0;
-    for (int i = 0; i < nPoints; ++i)
+//! Uniform grid over a set of (possibly overlapping) boxes, to get quickly the candidate boxes of a point
+class BoxesGrid_
+{
+public:
+    bool init(const std::vector<ccBBox>& boxes)
     {
-        CCVector3 P(padfX[i], padfY[i], dfLevel);
+        ccBBox globalBox;
+        CCVector3d meanDiag(0, 0, 0);
+        for (const ccBBox& box : boxes)
+        {
+            globalBox += box;
+            CCVector3 diag = box.getDiagVec();
+            meanDiag += CCVector3d(diag.x, diag.y, diag.z);
+        }
+        if (!globalBox.isValid())
+        {
+            return false;
+        }
+        meanDiag /= static_cast<double>(boxes.size());
+
+        //cells roughly as large as the boxes (with a reasonable number of cells)
+        m_origin = globalBox.minCorner();
+        CCVector3 globalDiag = globalBox.getDiagVec();
+        for (unsigned d = 0; d < 3; ++d)
+        {
+            m_dims[d] = 1;
+            if (meanDiag.u[d] > 0)
+            {
+                m_dims[d] = static_cast<int>(std::min(std::ceil(globalDiag.u[d] / meanDiag.u[d]), 4096.0));
+                m_dims[d] = std::max(m_dims[d], 1);
+            }
+        }
+        static const size_t s_maxCellCount = (1 << 24);
+        while (static_cast<size_t>(m_dims[0]) * m_dims[1] * m_dims[2] > s_maxCellCount)
+        {
+            int* largestDim = std::max_element(m_dims, m_dims + 3);
+            *largestDim = (*largestDim + 1) / 2;
+        }
+        size_t cellCount = static_cast<size_t>(m_dims[0]) * m_dims[1] * m_dims[2];
+        for (unsigned d = 0; d < 3; ++d)
+        {
+            m_cellSize.u[d] = std::max(globalDiag.u[d] / m_dims[d], std::numeric_limits<PointCoordinateType>::epsilon());
+        }
 
-        if (params->projectContourOnAltitudes)
+        //CSR storage of the boxes indexes per cell
+        m_cellStarts.resize(cellCount + 1, 0);
+        for (int pass = 0; pass < 2; ++pass)
         {
-            int xi = std::min(std::max(static_cast<int>(padfX[i]), 0), static_cast<int>(params->grid->width) - 1);
-            int yi = std::min(std::max(static_cast<int>(padfY[i]), 0), static_cast<int>(params->grid->height) - 1);
-            double h = params->grid->rows[yi][xi].h;
-            if (std::isfinite(h))
+            for (size_t b = 0; b < boxes.size(); ++b)
             {
-                P.z = static_cast<PointCoordinateType>(h);
+                if (!boxes[b].isValid())
+                {
+                    continue;
+                }
+                int minPos[3];
+                int maxPos[3];
+                getCellPos(boxes[b].minCorner(), minPos);
+                getCellPos(boxes[b].maxCorner(), maxPos);
+                for (int k = minPos[2]; k <= maxPos[2]; ++k)
+                    for (int j = minPos[1]; j <= maxPos[1]; ++j)
+                        for (int i = minPos[0]; i <= maxPos[0]; ++i)
+                        {
+                            size_t cellIndex = getCellIndex(i, j, k);
+                            if (pass == 0)
+                            {
+                                ++m_cellStarts[cellIndex + 1];
+                            }
+                            else
+                            {
+                                m_boxIndexes[m_cellStarts[cellIndex] + (m_fillCounts[cellIndex]++)] = static_cast<unsigned>(b);
+                            }
+                        }
             }
-            else
+            if (pass == 0)
             {
-                //DGM: we stop the current polyline
-                if (poly)
+                for (size_t c = 0; c < cellCount; ++c)
                 {
-                    if (poly->size() < 2)
-                    {
-                        delete poly;
-                        params->contourLines.pop_back();
-                    }
-                    poly = nullptr;
-                    vertices = nullptr;
+                    m_cellStarts[c + 1] += m_cellStarts[c];
                 }
-                continue;
+                m_boxIndexes.resize(m_cellStarts[cellCount]);
+                m_fillCounts.resize(cellCount, 0);
             }
         }
+        m_fillCounts.clear();
+        m_fillCounts.shrink_to_fit();
+        m_box = globalBox;
 
-        if (!poly)
-        {
-            //we need to instantiate a new polyline
-            vertices = new ccPointCloud("vertices");
-            vertices->setEnabled(false);
-            poly = new ccPolyline(vertices);
-            poly->addChild(vertices);
-            poly->setMetaData(ccContourLinesGenerator_::MetaKeySubIndex(), ++subIndex);
-            poly->setClosed(false);
-
-            //add the 'const altitude' meta-data as well
-            poly->setMetaData(ccPolyline::MetaKeyConstAltitude(), QVariant(dfLevel));
+        return true;
+    }
 
-            if (!vertices->reserve(nPoints - i) || !poly->reserve(nPoints - i))
-            {
-                //not enough memory
-                delete poly;
-                poly = nullptr;
-                return CE_Failure;
-            }
+    //! Calls f(boxIndex) for all the boxes that may contain P
+    template <class F> void forEachCandidate(const CCVector3& P, const F& f) const
+    {
+        if (!m_box.contains(P))
+        {
+            return;
+        }
+        int pos[3];
+        getCellPos(P, pos);
+        size_t cellIndex = getCellIndex(pos[0], pos[1], pos[2]);
+        for (unsigned n = m_cellStarts[cellIndex]; n < m_cellStarts[cellIndex + 1]; ++n)
+        {
+            f(m_boxIndexes[n]);
+        }
+    }
 
-            try
-            {
-                params->contourLines.push_back(poly);
-            }
-            catch (const std::bad_alloc&)
-            {
-                return CE_Failure;
-            }
+protected:
+    void getCellPos(const CCVector3& P, int pos[3]) const
+    {
+        for (unsigned d = 0; d < 3; ++d)
+        {
+            int i = static_cast<int>(std::floor((P.u[d] - m_origin.u[d]) / m_cellSize.u[d]));
+            pos[d] = std::min(std::max(i, 0), m_dims[d] - 1);
         }
+    }
 
-        assert(vertices);
-        poly->addPointIndex(vertices->size());
-        vertices->addPoint(P);
+    size_t getCellIndex(int i, int j, int k) const
+    {
+        return (static_cast<size_t>(k) * m_dims[1] + j) * m_dims[0] + i;
     }
 
-    return CE_None;
-}
-#endif //CC_GDAL_SUPPORT
+    ccBBox m_box;
+    CCVector3 m_origin;
+    CCVector3 m_cellSize;
+    int m_dims[3]{ 1, 1, 1 };
+    std::vector<unsigned> m_cellStarts;
+    std::vector<unsigned> m_boxIndexes;
+    std::vector<unsigned> m_fillCounts;
+};
 
-//! Finds the nearest (available) point to an edge
-/** \return The nearest point distance (or -1 if no point was found!)
+//! Dispatches the points of a cloud into several (possibly overlapping) targets, in two parallel passes (count, then write)
+/** 'findTargets(P, addTarget)' must call addTarget(targetIndex) for each target containing P (it may be called concurrently).
+    \return the clones of the cloud (one per target, nullptr if the target is empty)
 **/
-PointCoordinateType FindNearestCandidate_(  unsigned& minIndex,
-                                            const VertexIterator& itA,
-                                            const VertexIterator& itB,
-                                            const std::vector<Vertex2D>& points,
-                                            const std::vector<HullPointFlags>& pointFlags,
-                                            PointCoordinateType minSquareEdgeLength,
-                                            bool allowLongerChunks = false,
-                                            double minCosAngle = -1.0)
+template <class TargetsFinder>
+std::vector<ccPointCloud*> DispatchPoints_(ccPointCloud* cloud, size_t targetCount, const TargetsFinder& findTargets)
 {
-    //CCTRACE("FindNearestCandidate_");
-    //look for the nearest point in the input set
-    PointCoordinateType minDist2 = -1;
-    const CCVector2 AB = **itB-**itA;
-    const PointCoordinateType squareLengthAB = AB.norm2();
-    const unsigned pointCount = static_cast<unsigned>(points.size());
+    std::vector<ccPointCloud*> outputClouds(targetCount, nullptr);
+    unsigned pointCount = cloud->size();
 
+    //the points of each target are stored in CSR form (one offset table and one index array):
+    //a first pass counts the points per target and per chunk, a second pass writes the indexes
+    unsigned chunkCount = 1;
 #ifdef CC_CORE_LIB_USES_TBB
-    tbb::parallel_for( static_cast<unsigned int>(0), pointCount, [&](unsigned int i) {
-        const Vertex2D& P = points[i];
-        if (pointFlags[P.index] != POINT_NOT_USED)
-            return;
+    chunkCount = std::min(static_cast<unsigned>(std::max(QThread::idealThreadCount(), 1)) * 4, std::max(pointCount / 1024, 1u));
+#endif
+    unsigned chunkSize = (pointCount + chunkCount - 1) / chunkCount;
+    std::vector<size_t> chunkOffsets; //by target, then by chunk
+    std::vector<size_t> targetStarts;
+    std::vector<unsigned> indexes;
+    try
+    {
+        chunkOffsets.resize(targetCount * chunkCount, 0);
+        targetStarts.resize(targetCount + 1, 0);
+    }
+    catch (const std::bad_alloc&)
+    {
+        CCTRACE("Not enough memory");
+        return outputClouds;
+    }
 
-        //skip the edge vertices!
-        if (P.index == (*itA)->index || P.index == (*itB)->index)
+    auto countChunk = [&](unsigned c)
+    {
+        unsigned first = c * chunkSize;
+        unsigned last = std::min(pointCount, first + chunkSize);
+        for (unsigned i = first; i < last; ++i)
         {
-            return;
+            findTargets(*cloud->getPoint(i), [&](unsigned t) { ++chunkOffsets[t * chunkCount + c]; });
         }
-
-        //we only consider 'inner' points
-        const CCVector2 AP = P-**itA;
-        if (AB.x * AP.y - AB.y * AP.x < 0)
+    };
+    auto writeChunk = [&](unsigned c)
+    {
+        unsigned first = c * chunkSize;
+        unsigned last = std::min(pointCount, first + chunkSize);
+        for (unsigned i = first; i < last; ++i)
         {
-            return;
+            findTargets(*cloud->getPoint(i), [&](unsigned t) { indexes[chunkOffsets[t * chunkCount + c]++] = i; });
         }
+    };
 
-        //check the angle
-        if (minCosAngle > -1.0)
-        {
-            const CCVector2 PB = **itB - P;
-            const PointCoordinateType dotProd = AP.x * PB.x + AP.y * PB.y;
-            const PointCoordinateType minDotProd = static_cast<PointCoordinateType>(minCosAngle * std::sqrt(AP.norm2() * PB.norm2()));
-            if (dotProd < minDotProd)
-            {
-                return;
-            }
-        }
+#ifdef CC_CORE_LIB_USES_TBB
+    tbb::parallel_for(static_cast<unsigned>(0), chunkCount, countChunk);
+#else
+    countChunk(0);
+#endif
 
-        const PointCoordinateType dot = AB.dot(AP); // = cos(PAB) * ||AP|| * ||AB||
-        if (dot >= 0 && dot <= squareLengthAB)
+    //exclusive prefix sum (chunks in order inside each target, so that the points keep their original order)
+    size_t offset = 0;
+    for (size_t t = 0; t < targetCount; ++t)
+    {
+        targetStarts[t] = offset;
+        for (unsigned c = 0; c < chunkCount; ++c)
         {
-            const CCVector2 HP = AP - AB * (dot / squareLengthAB);
-            const PointCoordinateType dist2 = HP.norm2();
-            if (minDist2 < 0 || dist2 < minDist2)
-            {
-                //the 'nearest' point must also be a valid candidate
-                //(i.e. at least one of the created edges is smaller than the original one
-                //and we don't create too small edges!)
-                const PointCoordinateType squareLengthAP = AP.norm2();
-                const PointCoordinateType squareLengthBP = (P-**itB).norm2();
-                if (    squareLengthAP >= minSquareEdgeLength
-                    &&  squareLengthBP >= minSquareEdgeLength
-                    &&  (allowLongerChunks || (squareLengthAP < squareLengthAB || squareLengthBP < squareLengthAB))
-                    )
-                {
-                    minDist2 = dist2;
-                    minIndex = i;
-                }
-            }
+            size_t n = chunkOffsets[t * chunkCount + c];
+            chunkOffsets[t * chunkCount + c] = offset;
+            offset += n;
         }
-    } );
-#else
-    for (unsigned i = 0; i < pointCount; ++i)
+    }
+    targetStarts[targetCount] = offset;
+    try
     {
-        const Vertex2D& P = points[i];
-        if (pointFlags[P.index] != POINT_NOT_USED)
-            continue;
+        indexes.resize(offset);
+    }
+    catch (const std::bad_alloc&)
+    {
+        CCTRACE("Not enough memory");
+        return outputClouds;
+    }
+
+#ifdef CC_CORE_LIB_USES_TBB
+    tbb::parallel_for(static_cast<unsigned>(0), chunkCount, writeChunk);
+#else
+    writeChunk(0);
+#endif
+    chunkOffsets.clear();
+    chunkOffsets.shrink_to_fit();
 
-        //skip the edge vertices!
-        if (P.index == (*itA)->index || P.index == (*itB)->index)
+    //finally create the clouds (sequentially, as it involves CC entities), one selection at a time
+    for (size_t t = 0; t < targetCount; ++t)
+    {
+        size_t n = targetStarts[t + 1] - targetStarts[t];
+        if (n == 0)
         {
             continue;
         }
-
-        //we only consider 'inner' points
-        CCVector2 AP = P - **itA;
-        if (AB.x * AP.y - AB.y * AP.x < 0)
+        CCCoreLib::ReferenceCloud selection(cloud);
+        if (!selection.reserve(static_cast<unsigned>(n)))
         {
-            continue;
+            CCTRACE("Not enough memory");
+            break;
+        }
+        for (size_t k = targetStarts[t]; k < targetStarts[t + 1]; ++k)
+        {
+            selection.addPointIndex(indexes[k]);
         }
+        outputClouds[t] = cloud->partialClone(&selection);
+    }
+
+    return outputClouds;
+}
+
+std::vector<ccPointCloud*> CropCloudMultiBoxes(ccPointCloud* cloud, const std::vector<ccBBox>& boxes)
+{
+    std::vector<ccPointCloud*> outputClouds(boxes.size(), nullptr);
+    if (!cloud || boxes.empty())
+    {
+        CCTRACE("Invalid input parameters");
+        return outputClouds;
+    }
 
-        //check the angle
-        if (minCosAngle > -1.0)
+    BoxesGrid_ grid;
+    try
+    {
+        if (!grid.init(boxes))
         {
-            CCVector2 PB = **itB - P;
-            PointCoordinateType dotProd = AP.x * PB.x + AP.y * PB.y;
-            PointCoordinateType minDotProd = static_cast<PointCoordinateType>(minCosAngle * std::sqrt(AP.norm2() * PB.norm2()));
-            if (dotProd < minDotProd)
-            {
-                continue;
-            }
+            CCTRACE("no valid box");
+            return outputClouds;
         }
+    }
+    catch (const std::bad_alloc&)
+    {
+        CCTRACE("Not enough memory");
+        return outputClouds;
+    }
 
-        PointCoordinateType dot = AB.dot(AP); // = cos(PAB) * ||AP|| * ||AB||
-        if (dot >= 0 && dot <= squareLengthAB)
+    auto findTargets = [&](const CCVector3& P, const auto& addTarget)
+    {
+        grid.forEachCandidate(P, [&](unsigned b)
         {
-            CCVector2 HP = AP - AB * (dot / squareLengthAB);
-            PointCoordinateType dist2 = HP.norm2();
-            if (minDist2 < 0 || dist2 < minDist2)
+            if (boxes[b].contains(P))
             {
-                //the 'nearest' point must also be a valid candidate
-                //(i.e. at least one of the created edges is smaller than the original one
-                //and we don't create too small edges!)
-                PointCoordinateType squareLengthAP = AP.norm2();
-                PointCoordinateType squareLengthBP = (P - **itB).norm2();
-                if (    squareLengthAP >= minSquareEdgeLength
-                    &&  squareLengthBP >= minSquareEdgeLength
-                    &&  (allowLongerChunks || (squareLengthAP < squareLengthAB || squareLengthBP < squareLengthAB))
-                    )
-                {
-                    minDist2 = dist2;
-                    minIndex = i;
-                }
+                addTarget(b);
             }
-        }
-    }
-#endif
+        });
+    };
 
-    return (minDist2 < 0 ? minDist2 : minDist2/squareLengthAB);
+    return DispatchPoints_(cloud, boxes.size(), findTargets);
 }
 
-bool ExtractConcaveHull2D_( std::vector<Vertex2D>& points,
-                            std::list<Vertex2D*>& hullPoints,
-                            Envelope_Type envelopeType,
-                            bool allowMultiPass,
-                            PointCoordinateType maxSquareEdgeLength=0,
-                            bool enableVisualDebugMode=false,
-                            double maxAngleDeg=0.0)
+std::vector<ccPointCloud*> Crop2DCloudMultiPolylines(ccPointCloud* cloud, const std::vector<ccPolyline*>& polys, unsigned char orthoDim)
 {
-    CCTRACE("ExtractConcaveHull2D_");
-    //first compute the Convex hull
-    if (!CCCoreLib::PointProjectionTools::extractConvexHull2D(points,hullPoints))
-        return false;
-
-    //do we really need to compute the concave hull?
-    if (hullPoints.size() < 2 || maxSquareEdgeLength < 0)
-        return true;
+    std::vector<ccPointCloud*> outputClouds(polys.size(), nullptr);
+    if (!cloud || polys.empty() || orthoDim > 2)
+    {
+        CCTRACE("Invalid input parameters");
+        return outputClouds;
+    }
 
-    unsigned pointCount = static_cast<unsigned>(points.size());
+    unsigned char X = ((orthoDim + 1) % 3);
+    unsigned char Y = ((X + 1) % 3);
 
-    std::vector<HullPointFlags> pointFlags;
+    //the polylines bounding boxes are indexed in the (X, Y) plane
+    std::vector< std::vector<CCVector2> > polysVertices(polys.size());
+    std::vector<ccBBox> polysBoxes(polys.size());
+    BoxesGrid_ grid;
     try
     {
-        pointFlags.resize(pointCount, POINT_NOT_USED);
+        for (size_t p = 0; p < polys.size(); ++p)
+        {
+            if (!polys[p] || polys[p]->size() == 0)
+            {
+                continue;
+            }
+            CCVector2 polyMin(0, 0);
+            CCVector2 polyMax(0, 0);
+            polysVertices[p] = GetPolylineVertices2D_(polys[p], polyMin, polyMax);
+            polysBoxes[p] = ccBBox(CCVector3(polyMin.x, polyMin.y, 0), CCVector3(polyMax.x, polyMax.y, 0), true);
+        }
+        if (!grid.init(polysBoxes))
+        {
+            CCTRACE("no valid polyline");
+            return outputClouds;
+        }
     }
-    catch(...)
+    catch (const std::bad_alloc&)
     {
-        //not enough memory
-        return false;
+        CCTRACE("Not enough memory");
+        return outputClouds;
     }
 
-    double minCosAngle = maxAngleDeg <= 0 ? -1.0 : std::cos(maxAngleDeg * M_PI / 180.0);
-
-    //hack: compute the theoretical 'minimal' edge length
-    PointCoordinateType minSquareEdgeLength = 0;
+    auto findTargets = [&](const CCVector3& P, const auto& addTarget)
     {
-        CCVector2 minP;
-        CCVector2 maxP;
-        for (size_t i=0; i<pointCount; ++i)
+        CCVector2 P2D(P.u[X], P.u[Y]);
+        grid.forEachCandidate(CCVector3(P2D.x, P2D.y, 0), [&](unsigned p)
         {
-            const Vertex2D& P = points[i];
-            if (i)
-            {
-                minP.x = std::min(P.x,minP.x);
-                minP.y = std::min(P.y,minP.y);
-                maxP.x = std::max(P.x,maxP.x);
-                maxP.y = std::max(P.y,maxP.y);
-            }
-            else
+            if (    polysBoxes[p].contains(CCVector3(P2D.x, P2D.y, 0))
+                &&  CCCoreLib::ManualSegmentationTools::isPointInsidePoly(P2D, polysVertices[p]))
             {
-                minP = maxP = P;
+                addTarget(p);
             }
+        });
+    };
+
+    return DispatchPoints_(cloud, polys.size(), findTargets);
+}
+
+//! see ccCropTool::Crop
+ccHObject* Crop_(ccHObject* entity, const ccBBox& box, bool inside/*=true*/, const ccGLMatrix* meshRotation/*=nullptr*/)
+{
+    //CCTRACE("Crop_");
+    assert(entity);
+    if (!entity)
+    {
+        return nullptr;
+    }
+
+    if (entity->isA(CC_TYPES::POINT_CLOUD))
+    {
+        ccPointCloud* cloud = static_cast<ccPointCloud*>(entity);
+
+        CCCoreLib::ReferenceCloud* selection = CropCloud(cloud, box, inside);
+        if (!selection)
+        {
+            //process failed!
+            CCTRACE(QString("[Crop] Failed to crop cloud '%1'!").arg(cloud->getName()).toStdString());
+            return nullptr;
         }
-        minSquareEdgeLength = (maxP - minP).norm2() / static_cast<PointCoordinateType>(1.0e7); //10^-7 of the max bounding rectangle side
-        minSquareEdgeLength = std::min(minSquareEdgeLength, maxSquareEdgeLength / 10);
 
-        //we remove very small edges
-        for (VertexIterator itA = hullPoints.begin(); itA != hullPoints.end(); ++itA)
+        if (selection->size() == 0)
         {
-            VertexIterator itB = itA; ++itB;
-            if (itB == hullPoints.end())
-                itB = hullPoints.begin();
-            if ((**itB-**itA).norm2() < minSquareEdgeLength)
+            //no points fall inside selection!
+            CCTRACE(QString("[Crop] No point of the cloud '%1' falls %2side the input box!").arg(cloud->getName(), (inside ? "in" : "out")).toStdString());
+            delete selection;
+            return nullptr;
+        }
+
+        //crop
+        ccPointCloud* croppedEnt = cloud->partialClone(selection);
+        delete selection;
+        selection = nullptr;
+
+        return croppedEnt;
+    }
+    else if (entity->isKindOf(CC_TYPES::MESH))
+    {
+        ccGenericMesh* mesh = static_cast<ccGenericMesh*>(entity);
+        CCCoreLib::ManualSegmentationTools::MeshCutterParams params;
+        params.bbMin = box.minCorner();
+        params.bbMax = box.maxCorner();
+        params.generateOutsideMesh = !inside;
+        params.trackOrigIndexes = mesh->hasColors() || mesh->hasScalarFields() || mesh->hasMaterials();
+
+        ccGenericPointCloud* origVertices = mesh->getAssociatedCloud();
+        assert(origVertices);
+        ccGenericPointCloud* cropVertices = origVertices;
+        if (meshRotation)
+        {
+            ccPointCloud* rotatedVertices = ccPointCloud::From(origVertices);
+            if (!rotatedVertices)
             {
-                pointFlags[(*itB)->index] = POINT_FROZEN;
-                hullPoints.erase(itB);
+                CCTRACE(QString("[Crop] Failed to crop mesh '%1'! (not enough memory)").arg(mesh->getName()).toStdString());
+                return nullptr;
             }
+            rotatedVertices->setGLTransformation(*meshRotation);
+            rotatedVertices->applyGLTransformation_recursive();
+            cropVertices = rotatedVertices;
+        }
+
+        if (!CCCoreLib::ManualSegmentationTools::segmentMeshWithAABox(mesh, cropVertices, params))
+        {
+            //process failed!
+            CCTRACE(QString("[Crop] Failed to crop mesh '%1'!").arg(mesh->getName()).toStdString());
+        }
+
+        if (cropVertices != origVertices)
+        {
+            //don't need those anymore
+            delete cropVertices;
+            cropVertices = origVertices;
         }
 
-        if (envelopeType != FULL)
-        {
-            //we will now try to determine which part of the envelope is the 'upper' one and which one is the 'lower' one
+        CCCoreLib::SimpleMesh* tempMesh = inside ? params.insideMesh : params.outsideMesh;
+
+        //output
+        ccMesh* croppedMesh = nullptr;
 
-            //search for the min and max vertices
-            VertexIterator itLeft = hullPoints.begin();
-            VertexIterator itRight = hullPoints.begin();
+        if (tempMesh)
+        {
+            ccPointCloud* croppedVertices = ccPointCloud::From(tempMesh->vertices());
+            if (croppedVertices)
             {
-                for (VertexIterator it = hullPoints.begin(); it != hullPoints.end(); ++it)
+                if (meshRotation)
                 {
-                    if ((*it)->x < (*itLeft)->x || ((*it)->x == (*itLeft)->x && (*it)->y < (*itLeft)->y))
+                    //apply inverse transformation
+                    croppedVertices->setGLTransformation(meshRotation->inverse());
+                    croppedVertices->applyGLTransformation_recursive();
+                }
+                croppedMesh = new ccMesh(tempMesh, croppedVertices);
+                croppedMesh->addChild(croppedVertices);
+                croppedVertices->setEnabled(false);
+                if (croppedMesh->size() == 0)
+                {
+                    //no points fall inside selection!
+                    ccLog::Warning(QString("[Crop] No triangle of the mesh '%1' falls %2side the input box!").arg(mesh->getName(), (inside ? "in" : "out")));
+                    delete croppedMesh;
+                    croppedMesh = nullptr;
+                }
+                else
+                {
+                    assert(origVertices);
+
+                    //import parameters
+                    croppedVertices->importParametersFrom(origVertices);
+                    croppedMesh->importParametersFrom(mesh);
+
+                    //compute normals if necessary
+                    if (mesh->hasNormals())
                     {
-                        itLeft = it;
+                        bool success = false;
+                        if (mesh->hasTriNormals())
+                            success = croppedMesh->computePerTriangleNormals();
+                        else
+                            success = croppedMesh->computePerVertexNormals();
+
+                        if (!success)
+                        {
+                            ccLog::Warning("[Crop] Failed to compute normals on the output mesh (not enough memory)");
+                        }
+                        croppedMesh->showNormals(success && mesh->normalsShown());
                     }
-                    if ((*it)->x > (*itRight)->x || ((*it)->x == (*itRight)->x && (*it)->y < (*itRight)->y))
+
+                    //import other features if necessary
+                    if (params.trackOrigIndexes)
                     {
-                        itRight = it;
-                    }
-                }
-            }
-            assert(itLeft != itRight);
-            //find the right way to go
-            {
-                VertexIterator itBefore = itLeft;
-                if (itBefore == hullPoints.begin())
-                    itBefore = hullPoints.end(); --itBefore;
-                VertexIterator itAfter = itLeft; ++itAfter;
-                if (itAfter == hullPoints.end())
-                    itAfter = hullPoints.begin();
+                        const std::vector<unsigned>& origTriIndexes = inside ? params.origTriIndexesMapInside : params.origTriIndexesMapOutside;
 
-                bool forward = ((**itBefore - **itLeft).cross(**itAfter - **itLeft) < 0 && envelopeType == LOWER);
-                if (!forward)
-                    std::swap(itLeft,itRight);
-            }
+                        try
+                        {
+                            //per vertex features (RGB color & scalar fields)
+                            if (origVertices->hasColors() || origVertices->hasScalarFields())
+                            {
+                                //we use flags to avoid processing the same vertex multiple times
+                                std::vector<bool> vertProcessed(croppedVertices->size(), false);
 
-            //copy the right part
-            std::list<Vertex2D*> halfHullPoints;
-            try
-            {
-                for (VertexIterator it = itLeft; ; ++it)
-                {
-                    if (it == hullPoints.end())
-                        it = hullPoints.begin();
-                    halfHullPoints.push_back(*it);
-                    if (it == itRight)
-                        break;
-                }
-            }
-            catch (const std::bad_alloc&)
-            {
-                //not enough memory
-                return false;
-            }
-            //replace the input hull by the selected part
-            hullPoints = halfHullPoints;
-        }
+                                //colors
+                                bool importColors = false;
+                                if (origVertices->hasColors())
+                                {
+                                    importColors = croppedVertices->resizeTheRGBTable();
+                                    if (!importColors)
+                                        ccLog::Warning("[Crop] Failed to transfer RGB colors on the output mesh (not enough memory)");
+                                }
 
-        if (hullPoints.size() < 2)
-        {
-            //no more edges?!
-            return false;
-        }
-    }
+                                //scalar fields
+                                std::vector<ccScalarField*> importedSFs;
+                                ccPointCloud* origVertices_pc = nullptr;
+                                if (origVertices->hasScalarFields())
+                                {
+                                    origVertices_pc = origVertices->isA(CC_TYPES::POINT_CLOUD) ? static_cast<ccPointCloud*>(origVertices) : nullptr;
+                                    unsigned sfCount = origVertices_pc ? origVertices_pc->getNumberOfScalarFields() : 1;
+
+                                    //now try to import each SF
+                                    for (unsigned i = 0; i < sfCount; ++i)
+                                    {
+                                        int sfIdx = croppedVertices->addScalarField(origVertices_pc ? origVertices_pc->getScalarField(i)->getName() : "Scalar field");
+                                        if (sfIdx >= 0)
+                                        {
+                                            ccScalarField* sf = static_cast<ccScalarField*>(croppedVertices->getScalarField(i));
+                                            sf->fill(CCCoreLib::NAN_VALUE);
+                                            if (origVertices_pc)
+                                            {
+                                                //import display parameters if possible
+                                                ccScalarField* originSf = static_cast<ccScalarField*>(origVertices_pc->getScalarField(i));
+                                                assert(originSf);
+                                                //copy display parameters
+                                                sf->importParametersFrom(originSf);
+                                            }
+                                            importedSFs.push_back(sf);
+                                        }
+                                        else
+                                        {
+                                            ccLog::Warning("[Crop] Failed to transfer one or several scalar fields on the output mesh (not enough memory)");
+                                            //we can stop right now as all SFs have the same size!
+                                            break;
+                                        }
+                                    }
 
+                                    //default displayed SF
+                                    if (origVertices_pc)
+                                        croppedVertices->setCurrentDisplayedScalarField(std::max(static_cast<int>(croppedVertices->getNumberOfScalarFields())-1, origVertices_pc->getCurrentDisplayedScalarFieldIndex()));
+                                    else
+                                        croppedVertices->setCurrentDisplayedScalarField(0);
+                                }
+                                bool importSFs = !importedSFs.empty();
 
-    //DEBUG MECHANISM
-    ccPointCloud* debugCloud = nullptr;
-    ccPolyline* debugEnvelope = nullptr;
-    ccPointCloud* debugEnvelopeVertices = nullptr;
+                                if (importColors || importSFs)
+                                {
+                                    //for each new triangle
+                                    for (unsigned i = 0; i < croppedMesh->size(); ++i)
+                                    {
+                                        //get the origin triangle
+                                        unsigned origTriIndex = origTriIndexes[i];
+                                        const CCCoreLib::VerticesIndexes* tsio = mesh->getTriangleVertIndexes(origTriIndex);
 
-    //Warning: high STL containers usage ahead ;)
-    unsigned step = 0;
-    bool somethingHasChanged = true;
-    while (somethingHasChanged)
-    {
-        try
-        {
-            somethingHasChanged = false;
-            ++step;
+                                        //get the new triangle
+                                        const CCCoreLib::VerticesIndexes* tsic = croppedMesh->getTriangleVertIndexes(i);
 
-            //build the initial edge list & flag the convex hull points
-            std::multiset<Edge_> edges;
-            //initial number of edges
-            assert(hullPoints.size() >= 2);
-            size_t initEdgeCount = hullPoints.size();
-            if (envelopeType != FULL)
-                --initEdgeCount;
+                                        //we now have to test the 3 vertices of the new triangle
+                                        for (unsigned j = 0; j < 3; ++j)
+                                        {
+                                            unsigned vertIndex = tsic->i[j];
 
-            VertexIterator itB = hullPoints.begin();
-            for (size_t i = 0; i < initEdgeCount; ++i)
-            {
-                VertexIterator itA = itB; ++itB;
-                if (itB == hullPoints.end())
-                    itB = hullPoints.begin();
+                                            if (vertProcessed[vertIndex])
+                                            {
+                                                //vertex has already been process
+                                                continue;
+                                            }
 
-                //we will only process the edges that are longer than the maximum specified length
-                if ((**itB - **itA).norm2() > maxSquareEdgeLength)
-                {
-                    unsigned nearestPointIndex = 0;
-                    PointCoordinateType minSquareDist = FindNearestCandidate_(
-                        nearestPointIndex,
-                        itA,
-                        itB,
-                        points,
-                        pointFlags,
-                        minSquareEdgeLength,
-                        step > 1,
-                        minCosAngle);
+                                            const CCVector3* Vcj = croppedVertices->getPoint(vertIndex);
 
-                    if (minSquareDist >= 0)
-                    {
-                        Edge_ e(itA, nearestPointIndex, minSquareDist);
-                        edges.insert(e);
-                    }
-                }
+                                            //we'll deduce its color and SFs values by triangulation
+                                            if (importColors)
+                                            {
+                                                ccColor::Rgb col;
+                                                if (mesh->interpolateColors(origTriIndex, *Vcj, col))
+                                                {
+                                                    croppedVertices->setPointColor(vertIndex, col);
+                                                }
+                                            }
 
-                pointFlags[(*itA)->index] = POINT_USED;
-            }
+                                            if (importSFs)
+                                            {
+                                                CCVector3d w;
+                                                mesh->computeInterpolationWeights(origTriIndex, *Vcj, w);
+
+                                                //import SFs
+                                                for (unsigned s = 0; s < static_cast<unsigned>(importedSFs.size()); ++s)
+                                                {
+                                                    CCVector3d scalarValues(0, 0, 0);
+                                                    if (origVertices_pc)
+                                                    {
+                                                        const CCCoreLib::ScalarField* sf = origVertices_pc->getScalarField(s);
+                                                        scalarValues.x = sf->getValue(tsio->i1);
+                                                        scalarValues.y = sf->getValue(tsio->i2);
+                                                        scalarValues.z = sf->getValue(tsio->i3);
+                                                    }
+                                                    else
+                                                    {
+                                                        assert(s == 0);
+                                                        scalarValues.x = origVertices->getPointScalarValue(tsio->i1);
+                                                        scalarValues.y = origVertices->getPointScalarValue(tsio->i2);
+                                                        scalarValues.z = origVertices->getPointScalarValue(tsio->i3);
+                                                    }
+
+                                                    ScalarType sVal = static_cast<ScalarType>(scalarValues.dot(w));
+                                                    importedSFs[s]->setValue(vertIndex,sVal);
+                                                }
+                                            }
 
-            //flag the last vertex as well for non closed envelopes!
-            if (envelopeType != FULL)
-                pointFlags[(*hullPoints.rbegin())->index] = POINT_USED;
+                                            //update 'processed' flag
+                                            vertProcessed[vertIndex] = true;
+                                        }
+                                    }
 
-            while (!edges.empty())
-            {
-                //current edge (AB)
-                //this should be the edge with the nearest 'candidate'
-                Edge_ e = *edges.begin();
-                edges.erase(edges.begin());
+                                    for (size_t s = 0; s < importedSFs.size(); ++s)
+                                    {
+                                        importedSFs[s]->computeMinAndMax();
+                                    }
 
-                VertexIterator itA = e.itA;
-                VertexIterator itB = itA; ++itB;
-                if (itB == hullPoints.end())
-                {
-                    assert(envelopeType == FULL);
-                    itB = hullPoints.begin();
-                }
+                                    croppedVertices->showColors(importColors && origVertices->colorsShown());
+                                    croppedVertices->showSF(importSFs && origVertices->sfShown());
+                                    croppedMesh->showColors(importColors && mesh->colorsShown());
+                                    croppedMesh->showSF(importSFs && mesh->sfShown());
+                                }
+                            }
 
-                //nearest point
-                const Vertex2D& P = points[e.nearestPointIndex];
-                assert(pointFlags[P.index] == POINT_NOT_USED); //we don't consider already used points!
+                            //per-triangle features (materials)
+                            if (mesh->hasMaterials())
+                            {
+                                const ccMaterialSet* origMaterialSet = mesh->getMaterialSet();
+                                assert(origMaterialSet);
 
-                //create labels
-                cc2DLabel* edgeLabel = nullptr;
-                cc2DLabel* label = nullptr;
+                                if (origMaterialSet && !origMaterialSet->empty() && croppedMesh->reservePerTriangleMtlIndexes())
+                                {
+                                    std::vector<int> materialUsed(origMaterialSet->size(),-1);
 
-                //last check: the new segments must not intersect with the actual hull!
-                bool intersect = false;
-                //if (false)
-                {
-                    for (VertexIterator itJ = hullPoints.begin(), itI = itJ++; itI != hullPoints.end(); ++itI, ++itJ)
-                    {
-                        if (itJ == hullPoints.end())
-                        {
-                            if (envelopeType == FULL)
-                                itJ = hullPoints.begin();
-                            else
-                                break;
-                        }
+                                    //per-triangle materials
+                                    for (unsigned i = 0; i < croppedMesh->size(); ++i)
+                                    {
+                                        //get the origin triangle
+                                        unsigned origTriIndex = origTriIndexes[i];
+                                        int mtlIndex = mesh->getTriangleMtlIndex(origTriIndex);
+                                        croppedMesh->addTriangleMtlIndex(mtlIndex);
 
-                        if (    ((*itI)->index != (*itA)->index && (*itJ)->index != (*itA)->index && CCCoreLib::PointProjectionTools::segmentIntersect(**itI,**itJ,**itA,P))
-                            ||  ((*itI)->index != (*itB)->index && (*itJ)->index != (*itB)->index && CCCoreLib::PointProjectionTools::segmentIntersect(**itI,**itJ,P,**itB)) )
-                        {
-                            intersect = true;
-                            break;
-                        }
-                    }
-                }
-                if (!intersect)
-                {
-                    //add point to concave hull
-                    VertexIterator itP = hullPoints.insert(itB == hullPoints.begin() ? hullPoints.end() : itB, &points[e.nearestPointIndex]);
+                                        if (mtlIndex >= 0)
+                                            materialUsed[mtlIndex] = 1;
+                                    }
 
-                    //we won't use P anymore!
-                    pointFlags[P.index] = POINT_USED;
+                                    //import materials
+                                    {
+                                        size_t materialUsedCount = 0;
+                                        {
+                                            for (size_t i = 0; i < materialUsed.size(); ++i)
+                                                if (materialUsed[i] == 1)
+                                                    ++materialUsedCount;
+                                        }
 
-                    somethingHasChanged = true;
+                                        if (materialUsedCount == materialUsed.size())
+                                        {
+                                            //nothing to do, we use all input materials
+                                            croppedMesh->setMaterialSet(origMaterialSet->clone());
+                                        }
+                                        else
+                                        {
+                                            //create a subset of the input materials
+                                            ccMaterialSet* matSet = new ccMaterialSet(origMaterialSet->getName());
+                                            {
+                                                matSet->reserve(materialUsedCount);
+                                                for (size_t i = 0; i < materialUsed.size(); ++i)
+                                                {
+                                                    if (materialUsed[i] >= 0)
+                                                    {
+                                                        matSet->push_back(ccMaterial::Shared(new ccMaterial(*origMaterialSet->at(i))));
+                                                        //update index
+                                                        materialUsed[i] = static_cast<int>(matSet->size()) - 1;
+                                                    }
+                                                }
+                                            }
+                                            croppedMesh->setMaterialSet(matSet);
 
-                    //update all edges that were having 'P' as their nearest candidate as well
-                    if (!edges.empty())
-                    {
-                        std::vector<VertexIterator> removed;
-                        std::multiset<Edge_>::const_iterator lastValidIt = edges.end();
-                        for (std::multiset<Edge_>::const_iterator it = edges.begin(); it != edges.end(); ++it)
-                        {
-                            if ((*it).nearestPointIndex == e.nearestPointIndex)
-                            {
-                                //we'll have to put them back afterwards!
-                                removed.push_back((*it).itA);
+                                            //and update the materials indexes!
+                                            for (unsigned i = 0; i < croppedMesh->size(); ++i)
+                                            {
+                                                int mtlIndex = croppedMesh->getTriangleMtlIndex(i);
+                                                if (mtlIndex >= 0)
+                                                {
+                                                    assert(mtlIndex < static_cast<int>(materialUsed.size()));
+                                                    croppedMesh->setTriangleMtlIndex(i,materialUsed[mtlIndex]);
+                                                }
+                                            }
+                                        }
+                                    }
 
-                                edges.erase(it);
-                                if (edges.empty())
-                                    break;
-                                if (lastValidIt != edges.end())
-                                    it = lastValidIt;
+                                    croppedMesh->showMaterials(mesh->materialsShown());
+                                }
                                 else
-                                    it = edges.begin();
-                            }
-                            else
-                            {
-                                lastValidIt = it;
-                            }
-                        }
+                                {
+                                    ccLog::Warning("[Crop] Failed to transfer materials on the output mesh (not enough memory)");
+                                }
 
-                        //update the removed edges info and put them back in the main list
-                        for (size_t i = 0; i < removed.size(); ++i)
-                        {
-                            VertexIterator itC = removed[i];
-                            VertexIterator itD = itC; ++itD;
-                            if (itD == hullPoints.end())
-                                itD = hullPoints.begin();
+                                //per-triangle texture coordinates
+                                if (mesh->hasPerTriangleTexCoordIndexes())
+                                {
+                                    TextureCoordsContainer* texCoords = new TextureCoordsContainer;
+                                    if (    croppedMesh->reservePerTriangleTexCoordIndexes()
+                                        &&  texCoords->reserveSafe(croppedMesh->size()*3))
+                                    {
+                                        //for each new triangle
+                                        for (unsigned i = 0; i < croppedMesh->size(); ++i)
+                                        {
+                                            //get the origin triangle
+                                            unsigned origTriIndex = origTriIndexes[i];
+                                            TexCoords2D* tx1 = nullptr;
+                                            TexCoords2D* tx2 = nullptr;
+                                            TexCoords2D* tx3 = nullptr;
+                                            mesh->getTriangleTexCoordinates(origTriIndex, tx1, tx2, tx3);
 
-                            unsigned nearestPointIndex = 0;
-                            PointCoordinateType minSquareDist = FindNearestCandidate_(
-                                nearestPointIndex,
-                                itC,
-                                itD,
-                                points,
-                                pointFlags,
-                                minSquareEdgeLength,
-                                false,
-                                minCosAngle);
+                                            //get the new triangle
+                                            const CCCoreLib::VerticesIndexes* tsic = croppedMesh->getTriangleVertIndexes(i);
 
-                            if (minSquareDist >= 0)
-                            {
-                                Edge_ e(itC, nearestPointIndex, minSquareDist);
-                                edges.insert(e);
-                            }
-                        }
-                    }
+                                            //for each vertex of the new triangle
+                                            int texIndexes[3] = { -1, -1, -1 };
+                                            for (unsigned j = 0; j < 3; ++j)
+                                            {
+                                                unsigned vertIndex = tsic->i[j];
+                                                const CCVector3* Vcj = croppedVertices->getPoint(vertIndex);
 
-                    //we'll inspect the two new segments later (if necessary)
-                    if ((P-**itA).norm2() > maxSquareEdgeLength)
-                    {
-                        unsigned nearestPointIndex = 0;
-                        PointCoordinateType minSquareDist = FindNearestCandidate_(
-                            nearestPointIndex,
-                            itA,
-                            itP,
-                            points,
-                            pointFlags,
-                            minSquareEdgeLength,
-                            false,
-                            minCosAngle);
+                                                //intepolation weights
+                                                CCVector3d w;
+                                                mesh->computeInterpolationWeights(origTriIndex, *Vcj, w);
 
-                        if (minSquareDist >= 0)
-                        {
-                            Edge_ e(itA,nearestPointIndex,minSquareDist);
-                            edges.insert(e);
-                        }
-                    }
-                    if ((**itB-P).norm2() > maxSquareEdgeLength)
-                    {
-                        unsigned nearestPointIndex = 0;
-                        PointCoordinateType minSquareDist = FindNearestCandidate_(
-                            nearestPointIndex,
-                            itP,
-                            itB,
-                            points,
-                            pointFlags,
-                            minSquareEdgeLength,
-                            false,
-                            minCosAngle);
+                                                if (    (tx1 || CCCoreLib::LessThanEpsilon( w.u[0] ) )
+                                                    &&  (tx2 || CCCoreLib::LessThanEpsilon( w.u[1] ) )
+                                                    &&  (tx3 || CCCoreLib::LessThanEpsilon( w.u[2] ) ) )
+                                                {
+                                                    TexCoords2D t(  static_cast<float>((tx1 ? tx1->tx*w.u[0] : 0.0) + (tx2 ? tx2->tx*w.u[1] : 0.0) + (tx3 ? tx3->tx*w.u[2] : 0.0)),
+                                                                    static_cast<float>((tx1 ? tx1->ty*w.u[0] : 0.0) + (tx2 ? tx2->ty*w.u[1] : 0.0) + (tx3 ? tx3->ty*w.u[2] : 0.0)) );
 
-                        if (minSquareDist >= 0)
+                                                    texCoords->addElement(t);
+                                                    texIndexes[j] = static_cast<int>(texCoords->currentSize()) - 1;
+                                                }
+                                            }
+
+                                            croppedMesh->addTriangleTexCoordIndexes(texIndexes[0], texIndexes[1], texIndexes[2]);
+                                        }
+                                        croppedMesh->setTexCoordinatesTable(texCoords);
+                                    }
+                                    else
+                                    {
+                                        ccLog::Warning("[Crop] Failed to transfer texture coordinates on the output mesh (not enough memory)");
+                                        delete texCoords;
+                                        texCoords = nullptr;
+                                    }
+                                }
+                            }
+                        }
+                        catch (const std::bad_alloc&)
                         {
-                            Edge_ e(itP,nearestPointIndex,minSquareDist);
-                            edges.insert(e);
+                            ccLog::Warning("[Crop] Failed to transfer per-vertex features (color, SF values, etc.) on the output mesh (not enough memory)");
+                            croppedVertices->unallocateColors();
+                            croppedVertices->deleteAllScalarFields();
                         }
                     }
                 }
             }
+            else
+            {
+                ccLog::Warning("[Crop] Failed to create output mesh vertices (not enough memory)");
+            }
         }
-        catch (...)
+
+        //clean memory
+        if (params.insideMesh)
         {
-            //not enough memory
-            return false;
+            delete params.insideMesh;
+            params.insideMesh = nullptr;
+        }
+        if (params.outsideMesh)
+        {
+            delete params.outsideMesh;
+            params.outsideMesh = nullptr;
         }
 
-        if (!allowMultiPass)
-            break;
+        if (croppedMesh)
+        {
+            croppedMesh->setDisplay_recursive(entity->getDisplay());
+        }
+        return croppedMesh;
     }
 
-    return true;
+    //unhandled entity
+    ccLog::Warning("[Crop] Unhandled entity type");
+    return nullptr;
 }
 
-ccPolyline* ExtractFlatEnvelope__(  CCCoreLib::GenericIndexedCloudPersist* points,
-                                    bool allowMultiPass,
-                                    PointCoordinateType maxEdgeLength=0,
-                                    const PointCoordinateType* preferredNormDim=nullptr,
-                                    const PointCoordinateType* preferredUpDir=nullptr,
-                                    Envelope_Type envelopeType=FULL,
-                                    std::vector<unsigned>* originalPointIndexes=nullptr,
-                                    bool enableVisualDebugMode=false,
-                                    double maxAngleDeg=0.0)
+//! see ccClippingBoxTool.cpp
+ccHObject* GetSlice_(ccHObject* obj, ccClipBox* clipBox, bool silent)
 {
-    CCTRACE("ExtractFlatEnvelope__");
-    assert(points);
-
-    if (!points)
+    CCTRACE("GetSlice_");
+    assert(clipBox);
+    if (!obj)
+    {
+        assert(false);
         return nullptr;
+    }
 
-    unsigned ptsCount = points->size();
-
-    if (ptsCount < 3)
-        return nullptr;
+    if (obj->isKindOf(CC_TYPES::POINT_CLOUD))
+    {
+        CCTRACE("cloud");
+        ccGenericPointCloud* inputCloud = ccHObjectCaster::ToGenericPointCloud(obj);
 
-    CCCoreLib::Neighbourhood Yk(points);
+        ccGenericPointCloud::VisibilityTableType selectionTable;
+        try
+        {
+            selectionTable.resize(inputCloud->size());
+        }
+        catch (const std::bad_alloc&)
+        {
+            CCTRACE("Not enough memory!");
+            return nullptr;
+        }
+        clipBox->flagPointsInside(inputCloud, &selectionTable);
 
-    //local base
-    CCVector3 O;
-    CCVector3 X;
-    CCVector3 Y;
+        ccGenericPointCloud* sliceCloud = inputCloud->createNewCloudFromVisibilitySelection(false, &selectionTable, nullptr, true);
+        if (!sliceCloud)
+        {
+            CCTRACE("Not enough memory!");
+        }
+        else if (sliceCloud->size() == 0)
+        {
+            CCTRACE("empty slice!");
+            delete sliceCloud;
+            sliceCloud = nullptr;
+        }
+        return sliceCloud;
+    }
+    else if (obj->isKindOf(CC_TYPES::MESH))
+    {
+        CCTRACE("mesh");
+        const ccGLMatrix* _transformation = nullptr;
+        ccGLMatrix transformation;
+        if (clipBox->isGLTransEnabled())
+        {
+            transformation = clipBox->getGLTransformation().inverse();
+            _transformation = &transformation;
+        }
 
-    CCCoreLib::Neighbourhood::InputVectorsUsage vectorsUsage = CCCoreLib::Neighbourhood::None;
+        const ccBBox& cropBox = clipBox->getBox();
+        ccHObject* mesh = Crop_(obj, cropBox, true, _transformation);
+        if (!mesh)
+        {
+            CCTRACE("Failed to segment the mesh!");
+            return nullptr;
+        }
+        return mesh;
+    }
+    CCTRACE("neither cloud nor mesh?");
+    return nullptr;
+}
 
-    //we project the input points on a plane
-    std::vector<Vertex2D> points2D;
-    PointCoordinateType* planeEq = nullptr;
+unsigned ComputeGridDimensions_(const ccBBox& localBox,
+                                const bool processDim[3],
+                                int indexMins[3],
+                                int indexMaxs[3],
+                                int gridDim[3],
+                                const CCVector3& gridOrigin,
+                                const CCVector3& cellSizePlusGap)
+{
+    CCTRACE("ComputeGridDimensions_");
+    //compute 'grid' extents in the local clipping box ref.
+    for (int i = 0; i < 3; ++i)
+    {
+        indexMins[i] = 0;
+        indexMaxs[i] = 0;
+        gridDim[i]   = 1;
+    }
+    unsigned cellCount = 1;
 
-    if (preferredUpDir != nullptr)
+    for (unsigned char d = 0; d < 3; ++d)
     {
-        Y = CCVector3(preferredUpDir);
-        vectorsUsage = CCCoreLib::Neighbourhood::UseYAsUpDir;
+        if (processDim[d])
+        {
+            if (CCCoreLib::LessThanEpsilon(cellSizePlusGap.u[d]))
+            {
+                CCTRACE("Box size (plus gap) is null! Can't apply repetitive process!");
+                return 0;
+            }
+
+            PointCoordinateType a = (localBox.minCorner().u[d] - gridOrigin.u[d]) / cellSizePlusGap.u[d]; //don't forget the user defined gap between 'cells'
+            PointCoordinateType b = (localBox.maxCorner().u[d] - gridOrigin.u[d]) / cellSizePlusGap.u[d];
+
+            indexMins[d] = static_cast<int>(floor(a + static_cast<PointCoordinateType>(1.0e-6)));
+            indexMaxs[d] = static_cast<int>(ceil(b - static_cast<PointCoordinateType>(1.0e-6))) - 1;
+
+            assert(indexMaxs[d] >= indexMins[d]);
+            gridDim[d] = std::max(indexMaxs[d] - indexMins[d] + 1, 1);
+            cellCount *= static_cast<unsigned>(gridDim[d]);
+        }
     }
 
-    //if the user has specified a default direction, we'll use it as 'projecting plane'
-    PointCoordinateType preferredPlaneEq[4] = { 0, 0, 1, 0 };
+    return cellCount;
+}
 
-    if (preferredNormDim != nullptr)
+//! Sorts the point indexes by cell, with a stable (parallel) counting sort
+/** Each thread gets its own histogram, and the histograms are merged with a parallel prefix sum.
+    When the histograms would take more memory than the points themselves (many cells, few points per cell),
+    the (cell, point) keys are sorted in parallel instead. The result is the same in both cases.
+    \param pointCount number of points
+    \param cellCount number of cells
+    \param cellIndexOf returns the index of the cell of a given point, or -1 if the point should be ignored (may be called concurrently)
+    \param cellStarts output: first position of each cell in 'sortedIndexes' (cellCount + 1 values)
+    \param sortedIndexes output: the point indexes, sorted by cell (and by increasing value inside each cell)
+**/
+template <class CellIndexFunc> bool SortPointsByCell_(  unsigned pointCount,
+                                                        unsigned cellCount,
+                                                        const CellIndexFunc& cellIndexOf,
+                                                        std::vector<unsigned>& cellStarts,
+                                                        std::vector<unsigned>& sortedIndexes)
+{
+    unsigned chunkCount = 1;
+#ifdef CC_CORE_LIB_USES_TBB
+    chunkCount = static_cast<unsigned>(std::max(QThread::idealThreadCount(), 1));
+    if (chunkCount > 1 && static_cast<size_t>(chunkCount) * cellCount > 2 * static_cast<size_t>(std::max(pointCount, 1u << 20)))
     {
-        const CCVector3* G = points->getPoint(0); //any point through which the plane passes is ok
-        preferredPlaneEq[0] = preferredNormDim[0];
-        preferredPlaneEq[1] = preferredNormDim[1];
-        preferredPlaneEq[2] = preferredNormDim[2];
-        CCVector3::vnormalize(preferredPlaneEq);
-        preferredPlaneEq[3] = CCVector3::vdot(G->u, preferredPlaneEq);
-        planeEq = preferredPlaneEq;
-
-        if (preferredUpDir != nullptr)
+        //sparse case: parallel sort of the (cell, point) keys
+        std::vector<uint64_t> keys;
+        try
         {
-            O = *G;
-            //Y = CCVector3(preferredUpDir); //already done above
-            X = Y.cross(CCVector3(preferredNormDim));
-            vectorsUsage = CCCoreLib::Neighbourhood::UseOXYasBase;
+            keys.resize(pointCount);
+            cellStarts.resize(static_cast<size_t>(cellCount) + 1);
+        }
+        catch (const std::bad_alloc&)
+        {
+            CCTRACE("Not enough memory!");
+            return false;
+        }
+        std::atomic<unsigned> keptCount(0);
+        tbb::parallel_for(static_cast<unsigned>(0), pointCount, [&](unsigned i)
+        {
+            int cellIndex = cellIndexOf(i);
+            keys[i] = (cellIndex >= 0 ? (static_cast<uint64_t>(cellIndex) << 32) | i : std::numeric_limits<uint64_t>::max());
+            if (cellIndex >= 0)
+            {
+                keptCount.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+        tbb::parallel_sort(keys.begin(), keys.end());
+        unsigned kept = keptCount.load();
+        try
+        {
+            sortedIndexes.resize(kept);
+        }
+        catch (const std::bad_alloc&)
+        {
+            CCTRACE("Not enough memory!");
+            return false;
         }
+        //each cell starts at the first key of a higher cell
+        tbb::parallel_for(static_cast<unsigned>(0), kept, [&](unsigned k)
+        {
+            sortedIndexes[k] = static_cast<unsigned>(keys[k] & 0xFFFFFFFF);
+            unsigned cell = static_cast<unsigned>(keys[k] >> 32);
+            unsigned previousCell = (k == 0 ? 0 : static_cast<unsigned>(keys[k - 1] >> 32) + 1);
+            for (unsigned c = previousCell; c <= cell; ++c)
+            {
+                cellStarts[c] = k;
+            }
+        });
+        unsigned lastCell = (kept == 0 ? 0 : static_cast<unsigned>(keys[kept - 1] >> 32) + 1);
+        tbb::parallel_for(lastCell, cellCount + 1, [&](unsigned c)
+        {
+            cellStarts[c] = kept;
+        });
+        return true;
     }
+#endif
+    unsigned chunkSize = (pointCount + chunkCount - 1) / chunkCount;
 
-    if (!Yk.projectPointsOn2DPlane<Vertex2D>(points2D, planeEq, &O, &X, &Y, vectorsUsage))
+    std::vector<int> pointCells;
+    std::vector<unsigned> chunkCounts;
+    try
     {
-        CCTRACE("[ExtractFlatEnvelope] Failed to project the points on the LS plane (not enough memory?)!");
-        return nullptr;
+        pointCells.resize(pointCount);
+        chunkCounts.resize(static_cast<size_t>(chunkCount) * cellCount, 0);
+        cellStarts.resize(static_cast<size_t>(cellCount) + 1);
+    }
+    catch (const std::bad_alloc&)
+    {
+        CCTRACE("Not enough memory!");
+        return false;
     }
 
-    //update the points indexes (not done by Neighbourhood::projectPointsOn2DPlane)
+    //first pass: cell index of each point and per chunk histograms
+    auto countChunk = [&](unsigned c)
     {
-        for (unsigned i = 0; i < ptsCount; ++i)
+        unsigned first = c * chunkSize;
+        unsigned last = std::min(pointCount, first + chunkSize);
+        unsigned* counts = chunkCounts.data() + static_cast<size_t>(c) * cellCount;
+        for (unsigned i = first; i < last; ++i)
         {
-            points2D[i].index = i;
+            int cellIndex = cellIndexOf(i);
+            pointCells[i] = cellIndex;
+            if (cellIndex >= 0)
+            {
+                ++counts[cellIndex];
+            }
         }
-    }
+    };
 
-    //try to get the points on the convex/concave hull to build the envelope and the polygon
-    Hull2D hullPoints;
-    if (!ExtractConcaveHull2D_( points2D,
-                                hullPoints,
-                                envelopeType,
-                                allowMultiPass,
-                                maxEdgeLength*maxEdgeLength,
-                                enableVisualDebugMode,
-                                maxAngleDeg))
+    //exclusive prefix sum (by cell, then by chunk, so as to keep the points order inside each cell),
+    //over blocks of cells: block totals, scan of the block totals, then the offsets inside each block
+    unsigned blockCount = std::max(1u, std::min(chunkCount * 8, cellCount / 1024));
+    unsigned blockSize = (cellCount + blockCount - 1) / std::max(blockCount, 1u);
+    std::vector<unsigned> blockOffsets(static_cast<size_t>(blockCount) + 1, 0);
+    auto sumBlock = [&](unsigned b)
+    {
+        unsigned total = 0;
+        for (unsigned cell = b * blockSize; cell < std::min(cellCount, (b + 1) * blockSize); ++cell)
+        {
+            for (unsigned c = 0; c < chunkCount; ++c)
+            {
+                total += chunkCounts[static_cast<size_t>(c) * cellCount + cell];
+            }
+        }
+        blockOffsets[b + 1] = total;
+    };
+    auto offsetBlock = [&](unsigned b)
+    {
+        unsigned offset = blockOffsets[b];
+        for (unsigned cell = b * blockSize; cell < std::min(cellCount, (b + 1) * blockSize); ++cell)
+        {
+            cellStarts[cell] = offset;
+            for (unsigned c = 0; c < chunkCount; ++c)
+            {
+                unsigned& count = chunkCounts[static_cast<size_t>(c) * cellCount + cell];
+                unsigned n = count;
+                count = offset;
+                offset += n;
+            }
+        }
+    };
+
+    //second pass: scatter the point indexes
+    auto scatterChunk = [&](unsigned c)
+    {
+        unsigned first = c * chunkSize;
+        unsigned last = std::min(pointCount, first + chunkSize);
+        unsigned* positions = chunkCounts.data() + static_cast<size_t>(c) * cellCount;
+        for (unsigned i = first; i < last; ++i)
+        {
+            int cellIndex = pointCells[i];
+            if (cellIndex >= 0)
+            {
+                sortedIndexes[positions[cellIndex]++] = i;
+            }
+        }
+    };
+
+#ifdef CC_CORE_LIB_USES_TBB
+    tbb::parallel_for(static_cast<unsigned>(0), chunkCount, countChunk);
+    tbb::parallel_for(static_cast<unsigned>(0), blockCount, sumBlock);
+#else
+    countChunk(0);
+    for (unsigned b = 0; b < blockCount; ++b)
+        sumBlock(b);
+#endif
+    for (unsigned b = 0; b < blockCount; ++b)
+    {
+        blockOffsets[b + 1] += blockOffsets[b];
+    }
+#ifdef CC_CORE_LIB_USES_TBB
+    tbb::parallel_for(static_cast<unsigned>(0), blockCount, offsetBlock);
+#else
+    for (unsigned b = 0; b < blockCount; ++b)
+        offsetBlock(b);
+#endif
+    cellStarts[cellCount] = blockOffsets[blockCount];
+
+    try
     {
-        CCTRACE("[ExtractFlatEnvelope] Failed to compute the convex hull of the input points!");
-        return nullptr;
+        sortedIndexes.resize(cellStarts[cellCount]);
+    }
+    catch (const std::bad_alloc&)
+    {
+        CCTRACE("Not enough memory!");
+        return false;
     }
 
-    if (originalPointIndexes)
+#ifdef CC_CORE_LIB_USES_TBB
+    tbb::parallel_for(static_cast<unsigned>(0), chunkCount, scatterChunk);
+#else
+    scatterChunk(0);
+#endif
+
+    return true;
+}
+
+//! Union-find structure that can be updated concurrently
+/** The root of a set is always its smallest element, so that the result doesn't depend on the order of the unions.
+**/
+class ConcurrentUnionFind_
+{
+public:
+    bool init(unsigned count)
     {
         try
         {
-            originalPointIndexes->resize(hullPoints.size(), 0);
+            m_parents = std::vector< std::atomic<unsigned> >(count);
         }
         catch (const std::bad_alloc&)
         {
-            //not enough memory
-            CCTRACE("[ExtractFlatEnvelope] Not enough memory!");
-            return nullptr;
+            return false;
         }
-
-        unsigned i = 0;
-        for (Hull2D::const_iterator it = hullPoints.begin(); it != hullPoints.end(); ++it, ++i)
+        for (unsigned i = 0; i < count; ++i)
         {
-            (*originalPointIndexes)[i] = (*it)->index;
+            m_parents[i].store(i, std::memory_order_relaxed);
         }
+        return true;
     }
 
-    unsigned hullPtsCount = static_cast<unsigned>(hullPoints.size());
-
-    //create vertices
-    ccPointCloud* envelopeVertices = new ccPointCloud();
+    unsigned find(unsigned x)
     {
-        if (!envelopeVertices->reserve(hullPtsCount))
+        while (true)
         {
-            delete envelopeVertices;
-            envelopeVertices = nullptr;
-            CCTRACE("[ExtractFlatEnvelope] Not enough memory!");
-            return nullptr;
+            unsigned parent = m_parents[x].load();
+            if (parent == x)
+            {
+                return x;
+            }
+            unsigned grandParent = m_parents[parent].load();
+            if (grandParent != parent)
+            {
+                //path halving (it doesn't matter if it fails)
+                m_parents[x].compare_exchange_weak(parent, grandParent);
+            }
+            x = grandParent;
         }
+    }
 
-        //projection on the LS plane (in 3D)
-        for (Hull2D::const_iterator it = hullPoints.begin(); it != hullPoints.end(); ++it)
+    //! Returns true if the two sets were distinct (and are now merged)
+    bool unite(unsigned a, unsigned b)
+    {
+        while (true)
         {
-            envelopeVertices->addPoint(O + X*(*it)->x + Y*(*it)->y);
+            a = find(a);
+            b = find(b);
+            if (a == b)
+            {
+                return false;
+            }
+            if (a < b)
+            {
+                std::swap(a, b);
+            }
+            //we link the largest root to the smallest one (if it is still a root)
+            unsigned expected = a;
+            if (m_parents[a].compare_exchange_strong(expected, b))
+            {
+                return true;
+            }
         }
-
-        envelopeVertices->setName("vertices");
-        envelopeVertices->setEnabled(false);
     }
 
-    //we create the corresponding (3D) polyline
-    ccPolyline* envelopePolyline = new ccPolyline(envelopeVertices);
-    if (envelopePolyline->reserve(hullPtsCount))
+protected:
+    std::vector< std::atomic<unsigned> > m_parents;
+};
+
+//! see pyCC.h. The kNN graph is stored with kNN slots per point, the Boruvka rounds use the concurrent union-find.
+bool OrientNormalsWithMSTParallel(ccPointCloud* cloud, unsigned kNN, unsigned tilePointCount)
+{
+    CCTRACE("OrientNormalsWithMSTParallel kNN: " << kNN << " tilePointCount: " << tilePointCount);
+    if (!cloud || !cloud->hasNormals() || kNN == 0)
     {
-        envelopePolyline->addPointIndex(0, hullPtsCount);
-        envelopePolyline->setClosed(envelopeType == FULL);
-        envelopePolyline->setVisible(true);
-        envelopePolyline->setName("envelope");
-        envelopePolyline->addChild(envelopeVertices);
+        CCTRACE("a cloud with normals and kNN > 0 are required");
+        return false;
     }
-    else
+    const unsigned pointCount = cloud->size();
+    if (static_cast<uint64_t>(pointCount) * kNN >= (static_cast<uint64_t>(1) << 40))
     {
-        delete envelopePolyline;
-        envelopePolyline = nullptr;
-        CCTRACE("[ExtractFlatEnvelope] Not enough memory to create the envelope polyline!");
+        ccLog::Error("[OrientNormalsWithMST] Too many points");
+        return false;
+    }
+    ccOctree::Shared octree = cloud->getOctree();
+    if (!octree)
+    {
+        octree = cloud->computeOctree(nullptr);
+        if (!octree)
+        {
+            CCTRACE("Couldn't compute octree for cloud " << cloud->getName().toStdString());
+            return false;
+        }
     }
 
-    return envelopePolyline;
-}
-
-bool ExtractFlatEnvelope_(  CCCoreLib::GenericIndexedCloudPersist* points,
-                            bool allowMultiPass,
-                            PointCoordinateType maxEdgeLength,
-                            std::vector<ccPolyline*>& parts,
-                            Envelope_Type envelopeType=FULL,
-                            bool allowSplitting=true,
-                            const PointCoordinateType* preferredNormDir=nullptr,
-                            const PointCoordinateType* preferredUpDir=nullptr,
-                            bool enableVisualDebugMode=false)
-{
-    CCTRACE("ExtractFlatEnvelope_");
-    parts.clear();
-
-    //extract whole envelope
-    ccPolyline* basePoly = ExtractFlatEnvelope__(points, allowMultiPass, maxEdgeLength, preferredNormDir,
-                                                 preferredUpDir, envelopeType, nullptr, enableVisualDebugMode);
-    if (!basePoly)
+    const unsigned noNeighbour = std::numeric_limits<unsigned>::max();
+    std::vector<unsigned> neighbours;  //kNN graph, kNN slots per point (compact CSR with a fixed degree)
+    std::vector<unsigned> tiles;       //tile of each point (tiled mode only)
+    std::vector<unsigned char> flips;  //1 if the normal must be inverted
+    std::vector< std::atomic<uint64_t> > cheapest;
+    ConcurrentUnionFind_ trees;
+    try
     {
-        return false;
+        neighbours.resize(static_cast<size_t>(pointCount) * kNN, noNeighbour);
+        flips.resize(pointCount, 0);
+        cheapest = std::vector< std::atomic<uint64_t> >(pointCount);
+        if (tilePointCount != 0)
+            tiles.resize(pointCount, noNeighbour);
     }
-    else if (!allowSplitting)
+    catch (const std::bad_alloc&)
     {
-        parts.push_back(basePoly);
-        return true;
+        ccLog::Error("[OrientNormalsWithMST] Not enough memory!");
+        return false;
     }
-
-    //and split it if necessary
-    bool success = basePoly->split(maxEdgeLength, parts);
-
-    delete basePoly;
-    basePoly = nullptr;
-
-    return success;
-}
-
-//! see ccCropTool::Crop
-ccHObject* Crop_(ccHObject* entity, const ccBBox& box, bool inside/*=true*/, const ccGLMatrix* meshRotation/*=nullptr*/)
-{
-    //CCTRACE("Crop_");
-    assert(entity);
-    if (!entity)
+    if (!trees.init(pointCount))
     {
-        return nullptr;
+        ccLog::Error("[OrientNormalsWithMST] Not enough memory!");
+        return false;
     }
 
-    if (entity->isA(CC_TYPES::POINT_CLOUD))
+    unsigned chunkCount = 1;
+#ifdef CC_CORE_LIB_USES_TBB
+    chunkCount = std::min(static_cast<unsigned>(std::max(QThread::idealThreadCount(), 1)) * 8, std::max(pointCount / 1024, 1u));
+#endif
+    const unsigned chunkSize = (pointCount + chunkCount - 1) / chunkCount;
+    auto forEachChunk = [&](const std::function<void(unsigned, unsigned, unsigned)>& processChunk)
     {
-        ccPointCloud* cloud = static_cast<ccPointCloud*>(entity);
+        auto runChunk = [&](unsigned c)
+        {
+            processChunk(c, c * chunkSize, std::min(pointCount, (c + 1) * chunkSize));
+        };
+#ifdef CC_CORE_LIB_USES_TBB
+        tbb::parallel_for(static_cast<unsigned>(0), chunkCount, runChunk);
+#else
+        for (unsigned c = 0; c < chunkCount; ++c)
+            runChunk(c);
+#endif
+    };
 
-        CCCoreLib::ReferenceCloud* selection = cloud->crop(box, inside);
-        if (!selection)
+    //tiles: octree cells with about 'tilePointCount' points
+    if (tilePointCount != 0)
+    {
+        unsigned char tileLevel = octree->findBestLevelForAGivenPopulationPerCell(tilePointCount);
+        std::vector<CCCoreLib::DgmOctree::IndexAndCode> cells;
+        if (!octree->getCellCodesAndIndexes(tileLevel, cells, true))
         {
-            //process failed!
-            CCTRACE(QString("[Crop] Failed to crop cloud '%1'!").arg(cloud->getName()).toStdString());
-            return nullptr;
+            ccLog::Error("[OrientNormalsWithMST] Not enough memory!");
+            return false;
         }
-
-        if (selection->size() == 0)
+        const CCCoreLib::DgmOctree::cellsContainer& pointsAndCodes = octree->pointsAndTheirCellCodes();
+        unsigned projectedCount = static_cast<unsigned>(pointsAndCodes.size());
+        for (size_t c = 0; c < cells.size(); ++c)
         {
-            //no points fall inside selection!
-            CCTRACE(QString("[Crop] No point of the cloud '%1' falls %2side the input box!").arg(cloud->getName(), (inside ? "in" : "out")).toStdString());
-            delete selection;
-            return nullptr;
+            unsigned cellEnd = (c + 1 < cells.size() ? cells[c + 1].theIndex : projectedCount);
+            for (unsigned j = cells[c].theIndex; j < cellEnd; ++j)
+                tiles[pointsAndCodes[j].theIndex] = static_cast<unsigned>(c);
         }
-
-        //crop
-        ccPointCloud* croppedEnt = cloud->partialClone(selection);
-        delete selection;
-        selection = nullptr;
-
-        return croppedEnt;
+        CCTRACE("tile level: " << static_cast<int>(tileLevel) << " tiles: " << cells.size());
     }
-    else if (entity->isKindOf(CC_TYPES::MESH))
-    {
-        ccGenericMesh* mesh = static_cast<ccGenericMesh*>(entity);
-        CCCoreLib::ManualSegmentationTools::MeshCutterParams params;
-        params.bbMin = box.minCorner();
-        params.bbMax = box.maxCorner();
-        params.generateOutsideMesh = !inside;
-        params.trackOrigIndexes = mesh->hasColors() || mesh->hasScalarFields() || mesh->hasMaterials();
 
-        ccGenericPointCloud* origVertices = mesh->getAssociatedCloud();
-        assert(origVertices);
-        ccGenericPointCloud* cropVertices = origVertices;
-        if (meshRotation)
+    //kNN graph
+    unsigned char searchLevel = octree->findBestLevelForAGivenPopulationPerCell(std::max(kNN, 3u));
+    forEachChunk([&](unsigned, unsigned first, unsigned last)
+    {
+        CCCoreLib::ReferenceCloud Yk(cloud);
+        for (unsigned i = first; i < last; ++i)
         {
-            ccPointCloud* rotatedVertices = ccPointCloud::From(origVertices);
-            if (!rotatedVertices)
+            double maxSquareDist = 0;
+            Yk.clear();
+            unsigned found = octree->findPointNeighbourhood(cloud->getPoint(i), &Yk, kNN + 1, searchLevel, maxSquareDist);
+            unsigned slot = 0;
+            for (unsigned n = 0; n < found && slot < kNN; ++n)
             {
-                CCTRACE(QString("[Crop] Failed to crop mesh '%1'! (not enough memory)").arg(mesh->getName()).toStdString());
-                return nullptr;
+                unsigned j = Yk.getPointGlobalIndex(n);
+                if (j != i)
+                    neighbours[static_cast<size_t>(i) * kNN + slot++] = j;
             }
-            rotatedVertices->setGLTransformation(*meshRotation);
-            rotatedVertices->applyGLTransformation_recursive();
-            cropVertices = rotatedVertices;
         }
+    });
 
-        if (!CCCoreLib::ManualSegmentationTools::segmentMeshWithAABox(mesh, cropVertices, params))
-        {
-            //process failed!
-            CCTRACE(QString("[Crop] Failed to crop mesh '%1'!").arg(mesh->getName()).toStdString());
-        }
+    //edge weight (1 - |cos|), quantized on 23 bits, and edge index on 40 bits: unique keys
+    const uint64_t noEdge = std::numeric_limits<uint64_t>::max();
+    const uint64_t edgeMask = (static_cast<uint64_t>(1) << 40) - 1;
+    auto edgeKey = [&](unsigned i, unsigned j, uint64_t edge)
+    {
+        double w = 1.0 - std::abs(static_cast<double>(cloud->getPointNormal(i).dot(cloud->getPointNormal(j))));
+        uint64_t q = static_cast<uint64_t>(std::max(0.0, std::min(w, 1.0)) * ((1 << 23) - 1));
+        return (q << 40) | edge;
+    };
+    auto edgeAllowed = [&](unsigned i, unsigned j)
+    {
+        return j != noNeighbour && (tiles.empty() || tiles[i] == tiles[j]);
+    };
 
-        if (cropVertices != origVertices)
+    //Boruvka: at each round, each tree is linked to another one by its cheapest edge
+    std::vector< std::vector<std::pair<unsigned, unsigned> > > chunkEdges(chunkCount);
+    while (true)
+    {
+        forEachChunk([&](unsigned, unsigned first, unsigned last)
         {
-            //don't need those anymore
-            delete cropVertices;
-            cropVertices = origVertices;
-        }
-
-        CCCoreLib::SimpleMesh* tempMesh = inside ? params.insideMesh : params.outsideMesh;
-
-        //output
-        ccMesh* croppedMesh = nullptr;
-
-        if (tempMesh)
+            for (unsigned i = first; i < last; ++i)
+                cheapest[i].store(noEdge, std::memory_order_relaxed);
+        });
+        forEachChunk([&](unsigned, unsigned first, unsigned last)
         {
-            ccPointCloud* croppedVertices = ccPointCloud::From(tempMesh->vertices());
-            if (croppedVertices)
+            for (unsigned i = first; i < last; ++i)
             {
-                if (meshRotation)
-                {
-                    //apply inverse transformation
-                    croppedVertices->setGLTransformation(meshRotation->inverse());
-                    croppedVertices->applyGLTransformation_recursive();
-                }
-                croppedMesh = new ccMesh(tempMesh, croppedVertices);
-                croppedMesh->addChild(croppedVertices);
-                croppedVertices->setEnabled(false);
-                if (croppedMesh->size() == 0)
-                {
-                    //no points fall inside selection!
-                    ccLog::Warning(QString("[Crop] No triangle of the mesh '%1' falls %2side the input box!").arg(mesh->getName(), (inside ? "in" : "out")));
-                    delete croppedMesh;
-                    croppedMesh = nullptr;
-                }
-                else
+                unsigned ri = trees.find(i);
+                for (unsigned s = 0; s < kNN; ++s)
                 {
-                    assert(origVertices);
-
-                    //import parameters
-                    croppedVertices->importParametersFrom(origVertices);
-                    croppedMesh->importParametersFrom(mesh);
-
-                    //compute normals if necessary
-                    if (mesh->hasNormals())
+                    size_t edge = static_cast<size_t>(i) * kNN + s;
+                    unsigned j = neighbours[edge];
+                    if (!edgeAllowed(i, j))
+                        continue;
+                    unsigned rj = trees.find(j);
+                    if (ri == rj)
+                        continue;
+                    uint64_t key = edgeKey(i, j, edge);
+                    for (unsigned r : { ri, rj })
                     {
-                        bool success = false;
-                        if (mesh->hasTriNormals())
-                            success = croppedMesh->computePerTriangleNormals();
-                        else
-                            success = croppedMesh->computePerVertexNormals();
-
-                        if (!success)
+                        uint64_t current = cheapest[r].load(std::memory_order_relaxed);
+                        while (key < current && !cheapest[r].compare_exchange_weak(current, key))
                         {
-                            ccLog::Warning("[Crop] Failed to compute normals on the output mesh (not enough memory)");
                         }
-                        croppedMesh->showNormals(success && mesh->normalsShown());
                     }
+                }
+            }
+        });
+        std::atomic<unsigned> merged(0);
+        forEachChunk([&](unsigned c, unsigned first, unsigned last)
+        {
+            for (unsigned r = first; r < last; ++r)
+            {
+                uint64_t key = cheapest[r].load(std::memory_order_relaxed);
+                if (key == noEdge)
+                    continue;
+                uint64_t edge = key & edgeMask;
+                unsigned a = static_cast<unsigned>(edge / kNN);
+                unsigned b = neighbours[edge];
+                if (trees.unite(a, b)) //the same edge may be chosen by both trees
+                {
+                    chunkEdges[c].emplace_back(a, b);
+                    ++merged;
+                }
+            }
+        });
+        if (merged == 0)
+            break;
+    }
+    cheapest = std::vector< std::atomic<uint64_t> >();
+    if (tilePointCount == 0)
+    {
+        std::vector<unsigned>().swap(neighbours);
+    }
 
-                    //import other features if necessary
-                    if (params.trackOrigIndexes)
-                    {
-                        const std::vector<unsigned>& origTriIndexes = inside ? params.origTriIndexesMapInside : params.origTriIndexesMapOutside;
+    //minimum spanning forest (adjacency lists)
+    std::vector<unsigned> adjacencyStarts(static_cast<size_t>(pointCount) + 1, 0);
+    std::vector<unsigned> adjacency;
+    {
+        size_t edgeCount = 0;
+        for (const auto& edges : chunkEdges)
+        {
+            edgeCount += edges.size();
+            for (const auto& e : edges)
+            {
+                ++adjacencyStarts[e.first + 1];
+                ++adjacencyStarts[e.second + 1];
+            }
+        }
+        for (unsigned i = 0; i < pointCount; ++i)
+            adjacencyStarts[i + 1] += adjacencyStarts[i];
+        adjacency.resize(2 * edgeCount);
+        std::vector<unsigned> positions(adjacencyStarts.begin(), adjacencyStarts.end() - 1);
+        for (const auto& edges : chunkEdges)
+        {
+            for (const auto& e : edges)
+            {
+                adjacency[positions[e.first]++] = e.second;
+                adjacency[positions[e.second]++] = e.first;
+            }
+        }
+    }
+    chunkEdges.clear();
 
-                        try
-                        {
-                            //per vertex features (RGB color & scalar fields)
-                            if (origVertices->hasColors() || origVertices->hasScalarFields())
-                            {
-                                //we use flags to avoid processing the same vertex multiple times
-                                std::vector<bool> vertProcessed(croppedVertices->size(), false);
+    //each tree is oriented from its root (its smallest index, whose normal is kept), trees in parallel
+    std::vector<unsigned> roots;
+    for (unsigned i = 0; i < pointCount; ++i)
+        if (trees.find(i) == i)
+            roots.push_back(i);
+    auto orientTree = [&](size_t t)
+    {
+        std::vector< std::pair<unsigned, unsigned> > stack(1, std::make_pair(roots[t], noNeighbour)); //point, parent
+        while (!stack.empty())
+        {
+            unsigned u = stack.back().first;
+            unsigned parent = stack.back().second;
+            stack.pop_back();
+            CCVector3 Nu = cloud->getPointNormal(u);
+            if (flips[u])
+                Nu = -Nu;
+            for (unsigned a = adjacencyStarts[u]; a < adjacencyStarts[u + 1]; ++a)
+            {
+                unsigned v = adjacency[a];
+                if (v == parent)
+                    continue;
+                flips[v] = (Nu.dot(cloud->getPointNormal(v)) < 0 ? 1 : 0);
+                stack.emplace_back(v, u);
+            }
+        }
+    };
+#ifdef CC_CORE_LIB_USES_TBB
+    tbb::parallel_for(static_cast<size_t>(0), roots.size(), orientTree);
+#else
+    for (size_t t = 0; t < roots.size(); ++t)
+        orientTree(t);
+#endif
+    CCTRACE("MST orientation: " << roots.size() << " trees");
 
-                                //colors
-                                bool importColors = false;
-                                if (origVertices->hasColors())
-                                {
-                                    importColors = croppedVertices->resizeTheRGBTable();
-                                    if (!importColors)
-                                        ccLog::Warning("[Crop] Failed to transfer RGB colors on the output mesh (not enough memory)");
-                                }
+    //tiled mode: the signs of the trees are reconciled along the seams, with the kNN edges between trees
+    if (tilePointCount != 0 && roots.size() > 1)
+    {
+        std::vector<unsigned> treeIndexes(pointCount);
+        for (size_t t = 0; t < roots.size(); ++t)
+            treeIndexes[roots[t]] = static_cast<unsigned>(t);
+        forEachChunk([&](unsigned, unsigned first, unsigned last)
+        {
+            for (unsigned i = first; i < last; ++i)
+                treeIndexes[i] = treeIndexes[trees.find(i)];
+        });
 
-                                //scalar fields
-                                std::vector<ccScalarField*> importedSFs;
-                                ccPointCloud* origVertices_pc = nullptr;
-                                if (origVertices->hasScalarFields())
-                                {
-                                    origVertices_pc = origVertices->isA(CC_TYPES::POINT_CLOUD) ? static_cast<ccPointCloud*>(origVertices) : nullptr;
-                                    unsigned sfCount = origVertices_pc ? origVertices_pc->getNumberOfScalarFields() : 1;
+        //agreement between two trees: sum of the cosines between their oriented normals (kNN edges across the seams)
+        std::vector< std::unordered_map<uint64_t, double> > chunkVotes(chunkCount);
+        forEachChunk([&](unsigned c, unsigned first, unsigned last)
+        {
+            for (unsigned i = first; i < last; ++i)
+            {
+                CCVector3 Ni = cloud->getPointNormal(i);
+                if (flips[i])
+                    Ni = -Ni;
+                for (unsigned s = 0; s < kNN; ++s)
+                {
+                    unsigned j = neighbours[static_cast<size_t>(i) * kNN + s];
+                    if (j == noNeighbour || treeIndexes[i] == treeIndexes[j])
+                        continue;
+                    unsigned ta = std::min(treeIndexes[i], treeIndexes[j]);
+                    unsigned tb = std::max(treeIndexes[i], treeIndexes[j]);
+                    CCVector3 Nj = cloud->getPointNormal(j);
+                    if (flips[j])
+                        Nj = -Nj;
+                    chunkVotes[c][(static_cast<uint64_t>(ta) << 32) | tb] += Ni.dot(Nj);
+                }
+            }
+        });
+        std::unordered_map<uint64_t, double> votes;
+        for (const auto& chunk : chunkVotes)
+            for (const auto& vote : chunk)
+                votes[vote.first] += vote.second;
+        chunkVotes.clear();
+
+        //maximum spanning tree of the trees graph (most confident agreements first), then propagation
+        std::vector< std::pair<double, uint64_t> > seams;
+        seams.reserve(votes.size());
+        for (const auto& vote : votes)
+            seams.emplace_back(vote.second, vote.first);
+        std::sort(seams.begin(), seams.end(), [](const std::pair<double, uint64_t>& a, const std::pair<double, uint64_t>& b)
+                  { return std::abs(a.first) > std::abs(b.first) || (std::abs(a.first) == std::abs(b.first) && a.second < b.second); });
+        unsigned treeCount = static_cast<unsigned>(roots.size());
+        ConcurrentUnionFind_ treeSets;
+        if (!treeSets.init(treeCount))
+        {
+            ccLog::Error("[OrientNormalsWithMST] Not enough memory!");
+            return false;
+        }
+        std::vector< std::vector< std::pair<unsigned, bool> > > treeGraph(treeCount); //neighbour tree, opposite orientation
+        for (const auto& seam : seams)
+        {
+            unsigned ta = static_cast<unsigned>(seam.second >> 32);
+            unsigned tb = static_cast<unsigned>(seam.second & 0xFFFFFFFF);
+            if (seam.first != 0 && treeSets.unite(ta, tb))
+            {
+                treeGraph[ta].emplace_back(tb, seam.first < 0);
+                treeGraph[tb].emplace_back(ta, seam.first < 0);
+            }
+        }
+        std::vector<unsigned char> treeFlips(treeCount, 0);
+        std::vector<bool> visited(treeCount, false);
+        for (unsigned t = 0; t < treeCount; ++t)
+        {
+            if (visited[t])
+                continue;
+            visited[t] = true;
+            std::vector<unsigned> stack(1, t);
+            while (!stack.empty())
+            {
+                unsigned u = stack.back();
+                stack.pop_back();
+                for (const auto& link : treeGraph[u])
+                {
+                    if (!visited[link.first])
+                    {
+                        visited[link.first] = true;
+                        treeFlips[link.first] = treeFlips[u] ^ (link.second ? 1 : 0);
+                        stack.push_back(link.first);
+                    }
+                }
+            }
+        }
+        forEachChunk([&](unsigned, unsigned first, unsigned last)
+        {
+            for (unsigned i = first; i < last; ++i)
+                flips[i] ^= treeFlips[treeIndexes[i]];
+        });
+    }
 
-                                    //now try to import each SF
-                                    for (unsigned i = 0; i < sfCount; ++i)
-                                    {
-                                        int sfIdx = croppedVertices->addScalarField(origVertices_pc ? origVertices_pc->getScalarField(i)->getName() : "Scalar field");
-                                        if (sfIdx >= 0)
-                                        {
-                                            ccScalarField* sf = static_cast<ccScalarField*>(croppedVertices->getScalarField(i));
-                                            sf->fill(CCCoreLib::NAN_VALUE);
-                                            if (origVertices_pc)
-                                            {
-                                                //import display parameters if possible
-                                                ccScalarField* originSf = static_cast<ccScalarField*>(origVertices_pc->getScalarField(i));
-                                                assert(originSf);
-                                                //copy display parameters
-                                                sf->importParametersFrom(originSf);
-                                            }
-                                            importedSFs.push_back(sf);
-                                        }
-                                        else
-                                        {
-                                            ccLog::Warning("[Crop] Failed to transfer one or several scalar fields on the output mesh (not enough memory)");
-                                            //we can stop right now as all SFs have the same size!
-                                            break;
-                                        }
-                                    }
+    //inversion of the normals
+    CompressedNormType* normals = cloud->normals()->data();
+    forEachChunk([&](unsigned, unsigned first, unsigned last)
+    {
+        for (unsigned i = first; i < last; ++i)
+            if (flips[i])
+                normals[i] = ccNormalVectors::GetNormIndex(-cloud->getPointNormal(i));
+    });
+    cloud->normalsHaveChanged();
 
-                                    //default displayed SF
-                                    if (origVertices_pc)
-                                        croppedVertices->setCurrentDisplayedScalarField(std::max(static_cast<int>(croppedVertices->getNumberOfScalarFields())-1, origVertices_pc->getCurrentDisplayedScalarFieldIndex()));
-                                    else
-                                        croppedVertices->setCurrentDisplayedScalarField(0);
-                                }
-                                bool importSFs = !importedSFs.empty();
+    return true;
+}
 
-                                if (importColors || importSFs)
-                                {
-                                    //for each new triangle
-                                    for (unsigned i = 0; i < croppedMesh->size(); ++i)
-                                    {
-                                        //get the origin triangle
-                                        unsigned origTriIndex = origTriIndexes[i];
-                                        const CCCoreLib::VerticesIndexes* tsio = mesh->getTriangleVertIndexes(origTriIndex);
+int ExtractConnectedComponentsClouds(ccPointCloud* cloud,
+                                     unsigned char octreeLevel,
+                                     unsigned minComponentSize,
+                                     unsigned maxNumberComponents,
+                                     bool randomColors,
+                                     std::vector<ccPointCloud*>& components,
+                                     ccPointCloud*& residual)
+{
+    CCTRACE("ExtractConnectedComponentsClouds");
+    components.clear();
+    residual = nullptr;
+    if (!cloud || cloud->size() == 0)
+    {
+        return -1;
+    }
 
-                                        //get the new triangle
-                                        const CCCoreLib::VerticesIndexes* tsic = croppedMesh->getTriangleVertIndexes(i);
+    ccOctree::Shared octree = cloud->getOctree();
+    if (!octree)
+    {
+        octree = cloud->computeOctree(nullptr);
+        if (!octree)
+        {
+            CCTRACE("Couldn't compute octree for cloud " << cloud->getName().toStdString());
+            return -1;
+        }
+    }
+    unsigned char level = std::max(static_cast<unsigned char>(1), std::min(octreeLevel, static_cast<unsigned char>(CCCoreLib::DgmOctree::MAX_OCTREE_LEVEL)));
 
-                                        //we now have to test the 3 vertices of the new triangle
-                                        for (unsigned j = 0; j < 3; ++j)
-                                        {
-                                            unsigned vertIndex = tsic->i[j];
+    //non empty cells (sorted by code)
+    std::vector<CCCoreLib::DgmOctree::IndexAndCode> cells;
+    ConcurrentUnionFind_ cellSets;
+    if (!octree->getCellCodesAndIndexes(level, cells, true) || cells.empty() || !cellSets.init(static_cast<unsigned>(cells.size())))
+    {
+        CCTRACE("Not enough memory!");
+        return -1;
+    }
+    unsigned cellCount = static_cast<unsigned>(cells.size());
 
-                                            if (vertProcessed[vertIndex])
-                                            {
-                                                //vertex has already been process
-                                                continue;
-                                            }
+    //union of the neighbour cells (26-connexity: we only look at the 13 'forward' neighbours)
+    const int cellsPerDim = (1 << level);
+    auto connectCell = [&](unsigned c)
+    {
+        Tuple3i pos;
+        octree->getCellPos(cells[c].theCode, level, pos, true);
+        for (int dz = 0; dz <= 1; ++dz)
+            for (int dy = (dz ? -1 : 0); dy <= 1; ++dy)
+                for (int dx = (dz || dy ? -1 : 1); dx <= 1; ++dx)
+                {
+                    Tuple3i neighbourPos(pos.x + dx, pos.y + dy, pos.z + dz);
+                    if (    neighbourPos.x < 0 || neighbourPos.x >= cellsPerDim
+                        ||  neighbourPos.y < 0 || neighbourPos.y >= cellsPerDim
+                        ||  neighbourPos.z >= cellsPerDim)
+                    {
+                        continue;
+                    }
+                    CCCoreLib::DgmOctree::CellCode neighbourCode = CCCoreLib::DgmOctree::GenerateTruncatedCellCode(neighbourPos, level);
+                    auto it = std::lower_bound(cells.begin(), cells.end(), neighbourCode,
+                                               [](const CCCoreLib::DgmOctree::IndexAndCode& cell, CCCoreLib::DgmOctree::CellCode code) { return cell.theCode < code; });
+                    if (it != cells.end() && it->theCode == neighbourCode)
+                    {
+                        cellSets.unite(c, static_cast<unsigned>(it - cells.begin()));
+                    }
+                }
+    };
 
-                                            const CCVector3* Vcj = croppedVertices->getPoint(vertIndex);
+#ifdef CC_CORE_LIB_USES_TBB
+    tbb::parallel_for(static_cast<unsigned>(0), cellCount, connectCell);
+#else
+    for (unsigned c = 0; c < cellCount; ++c)
+    {
+        connectCell(c);
+    }
+#endif
 
-                                            //we'll deduce its color and SFs values by triangulation
-                                            if (importColors)
-                                            {
-                                                ccColor::Rgb col;
-                                                if (mesh->interpolateColors(origTriIndex, *Vcj, col))
-                                                {
-                                                    croppedVertices->setPointColor(vertIndex, col);
-                                                }
-                                            }
+    //components sizes (the components are numbered by their first cell)
+    const CCCoreLib::DgmOctree::cellsContainer& pointsAndCodes = octree->pointsAndTheirCellCodes();
+    unsigned projectedCount = static_cast<unsigned>(pointsAndCodes.size());
+    std::vector<unsigned> cellComponents(cellCount);
+    std::vector<unsigned> componentSizes;
+    for (unsigned c = 0; c < cellCount; ++c)
+    {
+        unsigned root = cellSets.find(c);
+        if (root == c)
+        {
+            cellComponents[c] = static_cast<unsigned>(componentSizes.size());
+            componentSizes.push_back(0);
+        }
+        else
+        {
+            cellComponents[c] = cellComponents[root]; //root < c
+        }
+        unsigned cellEnd = (c + 1 < cellCount ? cells[c + 1].theIndex : projectedCount);
+        componentSizes[cellComponents[c]] += cellEnd - cells[c].theIndex;
+    }
 
-                                            if (importSFs)
-                                            {
-                                                CCVector3d w;
-                                                mesh->computeInterpolationWeights(origTriIndex, *Vcj, w);
+    //we filter the components before creating anything
+    std::vector<unsigned> keptComponents;
+    for (unsigned i = 0; i < componentSizes.size(); ++i)
+    {
+        if (componentSizes[i] >= minComponentSize)
+        {
+            keptComponents.push_back(i);
+        }
+    }
+    CCTRACE("total components: " << componentSizes.size() << " with " << keptComponents.size() << " components of size >= " << minComponentSize);
+    if (keptComponents.size() > maxNumberComponents)
+    {
+        CCTRACE("Too many components: " << keptComponents.size() << " for a maximum of: " << maxNumberComponents);
+        return static_cast<int>(keptComponents.size());
+    }
+    std::stable_sort(keptComponents.begin(), keptComponents.end(), [&](unsigned a, unsigned b) { return componentSizes[a] > componentSizes[b]; });
 
-                                                //import SFs
-                                                for (unsigned s = 0; s < static_cast<unsigned>(importedSFs.size()); ++s)
-                                                {
-                                                    CCVector3d scalarValues(0, 0, 0);
-                                                    if (origVertices_pc)
-                                                    {
-                                                        const CCCoreLib::ScalarField* sf = origVertices_pc->getScalarField(s);
-                                                        scalarValues.x = sf->getValue(tsio->i1);
-                                                        scalarValues.y = sf->getValue(tsio->i2);
-                                                        scalarValues.z = sf->getValue(tsio->i3);
-                                                    }
-                                                    else
-                                                    {
-                                                        assert(s == 0);
-                                                        scalarValues.x = origVertices->getPointScalarValue(tsio->i1);
-                                                        scalarValues.y = origVertices->getPointScalarValue(tsio->i2);
-                                                        scalarValues.z = origVertices->getPointScalarValue(tsio->i3);
-                                                    }
+    //output rank of each component (the small ones go to the residual cloud)
+    const unsigned keptCount = static_cast<unsigned>(keptComponents.size());
+    std::vector<unsigned> componentRanks(componentSizes.size(), keptCount);
+    for (unsigned r = 0; r < keptCount; ++r)
+    {
+        componentRanks[keptComponents[r]] = r;
+    }
 
-                                                    ScalarType sVal = static_cast<ScalarType>(scalarValues.dot(w));
-                                                    importedSFs[s]->setValue(vertIndex,sVal);
-                                                }
-                                            }
+    //sort the points by output cloud (they keep their original order)
+    unsigned pointCount = cloud->size();
+    std::vector<int> pointRanks;
+    try
+    {
+        pointRanks.resize(pointCount, -1);
+    }
+    catch (const std::bad_alloc&)
+    {
+        CCTRACE("Not enough memory!");
+        return -1;
+    }
+    auto rankCellPoints = [&](unsigned c)
+    {
+        int rank = static_cast<int>(componentRanks[cellComponents[c]]);
+        unsigned cellEnd = (c + 1 < cellCount ? cells[c + 1].theIndex : projectedCount);
+        for (unsigned k = cells[c].theIndex; k < cellEnd; ++k)
+        {
+            pointRanks[pointsAndCodes[k].theIndex] = rank;
+        }
+    };
+#ifdef CC_CORE_LIB_USES_TBB
+    tbb::parallel_for(static_cast<unsigned>(0), cellCount, rankCellPoints);
+#else
+    for (unsigned c = 0; c < cellCount; ++c)
+    {
+        rankCellPoints(c);
+    }
+#endif
 
-                                            //update 'processed' flag
-                                            vertProcessed[vertIndex] = true;
-                                        }
-                                    }
+    std::vector<unsigned> rankStarts;
+    std::vector<unsigned> sortedIndexes;
+    if (!SortPointsByCell_(pointCount, keptCount + 1, [&](unsigned i) { return pointRanks[i]; }, rankStarts, sortedIndexes))
+    {
+        return -1;
+    }
+    pointRanks.clear();
+    pointRanks.shrink_to_fit();
 
-                                    for (size_t s = 0; s < importedSFs.size(); ++s)
-                                    {
-                                        importedSFs[s]->computeMinAndMax();
-                                    }
+    //selections (their sizes are known in advance)
+    std::vector<CCCoreLib::ReferenceCloud*> selections(keptCount + 1, nullptr);
+    std::vector<char> selectionFailed(keptCount + 1, 0);
+    auto fillSelection = [&](unsigned r)
+    {
+        if (rankStarts[r] == rankStarts[r + 1])
+        {
+            return;
+        }
+        CCCoreLib::ReferenceCloud* selection = new CCCoreLib::ReferenceCloud(cloud);
+        if (!selection->reserve(rankStarts[r + 1] - rankStarts[r]))
+        {
+            delete selection;
+            selectionFailed[r] = 1;
+            return;
+        }
+        for (unsigned k = rankStarts[r]; k < rankStarts[r + 1]; ++k)
+        {
+            selection->addPointIndex(sortedIndexes[k]);
+        }
+        selections[r] = selection;
+    };
+#ifdef CC_CORE_LIB_USES_TBB
+    tbb::parallel_for(static_cast<unsigned>(0), keptCount + 1, fillSelection);
+#else
+    for (unsigned r = 0; r <= keptCount; ++r)
+    {
+        fillSelection(r);
+    }
+#endif
+    sortedIndexes.clear();
+    sortedIndexes.shrink_to_fit();
 
-                                    croppedVertices->showColors(importColors && origVertices->colorsShown());
-                                    croppedVertices->showSF(importSFs && origVertices->sfShown());
-                                    croppedMesh->showColors(importColors && mesh->colorsShown());
-                                    croppedMesh->showSF(importSFs && mesh->sfShown());
-                                }
-                            }
+    bool error = (std::find(selectionFailed.begin(), selectionFailed.end(), 1) != selectionFailed.end());
+    if (error)
+    {
+        CCTRACE("Not enough memory!");
+    }
 
-                            //per-triangle features (materials)
-                            if (mesh->hasMaterials())
-                            {
-                                const ccMaterialSet* origMaterialSet = mesh->getMaterialSet();
-                                assert(origMaterialSet);
+    //finally create the clouds (sequentially, as it involves CC entities)
+    for (unsigned r = 0; r <= keptCount; ++r)
+    {
+        if (!selections[r])
+        {
+            continue;
+        }
+        if (!error)
+        {
+            ccPointCloud* compCloud = cloud->partialClone(selections[r]);
+            if (!compCloud)
+            {
+                CCTRACE("Failed to create component " << r << " (not enough memory)");
+            }
+            else if (r == keptCount)
+            {
+                residual = compCloud;
+            }
+            else
+            {
+                //shall we colorize it with random color?
+                if (randomColors)
+                {
+                    ccColor::Rgb col = ccColor::Generator::Random();
+                    compCloud->setColor(col);
+                }
+                compCloud->copyGlobalShiftAndScale(*cloud);
+                compCloud->setName(QString("CC#%1").arg(components.size()));
+                components.push_back(compCloud);
+            }
+        }
+        delete selections[r];
+        selections[r] = nullptr;
+    }
+    if (error)
+    {
+        return -1;
+    }
 
-                                if (origMaterialSet && !origMaterialSet->empty() && croppedMesh->reservePerTriangleMtlIndexes())
-                                {
-                                    std::vector<int> materialUsed(origMaterialSet->size(),-1);
+    CCTRACE(components.size() << " component(s) were created from cloud " << cloud->getName().toStdString());
+    return static_cast<int>(keptCount);
+}
 
-                                    //per-triangle materials
-                                    for (unsigned i = 0; i < croppedMesh->size(); ++i)
-                                    {
-                                        //get the origin triangle
-                                        unsigned origTriIndex = origTriIndexes[i];
-                                        int mtlIndex = mesh->getTriangleMtlIndex(origTriIndex);
-                                        croppedMesh->addTriangleMtlIndex(mtlIndex);
+bool InterpolateScalarFieldsFromCloud(ccPointCloud* destCloud,
+                                      ccPointCloud* srcCloud,
+                                      const std::vector<int>& sfIndexes,
+                                      const ccPointCloudInterpolator::Parameters& params,
+                                      unsigned char octreeLevel,
+                                      bool interpolateColors,
+                                      int maxThreadCount)
+{
+    CCTRACE("InterpolateScalarFieldsFromCloud");
+    if (!destCloud || !srcCloud || srcCloud->size() == 0 || (sfIndexes.empty() && !interpolateColors))
+    {
+        ccLog::Error("[InterpolateScalarFieldsFrom] Invalid input");
+        return false;
+    }
+    interpolateColors = interpolateColors && srcCloud->hasColors();
+    using Parameters = ccPointCloudInterpolator::Parameters;
+    if (    (params.method == Parameters::K_NEAREST_NEIGHBORS && params.knn == 0)
+        ||  (params.method == Parameters::RADIUS && params.radius <= 0)
+        ||  (params.algo == Parameters::NORMAL_DIST && params.sigma <= 0))
+    {
+        ccLog::Error("[InterpolateScalarFieldsFrom] Invalid parameters");
+        return false;
+    }
 
-                                        if (mtlIndex >= 0)
-                                            materialUsed[mtlIndex] = 1;
-                                    }
+    //source octree
+    ccOctree::Shared octree = srcCloud->getOctree();
+    if (!octree)
+    {
+        octree = srcCloud->computeOctree(nullptr);
+        if (!octree)
+        {
+            ccLog::Error("[InterpolateScalarFieldsFrom] Failed to compute the octree");
+            return false;
+        }
+    }
+    if (octreeLevel == 0 || octreeLevel > CCCoreLib::DgmOctree::MAX_OCTREE_LEVEL)
+    {
+        if (params.method == Parameters::RADIUS)
+            octreeLevel = octree->findBestLevelForAGivenNeighbourhoodSizeExtraction(params.radius);
+        else
+            octreeLevel = octree->findBestLevelForAGivenPopulationPerCell(std::max(params.knn, 3u));
+    }
 
-                                    //import materials
-                                    {
-                                        size_t materialUsedCount = 0;
-                                        {
-                                            for (size_t i = 0; i < materialUsed.size(); ++i)
-                                                if (materialUsed[i] == 1)
-                                                    ++materialUsedCount;
-                                        }
+    //destination scalar fields (same names) and colors, created in the main thread
+    std::vector<CCCoreLib::ScalarField*> srcSFs;
+    std::vector<CCCoreLib::ScalarField*> destSFs;
+    for (int sfIndex : sfIndexes)
+    {
+        CCCoreLib::ScalarField* srcSF = (sfIndex >= 0 ? srcCloud->getScalarField(sfIndex) : nullptr);
+        if (!srcSF)
+        {
+            ccLog::Error("[InterpolateScalarFieldsFrom] Invalid scalar field index: %i", sfIndex);
+            return false;
+        }
+        int destIndex = destCloud->getScalarFieldIndexByName(srcSF->getName());
+        if (destIndex < 0)
+            destIndex = destCloud->addScalarField(srcSF->getName());
+        if (destIndex < 0)
+        {
+            ccLog::Error("[InterpolateScalarFieldsFrom] Not enough memory!");
+            return false;
+        }
+        srcSFs.push_back(srcSF);
+        destSFs.push_back(destCloud->getScalarField(destIndex));
+    }
+    if (interpolateColors && !destCloud->hasColors() && !destCloud->resizeTheRGBTable(false))
+    {
+        ccLog::Error("[InterpolateScalarFieldsFrom] Not enough memory!");
+        return false;
+    }
 
-                                        if (materialUsedCount == materialUsed.size())
-                                        {
-                                            //nothing to do, we use all input materials
-                                            croppedMesh->setMaterialSet(origMaterialSet->clone());
-                                        }
-                                        else
-                                        {
-                                            //create a subset of the input materials
-                                            ccMaterialSet* matSet = new ccMaterialSet(origMaterialSet->getName());
-                                            {
-                                                matSet->reserve(materialUsedCount);
-                                                for (size_t i = 0; i < materialUsed.size(); ++i)
-                                                {
-                                                    if (materialUsed[i] >= 0)
-                                                    {
-                                                        matSet->push_back(ccMaterial::Shared(new ccMaterial(*origMaterialSet->at(i))));
-                                                        //update index
-                                                        materialUsed[i] = static_cast<int>(matSet->size()) - 1;
-                                                    }
-                                                }
-                                            }
-                                            croppedMesh->setMaterialSet(matSet);
+    //one neighbourhood search per destination point, for all the scalar fields and the colors
+    const unsigned pointCount = destCloud->size();
+    const size_t fieldCount = srcSFs.size();
+    const double twoSigma2 = 2.0 * params.sigma * params.sigma;
+    auto interpolatePoints = [&](unsigned first, unsigned last)
+    {
+        CCCoreLib::ReferenceCloud Yk(srcCloud);
+        CCCoreLib::DgmOctree::NeighboursSet neighbours;
+        std::vector<unsigned> indexes;
+        std::vector<double> weights;
+        std::vector<ScalarType> values;
+        for (unsigned i = first; i < last; ++i)
+        {
+            const CCVector3* P = destCloud->getPoint(i);
+            indexes.clear();
+            weights.clear();
+            if (params.method == Parameters::RADIUS)
+            {
+                neighbours.clear();
+                octree->getPointsInSphericalNeighbourhood(*P, static_cast<PointCoordinateType>(params.radius), neighbours, octreeLevel);
+                for (const CCCoreLib::DgmOctree::PointDescriptor& N : neighbours)
+                {
+                    indexes.push_back(N.pointIndex);
+                    weights.push_back(params.algo == Parameters::NORMAL_DIST ? std::exp(-N.squareDistd / twoSigma2) : 1.0);
+                }
+            }
+            else
+            {
+                double maxSquareDist = 0;
+                Yk.clear();
+                unsigned k = (params.method == Parameters::NEAREST_NEIGHBOR ? 1 : params.knn);
+                unsigned found = octree->findPointNeighbourhood(P, &Yk, k, octreeLevel, maxSquareDist);
+                for (unsigned n = 0; n < found; ++n)
+                {
+                    indexes.push_back(Yk.getPointGlobalIndex(n));
+                    weights.push_back(params.algo == Parameters::NORMAL_DIST ? std::exp(-(*Yk.getPoint(n) - *P).norm2d() / twoSigma2) : 1.0);
+                }
+            }
 
-                                            //and update the materials indexes!
-                                            for (unsigned i = 0; i < croppedMesh->size(); ++i)
-                                            {
-                                                int mtlIndex = croppedMesh->getTriangleMtlIndex(i);
-                                                if (mtlIndex >= 0)
-                                                {
-                                                    assert(mtlIndex < static_cast<int>(materialUsed.size()));
-                                                    croppedMesh->setTriangleMtlIndex(i,materialUsed[mtlIndex]);
-                                                }
-                                            }
-                                        }
-                                    }
+            //interpolation of a value from the neighbours (NaN values are ignored)
+            auto interpolate = [&](const std::function<ScalarType(unsigned)>& valueOf)
+            {
+                if (params.algo == Parameters::MEDIAN)
+                {
+                    values.clear();
+                    for (unsigned index : indexes)
+                    {
+                        ScalarType v = valueOf(index);
+                        if (CCCoreLib::ScalarField::ValidValue(v))
+                            values.push_back(v);
+                    }
+                    if (values.empty())
+                        return CCCoreLib::NAN_VALUE;
+                    size_t half = values.size() / 2;
+                    std::nth_element(values.begin(), values.begin() + half, values.end());
+                    return values[half];
+                }
+                double sum = 0;
+                double sumWeights = 0;
+                for (size_t n = 0; n < indexes.size(); ++n)
+                {
+                    ScalarType v = valueOf(indexes[n]);
+                    if (CCCoreLib::ScalarField::ValidValue(v))
+                    {
+                        sum += weights[n] * v;
+                        sumWeights += weights[n];
+                    }
+                }
+                return (sumWeights > 0 ? static_cast<ScalarType>(sum / sumWeights) : CCCoreLib::NAN_VALUE);
+            };
 
-                                    croppedMesh->showMaterials(mesh->materialsShown());
-                                }
-                                else
-                                {
-                                    ccLog::Warning("[Crop] Failed to transfer materials on the output mesh (not enough memory)");
-                                }
+            for (size_t f = 0; f < fieldCount; ++f)
+            {
+                const CCCoreLib::ScalarField* srcSF = srcSFs[f];
+                destSFs[f]->setValue(i, interpolate([srcSF](unsigned index) { return srcSF->getValue(index); }));
+            }
+            if (interpolateColors && !indexes.empty())
+            {
+                ccColor::Rgba C = destCloud->getPointColor(i);
+                for (unsigned c = 0; c < 3; ++c)
+                {
+                    ScalarType v = interpolate([srcCloud, c](unsigned index) { return static_cast<ScalarType>(srcCloud->getPointColor(index).rgba[c]); });
+                    if (CCCoreLib::ScalarField::ValidValue(v))
+                        C.rgba[c] = static_cast<ColorCompType>(std::max(0.0f, std::min(255.0f, static_cast<float>(v) + 0.5f)));
+                }
+                destCloud->rgbaColors()->data()[i] = C;
+            }
+        }
+    };
 
-                                //per-triangle texture coordinates
-                                if (mesh->hasPerTriangleTexCoordIndexes())
-                                {
-                                    TextureCoordsContainer* texCoords = new TextureCoordsContainer;
-                                    if (    croppedMesh->reservePerTriangleTexCoordIndexes()
-                                        &&  texCoords->reserveSafe(croppedMesh->size()*3))
-                                    {
-                                        //for each new triangle
-                                        for (unsigned i = 0; i < croppedMesh->size(); ++i)
-                                        {
-                                            //get the origin triangle
-                                            unsigned origTriIndex = origTriIndexes[i];
-                                            TexCoords2D* tx1 = nullptr;
-                                            TexCoords2D* tx2 = nullptr;
-                                            TexCoords2D* tx3 = nullptr;
-                                            mesh->getTriangleTexCoordinates(origTriIndex, tx1, tx2, tx3);
+#ifdef CC_CORE_LIB_USES_TBB
+    unsigned threadCount = (maxThreadCount > 0 ? static_cast<unsigned>(maxThreadCount) : static_cast<unsigned>(std::max(QThread::idealThreadCount(), 1)));
+    unsigned chunkCount = std::min(threadCount * 8, std::max(pointCount / 256, 1u));
+    unsigned chunkSize = (pointCount + chunkCount - 1) / chunkCount;
+    tbb::task_arena arena(static_cast<int>(threadCount));
+    arena.execute([&]()
+    {
+        tbb::parallel_for(static_cast<unsigned>(0), chunkCount, [&](unsigned c)
+        {
+            interpolatePoints(c * chunkSize, std::min(pointCount, (c + 1) * chunkSize));
+        });
+    });
+#else
+    interpolatePoints(0, pointCount);
+#endif
 
-                                            //get the new triangle
-                                            const CCCoreLib::VerticesIndexes* tsic = croppedMesh->getTriangleVertIndexes(i);
+    for (CCCoreLib::ScalarField* sf : destSFs)
+        sf->computeMinAndMax();
+    if (interpolateColors)
+        destCloud->colorsHaveChanged();
 
-                                            //for each vertex of the new triangle
-                                            int texIndexes[3] = { -1, -1, -1 };
-                                            for (unsigned j = 0; j < 3; ++j)
-                                            {
-                                                unsigned vertIndex = tsic->i[j];
-                                                const CCVector3* Vcj = croppedVertices->getPoint(vertIndex);
+    return true;
+}
 
-                                                //intepolation weights
-                                                CCVector3d w;
-                                                mesh->computeInterpolationWeights(origTriIndex, *Vcj, w);
+bool InterpolateScalarFieldsFromCloudMulti(const std::vector<ccPointCloud*>& destClouds,
+                                           ccPointCloud* srcCloud,
+                                           const std::vector<int>& sfIndexes,
+                                           const ccPointCloudInterpolator::Parameters& params,
+                                           unsigned char octreeLevel,
+                                           bool interpolateColors,
+                                           int maxThreadCount)
+{
+    //the source octree is computed once, then the destination points of each cloud are processed in parallel
+    bool success = !destClouds.empty();
+    for (ccPointCloud* destCloud : destClouds)
+    {
+        success = InterpolateScalarFieldsFromCloud(destCloud, srcCloud, sfIndexes, params, octreeLevel, interpolateColors, maxThreadCount) && success;
+    }
+    return success;
+}
 
-                                                if (    (tx1 || CCCoreLib::LessThanEpsilon( w.u[0] ) )
-                                                    &&  (tx2 || CCCoreLib::LessThanEpsilon( w.u[1] ) )
-                                                    &&  (tx3 || CCCoreLib::LessThanEpsilon( w.u[2] ) ) )
-                                                {
-                                                    TexCoords2D t(  static_cast<float>((tx1 ? tx1->tx*w.u[0] : 0.0) + (tx2 ? tx2->tx*w.u[1] : 0.0) + (tx3 ? tx3->tx*w.u[2] : 0.0)),
-                                                                    static_cast<float>((tx1 ? tx1->ty*w.u[0] : 0.0) + (tx2 ? tx2->ty*w.u[1] : 0.0) + (tx3 ? tx3->ty*w.u[2] : 0.0)) );
+//! Whether a cloud must be merged with ccPointCloud::append, because it has data the parallel copy doesn't handle
+/** (sensors, scan grids, full waveform data, or a different global shift / scale)
+**/
+static bool NeedsGenericAppend_(const ccPointCloud* destCloud, const ccPointCloud* pc)
+{
+    if (destCloud->hasFWF() || pc->hasFWF() || pc->gridCount() != 0)
+    {
+        return true;
+    }
+    if (pc->getGlobalShift() != destCloud->getGlobalShift() || pc->getGlobalScale() != destCloud->getGlobalScale())
+    {
+        return true;
+    }
+    for (unsigned c = 0; c < pc->getChildrenNumber(); ++c)
+    {
+        if (pc->getChild(c)->isKindOf(CC_TYPES::SENSOR))
+        {
+            return true;
+        }
+    }
+    return false;
+}
 
-                                                    texCoords->addElement(t);
-                                                    texIndexes[j] = static_cast<int>(texCoords->currentSize()) - 1;
-                                                }
-                                            }
+//! Appends clouds without sensors, grids, waveforms nor global shift conflict: single allocation, parallel copy
+/** The 'original cloud index' scalar field (if required) must already exist, the values of the appended points
+    are firstCloudIndex, firstCloudIndex + 1...
+**/
+static bool MergeCloudsFast_(ccPointCloud* destCloud, const std::vector<ccPointCloud*>& clouds, unsigned firstCloudIndex, bool createSFcloudIndex)
+{
+    //offsets and total size
+    const unsigned countBefore = destCloud->size();
+    std::vector<unsigned> offsets(clouds.size() + 1, countBefore);
+    bool needColors = destCloud->hasColors();
+    bool needNormals = destCloud->hasNormals();
+    for (size_t k = 0; k < clouds.size(); ++k)
+    {
+        uint64_t total = static_cast<uint64_t>(offsets[k]) + clouds[k]->size();
+        if (total > std::numeric_limits<unsigned>::max())
+        {
+            CCTRACE("Too many points!");
+            return false;
+        }
+        offsets[k + 1] = static_cast<unsigned>(total);
+        needColors |= clouds[k]->hasColors();
+        needNormals |= clouds[k]->hasNormals();
+    }
+    const unsigned totalCount = offsets.back();
 
-                                            croppedMesh->addTriangleTexCoordIndexes(texIndexes[0], texIndexes[1], texIndexes[2]);
-                                        }
-                                        croppedMesh->setTexCoordinatesTable(texCoords);
-                                    }
-                                    else
-                                    {
-                                        ccLog::Warning("[Crop] Failed to transfer texture coordinates on the output mesh (not enough memory)");
-                                        delete texCoords;
-                                        texCoords = nullptr;
-                                    }
-                                }
-                            }
-                        }
-                        catch (const std::bad_alloc&)
-                        {
-                            ccLog::Warning("[Crop] Failed to transfer per-vertex features (color, SF values, etc.) on the output mesh (not enough memory)");
-                            croppedVertices->unallocateColors();
-                            croppedVertices->deleteAllScalarFields();
-                        }
-                    }
-                }
-            }
-            else
+    //union of the scalar fields (by name)
+    const unsigned sfCountBefore = destCloud->getNumberOfScalarFields();
+    std::vector<std::string> sfNames;
+    for (unsigned s = 0; s < sfCountBefore; ++s)
+    {
+        sfNames.push_back(destCloud->getScalarFieldName(s));
+    }
+    for (ccPointCloud* pc : clouds)
+    {
+        for (unsigned s = 0; s < pc->getNumberOfScalarFields(); ++s)
+        {
+            std::string name = pc->getScalarFieldName(s);
+            if (std::find(sfNames.begin(), sfNames.end(), name) == sfNames.end())
             {
-                ccLog::Warning("[Crop] Failed to create output mesh vertices (not enough memory)");
+                sfNames.push_back(name);
             }
         }
+    }
+    if (createSFcloudIndex && std::find(sfNames.begin(), sfNames.end(), std::string(CC_ORIGINAL_CLOUD_INDEX_SF_NAME)) == sfNames.end())
+    {
+        sfNames.push_back(CC_ORIGINAL_CLOUD_INDEX_SF_NAME);
+    }
 
-        //clean memory
-        if (params.insideMesh)
+    //every buffer is allocated once
+    const bool hadColors = destCloud->hasColors();
+    const bool hadNormals = destCloud->hasNormals();
+    bool success = destCloud->resize(totalCount);
+    if (success && needColors && !hadColors)
+    {
+        success = destCloud->resizeTheRGBTable(true);
+    }
+    if (success && needNormals && !hadNormals)
+    {
+        success = destCloud->resizeTheNormsTable();
+    }
+    for (size_t s = sfCountBefore; s < sfNames.size() && success; ++s)
+    {
+        int sfIdx = destCloud->addScalarField(sfNames[s].c_str());
+        if (sfIdx < 0)
         {
-            delete params.insideMesh;
-            params.insideMesh = nullptr;
+            success = false;
         }
-        if (params.outsideMesh)
+        else
         {
-            delete params.outsideMesh;
-            params.outsideMesh = nullptr;
+            //the new fields are not defined on the former points
+            CCCoreLib::ScalarField* sf = destCloud->getScalarField(sfIdx);
+            std::fill(sf->begin(), sf->begin() + countBefore, CCCoreLib::NAN_VALUE);
         }
-
-        if (croppedMesh)
+    }
+    if (!success)
+    {
+        CCTRACE("Not enough memory!");
+        while (destCloud->getNumberOfScalarFields() > sfCountBefore)
         {
-            croppedMesh->setDisplay_recursive(entity->getDisplay());
+            destCloud->deleteScalarField(static_cast<int>(destCloud->getNumberOfScalarFields()) - 1);
         }
-        return croppedMesh;
+        if (!hadColors)
+            destCloud->unallocateColors();
+        if (!hadNormals)
+            destCloud->unallocateNorms();
+        destCloud->resize(countBefore);
+        return false;
     }
 
-    //unhandled entity
-    ccLog::Warning("[Crop] Unhandled entity type");
-    return nullptr;
-}
+    //destination buffers
+    CCVector3* destPoints = (totalCount ? const_cast<CCVector3*>(destCloud->getPoint(0)) : nullptr);
+    ccColor::Rgba* destColors = needColors ? destCloud->rgbaColors()->data() : nullptr;
+    CompressedNormType* destNormals = needNormals ? destCloud->normals()->data() : nullptr;
+    std::vector<CCCoreLib::ScalarField*> destSFs(sfNames.size());
+    for (size_t s = 0; s < sfNames.size(); ++s)
+    {
+        destSFs[s] = destCloud->getScalarField(destCloud->getScalarFieldIndexByName(sfNames[s].c_str()));
+    }
+    CCCoreLib::ScalarField* ocIndexSF = nullptr;
+    if (createSFcloudIndex)
+    {
+        ocIndexSF = destCloud->getScalarField(destCloud->getScalarFieldIndexByName(CC_ORIGINAL_CLOUD_INDEX_SF_NAME));
+    }
+
+    //source scalar fields matching the destination ones (nullptr if the source doesn't have it)
+    std::vector< std::vector<const CCCoreLib::ScalarField*> > sourceSFs(clouds.size(), std::vector<const CCCoreLib::ScalarField*>(sfNames.size(), nullptr));
+    for (size_t k = 0; k < clouds.size(); ++k)
+    {
+        for (size_t s = 0; s < sfNames.size(); ++s)
+        {
+            int sfIdx = clouds[k]->getScalarFieldIndexByName(sfNames[s].c_str());
+            if (sfIdx >= 0)
+            {
+                sourceSFs[k][s] = clouds[k]->getScalarField(sfIdx);
+            }
+        }
+    }
 
-//! see ccClippingBoxTool.cpp
-ccHObject* GetSlice_(ccHObject* obj, ccClipBox* clipBox, bool silent)
-{
-    CCTRACE("GetSlice_");
-    assert(clipBox);
-    if (!obj)
+    //blocks of points to copy (several per source, to balance large and small clouds)
+    static const unsigned s_blockSize = 65536;
+    std::vector< std::pair<unsigned, unsigned> > blocks; //(source, first point)
+    for (size_t k = 0; k < clouds.size(); ++k)
     {
-        assert(false);
-        return nullptr;
+        for (unsigned first = 0; first < clouds[k]->size(); first += s_blockSize)
+        {
+            blocks.emplace_back(static_cast<unsigned>(k), first);
+        }
     }
 
-    if (obj->isKindOf(CC_TYPES::POINT_CLOUD))
+    auto copyBlock = [&](size_t b)
     {
-        CCTRACE("cloud");
-        ccGenericPointCloud* inputCloud = ccHObjectCaster::ToGenericPointCloud(obj);
+        const unsigned k = blocks[b].first;
+        const ccPointCloud* pc = clouds[k];
+        const unsigned first = blocks[b].second;
+        const unsigned last = std::min(pc->size(), first + s_blockSize);
+        const unsigned offset = offsets[k];
 
-        ccGenericPointCloud::VisibilityTableType selectionTable;
-        try
+        for (unsigned i = first; i < last; ++i)
         {
-            selectionTable.resize(inputCloud->size());
+            destPoints[offset + i] = *pc->getPoint(i);
         }
-        catch (const std::bad_alloc&)
+        if (destColors)
         {
-            CCTRACE("Not enough memory!");
-            return nullptr;
+            for (unsigned i = first; i < last; ++i)
+            {
+                destColors[offset + i] = (pc->hasColors() ? pc->getPointColor(i) : ccColor::white);
+            }
         }
-        clipBox->flagPointsInside(inputCloud, &selectionTable);
-
-        ccGenericPointCloud* sliceCloud = inputCloud->createNewCloudFromVisibilitySelection(false, &selectionTable, nullptr, true);
-        if (!sliceCloud)
+        if (destNormals)
         {
-            CCTRACE("Not enough memory!");
+            for (unsigned i = first; i < last; ++i)
+            {
+                destNormals[offset + i] = (pc->hasNormals() ? pc->getPointNormalIndex(i) : 0);
+            }
         }
-        else if (sliceCloud->size() == 0)
+        for (size_t s = 0; s < destSFs.size(); ++s)
         {
-            CCTRACE("empty slice!");
-            delete sliceCloud;
-            sliceCloud = nullptr;
+            CCCoreLib::ScalarField* destSF = destSFs[s];
+            if (destSF == ocIndexSF)
+            {
+                continue;
+            }
+            const CCCoreLib::ScalarField* sourceSF = sourceSFs[k][s];
+            for (unsigned i = first; i < last; ++i)
+            {
+                (*destSF)[offset + i] = (sourceSF ? (*sourceSF)[i] : CCCoreLib::NAN_VALUE);
+            }
         }
-        return sliceCloud;
-    }
-    else if (obj->isKindOf(CC_TYPES::MESH))
-    {
-        CCTRACE("mesh");
-        const ccGLMatrix* _transformation = nullptr;
-        ccGLMatrix transformation;
-        if (clipBox->isGLTransEnabled())
+        if (ocIndexSF)
         {
-            transformation = clipBox->getGLTransformation().inverse();
-            _transformation = &transformation;
+            std::fill(ocIndexSF->begin() + offset + first, ocIndexSF->begin() + offset + last, static_cast<ScalarType>(firstCloudIndex + k));
         }
+    };
 
-        const ccBBox& cropBox = clipBox->getBox();
-        ccHObject* mesh = Crop_(obj, cropBox, true, _transformation);
-        if (!mesh)
-        {
-            CCTRACE("Failed to segment the mesh!");
-            return nullptr;
-        }
-        return mesh;
+#ifdef CC_CORE_LIB_USES_TBB
+    tbb::parallel_for(static_cast<size_t>(0), blocks.size(), copyBlock);
+#else
+    for (size_t b = 0; b < blocks.size(); ++b)
+    {
+        copyBlock(b);
     }
-    CCTRACE("neither cloud nor mesh?");
-    return nullptr;
+#endif
+
+    //merge display parameters
+    for (ccPointCloud* pc : clouds)
+    {
+        destCloud->setVisible(destCloud->isVisible() || pc->isVisible());
+        if (pc->hasColors() && pc->colorsShown())
+            destCloud->showColors(true);
+        if (pc->hasNormals() && pc->normalsShown())
+            destCloud->showNormals(true);
+    }
+
+    for (CCCoreLib::ScalarField* sf : destSFs)
+    {
+        sf->computeMinAndMax();
+    }
+    if (needColors)
+        destCloud->colorsHaveChanged();
+    if (needNormals)
+        destCloud->normalsHaveChanged();
+    destCloud->deleteOctree();
+    destCloud->invalidateBoundingBox();
+
+    return true;
 }
 
-unsigned ComputeGridDimensions_(const ccBBox& localBox,
-                                const bool processDim[3],
-                                int indexMins[3],
-                                int indexMaxs[3],
-                                int gridDim[3],
-                                const CCVector3& gridOrigin,
-                                const CCVector3& cellSizePlusGap)
+bool MergeCloudsInto(ccPointCloud* destCloud, const std::vector<ccPointCloud*>& clouds, bool createSFcloudIndex)
 {
-    CCTRACE("ComputeGridDimensions_");
-    //compute 'grid' extents in the local clipping box ref.
-    for (int i = 0; i < 3; ++i)
+    CCTRACE("MergeCloudsInto " << clouds.size());
+    if (!destCloud)
     {
-        indexMins[i] = 0;
-        indexMaxs[i] = 0;
-        gridDim[i]   = 1;
+        return false;
+    }
+    for (ccPointCloud* pc : clouds)
+    {
+        if (!pc || pc == destCloud)
+        {
+            CCTRACE("Invalid cloud to merge!");
+            return false;
+        }
     }
-    unsigned cellCount = 1;
 
-    for (unsigned char d = 0; d < 3; ++d)
+    int sfIdx = -1;
+    if (createSFcloudIndex)
     {
-        if (processDim[d])
+        sfIdx = destCloud->getScalarFieldIndexByName(CC_ORIGINAL_CLOUD_INDEX_SF_NAME);
+        if (sfIdx < 0)
         {
-            if (CCCoreLib::LessThanEpsilon(cellSizePlusGap.u[d]))
+            sfIdx = destCloud->addScalarField(CC_ORIGINAL_CLOUD_INDEX_SF_NAME);
+        }
+        if (sfIdx < 0)
+        {
+            CCTRACE("Couldn't allocate a new scalar field for storing the original cloud index! Try to free some memory ...");
+            return false;
+        }
+        destCloud->getScalarField(sfIdx)->fill(0);
+    }
+
+    //the consecutive clouds without sensors, grids, waveforms nor global shift conflict are merged in one pass,
+    //the others are appended one by one with ccPointCloud::append, which handles them
+    size_t k = 0;
+    while (k < clouds.size())
+    {
+        if (NeedsGenericAppend_(destCloud, clouds[k]))
+        {
+            unsigned countBefore = destCloud->size();
+            unsigned countAdded = clouds[k]->size();
+            *destCloud += clouds[k];
+            if (destCloud->size() != countBefore + countAdded)
             {
-                CCTRACE("Box size (plus gap) is null! Can't apply repetitive process!");
-                return 0;
+                CCTRACE("Fusion failed! (not enough memory?)");
+                return false;
             }
-
-            PointCoordinateType a = (localBox.minCorner().u[d] - gridOrigin.u[d]) / cellSizePlusGap.u[d]; //don't forget the user defined gap between 'cells'
-            PointCoordinateType b = (localBox.maxCorner().u[d] - gridOrigin.u[d]) / cellSizePlusGap.u[d];
-
-            indexMins[d] = static_cast<int>(floor(a + static_cast<PointCoordinateType>(1.0e-6)));
-            indexMaxs[d] = static_cast<int>(ceil(b - static_cast<PointCoordinateType>(1.0e-6))) - 1;
-
-            assert(indexMaxs[d] >= indexMins[d]);
-            gridDim[d] = std::max(indexMaxs[d] - indexMins[d] + 1, 1);
-            cellCount *= static_cast<unsigned>(gridDim[d]);
+            if (createSFcloudIndex)
+            {
+                sfIdx = destCloud->getScalarFieldIndexByName(CC_ORIGINAL_CLOUD_INDEX_SF_NAME);
+                CCCoreLib::ScalarField* ocIndexSF = destCloud->getScalarField(sfIdx);
+                std::fill(ocIndexSF->begin() + countBefore, ocIndexSF->begin() + countBefore + countAdded, static_cast<ScalarType>(k + 1));
+            }
+            ++k;
+        }
+        else
+        {
+            size_t end = k + 1;
+            while (end < clouds.size() && !NeedsGenericAppend_(destCloud, clouds[end]))
+            {
+                ++end;
+            }
+            std::vector<ccPointCloud*> run(clouds.begin() + k, clouds.begin() + end);
+            if (!MergeCloudsFast_(destCloud, run, static_cast<unsigned>(k + 1), createSFcloudIndex))
+            {
+                return false;
+            }
+            k = end;
         }
     }
 
-    return cellCount;
+    if (createSFcloudIndex)
+    {
+        sfIdx = destCloud->getScalarFieldIndexByName(CC_ORIGINAL_CLOUD_INDEX_SF_NAME);
+        destCloud->getScalarField(sfIdx)->computeMinAndMax();
+        destCloud->setCurrentDisplayedScalarField(sfIdx);
+        destCloud->showSF(true);
+    }
+
+    CCTRACE("  new size: " << destCloud->size());
+    return true;
 }
 
 //! see ccClippingBoxTool::ExtractSlicesAndContours
@@ -4532,7 +8293,8 @@ bool ExtractSlicesAndContoursClone
     bool projectOnBestFitPlane/*=false*/,
     bool visualDebugMode/*=false*/,
     bool generateRandomColors/*=false*/,
-    ccProgressDialog* progressDialog/*=nullptr*/)
+    ccProgressDialog* progressDialog/*=nullptr*/,
+    int maxThreadCount/*=0*/)
 {
     CCTRACE("ExtractSlicesAndContours");
     //check input
@@ -4637,20 +8399,20 @@ bool ExtractSlicesAndContoursClone
                 int gridDim[3]{ 0, 0, 0 };
                 unsigned cellCount = ComputeGridDimensions_(localBox, repeatDimensions, indexMins, indexMaxs,
                                                             gridDim, gridOrigin, cellSizePlusGap);
+                if (cellCount == 0)
+                {
+                    //error message already issued
+                    error = true;
+                }
 
-                //we'll potentially create up to one (ref.) cloud per input loud and per cell
-                std::vector<CCCoreLib::ReferenceCloud*> refClouds;
-                refClouds.resize(cellCount * clouds.size(), nullptr);
-
-                unsigned subCloudsCount = 0;
-
-                //project points into grid
-                for (size_t ci = 0; ci != clouds.size(); ++ci)
+                //project points into grid: the points of each cloud are sorted by cell
+                std::vector< std::vector<unsigned> > cellStarts(clouds.size());
+                std::vector< std::vector<unsigned> > sortedIndexes(clouds.size());
+                for (size_t ci = 0; ci != clouds.size() && !error; ++ci)
                 {
                     ccGenericPointCloud* cloud = clouds[ci];
-                    unsigned pointCount = cloud->size();
 
-                    for (unsigned i = 0; i < pointCount; ++i)
+                    auto cellIndexOf = [&](unsigned i) -> int
                     {
                         CCVector3 P = *cloud->getPoint(i);
                         localTrans.apply(P);
@@ -4674,101 +8436,94 @@ bool ExtractSlicesAndContoursClone
                             &&  (P.z - static_cast<PointCoordinateType>(zi))*cellSizePlusGap.z <= cellSize.z))
                         {
                             int cloudIndex = ((zi - indexMins[2]) * static_cast<int>(gridDim[1]) + (yi - indexMins[1])) * static_cast<int>(gridDim[0]) + (xi - indexMins[0]);
-                            assert(cloudIndex >= 0 && static_cast<size_t>(cloudIndex)* clouds.size() + ci < refClouds.size());
-
-                            CCCoreLib::ReferenceCloud*& destCloud = refClouds[cloudIndex * clouds.size() + ci];
-                            if (!destCloud)
-                            {
-                                destCloud = new CCCoreLib::ReferenceCloud(cloud);
-                                ++subCloudsCount;
-                            }
-
-                            if (!destCloud->addPointIndex(i))
-                            {
-                                CCTRACE("Not enough memory!");
-                                error = true;
-                                break;
-                            }
+                            assert(cloudIndex >= 0 && static_cast<unsigned>(cloudIndex) < cellCount);
+                            return cloudIndex;
                         }
+                        return -1;
+                    };
+
+                    if (!SortPointsByCell_(cloud->size(), cellCount, cellIndexOf, cellStarts[ci], sortedIndexes[ci]))
+                    {
+                        error = true;
                     }
 
                 } //project points into grid
 
-                //reset count
-                subCloudsCount = 0;
-
                 //now create the real clouds
-                for (int i = indexMins[0]; i <= indexMaxs[0]; ++i)
+                for (int i = indexMins[0]; i <= indexMaxs[0] && !error; ++i)
                 {
-                    for (int j = indexMins[1]; j <= indexMaxs[1]; ++j)
+                    for (int j = indexMins[1]; j <= indexMaxs[1] && !error; ++j)
                     {
-                        for (int k = indexMins[2]; k <= indexMaxs[2]; ++k)
+                        for (int k = indexMins[2]; k <= indexMaxs[2] && !error; ++k)
                         {
                             int cloudIndex = ((k - indexMins[2]) * static_cast<int>(gridDim[1]) + (j - indexMins[1])) * static_cast<int>(gridDim[0]) + (i - indexMins[0]);
-                            assert(cloudIndex >= 0 && static_cast<size_t>(cloudIndex)* clouds.size() < refClouds.size());
+                            assert(cloudIndex >= 0 && static_cast<unsigned>(cloudIndex) < cellCount);
 
                             for (size_t ci = 0; ci != clouds.size(); ++ci)
                             {
                                 ccGenericPointCloud* cloud = clouds[ci];
-                                CCCoreLib::ReferenceCloud* destCloud = refClouds[cloudIndex * clouds.size() + ci];
-                                if (destCloud) //some slices can be empty!
+                                unsigned firstPos = cellStarts[ci][cloudIndex];
+                                unsigned lastPos = cellStarts[ci][cloudIndex + 1];
+                                if (firstPos == lastPos) //some slices can be empty!
+                                {
+                                    continue;
+                                }
+
+                                CCCoreLib::ReferenceCloud destCloud(cloud);
+                                if (!destCloud.reserve(lastPos - firstPos))
+                                {
+                                    CCTRACE("Not enough memory!");
+                                    error = true;
+                                    break;
+                                }
+                                for (unsigned pos = firstPos; pos < lastPos; ++pos)
                                 {
-                                    //generate slice from previous selection
-                                    int warnings = 0;
-                                    ccPointCloud* sliceCloud = cloud->isA(CC_TYPES::POINT_CLOUD) ? static_cast<ccPointCloud*>(cloud)->partialClone(destCloud, &warnings) : ccPointCloud::From(destCloud, cloud);
-                                    warningsIssued |= (warnings != 0);
+                                    destCloud.addPointIndex(sortedIndexes[ci][pos]);
+                                }
 
-                                    if (sliceCloud)
+                                //generate slice from previous selection
+                                int warnings = 0;
+                                ccPointCloud* sliceCloud = cloud->isA(CC_TYPES::POINT_CLOUD) ? static_cast<ccPointCloud*>(cloud)->partialClone(&destCloud, &warnings) : ccPointCloud::From(&destCloud, cloud);
+                                warningsIssued |= (warnings != 0);
+
+                                if (sliceCloud)
+                                {
+                                    if (generateRandomColors)
                                     {
-                                        if (generateRandomColors)
+                                        ccColor::Rgb col = ccColor::Generator::Random();
+                                        if (!sliceCloud->setColor(col))
                                         {
-                                            ccColor::Rgb col = ccColor::Generator::Random();
-                                            if (!sliceCloud->setColor(col))
-                                            {
-                                                CCTRACE("Not enough memory!");
-                                                error = true;
-                                                i = indexMaxs[0];
-                                                j = indexMaxs[1];
-                                                k = indexMaxs[2];
-                                            }
-                                            sliceCloud->showColors(true);
+                                            CCTRACE("Not enough memory!");
+                                            error = true;
                                         }
-
-                                        sliceCloud->setEnabled(true);
-                                        sliceCloud->setVisible(true);
-                                        sliceCloud->setDisplay(cloud->getDisplay());
-
-                                        CCVector3 cellOrigin(   gridOrigin.x + i * cellSizePlusGap.x,
-                                                                gridOrigin.y + j * cellSizePlusGap.y,
-                                                                gridOrigin.z + k * cellSizePlusGap.z);
-                                        QString slicePosStr = QString("(%1 ; %2 ; %3)").arg(cellOrigin.x).arg(cellOrigin.y).arg(cellOrigin.z);
-                                        sliceCloud->setName(cloud->getName() + QString(".slice @ ") + slicePosStr);
-
-                                        //set meta-data
-                                        sliceCloud->setMetaData(s_originEntityUUID_, cloud->getUniqueID());
-                                        sliceCloud->setMetaData(s_sliceID_, slicePosStr);
-                                        sliceCloud->setMetaData("slice.origin.dim(0)", cellOrigin.x);
-                                        sliceCloud->setMetaData("slice.origin.dim(1)", cellOrigin.y);
-                                        sliceCloud->setMetaData("slice.origin.dim(2)", cellOrigin.z);
-
-                                        //add slice to group
-                                        outputSlices.push_back(sliceCloud);
-                                        ++subCloudsCount;
+                                        sliceCloud->showColors(true);
                                     }
+
+                                    sliceCloud->setEnabled(true);
+                                    sliceCloud->setVisible(true);
+                                    sliceCloud->setDisplay(cloud->getDisplay());
+
+                                    CCVector3 cellOrigin(   gridOrigin.x + i * cellSizePlusGap.x,
+                                                            gridOrigin.y + j * cellSizePlusGap.y,
+                                                            gridOrigin.z + k * cellSizePlusGap.z);
+                                    QString slicePosStr = QString("(%1 ; %2 ; %3)").arg(cellOrigin.x).arg(cellOrigin.y).arg(cellOrigin.z);
+                                    sliceCloud->setName(cloud->getName() + QString(".slice @ ") + slicePosStr);
+
+                                    //set meta-data
+                                    sliceCloud->setMetaData(s_originEntityUUID_, cloud->getUniqueID());
+                                    sliceCloud->setMetaData(s_sliceID_, slicePosStr);
+                                    sliceCloud->setMetaData("slice.origin.dim(0)", cellOrigin.x);
+                                    sliceCloud->setMetaData("slice.origin.dim(1)", cellOrigin.y);
+                                    sliceCloud->setMetaData("slice.origin.dim(2)", cellOrigin.z);
+
+                                    //add slice to group
+                                    outputSlices.push_back(sliceCloud);
                                 }
                             }
                         }
                     }
                 } //now create the real clouds
 
-                //release memory
-                {
-                    for (size_t i = 0; i < refClouds.size(); ++i)
-                        if (refClouds[i])
-                            delete refClouds[i];
-                    refClouds.clear();
-                }
-
                 cloudSliceCount = outputSlices.size();
 
             } //extract sections from clouds
@@ -4907,18 +8662,21 @@ bool ExtractSlicesAndContoursClone
                     break;
                 }
 
-                //process all the slices originating from point clouds
-                assert(cloudSliceCount <= outputSlices.size());
-                for (size_t i = 0; i < cloudSliceCount; ++i)
+                //contour lines parameters (the same for all slices)
+                ccContourLinesGenerator_::Parameters params;
+                params.emptyCellsValue = std::numeric_limits<double>::quiet_NaN();
+                params.minVertexCount = levelSetMinVertCount;
+                params.parentWidget = nullptr; //progressDialog->parentWidget();
+                params.startAltitude = 0.0;
+                params.maxAltitude = 1.0;
+                params.step = 1.0;
+                params.maxThreadCount = maxThreadCount;
+
+                //project a slice in 2D
+                auto projectSlice = [&](const ccPointCloud* sliceCloud, ccRasterGrid& sliceGrid)
                 {
-                    ccPointCloud* sliceCloud = ccHObjectCaster::ToPointCloud(outputSlices[i]);
-                    assert(sliceCloud);
-
-                    double sliceZ = sliceCloud->getMetaData(QString("slice.origin.dim(%1)").arg(Z)).toDouble();
-                    sliceZ += gridSize.u[Z] / 2;
-
-                    //grid.reset();
-                    for (ccRasterGrid::Row& row : grid.rows)
+                    //sliceGrid.reset();
+                    for (ccRasterGrid::Row& row : sliceGrid.rows)
                     {
                         for (ccRasterCell& cell : row)
                         {
@@ -4927,7 +8685,6 @@ bool ExtractSlicesAndContoursClone
                         }
                     }
 
-                    //project the slice in 2D
                     for (unsigned pi = 0; pi != sliceCloud->size(); ++pi)
                     {
                         CCVector3 relativePos = *sliceCloud->getPoint(pi);
@@ -4946,64 +8703,123 @@ bool ExtractSlicesAndContoursClone
                             continue;
                         }
 
-                        ccRasterCell& cell = grid.rows[j][i];
+                        ccRasterCell& cell = sliceGrid.rows[j][i];
                         cell.h = 1.0;
                         ++cell.nbPoints;
                     }
 
-                    grid.updateNonEmptyCellCount();
-                    grid.updateCellStats();
-                    grid.setValid(true);
+                    sliceGrid.updateNonEmptyCellCount();
+                    sliceGrid.updateCellStats();
+                    sliceGrid.setValid(true);
+                };
 
-                    //now extract the contour lines
-                    ccContourLinesGenerator_::Parameters params;
-                    params.emptyCellsValue = std::numeric_limits<double>::quiet_NaN();
-                    params.minVertexCount = levelSetMinVertCount;
-                    params.parentWidget = nullptr; //progressDialog->parentWidget();
-                    params.startAltitude = 0.0;
-                    params.maxAltitude = 1.0;
-                    params.step = 1.0;
+                //move the contour lines of a slice to the right place and store them
+                auto addContours = [&](const ccPointCloud* sliceCloud, std::vector<ccPolyline*>& contours)
+                {
+                    double sliceZ = sliceCloud->getMetaData(QString("slice.origin.dim(%1)").arg(Z)).toDouble();
+                    sliceZ += gridSize.u[Z] / 2;
 
-                    std::vector<ccPolyline*> contours;
-                    if (ccContourLinesGenerator_::GenerateContourLines(&grid, CCVector2d(gridOrigin.u[X],
-                                                                                         gridOrigin.u[Y]),
-                                                                       params, contours))
+                    for (size_t k = 0; k < contours.size(); ++k)
                     {
-                        for (size_t k = 0; k < contours.size(); ++k)
+                        ccPolyline* poly = contours[k];
+                        CCCoreLib::GenericIndexedCloudPersist* vertices = poly->getAssociatedCloud();
+                        for (unsigned pi = 0; pi < vertices->size(); ++pi)
                         {
-                            ccPolyline* poly = contours[k];
-                            CCCoreLib::GenericIndexedCloudPersist* vertices = poly->getAssociatedCloud();
-                            for (unsigned pi = 0; pi < vertices->size(); ++pi)
-                            {
-                                //convert the vertices from the local coordinate system to the global one
-                                const CCVector3* Pconst = vertices->getPoint(pi);
-                                CCVector3 P;
-                                P.u[X] = Pconst->x;
-                                P.u[Y] = Pconst->y;
-                                P.u[Z] = sliceZ;
-                                *const_cast<CCVector3*>(Pconst) = globalTrans * P;
-                            }
+                            //convert the vertices from the local coordinate system to the global one
+                            const CCVector3* Pconst = vertices->getPoint(pi);
+                            CCVector3 P;
+                            P.u[X] = Pconst->x;
+                            P.u[Y] = Pconst->y;
+                            P.u[Z] = sliceZ;
+                            *const_cast<CCVector3*>(Pconst) = globalTrans * P;
+                        }
 
-                            static char s_dimNames[3] = { 'X', 'Y', 'Z' };
-                            poly->setName(QString("Contour line %1=%2 (#%3)").arg(s_dimNames[Z]).arg(sliceZ).arg(k + 1));
-                            poly->copyGlobalShiftAndScale(*sliceCloud);
-                            poly->setMetaData(ccPolyline::MetaKeyConstAltitude(), QVariant(sliceZ)); //replace the 'altitude' meta-data by the right value
+                        static char s_dimNames[3] = { 'X', 'Y', 'Z' };
+                        poly->setName(QString("Contour line %1=%2 (#%3)").arg(s_dimNames[Z]).arg(sliceZ).arg(k + 1));
+                        poly->copyGlobalShiftAndScale(*sliceCloud);
+                        poly->setMetaData(ccPolyline::MetaKeyConstAltitude(), QVariant(sliceZ)); //replace the 'altitude' meta-data by the right value
 
-                            //set meta-data
-                            poly->setMetaData(s_originEntityUUID_, sliceCloud->getMetaData(s_originEntityUUID_));
-                            poly->setMetaData(s_sliceID_, sliceCloud->getMetaData(s_sliceID_));
-                            poly->setMetaData("slice.origin.dim(0)", sliceCloud->getMetaData("slice.origin.dim(0)"));
-                            poly->setMetaData("slice.origin.dim(1)", sliceCloud->getMetaData("slice.origin.dim(1)"));
-                            poly->setMetaData("slice.origin.dim(2)", sliceCloud->getMetaData("slice.origin.dim(2)"));
+                        //set meta-data
+                        poly->setMetaData(s_originEntityUUID_, sliceCloud->getMetaData(s_originEntityUUID_));
+                        poly->setMetaData(s_sliceID_, sliceCloud->getMetaData(s_sliceID_));
+                        poly->setMetaData("slice.origin.dim(0)", sliceCloud->getMetaData("slice.origin.dim(0)"));
+                        poly->setMetaData("slice.origin.dim(1)", sliceCloud->getMetaData("slice.origin.dim(1)"));
+                        poly->setMetaData("slice.origin.dim(2)", sliceCloud->getMetaData("slice.origin.dim(2)"));
 
-                            levelSet.push_back(poly);
-                        }
+                        levelSet.push_back(poly);
+                    }
+                };
+
+                //process all the slices originating from point clouds
+                assert(cloudSliceCount <= outputSlices.size());
+                CCVector2d gridMinCornerXY(gridOrigin.u[X], gridOrigin.u[Y]);
+    #ifdef CC_GDAL_SUPPORT
+                //the raw contour lines of all the slices are generated in parallel (each slice has its own grid)...
+                std::vector< std::vector<RawContourLine_> > slicesRawLines(cloudSliceCount);
+                std::vector<char> slicesSuccess(cloudSliceCount, 0);
+                auto generateSliceContours = [&](size_t i)
+                {
+                    const ccPointCloud* sliceCloud = ccHObjectCaster::ToPointCloud(outputSlices[i]);
+                    assert(sliceCloud);
+
+                    ccRasterGrid sliceGrid;
+                    if (!sliceGrid.init(gridWidth, gridHeight, levelSetGridStep, CCVector3d(0, 0, 0)))
+                    {
+                        return;
+                    }
+                    projectSlice(sliceCloud, sliceGrid);
+
+                    if (ccContourLinesGenerator_::GenerateRawContourLines(&sliceGrid, params, slicesRawLines[i]))
+                    {
+                        slicesSuccess[i] = 1;
+                    }
+                };
+    #ifdef CC_CORE_LIB_USES_TBB
+                tbb::parallel_for(static_cast<size_t>(0), cloudSliceCount, generateSliceContours);
+    #else
+                for (size_t i = 0; i < cloudSliceCount; ++i)
+                {
+                    generateSliceContours(i);
+                }
+    #endif
+
+                //...and the polylines are created afterwards, in the slices order
+                for (size_t i = 0; i < cloudSliceCount; ++i)
+                {
+                    ccPointCloud* sliceCloud = ccHObjectCaster::ToPointCloud(outputSlices[i]);
+                    std::vector<ccPolyline*> contours;
+                    if (    slicesSuccess[i]
+                        &&  ccContourLinesGenerator_::ConvertRawContourLines(slicesRawLines[i], &grid, gridMinCornerXY, params, contours))
+                    {
+                        addContours(sliceCloud, contours);
                     }
                     else
                     {
                         CCTRACE("Failed to generate contour lines for cloud #" << (i+1));
                     }
+                    slicesRawLines[i].clear();
+                    slicesRawLines[i].shrink_to_fit();
                 }
+    #else
+                for (size_t i = 0; i < cloudSliceCount; ++i)
+                {
+                    ccPointCloud* sliceCloud = ccHObjectCaster::ToPointCloud(outputSlices[i]);
+                    assert(sliceCloud);
+
+                    projectSlice(sliceCloud, grid);
+
+                    //now extract the contour lines
+                    std::vector<ccPolyline*> contours;
+                    if (ccContourLinesGenerator_::GenerateContourLines(&grid, gridMinCornerXY, params, contours))
+                    {
+                        addContours(sliceCloud, contours);
+                    }
+                    else
+                    {
+                        CCTRACE("Failed to generate contour lines for cloud #" << (i+1));
+                    }
+                }
+    #endif
             }
         }
 
@@ -5015,13 +8831,13 @@ bool ExtractSlicesAndContoursClone
             //preferred dimension?
             PointCoordinateType* preferredNormDir = nullptr;
             PointCoordinateType* preferredUpDir = nullptr;
+            ccGLMatrix invLocalTrans = localTrans.inverse(); //must outlive the preferred directions
             if (repeatDimensionsSum == 1)
             {
                 for (int i = 0; i < 3; ++i)
                 {
                     if (repeatDimensions[i])
                     {
-                        ccGLMatrix invLocalTrans = localTrans.inverse();
                         if (!projectOnBestFitPlane) //otherwise the normal will be automatically computed
                             preferredNormDir = invLocalTrans.getColumn(i);
                         preferredUpDir = invLocalTrans.getColumn(i < 2 ? 2 : 0);
@@ -5032,22 +8848,53 @@ bool ExtractSlicesAndContoursClone
 
             assert(cloudSliceCount <= outputSlices.size());
 
-            //process all the slices originating from point clouds
+            //the envelopes of all the slices originating from point clouds are computed in parallel...
+            std::vector< std::vector<CCVector3> > envelopesVertices(cloudSliceCount);
+            std::vector<char> envelopesSuccess(cloudSliceCount, 0);
+            auto computeEnvelope = [&](size_t i)
+            {
+                ccPointCloud* sliceCloud = ccHObjectCaster::ToPointCloud(outputSlices[i]);
+                assert(sliceCloud);
+
+                if (ComputeFlatEnvelopeVertices_(   sliceCloud,
+                                                    multiPass,
+                                                    maxEdgeLength,
+                                                    preferredNormDir,
+                                                    preferredUpDir,
+                                                    envelopeType,
+                                                    envelopesVertices[i],
+                                                    nullptr,
+                                                    visualDebugMode))
+                {
+                    envelopesSuccess[i] = 1;
+                }
+            };
+    #ifdef CC_CORE_LIB_USES_TBB
+            tbb::parallel_for(static_cast<size_t>(0), cloudSliceCount, computeEnvelope);
+    #else
+            for (size_t i = 0; i < cloudSliceCount; ++i)
+            {
+                computeEnvelope(i);
+            }
+    #endif
+
+            //...and the polylines are created afterwards, in the slices order
             for (size_t i = 0; i < cloudSliceCount; ++i)
             {
                 ccPointCloud* sliceCloud = ccHObjectCaster::ToPointCloud(outputSlices[i]);
                 assert(sliceCloud);
 
                 std::vector<ccPolyline*> polys;
-                if (ExtractFlatEnvelope_(sliceCloud,
-                    multiPass,
-                    maxEdgeLength,
-                    polys,
-                    envelopeType,
-                    splitEnvelopes,
-                    preferredNormDir,
-                    preferredUpDir,
-                    visualDebugMode))
+                bool success = false;
+                if (envelopesSuccess[i])
+                {
+                    ccPolyline* basePoly = CreateFlatEnvelopePolyline_(envelopesVertices[i], envelopeType);
+                    success = SplitFlatEnvelope_(basePoly, splitEnvelopes, maxEdgeLength, polys);
+                }
+                envelopesVertices[i].clear();
+                envelopesVertices[i].shrink_to_fit();
+
+                if (success)
                 {
                     if (!polys.empty())
                     {
@@ -41,6 +41,7 @@
 #include <ccCommandLineInterface.h>
 #include <Neighbourhood.h>
 #include <ccRasterGrid.h>
+#include <ccPointCloudInterpolator.h>
 
 #include "optdefines.h"
 
@@ -181,6 +182,106 @@ bool computeMomentOrder1(double radius, std::vector<ccHObject*> clouds);
  **/
 ccPointCloud* filterBySFValue(double minVal, double maxVal, ccPointCloud* cloud);
 
+//! Selects the points of a cloud inside (or outside) a box (see ccPointCloud::crop)
+/*! The cloud octree is computed if missing (and kept with the cloud). Only the octree cells meeting the box are visited,
+ *  and only the points of the cells crossing the box border are tested.
+ * \param cloud
+ * \param box
+ * \param inside whether to select the points inside or outside the box
+ * \return the selection (the points keep their order), or nullptr if problem
+ */
+CCCoreLib::ReferenceCloud* CropCloud(ccGenericPointCloud* cloud, const ccBBox& box, bool inside = true);
+
+//! Selects the points of a cloud inside (or outside) a 2D polyline (see ccPointCloud::crop2D)
+/*! The cloud octree is computed if missing (and kept with the cloud). Only the octree cells meeting the polyline
+ *  bounding box are visited.
+ * \param cloud
+ * \param poly the polyline (only the x and y coordinates of its vertices are used)
+ * \param orthoDim normal to the crop plane (0, 1, 2)
+ * \param inside whether to select the points inside or outside the polyline
+ * \return the selection (the points keep their order), or nullptr if problem
+ */
+CCCoreLib::ReferenceCloud* Crop2DCloud(ccGenericPointCloud* cloud, const ccPolyline* poly, unsigned char orthoDim, bool inside = true);
+
+//! Crops a cloud with several boxes at once
+/*! The points are counted per box in a first parallel pass, then their indexes are written per box in a second one.
+ *  The boxes are indexed with a uniform grid, so each point is only tested against a few boxes.
+ * \param cloud
+ * \param boxes the boxes (they may overlap)
+ * \return one cloud per box (nullptr for an empty crop)
+ */
+std::vector<ccPointCloud*> CropCloudMultiBoxes(ccPointCloud* cloud, const std::vector<ccBBox>& boxes);
+
+//! Crops a cloud with several 2D polylines at once (see Crop2DCloud and CropCloudMultiBoxes)
+/*! The polylines bounding boxes are indexed with a uniform grid, so each point is only tested against a few polylines.
+ * \param cloud
+ * \param polys the polylines (they may overlap)
+ * \param orthoDim normal to the crop plane (0, 1, 2)
+ * \return one cloud per polyline (nullptr for an empty crop)
+ */
+std::vector<ccPointCloud*> Crop2DCloudMultiPolylines(ccPointCloud* cloud, const std::vector<ccPolyline*>& polys, unsigned char orthoDim);
+
+//! Extracts the connected components of a cloud (see MainWindow::doActionLabelConnectedComponents)
+/*! The non empty cells of the octree at the given level are grouped with a parallel union-find (26-connexity).
+ *  The components are filtered by size before any cloud creation.
+ * \param cloud
+ * \param octreeLevel the octree level (defines the minimum gap between two components)
+ * \param minComponentSize components with fewer points are regrouped in the residual cloud
+ * \param maxNumberComponents maximum number of components of at least minComponentSize points
+ * \param randomColors whether to color randomly the components or not
+ * \param components output: the components clouds, sorted by decreasing size
+ * \param residual output: the regrouped small components (nullptr if none)
+ * \return the number of components of at least minComponentSize points (nothing is created if it exceeds maxNumberComponents), or -1 if problem
+ */
+int ExtractConnectedComponentsClouds(ccPointCloud* cloud,
+                                     unsigned char octreeLevel,
+                                     unsigned minComponentSize,
+                                     unsigned maxNumberComponents,
+                                     bool randomColors,
+                                     std::vector<ccPointCloud*>& components,
+                                     ccPointCloud*& residual);
+
+//! Interpolates scalar fields (and colors) from a source cloud (see ccPointCloudInterpolator::InterpolateScalarFieldsFrom)
+/*! One neighbourhood search per destination point feeds all the scalar fields and the colors.
+ *  The destination points are processed in parallel. Existing destination scalar fields with the same names are overwritten.
+ * \param destCloud the cloud receiving the scalar fields
+ * \param srcCloud the source cloud (its octree is computed if missing)
+ * \param sfIndexes indexes of the source scalar fields
+ * \param params interpolation method, algorithm, number of neighbours, radius, sigma
+ * \param octreeLevel octree level of the neighbourhood searches (0: automatic)
+ * \param interpolateColors whether to interpolate the colors (if the source has colors)
+ * \param maxThreadCount maximum number of threads (0: all)
+ * \return success
+ */
+bool InterpolateScalarFieldsFromCloud(ccPointCloud* destCloud,
+                                      ccPointCloud* srcCloud,
+                                      const std::vector<int>& sfIndexes,
+                                      const ccPointCloudInterpolator::Parameters& params,
+                                      unsigned char octreeLevel = 0,
+                                      bool interpolateColors = false,
+                                      int maxThreadCount = 0);
+
+//! Interpolates scalar fields (and colors) from a source cloud to several destination clouds (see InterpolateScalarFieldsFromCloud)
+bool InterpolateScalarFieldsFromCloudMulti(const std::vector<ccPointCloud*>& destClouds,
+                                           ccPointCloud* srcCloud,
+                                           const std::vector<int>& sfIndexes,
+                                           const ccPointCloudInterpolator::Parameters& params,
+                                           unsigned char octreeLevel = 0,
+                                           bool interpolateColors = false,
+                                           int maxThreadCount = 0);
+
+//! Appends several clouds to a cloud (see ccPointCloud::append)
+/*! The union of the scalar fields and the total size are computed first, so that every buffer is allocated once,
+ *  then the clouds are copied in parallel. Missing colors are set to white, missing scalar values to NaN.
+ *  The clouds with sensors, scan grids, full waveform data, or a global shift (or scale) different from destCloud,
+ *  are appended one by one with ccPointCloud::append, which handles them.
+ * \param destCloud the cloud to append to (the clouds already appended are kept if an allocation fails)
+ * \param clouds the clouds to append (left unchanged)
+ * \param createSFcloudIndex whether to fill the 'original cloud index' scalar field (0 for destCloud, k+1 for clouds[k])
+ * \return success
+ */
+bool MergeCloudsInto(ccPointCloud* destCloud, const std::vector<ccPointCloud*>& clouds, bool createSFcloudIndex = false);
+
 //! Returns a default first guess for algorithms kernel size (several clouds)
 /*! copied from ccLibAlgorithms::GetDefaultCloudKernelSize
  * \param list of clouds
@@ -189,7 +290,33 @@ ccPointCloud* filterBySFValue(double minVal, double maxVal, ccPointCloud* cloud)
  */
 double GetPointCloudRadius(std::vector<ccHObject*> clouds, unsigned knn = 12);
 
+//! Objective function minimized by ICP
+enum ICP_OBJECTIVE
+{
+    POINT_TO_POINT = 0, POINT_TO_PLANE, SYMMETRIC_POINT_TO_PLANE
+};
+
+//! ICP registration result for one level of the resolution pyramid (see ICP)
+struct ICPLevelInfo
+{
+    unsigned char octreeLevel = 0; //!< octree level used to subsample the data (0 for the full resolution level)
+    unsigned pointCount = 0;       //!< number of data points registered at this level
+    double rms = 0;                //!< final RMS at this level
+    double duration = 0;           //!< registration time at this level (s)
+};
+
 //! copied from ccRegistrationTools::ICP
+/*! With pyramidLevels > 1, the data is first registered on voxel subsampled versions (one point per cell of its octree),
+ *  coarse to fine, each level starting from the transformation of the previous one, and then at full resolution.
+ *  The convergence criteria apply to each level. The data and model octrees are computed once for all the levels.
+ *  With POINT_TO_POINT, the levels use a linearized point-to-point objective on the shared model octree,
+ *  except the full resolution level when it needs a mesh model, scale adjustment or weights (CCCoreLib ICP).
+ *  POINT_TO_PLANE and SYMMETRIC_POINT_TO_PLANE objectives use the model normals (computed if missing),
+ *  the model octree and normals are computed once for all the levels. They do not support scale nor weights.
+ * \param pyramidLevels number of levels, including the final full resolution one (1: single resolution)
+ * \param levelInfos optional output: results per level, coarse to fine
+ * \param objective objective function (POINT_TO_POINT: CCCoreLib ICPRegistrationTools)
+ */
 bool ICP(
     ccHObject* data,
     ccHObject* model,
@@ -207,9 +334,69 @@ bool ICP(
     bool useDataSFAsWeights = false,
     bool useModelSFAsWeights = false,
     int transformationFilters = CCCoreLib::RegistrationTools::SKIP_NONE,
-    int maxThreadCount = 0);
+    int maxThreadCount = 0,
+    int pyramidLevels = 1,
+    std::vector<ICPLevelInfo>* levelInfos = nullptr,
+    ICP_OBJECTIVE objective = POINT_TO_POINT);
+
+//! Pairwise registration of a multi-view registration (see ICPMultiView)
+struct ICPPairInfo
+{
+    unsigned modelIndex = 0; //!< index of the reference cloud
+    unsigned dataIndex = 0;  //!< index of the registered cloud
+    bool success = false;    //!< registration status
+    double rms = 0;          //!< final RMS
+    unsigned pointCount = 0; //!< number of data points used at the last iteration
+    ccGLMatrixd transMat;    //!< transformation to apply to the data cloud to register it on the model cloud
+};
+
+//! Registers a set of overlapping clouds pair by pair, then optionally computes their global poses
+/*! The pairwise registrations run in parallel. Each cloud octree (with its normals for the plane objectives, and
+ *  the data normals for the symmetric objective) and each data sampling are computed once (in parallel, cloud by
+ *  cloud), whatever the number of pairs using the cloud. With POINT_TO_POINT, the pairs use the linearized
+ *  point-to-point objective of the ICP pyramid on the shared model octree.
+ *  The registration parameters have the same meaning as with ICP (no partial overlap preprocessing: the trimming
+ *  by finalOverlapRatio is done at each iteration). The scale and the weights are not supported.
+ * \param clouds the clouds to register
+ * \param pairs input: the pairs (model, data) to register, or empty to use all the pairs of clouds with overlapping
+ *        bounding boxes; output: the pairwise registration results
+ * \param globalTransforms optional output: transformation to apply to each cloud (pose graph refinement,
+ *        the first cloud of each connected set of pairs is the reference)
+ * \param objective objective function (POINT_TO_POINT: linearized point-to-point objective)
+ * \return false on invalid input or memory error (the failure of a pair is reported by its success flag)
+ */
+bool ICPMultiView(const std::vector<ccPointCloud*>& clouds,
+                  std::vector<ICPPairInfo>& pairs,
+                  std::vector<ccGLMatrixd>* globalTransforms,
+                  double minRMSDecrease,
+                  unsigned maxIterationCount,
+                  unsigned randomSamplingLimit,
+                  bool removeFarthestPoints,
+                  CCCoreLib::ICPRegistrationTools::CONVERGENCE_TYPE method,
+                  double finalOverlapRatio = 1.0,
+                  int transformationFilters = CCCoreLib::RegistrationTools::SKIP_NONE,
+                  int maxThreadCount = 0,
+                  ICP_OBJECTIVE objective = POINT_TO_POINT);
+
+//! Orients the normals of a cloud with a Minimum Spanning Tree (parallel alternative to ccPointCloud::orientNormalsWithMST)
+/*! The kNN graph (weights: 1 - |cos| between the normals) is built in parallel, the minimum spanning forest is computed
+ *  with parallel Boruvka rounds, and each tree is oriented from its first point, whose normal is kept.
+ *  In tiled mode, the spanning trees are restricted to the tiles (octree cells), which are oriented independently,
+ *  then the signs of the trees are reconciled along the seams, with the kNN edges between trees.
+ *  The cloud octree is computed if missing.
+ * \param cloud cloud with normals
+ * \param kNN number of neighbours of each point in the graph
+ * \param tilePointCount mean number of points of the tiles (0: no tiling)
+ * \return success
+ */
+bool OrientNormalsWithMSTParallel(ccPointCloud* cloud, unsigned kNN = 6, unsigned tilePointCount = 0);
 
 //! copied from ccEntityAction::computeNormals
+/*! With adaptiveKnn > 0, the octree based normals use a per point scale instead of defaultRadius:
+ *  the adaptiveKnn nearest neighbours (fixed-k), or a density adaptive radius (mean distance to the
+ *  k-th neighbour around the point), with a least squares plane (the local model is ignored).
+ *  The scale can be exported in a "Normal scale" scalar field.
+ */
 bool computeNormals(std::vector<ccHObject*> selectedEntities,
     CCCoreLib::LOCAL_MODEL_TYPES model =CCCoreLib::LS,
     bool useScanGridsForComputation = true,
@@ -221,7 +408,10 @@ bool computeNormals(std::vector<ccHObject*> selectedEntities,
     ccNormalVectors::Orientation preferredOrientation = ccNormalVectors::UNDEFINED,
     bool orientNormalsMST = true,
     int mstNeighbors = 6,
-    bool computePerVertexNormals = true);
+    bool computePerVertexNormals = true,
+    unsigned adaptiveKnn = 0,
+    bool adaptiveRadius = false,
+    bool exportScaleSF = false);
 
 //! adapted from ccEntityAction:: invertNormals
 bool invertNormals(std::vector<ccHObject*> selectedEntities);
@@ -423,6 +613,7 @@ enum Envelope_Type { LOWER, UPPER, FULL };
     \param visualDebugMode displays a 'debugging' window during the envelope extraction process
     \param generateRandomColors randomly colors the extracted slices
     \param progressDialog optional progress dialog
+    \param maxThreadCount max number of threads used to generate the contours of a slice (0 = all the available threads)
 **/
 bool ExtractSlicesAndContoursClone
     (
@@ -449,6 +640,7 @@ bool ExtractSlicesAndContoursClone
     bool projectOnBestFitPlane = false,
     bool visualDebugMode = false,
     bool generateRandomColors = false,
-    ccProgressDialog* progressDialog = 0);
+    ccProgressDialog* progressDialog = 0,
+    int maxThreadCount = 0);
 
 #endif /* CLOUDCOMPY_PYAPI_PYCC_H_ */
@@ -23,6 +23,8 @@
 
 #include <QString>
 #include <vector>
+#include <algorithm>
+#include <cmath>
 
 #include <ccPointCloud.h>
 #include <ccMesh.h>
@@ -41,6 +43,161 @@ void initTrace_CSF()
 #endif
 }
 
+//! values of the classification scalar field (ASPRS classes)
+static const ScalarType CSF_GROUND_CLASS = 2;
+static const ScalarType CSF_OFFGROUND_CLASS = 1;
+
+//! an overlapping tile: the original point indexes
+struct CSFTile_
+{
+    std::vector<unsigned> indexes;
+    unsigned tileIndex = 0;
+};
+
+//! tile owning a point (the tile whose core contains it)
+static inline unsigned CSFTileOf_(const CCVector3* P, const CCVector3& bbMin, double tileSize, unsigned nx, unsigned ny)
+{
+    unsigned i = static_cast<unsigned>(std::max(0.0, std::floor((P->x - bbMin.x) / tileSize)));
+    unsigned j = static_cast<unsigned>(std::max(0.0, std::floor((P->y - bbMin.y) / tileSize)));
+    return std::min(j, ny - 1) * nx + std::min(i, nx - 1);
+}
+
+//! local index of the tile points, in two fields of 16 bits (exact with any ScalarType)
+static const char* s_csfIndexLowName = "CSF tile index (low)";
+static const char* s_csfIndexHighName = "CSF tile index (high)";
+
+//! classifies the points of a cloud produced from a tile, for the points owned by the tile
+static void ClassifyCSFTileOutput_(ccPointCloud* output, const CSFTile_& tile, const std::vector<unsigned>& owners,
+                                   ScalarType value, CCCoreLib::ScalarField* classSF)
+{
+    if (!output)
+        return;
+    int low = output->getScalarFieldIndexByName(s_csfIndexLowName);
+    int high = output->getScalarFieldIndexByName(s_csfIndexHighName);
+    if (low < 0 || high < 0)
+    {
+        CCTRACE("tile index lost in CSF output!");
+        return;
+    }
+    const CCCoreLib::ScalarField* lowSF = output->getScalarField(low);
+    const CCCoreLib::ScalarField* highSF = output->getScalarField(high);
+    for (unsigned k = 0; k < output->size(); ++k)
+    {
+        unsigned local = static_cast<unsigned>(lowSF->getValue(k)) | (static_cast<unsigned>(highSF->getValue(k)) << 16);
+        if (local >= tile.indexes.size())
+            continue;
+        unsigned index = tile.indexes[local];
+        if (owners[index] == tile.tileIndex)
+            classSF->setValue(index, value);
+    }
+}
+
+int computeCSFClassification(ccPointCloud* pc,
+                             int csfRigidness = 2,
+                             int maxIteration = 500,
+                             double clothResolution = 2.0,
+                             double classThreshold = 0.5,
+                             bool csfPostprocessing = false,
+                             double tileSize = 0.0,
+                             double tileOverlap = -1.0)
+{
+    CCTRACE("computeCSFClassification");
+    if (!pc || pc->size() == 0)
+    {
+        CCTRACE("empty cloud!");
+        return -1;
+    }
+    const unsigned count = pc->size();
+    CCVector3 bbMin, bbMax;
+    pc->getBoundingBox(bbMin, bbMax);
+    if (tileSize <= 0)
+        tileSize = std::max(static_cast<double>(bbMax.x - bbMin.x), static_cast<double>(bbMax.y - bbMin.y)) + 1.0;
+    if (tileOverlap < 0)
+        tileOverlap = 10.0 * clothResolution;
+    const unsigned nx = std::max(1u, static_cast<unsigned>(std::ceil((bbMax.x - bbMin.x) / tileSize)));
+    const unsigned ny = std::max(1u, static_cast<unsigned>(std::ceil((bbMax.y - bbMin.y) / tileSize)));
+    CCTRACE("tiles: " << nx << " x " << ny << ", size " << tileSize << ", overlap " << tileOverlap);
+
+    //a point belongs to the tiles whose extended box (core + overlap) contains it
+    std::vector<unsigned> owners(count);
+    std::vector<CSFTile_> tiles(nx * ny);
+    for (unsigned t = 0; t < tiles.size(); ++t)
+        tiles[t].tileIndex = t;
+    for (unsigned i = 0; i < count; ++i)
+    {
+        const CCVector3* P = pc->getPoint(i);
+        owners[i] = CSFTileOf_(P, bbMin, tileSize, nx, ny);
+        double fx = (P->x - bbMin.x) / tileSize;
+        double fy = (P->y - bbMin.y) / tileSize;
+        double ov = tileOverlap / tileSize;
+        unsigned i0 = static_cast<unsigned>(std::max(0.0, std::floor(fx - ov)));
+        unsigned i1 = std::min(nx - 1, static_cast<unsigned>(std::max(0.0, std::floor(fx + ov))));
+        unsigned j0 = static_cast<unsigned>(std::max(0.0, std::floor(fy - ov)));
+        unsigned j1 = std::min(ny - 1, static_cast<unsigned>(std::max(0.0, std::floor(fy + ov))));
+        for (unsigned j = j0; j <= j1; ++j)
+            for (unsigned k = i0; k <= i1; ++k)
+                tiles[j * nx + k].indexes.push_back(i);
+    }
+    tiles.erase(std::remove_if(tiles.begin(), tiles.end(), [](const CSFTile_& t) { return t.indexes.empty(); }), tiles.end());
+
+    int classIndex = pc->getScalarFieldIndexByName("CSF classification");
+    if (classIndex < 0)
+        classIndex = pc->addScalarField("CSF classification");
+    if (classIndex < 0)
+    {
+        CCTRACE("Not enough memory!");
+        return -1;
+    }
+    CCCoreLib::ScalarField* classSF = pc->getScalarField(classIndex);
+    classSF->fill(CSF_OFFGROUND_CLASS);
+
+    //one cloth per tile, the tiles one after the other: qCSF::computeCSF creates its output clouds,
+    //which is not thread safe (unique ids). A tile cloud (coordinates and local index only) exists only during its simulation.
+    bool memoryOk = true;
+    for (CSFTile_& tile : tiles)
+    {
+        ccPointCloud* tileCloud = new ccPointCloud(QString("CSF tile %1").arg(tile.tileIndex));
+        int low = -1;
+        int high = -1;
+        if (tileCloud->reserve(static_cast<unsigned>(tile.indexes.size())))
+        {
+            low = tileCloud->addScalarField(s_csfIndexLowName);
+            high = tileCloud->addScalarField(s_csfIndexHighName);
+        }
+        if (low < 0 || high < 0)
+        {
+            delete tileCloud;
+            memoryOk = false;
+            break;
+        }
+        CCCoreLib::ScalarField* lowSF = tileCloud->getScalarField(low);
+        CCCoreLib::ScalarField* highSF = tileCloud->getScalarField(high);
+        for (unsigned k = 0; k < tile.indexes.size(); ++k)
+        {
+            tileCloud->addPoint(*pc->getPoint(tile.indexes[k]));
+            lowSF->setValue(k, static_cast<ScalarType>(k & 0xFFFF));
+            highSF->setValue(k, static_cast<ScalarType>(k >> 16));
+        }
+
+        std::vector<ccPointCloud*> outputs = qCSF::computeCSF(tileCloud, csfRigidness, maxIteration, clothResolution,
+                                                              classThreshold, csfPostprocessing);
+        if (outputs.size() > 0)
+            ClassifyCSFTileOutput_(outputs[0], tile, owners, CSF_GROUND_CLASS, classSF);
+        for (ccPointCloud* cloud : outputs)
+            delete cloud;
+        delete tileCloud;
+        std::vector<unsigned>().swap(tile.indexes);
+    }
+    if (!memoryOk)
+    {
+        CCTRACE("Not enough memory!");
+        pc->deleteScalarField(classIndex);
+        return -1;
+    }
+    classSF->computeMinAndMax();
+    return classIndex;
+}
+
 PYBIND11_MODULE(_CSF, m7)
 {
     m7.doc() = CSF_doc;
@@ -48,6 +205,11 @@ PYBIND11_MODULE(_CSF, m7)
     m7.def("computeCSF", qCSF::computeCSF,
             py::arg("pc"), py::arg("csfRigidness")=2, py::arg("maxIteration")=500, py::arg("clothResolution")=2.0,
             py::arg("classThreshold")=0.5, py::arg("csfPostprocessing")=false, CSF_computeCSF_doc);
+    m7.def("computeCSFClassification", computeCSFClassification,
+            py::arg("pc"), py::arg("csfRigidness")=2, py::arg("maxIteration")=500, py::arg("clothResolution")=2.0,
+            py::arg("classThreshold")=0.5, py::arg("csfPostprocessing")=false,
+            py::arg("tileSize")=0.0, py::arg("tileOverlap")=-1.0,
+            CSF_computeCSFClassification_doc);
     m7.def("initTrace_CSF", initTrace_CSF, CSF_initTrace_CSF_doc);
 }
 
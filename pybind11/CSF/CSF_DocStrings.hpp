@@ -56,6 +56,33 @@ See `CSF plugin <https://www.cloudcompare.org/doc/wiki/index.php/CSF_(plugin)>`_
 :rtype: list
 )";
 
+const char* CSF_computeCSFClassification_doc=R"(
+Compute Cloth Simulation Filter (CSF) on overlapping tiles,
+and store the result as a classification scalar field on the cloud.
+
+The cloud is split in a grid of square tiles of tileSize (in the XY plane),
+each tile is extended by tileOverlap on each side and simulated with its own cloth.
+The tiles are simulated one after the other (the plugin creates its output clouds, which is not thread safe):
+only one tile copy exists at a time, so the memory peak is bounded by the tile size.
+A point covered by several tiles takes the class computed by the tile whose core contains it:
+the overlap only gives the cloth some context across the tile borders.
+Use an overlap larger than the size of the biggest off-ground objects.
+
+The scalar field "CSF classification" uses the ASPRS classes: 2 for ground, 1 for off-ground.
+
+:param ccPointCloud pc: the point cloud on which the filter is applied.
+:param int,optional csfRigidness: from (1:steep slope, 2:relief 3:flat), default 2
+:param int,optional maxIteration: maximum iterations, default 500
+:param double,optional clothResolution: default 2.0
+:param double,optional classThreshold: default 0.5
+:param bool,optional csfPostprocessing: default false
+:param double,optional tileSize: size of the tiles, default 0 (a single tile for the whole cloud)
+:param double,optional tileOverlap: overlap added on each side of the tiles, default -1 (10 x clothResolution)
+
+:return: index of the scalar field, -1 if failed
+:rtype: int
+)";
+
 const char* CSF_initTrace_CSF_doc=R"(
 Debug trace must be initialized for each Python module.
 
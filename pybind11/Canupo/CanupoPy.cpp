@@ -22,19 +22,38 @@
 #include "cloudComPy.hpp"
 
 #include <QString>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSharedPointer>
+#include <QThread>
 #include <vector>
+#include <map>
+#include <algorithm>
+#include <functional>
+#include <cmath>
 
 #include <ccPointCloud.h>
 #include <ccMesh.h>
 #include <ccHObject.h>
 #include <ccHObjectCaster.h>
+#include <ccOctree.h>
 #include <CloudSamplingTools.h>
+#include <DgmOctree.h>
+#include <ReferenceCloud.h>
 
 #include <qCanupoProcess.h>
+#include <qCanupoTools.h>
+#include <classifier.h>
+#include <ccPointDescriptor.h>
 
 #include "pyccTrace.h"
 #include "Canupo_DocStrings.hpp"
 
+#ifdef CC_CORE_LIB_USES_TBB
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+#endif
+
 void initTrace_Canupo()
 {
 #ifdef _PYTHONAPI_DEBUG_
@@ -62,8 +81,14 @@ bool ClassifyPy(
     bool generateRoughnessSF = false,
     int maxThreadCount = 0,
     bool useActiveSFForConfidence = false,
-    PointCoordinateType samplingDist = 0.0)
+    PointCoordinateType samplingDist = 0.0,
+    bool exportCorePoints = false)
 {
+    if (!cloud)
+    {
+        CCTRACE("no cloud to classify!");
+        return false;
+    }
     //store parameters
     qCanupoProcess::ClassifyParams params;
     {
@@ -104,11 +129,22 @@ bool ClassifyPy(
             CCTRACE("samplingDist <=0 and SUBSAMPLED core source specified!")
             return false;
         }
+        //the cloud octree is computed once, for the sub-sampling and the descriptors
+        ccOctree::Shared octree = cloud->getOctree();
+        if (!octree)
+        {
+            octree = cloud->computeOctree();
+        }
+        if (!octree)
+        {
+            CCTRACE("Failed to compute the octree!");
+            return false;
+        }
         CCCoreLib::CloudSamplingTools::SFModulationParams modParams(false);
         CCCoreLib::ReferenceCloud* refCloud = CCCoreLib::CloudSamplingTools::resampleCloudSpatially(cloud,
                                                                                             samplingDist,
                                                                                             modParams,
-                                                                                            nullptr,
+                                                                                            octree.data(),
                                                                                             nullptr);
         if (!refCloud)
         {
@@ -117,23 +153,27 @@ bool ClassifyPy(
         }
 
         params.samplingDist = samplingDist;
+        corePoints = refCloud;
 
-        //try to convert the references into a real point cloud (not mandatory though!)
-        realCorePoints = cloud->partialClone(refCloud);
-        if (realCorePoints)
+        //the core points are kept as references, unless a real point cloud is explicitly requested
+        if (exportCorePoints)
         {
-            realCorePoints->setName(cloud->getName() + QString(".core points (subsampled @ %1)").arg(samplingDist));
-            cloud->addChild(realCorePoints);
-            corePoints = realCorePoints;
-        }
-        else
-        {
-            CCTRACE("Can't save subsampled cloud (not enough memory)!");
-            return false;
+            realCorePoints = cloud->partialClone(refCloud);
+            if (realCorePoints)
+            {
+                realCorePoints->setName(cloud->getName() + QString(".core points (subsampled @ %1)").arg(samplingDist));
+                cloud->addChild(realCorePoints);
+                corePoints = realCorePoints;
+                delete refCloud;
+                refCloud = nullptr;
+            }
+            else
+            {
+                CCTRACE("Can't save subsampled cloud (not enough memory)!");
+                delete refCloud;
+                return false;
+            }
         }
-
-        delete refCloud;
-        refCloud = nullptr;
     }
     break;
 
@@ -174,7 +214,7 @@ bool ClassifyPy(
 
     assert(corePoints);
 
-    qCanupoProcess::Classify(classifierFilename, params, cloud, corePoints, corePointsDescriptors, realCorePoints, nullptr, nullptr);
+    bool success = qCanupoProcess::Classify(classifierFilename, params, cloud, corePoints, corePointsDescriptors, realCorePoints, nullptr, nullptr);
 
     //dispose of the 'virtual' core points (if any)
     if (corePoints != realCorePoints)
@@ -182,7 +222,304 @@ bool ClassifyPy(
         delete corePoints;
         corePoints = nullptr;
     }
-    return true;
+    return success;
+}
+
+//! classifies several clouds with the same classifier and parameters, the core points being the clouds or their sub-sampling
+std::vector<bool> ClassifyBatchPy(
+    std::vector<ccPointCloud*> clouds,
+    QString classifierFilename,
+    CORE_CLOUD_SOURCES coreSource = ORIGINAL,
+    double confidenceThreshold = 0.,
+    bool generateAdditionalSF = false,
+    bool generateRoughnessSF = false,
+    int maxThreadCount = 0,
+    bool useActiveSFForConfidence = false,
+    PointCoordinateType samplingDist = 0.0)
+{
+    CCTRACE("ClassifyBatch, " << clouds.size() << " clouds");
+    std::vector<bool> results(clouds.size(), false);
+    if (coreSource != ORIGINAL && coreSource != SUBSAMPLED)
+    {
+        CCTRACE("only ORIGINAL and SUBSAMPLED core sources are available for a batch!");
+        return results;
+    }
+    for (size_t i = 0; i < clouds.size(); ++i)
+    {
+        results[i] = ClassifyPy(clouds[i], classifierFilename, nullptr, coreSource, "", confidenceThreshold,
+                                generateAdditionalSF, generateRoughnessSF, maxThreadCount, useActiveSFForConfidence,
+                                samplingDist, false);
+    }
+    return results;
+}
+
+//! a Canupo classifier file, parsed once, read only afterwards (shared by the classifications)
+struct CanupoClassifier
+{
+    QString filename;
+    std::vector<Classifier> classifiers;
+    std::vector<float> scales;
+    unsigned descriptorID = 0;
+
+    //! the class labels known by the classifiers
+    std::vector<int> classes() const
+    {
+        std::vector<int> labels;
+        for (const Classifier& classifier : classifiers)
+        {
+            for (int label : { classifier.class1, classifier.class2 })
+            {
+                if (std::find(labels.begin(), labels.end(), label) == labels.end())
+                    labels.push_back(label);
+            }
+        }
+        std::sort(labels.begin(), labels.end());
+        return labels;
+    }
+};
+
+QSharedPointer<CanupoClassifier> loadCanupoClassifierPy(QString filename)
+{
+    CCTRACE("loadCanupoClassifier " << filename.toStdString());
+    QSharedPointer<CanupoClassifier> classifier(new CanupoClassifier);
+    QString error;
+    if (!Classifier::Load(filename, classifier->classifiers, classifier->scales, error))
+    {
+        CCTRACE(error.toStdString());
+        return QSharedPointer<CanupoClassifier>(nullptr);
+    }
+    if (classifier->classifiers.empty() || classifier->scales.empty())
+    {
+        CCTRACE("Invalid classifier file (no classifier or no scale)!");
+        return QSharedPointer<CanupoClassifier>(nullptr);
+    }
+    classifier->descriptorID = classifier->classifiers.front().descriptorID;
+    for (const Classifier& c : classifier->classifiers)
+    {
+        if (c.descriptorID != classifier->descriptorID)
+        {
+            CCTRACE("Classifiers with different descriptors in the same file are not handled!");
+            return QSharedPointer<CanupoClassifier>(nullptr);
+        }
+    }
+    classifier->filename = filename;
+    return classifier;
+}
+
+//! runs processChunk(first, last) over [0, count), in parallel if TBB is available
+static void ForEachCanupoChunk_(unsigned count, const std::function<void(unsigned, unsigned)>& processChunk)
+{
+#ifdef CC_CORE_LIB_USES_TBB
+    unsigned chunkCount = std::min(static_cast<unsigned>(std::max(QThread::idealThreadCount(), 1)) * 8, std::max(count / 256, 1u));
+    unsigned chunkSize = (count + chunkCount - 1) / chunkCount;
+    tbb::parallel_for(static_cast<unsigned>(0), chunkCount, [&](unsigned c)
+    {
+        processChunk(c * chunkSize, std::min(count, (c + 1) * chunkSize));
+    });
+#else
+    processChunk(0, count);
+#endif
+}
+
+//! class of a core point: a single classifier gives the side of the boundary, several (one-vs-one) classifiers vote
+static void ClassifyCanupoCorePoint_(const CanupoClassifier& classifier, const CorePointDesc& desc, int& classLabel, float& distance)
+{
+    if (classifier.classifiers.size() == 1)
+    {
+        const Classifier& c = classifier.classifiers.front();
+        float d = c.classify(desc);
+        classLabel = (d >= 0 ? c.class2 : c.class1);
+        distance = std::abs(d);
+        return;
+    }
+    std::map<int, std::pair<int, float> > votes; //class: votes, smallest distance to the boundaries
+    for (const Classifier& c : classifier.classifiers)
+    {
+        float d = c.classify(desc);
+        int label = (d >= 0 ? c.class2 : c.class1);
+        auto it = votes.find(label);
+        if (it == votes.end())
+            votes[label] = std::make_pair(1, std::abs(d));
+        else
+        {
+            it->second.first++;
+            it->second.second = std::min(it->second.second, std::abs(d));
+        }
+    }
+    classLabel = votes.begin()->first;
+    distance = votes.begin()->second.second;
+    for (const auto& vote : votes)
+    {
+        if (vote.second.first > votes[classLabel].first)
+        {
+            classLabel = vote.first;
+            distance = vote.second.second;
+        }
+    }
+}
+
+//! the plugin descriptors computation is not reentrant (static state shared by its worker threads):
+//! concurrent classifications compute their descriptors one at a time
+static QMutex s_canupoDescriptorsMutex;
+
+bool ClassifyWithClassifierPy(
+    ccPointCloud* cloud,
+    QSharedPointer<CanupoClassifier> classifier,
+    CORE_CLOUD_SOURCES coreSource = ORIGINAL,
+    PointCoordinateType samplingDist = 0.0,
+    int maxThreadCount = 0)
+{
+    CCTRACE("ClassifyWithClassifier");
+    if (!cloud || cloud->size() == 0 || !classifier)
+    {
+        CCTRACE("no cloud or no classifier!");
+        return false;
+    }
+    if (coreSource != ORIGINAL && coreSource != SUBSAMPLED)
+    {
+        CCTRACE("only ORIGINAL and SUBSAMPLED core sources are available with a loaded classifier!");
+        return false;
+    }
+    if (coreSource == SUBSAMPLED && samplingDist <= 0)
+    {
+        CCTRACE("samplingDist <=0 and SUBSAMPLED core source specified!")
+        return false;
+    }
+
+    ccOctree::Shared octree = cloud->getOctree();
+    if (!octree)
+    {
+        octree = cloud->computeOctree();
+    }
+    if (!octree)
+    {
+        CCTRACE("Failed to compute the octree!");
+        return false;
+    }
+
+    //core points, as indexes on the cloud
+    QSharedPointer<CCCoreLib::ReferenceCloud> subsampled;
+    CCCoreLib::GenericIndexedCloudPersist* corePoints = cloud;
+    if (coreSource == SUBSAMPLED)
+    {
+        CCCoreLib::CloudSamplingTools::SFModulationParams modParams(false);
+        subsampled.reset(CCCoreLib::CloudSamplingTools::resampleCloudSpatially(cloud, samplingDist, modParams, octree.data(), nullptr));
+        if (!subsampled || subsampled->size() == 0)
+        {
+            CCTRACE("Failed to compute sub-sampled core points!");
+            return false;
+        }
+        corePoints = subsampled.data();
+    }
+    const unsigned coreCount = corePoints->size();
+
+    //the GIL is released during the computations (no Python object nor entity creation inside),
+    //it is released before waiting for the descriptors mutex
+    CorePointDescSet descriptors;
+    {
+        py::gil_scoped_release release;
+        QMutexLocker locker(&s_canupoDescriptorsMutex);
+        bool invalidDescriptors = false;
+        QString error;
+        if (!qCanupoTools::ComputeCorePointsDescriptors(corePoints, descriptors, cloud, classifier->scales, invalidDescriptors,
+                                                        error, classifier->descriptorID, maxThreadCount, nullptr, octree.data()))
+        {
+            CCTRACE("Failed to compute the core points descriptors: " << error.toStdString());
+            return false;
+        }
+        if (invalidDescriptors)
+        {
+            CCTRACE("Some descriptors couldn't be computed (min scale may be too small)!");
+        }
+    }
+    if (descriptors.size() != coreCount)
+    {
+        CCTRACE("descriptors and core points mismatch!");
+        return false;
+    }
+
+    //output scalar fields, on the classified cloud
+    int classIdx = cloud->getScalarFieldIndexByName("CANUPO.class");
+    if (classIdx < 0)
+        classIdx = cloud->addScalarField("CANUPO.class");
+    int distIdx = cloud->getScalarFieldIndexByName("CANUPO.boundary distance");
+    if (distIdx < 0)
+        distIdx = cloud->addScalarField("CANUPO.boundary distance");
+    if (classIdx < 0 || distIdx < 0)
+    {
+        CCTRACE("Not enough memory!");
+        return false;
+    }
+    CCCoreLib::ScalarField* classSF = cloud->getScalarField(classIdx);
+    CCCoreLib::ScalarField* distSF = cloud->getScalarField(distIdx);
+
+    bool success = true;
+    py::gil_scoped_release release;
+    auto task = [&]()
+    {
+        std::vector<int> labels(coreCount);
+        std::vector<float> distances(coreCount);
+        ForEachCanupoChunk_(coreCount, [&](unsigned first, unsigned last)
+        {
+            for (unsigned i = first; i < last; ++i)
+                ClassifyCanupoCorePoint_(*classifier, descriptors[i], labels[i], distances[i]);
+        });
+
+        if (corePoints == cloud)
+        {
+            ForEachCanupoChunk_(coreCount, [&](unsigned first, unsigned last)
+            {
+                for (unsigned i = first; i < last; ++i)
+                {
+                    classSF->setValue(i, static_cast<ScalarType>(labels[i]));
+                    distSF->setValue(i, static_cast<ScalarType>(distances[i]));
+                }
+            });
+            return;
+        }
+
+        //propagation to the whole cloud: class of the nearest core point
+        CCCoreLib::DgmOctree coreOctree(corePoints);
+        if (coreOctree.build() <= 0)
+        {
+            CCTRACE("Failed to compute the core points octree!");
+            success = false;
+            return;
+        }
+        unsigned char level = coreOctree.findBestLevelForAGivenNeighbourhoodSizeExtraction(samplingDist);
+        ForEachCanupoChunk_(cloud->size(), [&](unsigned first, unsigned last)
+        {
+            CCCoreLib::ReferenceCloud nearest(corePoints);
+            for (unsigned i = first; i < last; ++i)
+            {
+                double maxSquareDist = 0;
+                nearest.clear(false);
+                if (coreOctree.findPointNeighbourhood(cloud->getPoint(i), &nearest, 1, level, maxSquareDist) == 0)
+                {
+                    classSF->setValue(i, CCCoreLib::NAN_VALUE);
+                    distSF->setValue(i, CCCoreLib::NAN_VALUE);
+                    continue;
+                }
+                unsigned c = nearest.getPointGlobalIndex(0);
+                classSF->setValue(i, static_cast<ScalarType>(labels[c]));
+                distSF->setValue(i, static_cast<ScalarType>(distances[c]));
+            }
+        });
+    };
+#ifdef CC_CORE_LIB_USES_TBB
+    if (maxThreadCount > 0)
+    {
+        tbb::task_arena arena(maxThreadCount);
+        arena.execute(task);
+    }
+    else
+#endif
+    {
+        task();
+    }
+    classSF->computeMinAndMax();
+    distSF->computeMinAndMax();
+    return success;
 }
 
 PYBIND11_MODULE(_Canupo, m9)
@@ -207,8 +544,40 @@ PYBIND11_MODULE(_Canupo, m9)
             py::arg("maxThreadCount")=0,
             py::arg("useActiveSFForConfidence")=false,
             py::arg("samplingDist")=0.,
+            py::arg("exportCorePoints")=false,
             Canupo_Classify_doc);
 
+    m9.def("ClassifyBatch", &ClassifyBatchPy,
+            py::arg("clouds"), py::arg("classifierFilename"),
+            py::arg("coreSource")=ORIGINAL,
+            py::arg("confidenceThreshold")=0.,
+            py::arg("generateAdditionalSF")=false,
+            py::arg("generateRoughnessSF")=false,
+            py::arg("maxThreadCount")=0,
+            py::arg("useActiveSFForConfidence")=false,
+            py::arg("samplingDist")=0.,
+            Canupo_ClassifyBatch_doc);
+
+    py::class_<CanupoClassifier, QSharedPointer<CanupoClassifier> >(m9, "CanupoClassifier", Canupo_CanupoClassifier_doc)
+        .def_readonly("filename", &CanupoClassifier::filename, Canupo_CanupoClassifier_filename_doc)
+        .def_readonly("scales", &CanupoClassifier::scales, Canupo_CanupoClassifier_scales_doc)
+        .def_readonly("descriptorID", &CanupoClassifier::descriptorID, Canupo_CanupoClassifier_descriptorID_doc)
+        .def("classes", &CanupoClassifier::classes, Canupo_CanupoClassifier_classes_doc)
+        .def("classifierCount", [](const CanupoClassifier& self) { return self.classifiers.size(); },
+             Canupo_CanupoClassifier_classifierCount_doc)
+        ;
+
+    m9.def("loadCanupoClassifier", &loadCanupoClassifierPy,
+            py::arg("filename"),
+            Canupo_loadCanupoClassifier_doc);
+
+    m9.def("ClassifyWithClassifier", &ClassifyWithClassifierPy,
+            py::arg("cloud"), py::arg("classifier"),
+            py::arg("coreSource")=ORIGINAL,
+            py::arg("samplingDist")=0.,
+            py::arg("maxThreadCount")=0,
+            Canupo_ClassifyWithClassifier_doc);
+
     m9.def("initTrace_Canupo", initTrace_Canupo, Canupo_initTrace_Canupo_doc);
 }
 
@@ -56,6 +56,97 @@ See `Canupo plugin <https://www.cloudcompare.org/doc/wiki/index.php/CANUPO_(plug
 :param int,optional maxThreadCount: number of threads used for parallel computation, default 0 meaning automatic
 :param bool,optional useActiveSFForConfidence: use the active scalarField as confidence, default False
 :param double,optional samplingDist: default 0., to use if coreSource=SUBSAMPLED, must be >0 in that case.
+:param bool,optional exportCorePoints: with coreSource=SUBSAMPLED, create the core points as a real cloud,
+       child of the classified cloud, default False: the core points are only kept as indexes during the classification.
+
+:return: whether the classification is successful or not
+:rtype: bool
+)";
+
+const char* Canupo_ClassifyBatch_doc=R"(
+Classify a list of point clouds using the same Canupo classifier and parameters.
+
+The core points are the clouds themselves (coreSource=ORIGINAL) or their spatial sub-sampling (coreSource=SUBSAMPLED),
+kept as indexes on the clouds. The clouds are processed one after the other,
+the descriptors of each cloud being computed in parallel (maxThreadCount).
+As with :py:func:`Classify`, each cloud gets the scalar fields 'CANUPO.class' and 'CANUPO.confidence'.
+
+:param list clouds: the point clouds to classify.
+:param string classifierFilename: the path of the Canupo classifier file.
+:param int,optional coreSource: ORIGINAL or SUBSAMPLED, default ORIGINAL
+:param double,optional confidenceThreshold: threshold to use for classification, default 0.
+:param bool,optional generateAdditionalSF: default False
+:param bool,optional generateRoughnessSF: default False
+:param int,optional maxThreadCount: number of threads used for parallel computation, default 0 meaning automatic
+:param bool,optional useActiveSFForConfidence: use the active scalarField as confidence, default False
+:param double,optional samplingDist: default 0., to use if coreSource=SUBSAMPLED, must be >0 in that case.
+
+:return: for each cloud, whether the classification is successful or not
+:rtype: list of bool
+)";
+
+const char* Canupo_CanupoClassifier_doc=R"(
+A Canupo classifier file, loaded and parsed once with :py:func:`loadCanupoClassifier`.
+
+The classifier is read only after loading, the same object can be used to classify any number of clouds
+with :py:func:`ClassifyWithClassifier`, without reading the file again.
+)";
+
+const char* Canupo_CanupoClassifier_filename_doc=R"(
+path of the classifier file.)";
+
+const char* Canupo_CanupoClassifier_scales_doc=R"(
+scales of the descriptors, from the classifier file.)";
+
+const char* Canupo_CanupoClassifier_descriptorID_doc=R"(
+identifier of the descriptor type used by the classifier.)";
+
+const char* Canupo_CanupoClassifier_classes_doc=R"(
+Get the class labels known by the classifier.
+
+:return: the sorted class labels
+:rtype: list of int
+)";
+
+const char* Canupo_CanupoClassifier_classifierCount_doc=R"(
+Get the number of classifiers in the file (one classifier for two classes, one per pair of classes otherwise).
+
+:return: number of classifiers
+:rtype: int
+)";
+
+const char* Canupo_loadCanupoClassifier_doc=R"(
+Load and parse a Canupo classifier file (.prm), to use it with :py:func:`ClassifyWithClassifier`.
+
+:param string filename: the path of the Canupo classifier file.
+
+:return: the classifier, or None if the file can't be read
+:rtype: CanupoClassifier
+)";
+
+const char* Canupo_ClassifyWithClassifier_doc=R"(
+Classify a point cloud using a Canupo classifier already loaded with :py:func:`loadCanupoClassifier`.
+
+The multi-scale descriptors of the core points are computed in parallel,
+then each core point is classified: with a single classifier, the class is given by the side of the decision boundary,
+with several classifiers (one per pair of classes), the class with the most votes wins.
+With coreSource=SUBSAMPLED, the core points are only kept as indexes,
+and each point of the cloud takes the class of its nearest core point (in parallel).
+
+The function produces two scalar fields on the cloud: 'CANUPO.class' and 'CANUPO.boundary distance'
+(distance to the decision boundary in the classifier 2D space, the higher the more reliable).
+The confidence threshold, the additional and roughness scalar fields of :py:func:`Classify` are not available here.
+
+The Python GIL is released during the descriptors computation and the classification,
+so several clouds can be classified from Python threads (do not modify a cloud while it is classified).
+The plugin descriptors computation is not reentrant: concurrent calls compute their descriptors one at a time
+(each computation being itself parallel), the classification steps run concurrently.
+
+:param ccPointCloud cloud: the point cloud to classify.
+:param CanupoClassifier classifier: the loaded classifier.
+:param int,optional coreSource: ORIGINAL or SUBSAMPLED, default ORIGINAL
+:param double,optional samplingDist: default 0., to use if coreSource=SUBSAMPLED, must be >0 in that case.
+:param int,optional maxThreadCount: number of threads used for parallel computation, default 0 meaning automatic
 
 :return: whether the classification is successful or not
 :rtype: bool
@@ -22,7 +22,12 @@
 #include "cloudComPy.hpp"
 
 #include <QString>
+#include <QThread>
 #include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
 
 #include <ccPointCloud.h>
 #include <ccOctree.h>
@@ -31,6 +36,10 @@
 
 #include <qHPR.h>
 
+#ifdef CC_CORE_LIB_USES_TBB
+#include <tbb/parallel_for.h>
+#endif
+
 #include "pyccTrace.h"
 #include "HPR_DocStrings.hpp"
 
@@ -41,108 +50,319 @@ void initTrace_HPR()
 #endif
 }
 
-ccPointCloud* computeHPR( ccPointCloud* cloud,
-                          CCVector3d viewPoint,
-                          int octreeLevel = 7)
+//! octree cells of a cloud at a given level, with one representative point per cell, shared by several HPR computations
+struct HPRCells_
 {
-    CCTRACE("computeHPR");
-    if(octreeLevel < 0 || octreeLevel > CCCoreLib::DgmOctree::MAX_OCTREE_LEVEL)
+    ccOctree::Shared octree;
+    unsigned char level = 0;
+    std::unique_ptr<CCCoreLib::ReferenceCloud> cellCenters;     //!< one point per cell, in cell order
+    CCCoreLib::DgmOctree::cellIndexesContainer cellIndexes;     //!< first position of each cell in the octree codes
+
+    //! end position of a cell in the octree codes
+    unsigned cellEnd(unsigned cell) const
+    {
+        return (cell + 1 < cellIndexes.size() ? cellIndexes[cell + 1] : static_cast<unsigned>(octree->pointsAndTheirCellCodes().size()));
+    }
+
+    //! number of points in a cell
+    unsigned cellSize(unsigned cell) const
+    {
+        return cellEnd(cell) - cellIndexes[cell];
+    }
+
+    //! calls f(pointIndex) for all the points of a cell
+    template <typename F> void forEachPointInCell(unsigned cell, F f) const
+    {
+        const CCCoreLib::DgmOctree::cellsContainer& pointsAndCodes = octree->pointsAndTheirCellCodes();
+        unsigned end = cellEnd(cell);
+        for (unsigned j = cellIndexes[cell]; j < end; ++j)
+            f(pointsAndCodes[j].theIndex);
+    }
+};
+
+//! computes the octree if needed, subsamples the cloud at the octree level and indexes the cells, once
+bool PrepareHPRCells_(ccPointCloud* cloud, int octreeLevel, HPRCells_& cells)
+{
+    if (octreeLevel < 0 || octreeLevel > CCCoreLib::DgmOctree::MAX_OCTREE_LEVEL)
     {
         CCTRACE("octreeLevel must be between 0 and " << CCCoreLib::DgmOctree::MAX_OCTREE_LEVEL);
-        return nullptr;
+        return false;
     }
+    cells.level = static_cast<unsigned char>(octreeLevel);
 
     //compute octree if cloud hasn't any
-    ccOctree::Shared theOctree = cloud->getOctree();
-    if (!theOctree)
+    cells.octree = cloud->getOctree();
+    if (!cells.octree)
     {
-        theOctree = cloud->computeOctree(nullptr);
+        cells.octree = cloud->computeOctree(nullptr);
     }
-
-    if (!theOctree)
+    if (!cells.octree)
     {
         CCTRACE("Couldn't compute octree!");
+        return false;
+    }
+
+    cells.cellCenters.reset(CCCoreLib::CloudSamplingTools::subsampleCloudWithOctreeAtLevel( cloud,
+                                                                                           cells.level,
+                                                                                           CCCoreLib::CloudSamplingTools::NEAREST_POINT_TO_CELL_CENTER,
+                                                                                           nullptr,
+                                                                                           cells.octree.data()) );
+    if (!cells.cellCenters)
+    {
+        CCTRACE("Error while simplifying point cloud with octree!");
+        return false;
+    }
+    if (!cells.octree->getCellIndexes(cells.level, cells.cellIndexes))
+    {
+        CCTRACE("Couldn't fetch the list of octree cell indexes! (Not enough memory?)");
+        return false;
+    }
+    return true;
+}
+
+//! qhull is not reentrant: the convex hulls are computed one at a time
+static std::mutex s_qhullMutex;
+
+//! HPR on the cell representative points: indexes of the cells visible from the view point
+/** Works on a private copy of the cell list, so that several view points can be prepared concurrently.
+    The convex hull step (qhull) is serialized.
+**/
+bool ComputeHPRVisibleCells_(const HPRCells_& cells, const CCVector3d& viewPoint, std::vector<unsigned>& visibleCells)
+{
+    visibleCells.clear();
+    CCCoreLib::ReferenceCloud cellCenters(cells.octree->associatedCloud());
+    if (!cellCenters.add(*cells.cellCenters))
+    {
+        CCTRACE("Not enough memory!");
+        return false;
+    }
+    std::unique_ptr<CCCoreLib::ReferenceCloud> visible;
+    {
+        std::lock_guard<std::mutex> lock(s_qhullMutex);
+        visible.reset(qHPR::removeHiddenPoints(&cellCenters, viewPoint, 3.5));
+    }
+    if (!visible)
+        return false;
+    //only the indexes of 'visible' are valid (they are corresponding to octree cells)
+    visibleCells.resize(visible->size());
+    for (unsigned i = 0; i < visible->size(); ++i)
+        visibleCells[i] = visible->getPointGlobalIndex(i);
+    return true;
+}
+
+ccPointCloud* computeHPR( ccPointCloud* cloud,
+                          CCVector3d viewPoint,
+                          int octreeLevel = 7)
+{
+    CCTRACE("computeHPR");
+    HPRCells_ cells;
+    if (!PrepareHPRCells_(cloud, octreeLevel, cells))
+    {
         return nullptr;
     }
 
     //HPR
-    QScopedPointer<CCCoreLib::ReferenceCloud> visibleCells;
-    {
-        QScopedPointer<CCCoreLib::ReferenceCloud> theCellCenters(
-            CCCoreLib::CloudSamplingTools::subsampleCloudWithOctreeAtLevel( cloud,
-                                                                            static_cast<unsigned char>(octreeLevel),
-                                                                            CCCoreLib::CloudSamplingTools::NEAREST_POINT_TO_CELL_CENTER,
-                                                                            nullptr,
-                                                                            theOctree.data()) );
-        if (!theCellCenters)
-        {
-            CCTRACE("Error while simplifying point cloud with octree!");
-            return nullptr;
-        }
+    std::vector<unsigned> visibleCells;
+    if (!ComputeHPRVisibleCells_(cells, viewPoint, visibleCells))
+    {
+        return nullptr;
+    }
 
-        visibleCells.reset(qHPR::removeHiddenPoints(theCellCenters.data(), viewPoint, 3.5));
+    //DGM: we generate a new cloud now, instead of playing with the points visiblity! (too confusing for the user)
+    unsigned visiblePointCount = 0;
+    for (unsigned cell : visibleCells)
+        visiblePointCount += cells.cellSize(cell);
+    CCTRACE("[HPR] Visible points: " << visiblePointCount);
 
-        //warning: after this point, visibleCells can't be used anymore as a
-        //normal cloud (as it's 'associated cloud' has been deleted).
-        //Only its indexes are valid! (they are corresponding to octree cells)
+    if (visiblePointCount == cloud->size())
+    {
+        CCTRACE("No points were removed!");
+        return nullptr;
     }
 
-    if (visibleCells)
+    CCCoreLib::ReferenceCloud visiblePoints(cells.octree->associatedCloud());
+    if (!visiblePoints.reserve(visiblePointCount))
+    {
+        CCTRACE("Not enough memory!");
+        return nullptr;
+    }
+    for (unsigned cell : visibleCells)
+    {
+        //points in this cell are all visible
+        cells.forEachPointInCell(cell, [&visiblePoints](unsigned index) { visiblePoints.addPointIndex(index); });
+    }
+
+    //create cloud from visibility selection
+    ccPointCloud* newCloud = cloud->partialClone(&visiblePoints);
+    if (newCloud)
+    {
+        newCloud->setName(cloud->getName() + QString(".visible_points"));
+    }
+    else
     {
-        //DGM: we generate a new cloud now, instead of playing with the points visiblity! (too confusing for the user)
-        CCCoreLib::ReferenceCloud visiblePoints(theOctree->associatedCloud());
+        CCTRACE("Not enough memory!");
+    }
+    return newCloud;
+}
 
-        unsigned visiblePointCount = 0;
-        unsigned visibleCellsCount = visibleCells->size();
+py::tuple computeHPRVisibility(ccPointCloud* cloud,
+                               CCVector3d viewPoint,
+                               int octreeLevel = 7,
+                               bool visibilitySF = true,
+                               bool numpyMask = false)
+{
+    CCTRACE("computeHPRVisibility");
+    py::object mask = py::none();
+    HPRCells_ cells;
+    std::vector<unsigned> visibleCells;
+    if (!PrepareHPRCells_(cloud, octreeLevel, cells) || !ComputeHPRVisibleCells_(cells, viewPoint, visibleCells))
+    {
+        return py::make_tuple(-1, mask);
+    }
+    const unsigned pointCount = cloud->size();
+    const unsigned visibleCellCount = static_cast<unsigned>(visibleCells.size());
 
-        CCCoreLib::DgmOctree::cellIndexesContainer cellIndexes;
-        if (!theOctree->getCellIndexes(static_cast<unsigned char>(octreeLevel), cellIndexes))
+    //outputs are allocated once, at the cloud size, and filled per visible cell (cells are disjoint)
+    bool* maskData = nullptr;
+    if (numpyMask)
+    {
+        py::array_t<bool> maskArray(static_cast<size_t>(pointCount));
+        maskData = maskArray.mutable_data();
+        std::fill(maskData, maskData + pointCount, false);
+        mask = maskArray;
+    }
+    CCCoreLib::ScalarField* sf = nullptr;
+    int sfIndex = -1;
+    if (visibilitySF)
+    {
+        static const char* sfName = "HPR visibility";
+        sfIndex = cloud->getScalarFieldIndexByName(sfName);
+        if (sfIndex < 0)
+            sfIndex = cloud->addScalarField(sfName);
+        if (sfIndex < 0)
         {
-            CCTRACE("Couldn't fetch the list of octree cell indexes! (Not enough memory?)");
-            return nullptr;
+            CCTRACE("Not enough memory!");
+            return py::make_tuple(-1, mask);
         }
+        sf = cloud->getScalarField(sfIndex);
+        sf->fill(0);
+    }
 
-        for (unsigned i = 0; i < visibleCellsCount; ++i)
+    auto markCell = [&](unsigned i)
+    {
+        cells.forEachPointInCell(visibleCells[i], [sf, maskData](unsigned index)
         {
-            //cell index
-            unsigned index = visibleCells->getPointGlobalIndex(i);
-
-            //points in this cell...
-            CCCoreLib::ReferenceCloud Yk(theOctree->associatedCloud());
-            theOctree->getPointsInCellByCellIndex(&Yk, cellIndexes[index], static_cast<unsigned char>(octreeLevel));
-            //...are all visible
-            if (!visiblePoints.add(Yk))
-            {
-                CCTRACE("Not enough memory!");
-                return nullptr;
-            }
-        }
+            if (sf)
+                sf->setValue(index, 1);
+            if (maskData)
+                maskData[index] = true;
+        });
+    };
+#ifdef CC_CORE_LIB_USES_TBB
+    tbb::parallel_for(static_cast<unsigned>(0), visibleCellCount, markCell);
+#else
+    for (unsigned i = 0; i < visibleCellCount; ++i)
+        markCell(i);
+#endif
+    if (sf)
+        sf->computeMinAndMax();
+    return py::make_tuple(sfIndex, mask);
+}
 
-        visibleCells.reset(nullptr);
+py::tuple computeHPRMulti(ccPointCloud* cloud,
+                          py::array_t<double, py::array::c_style | py::array::forcecast> viewPoints,
+                          int octreeLevel = 7,
+                          bool countsSF = true,
+                          bool packedBitset = true)
+{
+    CCTRACE("computeHPRMulti");
+    py::object bitset = py::none();
+    if (viewPoints.ndim() != 2 || viewPoints.shape(1) != 3)
+    {
+        CCTRACE("viewPoints must be an array of shape (N, 3)");
+        return py::make_tuple(-1, bitset);
+    }
+    HPRCells_ cells;
+    if (!PrepareHPRCells_(cloud, octreeLevel, cells))
+    {
+        return py::make_tuple(-1, bitset);
+    }
+    const unsigned viewPointCount = static_cast<unsigned>(viewPoints.shape(0));
+    const unsigned pointCount = cloud->size();
+    const unsigned cellCount = static_cast<unsigned>(cells.cellIndexes.size());
+    const size_t rowBytes = (static_cast<size_t>(pointCount) + 7) / 8;
+    CCTRACE("view points: " << viewPointCount << " cells: " << cellCount);
 
-        CCTRACE("[HPR] Visible points: " << visiblePointCount);
+    //outputs are allocated once, at their final size
+    uint8_t* bits = nullptr;
+    if (packedBitset)
+    {
+        py::array_t<uint8_t> bitArray({ static_cast<size_t>(viewPointCount), rowBytes });
+        bits = bitArray.mutable_data();
+        std::fill(bits, bits + viewPointCount * rowBytes, static_cast<uint8_t>(0));
+        bitset = bitArray;
+    }
+    std::vector<std::atomic<unsigned>> cellVisibility(countsSF ? cellCount : 0);
+    for (std::atomic<unsigned>& c : cellVisibility)
+        c = 0;
 
-        if (visiblePoints.size() == cloud->size())
+    const double* vp = viewPoints.data();
+    std::atomic<unsigned> failures(0);
+    auto processViewPoint = [&](unsigned v)
+    {
+        std::vector<unsigned> visibleCells;
+        if (!ComputeHPRVisibleCells_(cells, CCVector3d(vp[3 * v], vp[3 * v + 1], vp[3 * v + 2]), visibleCells))
         {
-            CCTRACE("No points were removed!");
-            return nullptr;
+            ++failures;
+            return;
         }
-        else
+        uint8_t* row = (bits ? bits + v * rowBytes : nullptr);
+        for (unsigned cell : visibleCells)
         {
-            //create cloud from visibility selection
-            ccPointCloud* newCloud = cloud->partialClone(&visiblePoints);
-            if (newCloud)
-            {
-                newCloud->setName(cloud->getName() + QString(".visible_points"));
-            }
-            else
-            {
-                CCTRACE("Not enough memory!");
-            }
-            return newCloud;
+            if (countsSF)
+                ++cellVisibility[cell];
+            if (row)
+                cells.forEachPointInCell(cell, [row](unsigned index) { row[index >> 3] |= static_cast<uint8_t>(0x80 >> (index & 7)); });
         }
+    };
+#ifdef CC_CORE_LIB_USES_TBB
+    tbb::parallel_for(static_cast<unsigned>(0), viewPointCount, processViewPoint);
+#else
+    for (unsigned v = 0; v < viewPointCount; ++v)
+        processViewPoint(v);
+#endif
+    if (failures)
+    {
+        CCTRACE("[HPR] failed for " << failures << " view points");
+    }
+
+    int sfIndex = -1;
+    if (countsSF)
+    {
+        static const char* sfName = "HPR visibility count";
+        sfIndex = cloud->getScalarFieldIndexByName(sfName);
+        if (sfIndex < 0)
+            sfIndex = cloud->addScalarField(sfName);
+        if (sfIndex < 0)
+        {
+            CCTRACE("Not enough memory!");
+            return py::make_tuple(-1, bitset);
+        }
+        CCCoreLib::ScalarField* sf = cloud->getScalarField(sfIndex);
+        auto fillCell = [&](unsigned cell)
+        {
+            ScalarType count = static_cast<ScalarType>(cellVisibility[cell].load());
+            cells.forEachPointInCell(cell, [sf, count](unsigned index) { sf->setValue(index, count); });
+        };
+#ifdef CC_CORE_LIB_USES_TBB
+        tbb::parallel_for(static_cast<unsigned>(0), cellCount, fillCell);
+#else
+        for (unsigned cell = 0; cell < cellCount; ++cell)
+            fillCell(cell);
+#endif
+        sf->computeMinAndMax();
     }
-    return nullptr;
+    return py::make_tuple(sfIndex, bitset);
 }
 
 PYBIND11_MODULE(_HPR, m3)
@@ -152,5 +372,13 @@ PYBIND11_MODULE(_HPR, m3)
     m3.def("computeHPR", computeHPR,
         py::arg("cloud"), py::arg("viewPoint"), py::arg("octreeLevel")=7,
         HPR_computeHPR_doc, py::return_value_policy::reference);
+    m3.def("computeHPRVisibility", computeHPRVisibility,
+        py::arg("cloud"), py::arg("viewPoint"), py::arg("octreeLevel")=7,
+        py::arg("visibilitySF")=true, py::arg("numpyMask")=false,
+        HPR_computeHPRVisibility_doc);
+    m3.def("computeHPRMulti", computeHPRMulti,
+        py::arg("cloud"), py::arg("viewPoints"), py::arg("octreeLevel")=7,
+        py::arg("countsSF")=true, py::arg("packedBitset")=true,
+        HPR_computeHPRMulti_doc);
     m3.def("initTrace_HPR", initTrace_HPR, HPR_initTrace_HPR_doc);
 }
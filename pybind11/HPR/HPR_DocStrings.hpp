@@ -55,6 +55,47 @@ The viewPoint coordinates are required.
 :rtype: ccPointCloud
 )";
 
+const char* HPR_computeHPRVisibility_doc=R"(
+Compute Hidden Point Removal for a point cloud, without creating a new cloud. (plugin HPR)
+
+Unlike :py:func:`computeHPR`, the visible points are not copied (no coordinates nor scalar fields duplication):
+the visibility is written in place, in a scalar field 'HPR visibility' (1: visible, 0: hidden, added to the cloud or overwritten),
+and/or returned as a numpy boolean mask, usable later to filter the cloud.
+
+:param ccPointCloud cloud: input cloud
+:param ccVector3D viewPoint: view point coordinates
+:param int,optional octreeLevel: octree level, default 7.
+:param bool,optional visibilitySF: write the visibility scalar field, default True.
+:param bool,optional numpyMask: return a numpy boolean mask of the visible points, default False.
+
+:return: a tuple (index of the visibility scalar field or -1, mask or None)
+:rtype: tuple
+)";
+
+const char* HPR_computeHPRMulti_doc=R"(
+Compute Hidden Point Removal for a point cloud, from several view points. (plugin HPR)
+
+The cloud is subsampled and its octree cells are indexed once, then the view points are processed in parallel,
+except the convex hull computation (qhull is not reentrant) which runs for one view point at a time.
+No cloud is created: the visibility is returned as a count scalar field and/or a packed bitset.
+
+The count scalar field 'HPR visibility count' (added to the cloud, or overwritten)
+gives, for each point, the number of view points from which it is visible.
+
+The bitset is a numpy array of uint8, of shape (number of view points, (number of points + 7) // 8).
+The visibility mask of the view point v is obtained with:
+``numpy.unpackbits(bitset[v], count=cloud.size()).astype(bool)``.
+
+:param ccPointCloud cloud: input cloud
+:param numpy.array viewPoints: view point coordinates, array of shape (N, 3)
+:param int,optional octreeLevel: octree level, default 7.
+:param bool,optional countsSF: add the count scalar field to the cloud, default True.
+:param bool,optional packedBitset: return the packed bitset, default True.
+
+:return: a tuple (index of the count scalar field or -1, bitset or None)
+:rtype: tuple
+)";
+
 const char* HPR_initTrace_HPR_doc=R"(
 Debug trace must be initialized for each Python module.
 
@@ -22,11 +22,25 @@
 #include "cloudComPy.hpp"
 
 #include <QString>
+#include <QSettings>
+#include <QFileInfo>
+#include <QThread>
 #include <vector>
+#include <memory>
+#include <functional>
+#include <limits>
+#include <algorithm>
+#include <cmath>
 
 #include <ccPointCloud.h>
+#include <ccScalarField.h>
 #include <ccHObject.h>
 #include <ccHObjectCaster.h>
+#include <CloudSamplingTools.h>
+#include <DgmOctree.h>
+#include <GeometricalAnalysisTools.h>
+#include <Neighbourhood.h>
+#include <ReferenceCloud.h>
 #include "pyccTrace.h"
 #include "M3C2_DocStrings.hpp"
 
@@ -34,6 +48,11 @@
 #include "qM3C2Tools.h"
 #include "qM3C2Dialog.h"
 
+#ifdef CC_CORE_LIB_USES_TBB
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+#endif
+
 void initTrace_M3C2()
 {
 #ifdef _PYTHONAPI_DEBUG_
@@ -41,6 +60,733 @@ void initTrace_M3C2()
 #endif
 }
 
+//! M3C2 parameters, kept in memory (same meaning as the keys of the plugin parameter file)
+struct M3C2Parameters
+{
+    double normalScale = 0;                 //!< diameter of the neighbourhood used for the normals (NormalScale)
+    int normalMode = 0;                     //!< 0: default, 1: cloud #1 normals, 2: multi-scale, 3: vertical, 4: horizontal (NormalMode)
+    double normalMinScale = 0;              //!< multi-scale mode: smallest diameter (NormalMinScale)
+    double normalStep = 0;                  //!< multi-scale mode: diameter step (NormalStep)
+    double normalMaxScale = 0;              //!< multi-scale mode: largest diameter (NormalMaxScale)
+    int normalPreferedOri = 4;              //!< 0..5: +X,-X,+Y,-Y,+Z,-Z, 6,7: +/-barycenter, 8,9: +/-origin (NormalPreferedOri)
+    double searchScale = 0;                 //!< projection cylinder diameter (SearchScale)
+    double searchDepth = 0;                 //!< projection cylinder half height (SearchDepth)
+    bool positiveSearchOnly = false;        //!< search only in the normal direction (PositiveSearchOnly)
+    bool useMedian = false;                 //!< median instead of mean along the cylinder axis (UseMedian)
+    bool useMinPoints4Stat = false;         //!< require a minimum population for the statistics (UseMinPoints4Stat)
+    unsigned minPoints4Stat = 5;            //!< minimum population for the statistics (MinPoints4Stat)
+    bool registrationErrorEnabled = false;  //!< add the registration error to the uncertainty (RegistrationErrorEnabled)
+    double registrationError = 0;           //!< registration error (RegistrationError)
+    bool useOriginalCloud = false;          //!< use the whole cloud #1 as core points (UseOriginalCloud)
+    bool subsampleEnabled = true;           //!< subsample cloud #1 to get the core points (SubsampleEnabled)
+    double subsampleRadius = 0;             //!< core points minimal spacing (SubsampleRadius)
+    bool exportStdDevInfo = false;          //!< export the 'STD cloud1' and 'STD cloud2' scalar fields (ExportStdDevInfo)
+    bool exportDensityAtProjScale = false;  //!< export the 'Npoints cloud1' and 'Npoints cloud2' scalar fields (ExportDensityAtProjScale)
+    bool normalUseCorePoints = false;       //!< compute the normals on the core points instead of cloud #1 (NormalUseCorePoints)
+    bool useSinglePass4Depth = false;       //!< one search over the whole cylinder instead of a progressive search (UseSinglePass4Depth)
+    bool usePrecisionMaps = false;          //!< uncertainty from the precision maps (UsePrecisionMaps)
+    double pm1Scale = 1.0;                  //!< precision maps scale of cloud #1 (PM1Scale)
+    double pm2Scale = 1.0;                  //!< precision maps scale of cloud #2 (PM2Scale)
+    int projDestIndex = 2;                  //!< output points: 0: projected on cloud #1, 1: projected on cloud #2, 2: core points (ProjDestIndex)
+    int maxThreadCount = 0;                 //!< maximum number of threads, 0 for all (MaxThreadCount)
+
+    //! reads the values from a parameter file (see M3C2guessParamsToFile), missing keys keep their value
+    bool loadFromFile(const QString& paramFilename)
+    {
+        if (!QFileInfo::exists(paramFilename))
+        {
+            CCTRACE("M3C2 parameter file not found: " << paramFilename.toStdString());
+            return false;
+        }
+        QSettings settings(paramFilename, QSettings::IniFormat);
+        normalScale = settings.value("NormalScale", normalScale).toDouble();
+        normalMode = settings.value("NormalMode", normalMode).toInt();
+        normalMinScale = settings.value("NormalMinScale", normalMinScale).toDouble();
+        normalStep = settings.value("NormalStep", normalStep).toDouble();
+        normalMaxScale = settings.value("NormalMaxScale", normalMaxScale).toDouble();
+        normalPreferedOri = settings.value("NormalPreferedOri", normalPreferedOri).toInt();
+        searchScale = settings.value("SearchScale", searchScale).toDouble();
+        searchDepth = settings.value("SearchDepth", searchDepth).toDouble();
+        positiveSearchOnly = settings.value("PositiveSearchOnly", positiveSearchOnly).toBool();
+        useMedian = settings.value("UseMedian", useMedian).toBool();
+        useMinPoints4Stat = settings.value("UseMinPoints4Stat", useMinPoints4Stat).toBool();
+        minPoints4Stat = settings.value("MinPoints4Stat", minPoints4Stat).toUInt();
+        registrationErrorEnabled = settings.value("RegistrationErrorEnabled", registrationErrorEnabled).toBool();
+        registrationError = settings.value("RegistrationError", registrationError).toDouble();
+        useOriginalCloud = settings.value("UseOriginalCloud", useOriginalCloud).toBool();
+        subsampleEnabled = settings.value("SubsampleEnabled", subsampleEnabled).toBool();
+        subsampleRadius = settings.value("SubsampleRadius", subsampleRadius).toDouble();
+        exportStdDevInfo = settings.value("ExportStdDevInfo", exportStdDevInfo).toBool();
+        exportDensityAtProjScale = settings.value("ExportDensityAtProjScale", exportDensityAtProjScale).toBool();
+        normalUseCorePoints = settings.value("NormalUseCorePoints", normalUseCorePoints).toBool();
+        useSinglePass4Depth = settings.value("UseSinglePass4Depth", useSinglePass4Depth).toBool();
+        usePrecisionMaps = settings.value("UsePrecisionMaps", usePrecisionMaps).toBool();
+        pm1Scale = settings.value("PM1Scale", pm1Scale).toDouble();
+        pm2Scale = settings.value("PM2Scale", pm2Scale).toDouble();
+        projDestIndex = settings.value("ProjDestIndex", projDestIndex).toInt();
+        maxThreadCount = settings.value("MaxThreadCount", maxThreadCount).toInt();
+        return (settings.status() == QSettings::NoError);
+    }
+
+    //! writes the values to a parameter file, readable by computeM3C2 and the GUI
+    bool saveToFile(const QString& paramFilename) const
+    {
+        QSettings settings(paramFilename, QSettings::IniFormat);
+        settings.setValue("M3C2VER", 1);
+        settings.setValue("NormalScale", normalScale);
+        settings.setValue("NormalMode", normalMode);
+        settings.setValue("NormalMinScale", normalMinScale);
+        settings.setValue("NormalStep", normalStep);
+        settings.setValue("NormalMaxScale", normalMaxScale);
+        settings.setValue("NormalPreferedOri", normalPreferedOri);
+        settings.setValue("SearchScale", searchScale);
+        settings.setValue("SearchDepth", searchDepth);
+        settings.setValue("PositiveSearchOnly", positiveSearchOnly);
+        settings.setValue("UseMedian", useMedian);
+        settings.setValue("UseMinPoints4Stat", useMinPoints4Stat);
+        settings.setValue("MinPoints4Stat", minPoints4Stat);
+        settings.setValue("RegistrationErrorEnabled", registrationErrorEnabled);
+        settings.setValue("RegistrationError", registrationError);
+        settings.setValue("UseOriginalCloud", useOriginalCloud);
+        settings.setValue("SubsampleEnabled", subsampleEnabled);
+        settings.setValue("SubsampleRadius", subsampleRadius);
+        settings.setValue("ExportStdDevInfo", exportStdDevInfo);
+        settings.setValue("ExportDensityAtProjScale", exportDensityAtProjScale);
+        settings.setValue("NormalUseCorePoints", normalUseCorePoints);
+        settings.setValue("UseSinglePass4Depth", useSinglePass4Depth);
+        settings.setValue("UsePrecisionMaps", usePrecisionMaps);
+        settings.setValue("PM1Scale", pm1Scale);
+        settings.setValue("PM2Scale", pm2Scale);
+        settings.setValue("ProjDestIndex", projDestIndex);
+        settings.setValue("MaxThreadCount", maxThreadCount);
+        settings.sync();
+        return (settings.status() == QSettings::NoError);
+    }
+};
+
+//! precision map of a cloud: per point sigma along X, Y, Z and a scale factor
+struct M3C2PrecisionMap_
+{
+    const CCCoreLib::ScalarField* sX = nullptr;
+    const CCCoreLib::ScalarField* sY = nullptr;
+    const CCCoreLib::ScalarField* sZ = nullptr;
+    double scale = 1.0;
+
+    bool isValid() const { return sX && sY && sZ; }
+};
+
+//! statistics of the points of a cloud inside the projection cylinder of a core point
+struct M3C2CylinderStats_
+{
+    unsigned count = 0;
+    bool valid = false;                                             //!< enough points for the statistics
+    double value = std::numeric_limits<double>::quiet_NaN();        //!< mean or median position along the normal
+    double spread = std::numeric_limits<double>::quiet_NaN();       //!< standard deviation, or interquartile range with the median
+    double pmVariance = std::numeric_limits<double>::quiet_NaN();   //!< mean variance along the normal given by the precision maps
+};
+
+//! core points, normals and reference side statistics, computed once and shared by all the compared clouds
+struct M3C2Reference_
+{
+    ccPointCloud* reference = nullptr;
+    CCCoreLib::GenericIndexedCloudPersist* corePoints = nullptr;
+    std::unique_ptr<CCCoreLib::ReferenceCloud> subsampledCorePoints;
+    std::vector<CCVector3> normals;         //!< null vector when the normal is undefined
+    std::vector<ScalarType> normalScales;   //!< multi-scale mode only
+    std::vector<M3C2CylinderStats_> stats;
+};
+
+//! scalar fields of an M3C2 output cloud (some are optional)
+struct M3C2Output_
+{
+    ccPointCloud* cloud = nullptr;
+    ccScalarField* distance = nullptr;
+    ccScalarField* uncertainty = nullptr;
+    ccScalarField* significant = nullptr;
+    ccScalarField* std1 = nullptr;
+    ccScalarField* std2 = nullptr;
+    ccScalarField* count1 = nullptr;
+    ccScalarField* count2 = nullptr;
+    ccScalarField* normalScale = nullptr;
+    std::vector<double> projection;     //!< offset along the normal of each output point (projDestIndex 0 or 1)
+};
+
+//! runs processChunk(first, last) over [0, count), in parallel if TBB is available
+void ForEachM3C2Chunk_(unsigned count, const std::function<void(unsigned, unsigned)>& processChunk)
+{
+#ifdef CC_CORE_LIB_USES_TBB
+    unsigned chunkCount = std::min(static_cast<unsigned>(std::max(QThread::idealThreadCount(), 1)) * 8, std::max(count / 256, 1u));
+    unsigned chunkSize = (count + chunkCount - 1) / chunkCount;
+    tbb::parallel_for(static_cast<unsigned>(0), chunkCount, [&](unsigned c)
+    {
+        processChunk(c * chunkSize, std::min(count, (c + 1) * chunkSize));
+    });
+#else
+    processChunk(0, count);
+#endif
+}
+
+//! runs the task in an arena limited to maxThreadCount threads (all threads if 0)
+void RunM3C2Task_(int maxThreadCount, const std::function<void()>& task)
+{
+#ifdef CC_CORE_LIB_USES_TBB
+    if (maxThreadCount > 0)
+    {
+        tbb::task_arena arena(maxThreadCount);
+        arena.execute(task);
+        return;
+    }
+#endif
+    task();
+}
+
+//! least squares plane normal of the neighbourhood of P in the octree cloud (optionally its normal change rate)
+bool ComputeM3C2LocalNormal_(const CCCoreLib::DgmOctree& octree,
+                             const CCVector3& P,
+                             PointCoordinateType radius,
+                             CCCoreLib::DgmOctree::NeighboursSet& neighbours,
+                             CCCoreLib::ReferenceCloud& points,
+                             CCVector3& N,
+                             ScalarType* normalChangeRate = nullptr)
+{
+    neighbours.clear();
+    points.clear();
+    unsigned char level = octree.findBestLevelForAGivenNeighbourhoodSizeExtraction(radius);
+    octree.getPointsInSphericalNeighbourhood(P, radius, neighbours, level);
+    if (neighbours.size() < 3)
+        return false;
+    for (const CCCoreLib::DgmOctree::PointDescriptor& D : neighbours)
+        points.addPointIndex(D.pointIndex);
+    CCCoreLib::Neighbourhood Z(&points);
+    const CCVector3* LSN = Z.getLSPlaneNormal();
+    if (!LSN)
+        return false;
+    N = *LSN;
+    if (normalChangeRate)
+        *normalChangeRate = Z.computeCurvature(P, CCCoreLib::Neighbourhood::NORMAL_CHANGE_RATE);
+    return true;
+}
+
+//! mean and standard deviation, or median and interquartile range, of the positions along the normal (same as the plugin)
+void ComputeM3C2Statistics_(const CCCoreLib::DgmOctree::NeighboursSet& neighbours,
+                            const M3C2Parameters& params,
+                            const M3C2PrecisionMap_& precisionMap,
+                            const CCVector3& P,
+                            const CCVector3& N,
+                            std::vector<double>& values,
+                            M3C2CylinderStats_& stats)
+{
+    values.clear();
+    double sum = 0;
+    double sum2 = 0;
+    double sumPM = 0;
+    for (const CCCoreLib::DgmOctree::PointDescriptor& D : neighbours)
+    {
+        double v = (*D.point - P).dot(N);
+        values.push_back(v);
+        sum += v;
+        sum2 += v * v;
+        if (precisionMap.isValid())
+        {
+            double sx = precisionMap.sX->getValue(D.pointIndex) * N.x;
+            double sy = precisionMap.sY->getValue(D.pointIndex) * N.y;
+            double sz = precisionMap.sZ->getValue(D.pointIndex) * N.z;
+            sumPM += (sx * sx + sy * sy + sz * sz) * precisionMap.scale * precisionMap.scale;
+        }
+    }
+    size_t n = values.size();
+    if (params.useMedian)
+    {
+        std::sort(values.begin(), values.end());
+        size_t half = n / 2;
+        stats.value = ((n & 1) ? values[half] : (values[half - 1] + values[half]) / 2);
+        stats.spread = values[(3 * n) / 4] - values[n / 4];
+    }
+    else
+    {
+        stats.value = sum / n;
+        stats.spread = std::sqrt(std::abs(sum2 / n - stats.value * stats.value));
+    }
+    if (precisionMap.isValid())
+        stats.pmVariance = sumPM / n;
+    stats.valid = true;
+}
+
+//! position statistics, along the normal, of the points of the octree cloud inside the projection cylinder
+/** Unless useSinglePass4Depth is set, the cylinder grows progressively and the search stops
+    as soon as the statistics are stable (same criterion as the plugin).
+**/
+M3C2CylinderStats_ ComputeM3C2CylinderStats_(const CCCoreLib::DgmOctree& octree,
+                                             unsigned char level,
+                                             const CCVector3& P,
+                                             const CCVector3& N,
+                                             const M3C2Parameters& params,
+                                             const M3C2PrecisionMap_& precisionMap,
+                                             std::vector<double>& values)
+{
+    M3C2CylinderStats_ stats;
+    const size_t minPoints = (params.useMinPoints4Stat ? std::max(params.minPoints4Stat, 1u) : 1u);
+    if (params.useSinglePass4Depth)
+    {
+        CCCoreLib::DgmOctree::CylindricalNeighbourhood cn;
+        cn.center = P;
+        cn.dir = N;
+        cn.radius = static_cast<PointCoordinateType>(params.searchScale / 2);
+        cn.maxHalfLength = static_cast<PointCoordinateType>(params.searchDepth);
+        cn.onlyPositiveDir = params.positiveSearchOnly;
+        cn.level = level;
+        octree.getPointsInCylindricalNeighbourhood(cn);
+        stats.count = static_cast<unsigned>(cn.neighbours.size());
+        if (stats.count >= minPoints)
+            ComputeM3C2Statistics_(cn.neighbours, params, precisionMap, P, N, values, stats);
+        return stats;
+    }
+
+    CCCoreLib::DgmOctree::ProgressiveCylindricalNeighbourhood cn;
+    cn.center = P;
+    cn.dir = N;
+    cn.radius = static_cast<PointCoordinateType>(params.searchScale / 2);
+    cn.maxHalfLength = static_cast<PointCoordinateType>(params.searchDepth);
+    cn.onlyPositiveDir = params.positiveSearchOnly;
+    cn.level = level;
+    size_t previousCount = 0;
+    while (cn.currentHalfLength < cn.maxHalfLength)
+    {
+        size_t count = octree.getPointsInCylindricalNeighbourhoodProgressive(cn);
+        if (count == previousCount)
+            continue;
+        previousCount = count;
+        if (count < minPoints)
+            continue;
+        ComputeM3C2Statistics_(cn.neighbours, params, precisionMap, P, N, values, stats);
+        if (std::abs(stats.value) + stats.spread < cn.currentHalfLength)
+            break;
+    }
+    stats.count = static_cast<unsigned>(cn.neighbours.size());
+    return stats;
+}
+
+//! selects the core points, computes their normals and the reference side statistics
+bool PrepareM3C2Reference_(ccPointCloud* reference,
+                           ccPointCloud* corePointsCloud,
+                           const M3C2Parameters& params,
+                           const M3C2PrecisionMap_& precisionMap,
+                           M3C2Reference_& ref)
+{
+    if (!reference || reference->size() == 0)
+    {
+        CCTRACE("M3C2: empty reference cloud");
+        return false;
+    }
+    if (params.searchScale <= 0 || params.searchDepth <= 0)
+    {
+        CCTRACE("M3C2: searchScale and searchDepth must be positive");
+        return false;
+    }
+    bool multiScale = (params.normalMode == 2);
+    if (multiScale && (params.normalMinScale <= 0 || params.normalStep <= 0 || params.normalMaxScale < params.normalMinScale))
+    {
+        CCTRACE("M3C2: invalid multi-scale normal parameters");
+        return false;
+    }
+    if ((params.normalMode == 0 || params.normalMode == 4) && params.normalScale <= 0)
+    {
+        CCTRACE("M3C2: normalScale must be positive");
+        return false;
+    }
+    if (params.normalMode < 0 || params.normalMode > 4)
+    {
+        CCTRACE("M3C2: unknown normal mode " << params.normalMode);
+        return false;
+    }
+    ref.reference = reference;
+
+    //core points
+    if (corePointsCloud)
+    {
+        ref.corePoints = corePointsCloud;
+    }
+    else if (params.subsampleEnabled && !params.useOriginalCloud && params.subsampleRadius > 0)
+    {
+        CCCoreLib::CloudSamplingTools::SFModulationParams modParams(false);
+        ref.subsampledCorePoints.reset(CCCoreLib::CloudSamplingTools::resampleCloudSpatially(reference,
+                                                                                            static_cast<PointCoordinateType>(params.subsampleRadius),
+                                                                                            modParams));
+        if (!ref.subsampledCorePoints)
+        {
+            CCTRACE("M3C2: failed to subsample the core points");
+            return false;
+        }
+        ref.corePoints = ref.subsampledCorePoints.get();
+    }
+    else
+    {
+        ref.corePoints = reference;
+    }
+    unsigned coreCount = ref.corePoints->size();
+    if (coreCount == 0)
+    {
+        CCTRACE("M3C2: no core points");
+        return false;
+    }
+
+    CCCoreLib::DgmOctree octree(reference);
+    if (octree.build() <= 0)
+    {
+        CCTRACE("M3C2: failed to compute the reference octree (not enough memory?)");
+        return false;
+    }
+
+    //the normals may be computed on the core points instead of cloud #1
+    CCCoreLib::GenericIndexedCloudPersist* normalSource = reference;
+    std::unique_ptr<CCCoreLib::DgmOctree> coreOctree;
+    if (params.normalUseCorePoints && ref.corePoints != reference && params.normalMode != 1 && params.normalMode != 3)
+    {
+        normalSource = ref.corePoints;
+        coreOctree.reset(new CCCoreLib::DgmOctree(normalSource));
+        if (coreOctree->build() <= 0)
+        {
+            CCTRACE("M3C2: failed to compute the core points octree (not enough memory?)");
+            return false;
+        }
+    }
+    const CCCoreLib::DgmOctree& normalOctree = (coreOctree ? *coreOctree : octree);
+
+    try
+    {
+        ref.normals.resize(coreCount, CCVector3(0, 0, 0));
+        ref.stats.resize(coreCount);
+        if (multiScale)
+            ref.normalScales.resize(coreCount, CCCoreLib::NAN_VALUE);
+    }
+    catch (const std::bad_alloc&)
+    {
+        CCTRACE("M3C2: not enough memory");
+        return false;
+    }
+
+    //normals
+    if (params.normalMode == 1 && !(corePointsCloud && corePointsCloud->hasNormals()) && !reference->hasNormals())
+    {
+        CCTRACE("M3C2: no normals on cloud #1 or on the core points");
+        return false;
+    }
+    const CCVector3 G = CCCoreLib::GeometricalAnalysisTools::ComputeGravityCenter(reference);
+    auto preferredDirection = [&](const CCVector3& P)
+    {
+        switch (params.normalPreferedOri)
+        {
+        case 0: return CCVector3(1, 0, 0);
+        case 1: return CCVector3(-1, 0, 0);
+        case 2: return CCVector3(0, 1, 0);
+        case 3: return CCVector3(0, -1, 0);
+        case 5: return CCVector3(0, 0, -1);
+        case 6: return CCVector3(P - G);
+        case 7: return CCVector3(G - P);
+        case 8: return CCVector3(P);
+        case 9: return CCVector3(-P);
+        default: return CCVector3(0, 0, 1);
+        }
+    };
+    unsigned char nnLevel = octree.findBestLevelForAGivenPopulationPerCell(2);
+    ForEachM3C2Chunk_(coreCount, [&](unsigned first, unsigned last)
+    {
+        CCCoreLib::DgmOctree::NeighboursSet neighbours;
+        CCCoreLib::ReferenceCloud points(reference);
+        CCCoreLib::ReferenceCloud normalPoints(normalSource);
+        for (unsigned i = first; i < last; ++i)
+        {
+            const CCVector3& P = *ref.corePoints->getPoint(i);
+            CCVector3 N(0, 0, 0);
+            bool valid = false;
+            switch (params.normalMode)
+            {
+            case 1:
+                if (corePointsCloud && corePointsCloud->hasNormals())
+                {
+                    N = corePointsCloud->getPointNormal(i);
+                }
+                else if (ref.corePoints == reference)
+                {
+                    N = reference->getPointNormal(i);
+                }
+                else if (ref.subsampledCorePoints)
+                {
+                    N = reference->getPointNormal(ref.subsampledCorePoints->getPointGlobalIndex(i));
+                }
+                else
+                {
+                    double maxSquareDist = 0;
+                    points.clear();
+                    if (octree.findPointNeighbourhood(&P, &points, 1, nnLevel, maxSquareDist) > 0)
+                        N = reference->getPointNormal(points.getPointGlobalIndex(0));
+                }
+                valid = (N.norm2() > 0);
+                break;
+            case 2:
+            {
+                ScalarType bestRate = std::numeric_limits<ScalarType>::max();
+                for (double scale = params.normalMinScale; scale <= params.normalMaxScale * (1.0 + 1.0e-6); scale += params.normalStep)
+                {
+                    CCVector3 Ns;
+                    ScalarType rate = CCCoreLib::NAN_VALUE;
+                    if (ComputeM3C2LocalNormal_(normalOctree, P, static_cast<PointCoordinateType>(scale / 2), neighbours, normalPoints, Ns, &rate)
+                        && CCCoreLib::ScalarField::ValidValue(rate) && rate < bestRate)
+                    {
+                        bestRate = rate;
+                        N = Ns;
+                        ref.normalScales[i] = static_cast<ScalarType>(scale);
+                        valid = true;
+                    }
+                }
+            }
+            break;
+            case 3:
+                N = CCVector3(0, 0, 1);
+                valid = true;
+                break;
+            case 4:
+                if (ComputeM3C2LocalNormal_(normalOctree, P, static_cast<PointCoordinateType>(params.normalScale / 2), neighbours, normalPoints, N))
+                {
+                    N.z = 0;
+                    valid = (N.norm2() > std::numeric_limits<PointCoordinateType>::epsilon());
+                }
+                break;
+            default:
+                valid = ComputeM3C2LocalNormal_(normalOctree, P, static_cast<PointCoordinateType>(params.normalScale / 2), neighbours, normalPoints, N);
+                break;
+            }
+            if (!valid)
+                continue;
+            N.normalize();
+            if (params.normalMode != 1 && params.normalMode != 3 && N.dot(preferredDirection(P)) < 0)
+                N = -N;
+            ref.normals[i] = N;
+        }
+    });
+
+    //reference side of the projection cylinders
+    unsigned char cylinderLevel = octree.findBestLevelForAGivenNeighbourhoodSizeExtraction(static_cast<PointCoordinateType>(params.searchScale / 2));
+    ForEachM3C2Chunk_(coreCount, [&](unsigned first, unsigned last)
+    {
+        std::vector<double> values;
+        for (unsigned i = first; i < last; ++i)
+        {
+            if (ref.normals[i].norm2() > 0)
+                ref.stats[i] = ComputeM3C2CylinderStats_(octree, cylinderLevel, *ref.corePoints->getPoint(i), ref.normals[i],
+                                                         params, precisionMap, values);
+        }
+    });
+    return true;
+}
+
+//! creates the output cloud (core points, M3C2 normals) and its scalar fields, not thread safe
+bool CreateM3C2Output_(const M3C2Reference_& ref,
+                       ccPointCloud* compared,
+                       const M3C2Parameters& params,
+                       M3C2Output_& output)
+{
+    unsigned coreCount = ref.corePoints->size();
+    ccPointCloud* cloud = new ccPointCloud(QString("[M3C2] %1 vs %2").arg(ref.reference->getName()).arg(compared->getName()));
+    if (!cloud->reserve(coreCount) || !cloud->reserveTheNormsTable())
+    {
+        delete cloud;
+        CCTRACE("M3C2: not enough memory");
+        return false;
+    }
+    for (unsigned i = 0; i < coreCount; ++i)
+    {
+        cloud->addPoint(*ref.corePoints->getPoint(i));
+        cloud->addNorm(ref.normals[i]);
+    }
+    cloud->copyGlobalShiftAndScale(*ref.reference);
+    output.cloud = cloud;
+
+    auto addSF = [&](const char* name, ccScalarField*& sf)
+    {
+        sf = new ccScalarField(name);
+        if (!sf->resizeSafe(coreCount, true, CCCoreLib::NAN_VALUE))
+        {
+            sf->release();
+            sf = nullptr;
+            return false;
+        }
+        cloud->addScalarField(sf);
+        return true;
+    };
+    bool ok = addSF("M3C2 distance", output.distance)
+           && addSF("distance uncertainty", output.uncertainty)
+           && addSF("significant change", output.significant);
+    if (ok && params.exportStdDevInfo)
+        ok = addSF("STD cloud1", output.std1) && addSF("STD cloud2", output.std2);
+    if (ok && params.exportDensityAtProjScale)
+        ok = addSF("Npoints cloud1", output.count1) && addSF("Npoints cloud2", output.count2);
+    if (ok && !ref.normalScales.empty())
+        ok = addSF("normal scale", output.normalScale);
+    if (ok && (params.projDestIndex == 0 || params.projDestIndex == 1))
+    {
+        try
+        {
+            output.projection.resize(coreCount, std::numeric_limits<double>::quiet_NaN());
+        }
+        catch (const std::bad_alloc&)
+        {
+            ok = false;
+        }
+    }
+    if (!ok)
+    {
+        delete cloud;
+        output = M3C2Output_();
+        CCTRACE("M3C2: not enough memory");
+        return false;
+    }
+    return true;
+}
+
+//! compares a cloud to the prepared reference and fills the output scalar fields, thread safe
+bool ComputeM3C2Compared_(const M3C2Reference_& ref,
+                          ccPointCloud* compared,
+                          const M3C2Parameters& params,
+                          const M3C2PrecisionMap_& precisionMap,
+                          M3C2Output_& output)
+{
+    CCCoreLib::DgmOctree octree(compared);
+    if (octree.build() <= 0)
+    {
+        CCTRACE("M3C2: failed to compute the octree of " << compared->getName().toStdString());
+        return false;
+    }
+    unsigned char cylinderLevel = octree.findBestLevelForAGivenNeighbourhoodSizeExtraction(static_cast<PointCoordinateType>(params.searchScale / 2));
+    const double registrationError = (params.registrationErrorEnabled ? params.registrationError : 0.0);
+    ForEachM3C2Chunk_(ref.corePoints->size(), [&](unsigned first, unsigned last)
+    {
+        std::vector<double> values;
+        for (unsigned i = first; i < last; ++i)
+        {
+            if (ref.normals[i].norm2() == 0)
+                continue;
+            const M3C2CylinderStats_& stats1 = ref.stats[i];
+            M3C2CylinderStats_ stats2 = ComputeM3C2CylinderStats_(octree, cylinderLevel, *ref.corePoints->getPoint(i), ref.normals[i],
+                                                                  params, precisionMap, values);
+            if (output.count1)
+            {
+                output.count1->setValue(i, static_cast<ScalarType>(stats1.count));
+                output.count2->setValue(i, static_cast<ScalarType>(stats2.count));
+            }
+            if (output.std1)
+            {
+                output.std1->setValue(i, static_cast<ScalarType>(stats1.spread));
+                output.std2->setValue(i, static_cast<ScalarType>(stats2.spread));
+            }
+            if (output.normalScale)
+                output.normalScale->setValue(i, ref.normalScales[i]);
+            if (!output.projection.empty())
+            {
+                const M3C2CylinderStats_& projStats = (params.projDestIndex == 0 ? stats1 : stats2);
+                if (projStats.valid)
+                    output.projection[i] = projStats.value;
+            }
+            if (!stats1.valid || !stats2.valid)
+                continue;
+            double distance = stats2.value - stats1.value;
+            output.distance->setValue(i, static_cast<ScalarType>(distance));
+            double sigma = (precisionMap.isValid() ? std::sqrt(stats1.pmVariance + stats2.pmVariance)
+                                                   : std::sqrt(stats1.spread * stats1.spread / stats1.count
+                                                             + stats2.spread * stats2.spread / stats2.count));
+            double LOD = 1.96 * (sigma + registrationError);
+            output.uncertainty->setValue(i, static_cast<ScalarType>(LOD));
+            output.significant->setValue(i, std::abs(distance) > LOD ? 1 : 0);
+        }
+    });
+    return true;
+}
+
+//! computes the scalar field ranges and shows the distances, not thread safe
+void FinalizeM3C2Output_(const M3C2Reference_& ref, M3C2Output_& output)
+{
+    ccPointCloud* cloud = output.cloud;
+    if (!output.projection.empty())
+    {
+        for (unsigned i = 0; i < cloud->size(); ++i)
+        {
+            if (!std::isnan(output.projection[i]))
+                *const_cast<CCVector3*>(cloud->getPoint(i)) += ref.normals[i] * static_cast<PointCoordinateType>(output.projection[i]);
+        }
+        cloud->invalidateBoundingBox();
+        output.projection.clear();
+    }
+    for (unsigned i = 0; i < cloud->getNumberOfScalarFields(); ++i)
+        cloud->getScalarField(i)->computeMinAndMax();
+    cloud->setCurrentDisplayedScalarField(cloud->getScalarFieldIndexByName("M3C2 distance"));
+    cloud->showSF(true);
+    cloud->showNormals(false);
+}
+
+//! M3C2 of one reference against several clouds, the reference side is computed once
+std::vector<ccPointCloud*> ComputeM3C2Epochs_(ccPointCloud* reference,
+                                              const std::vector<ccPointCloud*>& epochs,
+                                              ccPointCloud* corePointsCloud,
+                                              const M3C2Parameters& params,
+                                              const M3C2PrecisionMap_& referencePM,
+                                              const std::vector<M3C2PrecisionMap_>& epochsPM)
+{
+    std::vector<ccPointCloud*> results(epochs.size(), nullptr);
+    M3C2Reference_ ref;
+    bool prepared = false;
+    RunM3C2Task_(params.maxThreadCount, [&]()
+    {
+        prepared = PrepareM3C2Reference_(reference, corePointsCloud, params, referencePM, ref);
+    });
+    if (!prepared)
+        return results;
+
+    //entities are created in the main thread (unique ids)
+    std::vector<M3C2Output_> outputs(epochs.size());
+    for (size_t e = 0; e < epochs.size(); ++e)
+    {
+        if (!epochs[e] || epochs[e]->size() == 0)
+        {
+            CCTRACE("M3C2: compared cloud " << e << " is empty");
+            continue;
+        }
+        CreateM3C2Output_(ref, epochs[e], params, outputs[e]);
+    }
+
+    std::vector<char> success(epochs.size(), 0);
+    M3C2PrecisionMap_ noPM;
+    auto computeEpoch = [&](size_t e)
+    {
+        if (outputs[e].cloud)
+            success[e] = ComputeM3C2Compared_(ref, epochs[e], params, (e < epochsPM.size() ? epochsPM[e] : noPM), outputs[e]);
+    };
+    RunM3C2Task_(params.maxThreadCount, [&]()
+    {
+#ifdef CC_CORE_LIB_USES_TBB
+        tbb::parallel_for(static_cast<size_t>(0), epochs.size(), computeEpoch);
+#else
+        for (size_t e = 0; e < epochs.size(); ++e)
+            computeEpoch(e);
+#endif
+    });
+
+    for (size_t e = 0; e < epochs.size(); ++e)
+    {
+        if (!outputs[e].cloud)
+            continue;
+        if (success[e])
+        {
+            FinalizeM3C2Output_(ref, outputs[e]);
+            results[e] = outputs[e].cloud;
+        }
+        else
+        {
+            delete outputs[e].cloud;
+        }
+    }
+    return results;
+}
+
 ccPointCloud* computeM3C2(std::vector<ccHObject*> clouds,
                           const QString& paramFilename,
                           std::vector<ccScalarField*> precisionMaps = {},
@@ -112,14 +858,153 @@ bool M3C2guessParamsToFile(std::vector<ccHObject*> clouds, const QString& paramF
     return true;
 }
 
+M3C2Parameters M3C2guessParams(std::vector<ccHObject*> clouds, bool fastMode)
+{
+    CCTRACE("M3C2guessParams");
+    M3C2Parameters params;
+    if (clouds.size() < 2)
+    {
+        CCTRACE("minimum two clouds required for M3C2 computation");
+        return params;
+    }
+    ccPointCloud* cloud1 = ccHObjectCaster::ToPointCloud(clouds[0]);
+    ccPointCloud* cloud2 = ccHObjectCaster::ToPointCloud(clouds[1]);
+    if (!cloud1 || !cloud2)
+    {
+        CCTRACE("the two first entities must be point clouds");
+        return params;
+    }
+
+    //same estimation and same updates as the Guess params button of the plugin dialog
+    qM3C2Tools::GuessedParams guessed;
+    unsigned minPoints4Stats = (params.useMinPoints4Stat ? params.minPoints4Stat : 5);
+    if (!qM3C2Tools::GuessBestParams(cloud1, cloud2, minPoints4Stats, guessed, fastMode, nullptr))
+    {
+        CCTRACE("M3C2: failed to guess the parameters");
+        return params;
+    }
+    params.subsampleRadius = guessed.normScale / 2;
+    params.normalScale = guessed.normScale;
+    params.normalMinScale = guessed.normScale / 2;
+    params.normalStep = guessed.normScale / 2;
+    params.normalMaxScale = guessed.normScale * 2;
+    params.searchScale = guessed.projScale;
+    params.searchDepth = guessed.projDepth;
+    if (guessed.preferredDimension != -1)
+        params.normalPreferedOri = guessed.preferredDimension * 2;
+    return params;
+}
+
+ccPointCloud* computeM3C2WithParams(std::vector<ccHObject*> clouds,
+                                    const M3C2Parameters& params,
+                                    std::vector<ccScalarField*> precisionMaps = {},
+                                    std::vector<double> scales = {})
+{
+    CCTRACE("computeM3C2WithParams");
+    if (clouds.size() < 2)
+    {
+        CCTRACE("minimum two clouds required for M3C2 computation");
+        return nullptr;
+    }
+    ccPointCloud* cloud1 = ccHObjectCaster::ToPointCloud(clouds[0]);
+    ccPointCloud* cloud2 = ccHObjectCaster::ToPointCloud(clouds[1]);
+    ccPointCloud* corePointsCloud = (clouds.size() > 2 ? ccHObjectCaster::ToPointCloud(clouds[2]) : nullptr);
+    if (!cloud1 || !cloud2)
+    {
+        CCTRACE("the two first entities must be point clouds");
+        return nullptr;
+    }
+
+    M3C2PrecisionMap_ pm1;
+    std::vector<M3C2PrecisionMap_> pm2(1);
+    if (params.usePrecisionMaps && precisionMaps.size() != 6)
+    {
+        CCTRACE("usePrecisionMaps requires 6 precision map scalar fields");
+        return nullptr;
+    }
+    if ((precisionMaps.size() == 6) && (scales.size() == 2 || scales.empty()))
+    {
+        CCTRACE("computeM3C2WithParams using precision maps");
+        pm1.sX = precisionMaps[0];
+        pm1.sY = precisionMaps[1];
+        pm1.sZ = precisionMaps[2];
+        pm1.scale = (scales.empty() ? params.pm1Scale : scales[0]);
+        pm2[0].sX = precisionMaps[3];
+        pm2[0].sY = precisionMaps[4];
+        pm2[0].sZ = precisionMaps[5];
+        pm2[0].scale = (scales.empty() ? params.pm2Scale : scales[1]);
+        if (!pm1.isValid() || !pm2[0].isValid())
+        {
+            CCTRACE("invalid precision map scalar fields");
+            return nullptr;
+        }
+    }
+    return ComputeM3C2Epochs_(cloud1, { cloud2 }, corePointsCloud, params, pm1, pm2)[0];
+}
+
+std::vector<ccPointCloud*> computeM3C2Batch(ccPointCloud* reference,
+                                            std::vector<ccPointCloud*> epochs,
+                                            const M3C2Parameters& params,
+                                            ccPointCloud* corePoints = nullptr)
+{
+    CCTRACE("computeM3C2Batch: " << epochs.size() << " clouds compared");
+    if (!reference || epochs.empty())
+    {
+        CCTRACE("a reference cloud and at least one compared cloud are required");
+        return std::vector<ccPointCloud*>(epochs.size(), nullptr);
+    }
+    return ComputeM3C2Epochs_(reference, epochs, corePoints, params, M3C2PrecisionMap_(), {});
+}
+
 PYBIND11_MODULE(_M3C2, m1)
 {
     m1.doc() = M3C2_doc;
 
+    py::class_<M3C2Parameters>(m1, "M3C2Parameters", M3C2_M3C2Parameters_doc)
+        .def(py::init<>())
+        .def_readwrite("normalScale", &M3C2Parameters::normalScale, M3C2_M3C2Parameters_normalScale_doc)
+        .def_readwrite("normalMode", &M3C2Parameters::normalMode, M3C2_M3C2Parameters_normalMode_doc)
+        .def_readwrite("normalMinScale", &M3C2Parameters::normalMinScale, M3C2_M3C2Parameters_normalMinScale_doc)
+        .def_readwrite("normalStep", &M3C2Parameters::normalStep, M3C2_M3C2Parameters_normalStep_doc)
+        .def_readwrite("normalMaxScale", &M3C2Parameters::normalMaxScale, M3C2_M3C2Parameters_normalMaxScale_doc)
+        .def_readwrite("normalPreferedOri", &M3C2Parameters::normalPreferedOri, M3C2_M3C2Parameters_normalPreferedOri_doc)
+        .def_readwrite("searchScale", &M3C2Parameters::searchScale, M3C2_M3C2Parameters_searchScale_doc)
+        .def_readwrite("searchDepth", &M3C2Parameters::searchDepth, M3C2_M3C2Parameters_searchDepth_doc)
+        .def_readwrite("positiveSearchOnly", &M3C2Parameters::positiveSearchOnly, M3C2_M3C2Parameters_positiveSearchOnly_doc)
+        .def_readwrite("useMedian", &M3C2Parameters::useMedian, M3C2_M3C2Parameters_useMedian_doc)
+        .def_readwrite("useMinPoints4Stat", &M3C2Parameters::useMinPoints4Stat, M3C2_M3C2Parameters_useMinPoints4Stat_doc)
+        .def_readwrite("minPoints4Stat", &M3C2Parameters::minPoints4Stat, M3C2_M3C2Parameters_minPoints4Stat_doc)
+        .def_readwrite("registrationErrorEnabled", &M3C2Parameters::registrationErrorEnabled, M3C2_M3C2Parameters_registrationErrorEnabled_doc)
+        .def_readwrite("registrationError", &M3C2Parameters::registrationError, M3C2_M3C2Parameters_registrationError_doc)
+        .def_readwrite("useOriginalCloud", &M3C2Parameters::useOriginalCloud, M3C2_M3C2Parameters_useOriginalCloud_doc)
+        .def_readwrite("subsampleEnabled", &M3C2Parameters::subsampleEnabled, M3C2_M3C2Parameters_subsampleEnabled_doc)
+        .def_readwrite("subsampleRadius", &M3C2Parameters::subsampleRadius, M3C2_M3C2Parameters_subsampleRadius_doc)
+        .def_readwrite("exportStdDevInfo", &M3C2Parameters::exportStdDevInfo, M3C2_M3C2Parameters_exportStdDevInfo_doc)
+        .def_readwrite("exportDensityAtProjScale", &M3C2Parameters::exportDensityAtProjScale, M3C2_M3C2Parameters_exportDensityAtProjScale_doc)
+        .def_readwrite("normalUseCorePoints", &M3C2Parameters::normalUseCorePoints, M3C2_M3C2Parameters_normalUseCorePoints_doc)
+        .def_readwrite("useSinglePass4Depth", &M3C2Parameters::useSinglePass4Depth, M3C2_M3C2Parameters_useSinglePass4Depth_doc)
+        .def_readwrite("usePrecisionMaps", &M3C2Parameters::usePrecisionMaps, M3C2_M3C2Parameters_usePrecisionMaps_doc)
+        .def_readwrite("pm1Scale", &M3C2Parameters::pm1Scale, M3C2_M3C2Parameters_pm1Scale_doc)
+        .def_readwrite("pm2Scale", &M3C2Parameters::pm2Scale, M3C2_M3C2Parameters_pm2Scale_doc)
+        .def_readwrite("projDestIndex", &M3C2Parameters::projDestIndex, M3C2_M3C2Parameters_projDestIndex_doc)
+        .def_readwrite("maxThreadCount", &M3C2Parameters::maxThreadCount, M3C2_M3C2Parameters_maxThreadCount_doc)
+        .def("loadFromFile", &M3C2Parameters::loadFromFile, M3C2_M3C2Parameters_loadFromFile_doc)
+        .def("saveToFile", &M3C2Parameters::saveToFile, M3C2_M3C2Parameters_saveToFile_doc)
+        ;
+
     m1.def("computeM3C2", computeM3C2,
            py::arg("clouds"), py::arg("paramFilename"),
            py::arg("precisionMaps")=std::vector<ccScalarField*>{}, py::arg("scales")=std::vector<double>{},
            py::return_value_policy::reference, M3C2_computeM3C2_doc);
     m1.def("initTrace_M3C2", initTrace_M3C2, M3C2_initTrace_M3C2_doc);
     m1.def("M3C2guessParamsToFile", M3C2guessParamsToFile, M3C2_M3C2guessParamsToFile_doc);
+    m1.def("M3C2guessParams", M3C2guessParams,
+           py::arg("clouds"), py::arg("fastMode")=true, M3C2_M3C2guessParams_doc);
+    m1.def("computeM3C2WithParams", computeM3C2WithParams,
+           py::arg("clouds"), py::arg("params"),
+           py::arg("precisionMaps")=std::vector<ccScalarField*>{}, py::arg("scales")=std::vector<double>{},
+           py::return_value_policy::reference, M3C2_computeM3C2WithParams_doc);
+    m1.def("computeM3C2Batch", computeM3C2Batch,
+           py::arg("reference"), py::arg("epochs"), py::arg("params"), py::arg("corePoints")=nullptr,
+           py::return_value_policy::reference, M3C2_computeM3C2Batch_doc);
 }
@@ -78,4 +78,188 @@ Guess the parameters for compute_M3C2 and save them to a file.
 :rtype: bool
 )";
 
+const char* M3C2_M3C2guessParams_doc=R"(
+Guess the parameters for M3C2 and return them in memory (see :py:class:`M3C2Parameters`).
+Same estimation as :py:func:`M3C2guessParamsToFile`, without dialog nor parameter file.
+
+:param list clouds: two or three clouds to compare. If a 3rd cloud is present, it will be used as core points.
+:param bool,optional fastMode: default True, True corresponds to the values of the GUI dialog before Guess params button,
+                      False corresponds to the values of the GUI dialog after Guess params button.
+
+:return: the parameters
+:rtype: M3C2Parameters
+)";
+
+const char* M3C2_computeM3C2WithParams_doc=R"(
+Compute Multiscale Model to Model Cloud Comparison with in memory parameters (:py:class:`M3C2Parameters`).
+
+Unlike :py:func:`computeM3C2`, there is no parameter file, no dialog and no global state:
+several computations can run concurrently. The core points, normals and projection cylinders
+are computed in parallel (octree based neighbourhoods).
+
+The output cloud holds the core points, the M3C2 normals and the scalar fields
+'M3C2 distance', 'distance uncertainty' (level of detection at 95%), 'significant change',
+'STD cloud1', 'STD cloud2' (if exportStdDevInfo), 'Npoints cloud1', 'Npoints cloud2' (if exportDensityAtProjScale),
+'normal scale' (multi-scale mode).
+
+To compute the uncertainty with precision maps, 6 scalar fields are required 
+(3 components for first cloud then 3 components for second cloud), and two scales
+(pm1Scale and pm2Scale of the parameters when no scales are given).
+The statistics follow the plugin: progressive search along the cylinder (unless useSinglePass4Depth),
+mean and standard deviation, or median and interquartile range with useMedian.
+
+:param list clouds: two or three clouds to compare. If a 3rd cloud is present, it will be used as core points.
+:param M3C2Parameters params: the computation parameters
+:param list,optional precisionMaps: list of 6 scalar fields (3 components for first cloud then 3 components for second cloud), default empty list
+:param list,optional scales: list of two doubles (scale for first and second cloud), default empty list (pm1Scale, pm2Scale)
+
+:return: output cloud with computed scalar fields, or None on failure
+:rtype: ccPointCloud
+)";
+
+const char* M3C2_computeM3C2Batch_doc=R"(
+Compare a reference cloud with several clouds (epochs) using M3C2 (see :py:func:`computeM3C2WithParams`).
+
+The core points, their normals and the reference side of the projection cylinders
+are computed once and shared by all the epochs, which are then processed in parallel.
+Precision maps are not available in this mode.
+
+:param ccPointCloud reference: the reference cloud (cloud #1)
+:param list epochs: the clouds compared to the reference (cloud #2 of each comparison)
+:param M3C2Parameters params: the computation parameters
+:param ccPointCloud,optional corePoints: the core points, default None (core points defined by the parameters)
+
+:return: one output cloud per epoch (None for a failed comparison)
+:rtype: list of ccPointCloud
+)";
+
+const char* M3C2_M3C2Parameters_doc=R"(
+M3C2 parameters, kept in memory. The attributes correspond to the keys of the parameter file
+(see :py:func:`M3C2guessParamsToFile`), they can be read from or written to a parameter file.
+
+:ivar float normalScale: diameter of the neighbourhood used to compute the normals, default 0 (NormalScale)
+:ivar int normalMode: 0: default, 1: use cloud #1 normals, 2: multi-scale, 3: vertical, 4: horizontal, default 0 (NormalMode)
+:ivar float normalMinScale: multi-scale mode: smallest diameter, default 0 (NormalMinScale)
+:ivar float normalStep: multi-scale mode: diameter step, default 0 (NormalStep)
+:ivar float normalMaxScale: multi-scale mode: largest diameter, default 0 (NormalMaxScale)
+:ivar int normalPreferedOri: normals orientation, 0 to 5: +X, -X, +Y, -Y, +Z, -Z, 6, 7: +/- barycenter, 8, 9: +/- origin, default 4 (NormalPreferedOri)
+:ivar float searchScale: diameter of the projection cylinder, default 0 (SearchScale)
+:ivar float searchDepth: half height of the projection cylinder, default 0 (SearchDepth)
+:ivar bool positiveSearchOnly: search only in the normal direction, default False (PositiveSearchOnly)
+:ivar bool useMedian: median and interquartile range instead of mean and standard deviation in the cylinder, default False (UseMedian)
+:ivar bool useMinPoints4Stat: require a minimum number of points for the statistics, default False (UseMinPoints4Stat)
+:ivar int minPoints4Stat: minimum number of points for the statistics, default 5 (MinPoints4Stat)
+:ivar bool registrationErrorEnabled: add the registration error to the uncertainty, default False (RegistrationErrorEnabled)
+:ivar float registrationError: registration error, default 0 (RegistrationError)
+:ivar bool useOriginalCloud: use cloud #1 as core points, default False (UseOriginalCloud)
+:ivar bool subsampleEnabled: subsample cloud #1 to get the core points, default True (SubsampleEnabled)
+:ivar float subsampleRadius: minimal distance between core points, default 0 (SubsampleRadius)
+:ivar bool exportStdDevInfo: export the standard deviations, default False (ExportStdDevInfo)
+:ivar bool exportDensityAtProjScale: export the number of points in the cylinders, default False (ExportDensityAtProjScale)
+:ivar bool normalUseCorePoints: compute the normals on the core points instead of cloud #1, default False (NormalUseCorePoints)
+:ivar bool useSinglePass4Depth: search the whole cylinder at once instead of a progressive search, default False (UseSinglePass4Depth)
+:ivar bool usePrecisionMaps: compute the uncertainty with precision maps, default False (UsePrecisionMaps)
+:ivar float pm1Scale: precision maps scale of cloud #1, default 1 (PM1Scale)
+:ivar float pm2Scale: precision maps scale of cloud #2, default 1 (PM2Scale)
+:ivar int projDestIndex: output points, 0: projected on cloud #1, 1: projected on cloud #2, 2: core points, default 2 (ProjDestIndex)
+:ivar int maxThreadCount: maximum number of threads, 0 for all, default 0 (MaxThreadCount)
+)";
+
+const char* M3C2_M3C2Parameters_normalScale_doc=R"(
+diameter of the neighbourhood used to compute the normals, default 0)";
+
+const char* M3C2_M3C2Parameters_normalMode_doc=R"(
+0: default, 1: use cloud #1 normals, 2: multi-scale, 3: vertical, 4: horizontal, default 0)";
+
+const char* M3C2_M3C2Parameters_normalMinScale_doc=R"(
+multi-scale mode: smallest diameter, default 0)";
+
+const char* M3C2_M3C2Parameters_normalStep_doc=R"(
+multi-scale mode: diameter step, default 0)";
+
+const char* M3C2_M3C2Parameters_normalMaxScale_doc=R"(
+multi-scale mode: largest diameter, default 0)";
+
+const char* M3C2_M3C2Parameters_normalPreferedOri_doc=R"(
+normals orientation, 0 to 5: +X, -X, +Y, -Y, +Z, -Z, 6, 7: +/- barycenter, 8, 9: +/- origin, default 4)";
+
+const char* M3C2_M3C2Parameters_searchScale_doc=R"(
+diameter of the projection cylinder, default 0)";
+
+const char* M3C2_M3C2Parameters_searchDepth_doc=R"(
+half height of the projection cylinder, default 0)";
+
+const char* M3C2_M3C2Parameters_positiveSearchOnly_doc=R"(
+search only in the normal direction, default False)";
+
+const char* M3C2_M3C2Parameters_useMedian_doc=R"(
+median and interquartile range instead of mean and standard deviation in the cylinder, default False)";
+
+const char* M3C2_M3C2Parameters_useMinPoints4Stat_doc=R"(
+require a minimum number of points for the statistics, default False)";
+
+const char* M3C2_M3C2Parameters_minPoints4Stat_doc=R"(
+minimum number of points for the statistics, default 5)";
+
+const char* M3C2_M3C2Parameters_registrationErrorEnabled_doc=R"(
+add the registration error to the uncertainty, default False)";
+
+const char* M3C2_M3C2Parameters_registrationError_doc=R"(
+registration error, default 0)";
+
+const char* M3C2_M3C2Parameters_useOriginalCloud_doc=R"(
+use cloud #1 as core points, default False)";
+
+const char* M3C2_M3C2Parameters_subsampleEnabled_doc=R"(
+subsample cloud #1 to get the core points, default True)";
+
+const char* M3C2_M3C2Parameters_subsampleRadius_doc=R"(
+minimal distance between core points, default 0)";
+
+const char* M3C2_M3C2Parameters_exportStdDevInfo_doc=R"(
+export the standard deviations ('STD cloud1', 'STD cloud2'), default False)";
+
+const char* M3C2_M3C2Parameters_exportDensityAtProjScale_doc=R"(
+export the number of points in the cylinders ('Npoints cloud1', 'Npoints cloud2'), default False)";
+
+const char* M3C2_M3C2Parameters_normalUseCorePoints_doc=R"(
+compute the normals on the core points instead of cloud #1, default False)";
+
+const char* M3C2_M3C2Parameters_useSinglePass4Depth_doc=R"(
+search the whole cylinder at once instead of a progressive search, default False)";
+
+const char* M3C2_M3C2Parameters_usePrecisionMaps_doc=R"(
+compute the uncertainty with precision maps, default False)";
+
+const char* M3C2_M3C2Parameters_pm1Scale_doc=R"(
+precision maps scale of cloud #1, default 1)";
+
+const char* M3C2_M3C2Parameters_pm2Scale_doc=R"(
+precision maps scale of cloud #2, default 1)";
+
+const char* M3C2_M3C2Parameters_projDestIndex_doc=R"(
+output points, 0: projected on cloud #1, 1: projected on cloud #2, 2: core points, default 2)";
+
+const char* M3C2_M3C2Parameters_maxThreadCount_doc=R"(
+maximum number of threads, 0 for all, default 0)";
+
+const char* M3C2_M3C2Parameters_loadFromFile_doc=R"(
+Read the parameters from a parameter file (see :py:func:`M3C2guessParamsToFile`).
+The keys missing in the file keep their current value.
+
+:param string paramFilename: full path of the parameter file
+
+:return: success
+:rtype: bool
+)";
+
+const char* M3C2_M3C2Parameters_saveToFile_doc=R"(
+Write the parameters to a parameter file, usable with :py:func:`computeM3C2` or the GUI.
+
+:param string paramFilename: full path of the parameter file
+
+:return: success
+:rtype: bool
+)";
+
 #endif /* M3C2_DOCSTRINGS_HPP_ */
@@ -22,7 +22,12 @@
 #include "cloudComPy.hpp"
 
 #include <QString>
+#include <QThread>
 #include <vector>
+#include <atomic>
+#include <algorithm>
+#include <limits>
+#include <cmath>
 
 #include <ccPointCloud.h>
 #include <ccMesh.h>
@@ -35,6 +40,11 @@
 #include "pyccTrace.h"
 #include "PCV_DocStrings.hpp"
 
+#ifdef CC_CORE_LIB_USES_TBB
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+#endif
+
 void initTrace_PCV()
 {
 #ifdef _PYTHONAPI_DEBUG_
@@ -42,12 +52,231 @@ void initTrace_PCV()
 #endif
 }
 
+//! projected vertex (pixel coordinates and depth towards the light) for the CPU engine
+struct PCVProjected_
+{
+    float x;
+    float y;
+    float d;
+};
+
+//! rasterizes a projected triangle in the z-buffer (the highest depth, i.e. the closest to the light, is kept)
+static void RasterizePCVTriangle_(std::vector<float>& zBuffer, int resolution,
+                                  const PCVProjected_& a, const PCVProjected_& b, const PCVProjected_& c)
+{
+    float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+    if (std::abs(area) < std::numeric_limits<float>::epsilon())
+        return; //degenerate or edge-on: the vertices are splatted anyway
+    int xMin = std::max(0, static_cast<int>(std::floor(std::min({ a.x, b.x, c.x }))));
+    int xMax = std::min(resolution - 1, static_cast<int>(std::ceil(std::max({ a.x, b.x, c.x }))));
+    int yMin = std::max(0, static_cast<int>(std::floor(std::min({ a.y, b.y, c.y }))));
+    int yMax = std::min(resolution - 1, static_cast<int>(std::ceil(std::max({ a.y, b.y, c.y }))));
+    float invArea = 1.0f / area;
+    for (int y = yMin; y <= yMax; ++y)
+    {
+        float py = y + 0.5f;
+        float* row = zBuffer.data() + static_cast<size_t>(y) * resolution;
+        for (int x = xMin; x <= xMax; ++x)
+        {
+            float px = x + 0.5f;
+            float l0 = ((c.x - b.x) * (py - b.y) - (c.y - b.y) * (px - b.x)) * invArea;
+            float l1 = ((a.x - c.x) * (py - c.y) - (a.y - c.y) * (px - c.x)) * invArea;
+            float l2 = 1.0f - l0 - l1;
+            if (l0 < 0 || l1 < 0 || l2 < 0)
+                continue;
+            float d = l0 * a.d + l1 * b.d + l2 * c.d;
+            row[x] = std::max(row[x], d);
+        }
+    }
+}
+
+//! CPU visibility engine: an orthographic z-buffer per ray direction, the directions distributed over the threads.
+//! The illuminance of a point is the ratio of the directions from which it is visible.
+static bool ComputePCVIlluminanceCPU_(ccPointCloud* cloud,
+                                      ccGenericMesh* mesh,
+                                      const std::vector<CCVector3>& rays,
+                                      int resolution,
+                                      int maxThreadCount)
+{
+    const unsigned count = cloud->size();
+    if (count == 0 || rays.empty() || resolution <= 0)
+        return false;
+
+    //coordinates relative to the bounding sphere center, as contiguous arrays
+    CCVector3 bbMin, bbMax;
+    cloud->getBoundingBox(bbMin, bbMax);
+    CCVector3 center = (bbMin + bbMax) / 2;
+    float radius = static_cast<float>((bbMax - bbMin).normd() / 2);
+    if (radius <= 0)
+        radius = 1.0f;
+    std::vector<float> xs, ys, zs;
+    std::vector<unsigned> triangles;
+    try
+    {
+        xs.resize(count);
+        ys.resize(count);
+        zs.resize(count);
+        if (mesh)
+        {
+            triangles.resize(static_cast<size_t>(mesh->size()) * 3);
+        }
+    }
+    catch (const std::bad_alloc&)
+    {
+        CCTRACE("Not enough memory!");
+        return false;
+    }
+    for (unsigned i = 0; i < count; ++i)
+    {
+        CCVector3 P = *cloud->getPoint(i) - center;
+        xs[i] = P.x;
+        ys[i] = P.y;
+        zs[i] = P.z;
+    }
+    for (unsigned t = 0; mesh && t < mesh->size(); ++t)
+    {
+        const CCCoreLib::VerticesIndexes* tri = mesh->getTriangleVertIndexes(t);
+        triangles[3 * t] = tri->i1;
+        triangles[3 * t + 1] = tri->i2;
+        triangles[3 * t + 2] = tri->i3;
+    }
+
+    std::vector<std::atomic<unsigned>> visibility(count);
+    for (std::atomic<unsigned>& v : visibility)
+        v = 0;
+
+    const float scale = resolution / (2 * radius);
+    const float tolerance = 1.0f / scale; //one pixel
+    const size_t pixelCount = static_cast<size_t>(resolution) * resolution;
+    const unsigned rayCount = static_cast<unsigned>(rays.size());
+    bool memoryOk = true;
+
+    //one z-buffer per chunk of directions
+    auto processDirections = [&](unsigned first, unsigned last)
+    {
+        std::vector<float> zBuffer;
+        std::vector<PCVProjected_> projected;
+        try
+        {
+            zBuffer.resize(pixelCount);
+            if (mesh)
+                projected.resize(count);
+        }
+        catch (const std::bad_alloc&)
+        {
+            memoryOk = false;
+            return;
+        }
+        for (unsigned r = first; r < last; ++r)
+        {
+            CCVector3 D = rays[r];
+            D.normalize();
+            CCVector3 U = D.orthogonal();
+            U.normalize();
+            CCVector3 V = D.cross(U);
+            const float ux = U.x * scale, uy = U.y * scale, uz = U.z * scale;
+            const float vx = V.x * scale, vy = V.y * scale, vz = V.z * scale;
+            const float dx = D.x, dy = D.y, dz = D.z;
+            const float offset = radius * scale;
+            auto pixelOf = [&](unsigned i)
+            {
+                int px = static_cast<int>(xs[i] * ux + ys[i] * uy + zs[i] * uz + offset);
+                int py = static_cast<int>(xs[i] * vx + ys[i] * vy + zs[i] * vz + offset);
+                px = std::min(std::max(px, 0), resolution - 1);
+                py = std::min(std::max(py, 0), resolution - 1);
+                return static_cast<size_t>(py) * resolution + px;
+            };
+
+            std::fill(zBuffer.begin(), zBuffer.end(), -std::numeric_limits<float>::max());
+            for (unsigned i = 0; i < count; ++i)
+            {
+                float d = xs[i] * dx + ys[i] * dy + zs[i] * dz;
+                size_t p = pixelOf(i);
+                zBuffer[p] = std::max(zBuffer[p], d);
+            }
+            if (mesh)
+            {
+                for (unsigned i = 0; i < count; ++i)
+                {
+                    projected[i].x = xs[i] * ux + ys[i] * uy + zs[i] * uz + offset;
+                    projected[i].y = xs[i] * vx + ys[i] * vy + zs[i] * vz + offset;
+                    projected[i].d = xs[i] * dx + ys[i] * dy + zs[i] * dz;
+                }
+                for (size_t t = 0; t < triangles.size(); t += 3)
+                {
+                    RasterizePCVTriangle_(zBuffer, resolution, projected[triangles[t]], projected[triangles[t + 1]], projected[triangles[t + 2]]);
+                }
+            }
+            for (unsigned i = 0; i < count; ++i)
+            {
+                float d = xs[i] * dx + ys[i] * dy + zs[i] * dz;
+                if (d >= zBuffer[pixelOf(i)] - tolerance)
+                    visibility[i].fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    auto task = [&]()
+    {
+#ifdef CC_CORE_LIB_USES_TBB
+        unsigned chunkCount = std::min(static_cast<unsigned>(std::max(QThread::idealThreadCount(), 1)), rayCount);
+        if (maxThreadCount > 0)
+            chunkCount = std::min(chunkCount, static_cast<unsigned>(maxThreadCount));
+        unsigned chunkSize = (rayCount + chunkCount - 1) / chunkCount;
+        tbb::parallel_for(static_cast<unsigned>(0), chunkCount, [&](unsigned c)
+        {
+            processDirections(std::min(rayCount, c * chunkSize), std::min(rayCount, (c + 1) * chunkSize));
+        });
+#else
+        processDirections(0, rayCount);
+#endif
+    };
+#ifdef CC_CORE_LIB_USES_TBB
+    if (maxThreadCount > 0)
+    {
+        tbb::task_arena arena(maxThreadCount);
+        arena.execute(task);
+    }
+    else
+#endif
+    {
+        task();
+    }
+    if (!memoryOk)
+    {
+        CCTRACE("Not enough memory for the z-buffers!");
+        return false;
+    }
+
+    int sfIdx = cloud->getScalarFieldIndexByName("Illuminance (PCV)");
+    if (sfIdx < 0)
+        sfIdx = cloud->addScalarField("Illuminance (PCV)");
+    if (sfIdx < 0)
+    {
+        CCTRACE("Not enough memory!");
+        return false;
+    }
+    CCCoreLib::ScalarField* sf = cloud->getScalarField(sfIdx);
+    for (unsigned i = 0; i < count; ++i)
+    {
+        sf->setValue(i, static_cast<ScalarType>(visibility[i].load()) / rayCount);
+    }
+    sf->computeMinAndMax();
+    cloud->setCurrentDisplayedScalarField(sfIdx);
+    cloud->showSF(true);
+    if (mesh)
+        mesh->showSF(true);
+    return true;
+}
+
 bool computeShadeVIS(std::vector<ccHObject*> clouds,
                         ccPointCloud* cloudWithNormals = nullptr,
                         int rayCount = 256,
                         int resolution = 1024,
                         bool is360 = false,
-                        bool isClosedMesh = false)
+                        bool isClosedMesh = false,
+                        bool cpuEngine = false,
+                        int maxThreadCount = 0)
 {
     CCTRACE("computeShadeVIS");
     std::vector<CCVector3> rays;
@@ -112,7 +341,33 @@ bool computeShadeVIS(std::vector<ccHObject*> clouds,
         }
     }
 
-    return PCVCommand::Process(candidates, rays, isClosedMesh, resolution);
+    if (!cpuEngine)
+    {
+        return PCVCommand::Process(candidates, rays, isClosedMesh, resolution);
+    }
+
+    //no OpenGL context: all the triangles are rasterized (isClosedMesh is only a rendering acceleration)
+    bool success = true;
+    for (ccHObject* obj : candidates)
+    {
+        ccGenericMesh* mesh = nullptr;
+        ccPointCloud* cloud = nullptr;
+        if (obj->isA(CC_TYPES::POINT_CLOUD))
+        {
+            cloud = ccHObjectCaster::ToPointCloud(obj);
+        }
+        else
+        {
+            mesh = ccHObjectCaster::ToGenericMesh(obj);
+            cloud = ccHObjectCaster::ToPointCloud(mesh->getAssociatedCloud());
+        }
+        if (!cloud || !ComputePCVIlluminanceCPU_(cloud, mesh, rays, resolution, maxThreadCount))
+        {
+            CCTRACE("CPU engine failed on entity " << obj->getName().toStdString());
+            success = false;
+        }
+    }
+    return success;
 }
 
 PYBIND11_MODULE(_PCV, m2)
@@ -121,6 +376,7 @@ PYBIND11_MODULE(_PCV, m2)
 
     m2.def("computeShadeVIS", computeShadeVIS,
         py::arg("clouds"), py::arg("cloudWithNormals")=nullptr, py::arg("rayCount")=256, py::arg("resolution")=1024,
-        py::arg("is360")=false, py::arg("isClosedMesh")=false, PCV_computeShadeVIS_doc);
+        py::arg("is360")=false, py::arg("isClosedMesh")=false, py::arg("cpuEngine")=false, py::arg("maxThreadCount")=0,
+        PCV_computeShadeVIS_doc);
     m2.def("initTrace_PCV", initTrace_PCV, PCV_initTrace_PCV_doc);
 }
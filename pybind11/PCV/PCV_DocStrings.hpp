@@ -53,6 +53,11 @@ Result on a ScalarField.
 :param int,optional resolution: render context resolution, default 1024
 :param bool,optional is360: use the whole sphere or not (default false)
 :param bool,optional isClosedMesh: if the mesh is closed, accelerate the computation (default false)
+:param bool,optional cpuEngine: compute the visibility on the CPU instead of the OpenGL offscreen rendering (default false).
+       For each ray direction, the points (and the mesh triangles) are projected in an orthographic z-buffer of resolution x resolution,
+       a point is visible if it is within one pixel size of the z-buffer depth.
+       The directions are distributed over the threads. No GPU or display is required.
+:param int,optional maxThreadCount: maximum number of threads for the CPU engine, default 0 (all)
 
 :return: success
 :rtype: bool
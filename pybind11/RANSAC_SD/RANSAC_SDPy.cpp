@@ -23,17 +23,34 @@
 
 #include <QString>
 #include <vector>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <limits>
 
 #include <ccPointCloud.h>
 #include <ccMesh.h>
 #include <ccHObject.h>
 #include <ccHObjectCaster.h>
+#include <ccPlane.h>
+#include <ccSphere.h>
+#include <ccCylinder.h>
+#include <ccCone.h>
+#include <ccTorus.h>
+#include <ccGenericPrimitive.h>
+#include <DgmOctree.h>
+#include <ReferenceCloud.h>
+#include <GeometricalAnalysisTools.h>
 
 #include <qRANSAC_SD.h>
 
 #include "pyccTrace.h"
 #include "RANSAC_SD_DocStrings.hpp"
 
+#ifdef CC_CORE_LIB_USES_TBB
+#include <tbb/parallel_for.h>
+#endif
+
 void initTrace_RANSAC_SD()
 {
 #ifdef _PYTHONAPI_DEBUG_
@@ -41,66 +58,564 @@ void initTrace_RANSAC_SD()
 #endif
 }
 
-py::tuple computeRANSAC_SD(ccPointCloud* ccPC,
-                           const qRansacSD::RansacParams& param)
+//! a detected shape: its points and its primitive (no primitive for the leftover points)
+struct RansacShape_
 {
-    CCTRACE("computeRANSAC_SD");
-    std::vector<ccMesh*> meshes;
-    std::vector<ccPointCloud*> clouds;
-    ccHObject* objsFound = qRansacSD::executeRANSAC(ccPC, param, true);
-    if (objsFound)
+    ccPointCloud* cloud = nullptr;
+    ccMesh* mesh = nullptr;
+    size_t tile = 0;    //!< tiled detection only
+};
+
+//! splits the executeRANSAC output group in (cloud, primitive) pairs, then deletes the group
+void CollectRansacShapes_(ccHObject* objsFound, std::vector<RansacShape_>& shapes)
+{
+    if (!objsFound)
+    {
+        CCTRACE("Nothing found by RANSAC_SD!");
+        return;
+    }
+    unsigned int nbChildren = objsFound->getChildrenNumber();
+    CCTRACE("found " << nbChildren << " shapes");
+    for (unsigned i=0; i<nbChildren; i++)
     {
-        unsigned int nbChildren = objsFound->getChildrenNumber();
-        CCTRACE("found " << nbChildren << " shapes");
-        for (int i=0; i<nbChildren; i++)
+        CCTRACE(" --- shape n°: " << i << " ---");
+        ccHObject* child = objsFound->getChild(i);
+        if (!child)
+            continue;
+        CCTRACE("child name: " << child->getName().toStdString() << " type: " << child->getClassID());
+        RansacShape_ shape;
+        int nbch = child->getChildrenNumber();
+        CCTRACE("nbch " << nbch);
+        for (int j=0; j<nbch; j++)
         {
-            CCTRACE(" --- shape n°: " << i << " ---");
-            ccHObject* child = objsFound->getChild(i);
-            if (child)
+            ccHObject* grandChild = child->getChild(j);
+            if (grandChild)
             {
-                CCTRACE("child name: " << child->getName().toStdString() << " type: " << child->getClassID());
-                int nbch = child->getChildrenNumber();
-                CCTRACE("nbch " << nbch);
-                if (nbch)
+                CCTRACE(grandChild->getName().toStdString() << " type: " << grandChild->getClassID());
+                ccMesh* prim = ccHObjectCaster::ToMesh(grandChild);
+                if (prim)
                 {
-                    bool meshFound = false;
-                    for (int j=0; j<nbch; j++)
+                    CCTRACE("mesh name: " << prim->getName().toStdString());
+                    shape.mesh = prim;
+                    child->detachAllChildren();
+                    break;
+                }
+            }
+        }
+        shape.cloud = ccHObjectCaster::ToPointCloud(child);
+        if (shape.cloud)
+        {
+            CCTRACE("pc name:" << shape.cloud->getName().toStdString());
+        }
+        shapes.push_back(shape);
+    }
+    objsFound->detachAllChildren();
+    if (objsFound->getParent())
+        objsFound->getParent()->detachChild(objsFound);
+    delete objsFound;
+    CCTRACE("found " << shapes.size() << " separate clouds");
+}
+
+//! are two bounding boxes closer than margin?
+bool RansacBoxesTouch_(const ccBBox& bbA, const ccBBox& bbB, PointCoordinateType margin)
+{
+    for (unsigned d = 0; d < 3; ++d)
+    {
+        if (bbA.minCorner().u[d] - bbB.maxCorner().u[d] > margin || bbB.minCorner().u[d] - bbA.maxCorner().u[d] > margin)
+            return false;
+    }
+    return true;
+}
+
+//! are two primitives (planes, spheres or cylinders) the same shape, within the RANSAC tolerances?
+bool RansacPrimitivesMatch_(ccMesh* a, ccMesh* b, const qRansacSD::RansacParams& param)
+{
+    const double cosMaxDev = std::cos(param.maxNormalDev_deg * M_PI / 180.0);
+    const double eps = param.epsilon;
+    if (a->isA(CC_TYPES::PLANE) && b->isA(CC_TYPES::PLANE))
+    {
+        ccPlane* pA = static_cast<ccPlane*>(a);
+        ccPlane* pB = static_cast<ccPlane*>(b);
+        CCVector3 nA = pA->getNormal();
+        CCVector3 nB = pB->getNormal();
+        CCVector3 AB = pB->getCenter() - pA->getCenter();
+        return std::abs(nA.dot(nB)) >= cosMaxDev && std::abs(AB.dot(nA)) <= eps && std::abs(AB.dot(nB)) <= eps;
+    }
+    if (a->isA(CC_TYPES::SPHERE) && b->isA(CC_TYPES::SPHERE))
+    {
+        ccSphere* sA = static_cast<ccSphere*>(a);
+        ccSphere* sB = static_cast<ccSphere*>(b);
+        CCVector3 AB = sB->getTransformation().getTranslationAsVec3D() - sA->getTransformation().getTranslationAsVec3D();
+        return std::abs(sA->getRadius() - sB->getRadius()) <= eps && AB.norm() <= eps;
+    }
+    if (a->isA(CC_TYPES::CYLINDER) && b->isA(CC_TYPES::CYLINDER))
+    {
+        ccCylinder* cA = static_cast<ccCylinder*>(a);
+        ccCylinder* cB = static_cast<ccCylinder*>(b);
+        CCVector3 axisA = cA->getTransformation().getColumnAsVec3D(2);
+        CCVector3 axisB = cB->getTransformation().getColumnAsVec3D(2);
+        axisA.normalize();
+        axisB.normalize();
+        CCVector3 AB = cB->getTransformation().getTranslationAsVec3D() - cA->getTransformation().getTranslationAsVec3D();
+        return std::abs(axisA.dot(axisB)) >= cosMaxDev
+            && std::abs(cA->getBottomRadius() - cB->getBottomRadius()) <= eps
+            && (AB - axisA * AB.dot(axisA)).norm() <= eps
+            && (AB - axisB * AB.dot(axisB)).norm() <= eps;
+    }
+    return false;
+}
+
+//! fits a new primitive on the merged support (the primitive of the largest part is used as a guess)
+ccMesh* RefitRansacPrimitive_(ccMesh* guess, ccPointCloud* cloud, const std::vector<RansacShape_>& parts)
+{
+    ccMesh* prim = nullptr;
+    if (guess->isA(CC_TYPES::PLANE))
+    {
+        prim = ccPlane::Fit(cloud);
+    }
+    else if (guess->isA(CC_TYPES::SPHERE))
+    {
+        CCVector3 center;
+        PointCoordinateType radius = 0;
+        double rms = 0;
+        if (CCCoreLib::GeometricalAnalysisTools::DetectSphereRobust(cloud, 0.5, center, radius, rms) == CCCoreLib::GeometricalAnalysisTools::NoError)
+        {
+            ccGLMatrix trans;
+            trans.setTranslation(center);
+            prim = new ccSphere(radius, &trans);
+        }
+    }
+    else if (guess->isA(CC_TYPES::CYLINDER))
+    {
+        //same axis, mean radius, length of the merged support along the axis
+        ccCylinder* cylinder = static_cast<ccCylinder*>(guess);
+        CCVector3 axis = cylinder->getTransformation().getColumnAsVec3D(2);
+        axis.normalize();
+        CCVector3 C = cylinder->getTransformation().getTranslationAsVec3D();
+        double radiusSum = 0;
+        for (const RansacShape_& part : parts)
+            radiusSum += static_cast<ccCylinder*>(part.mesh)->getBottomRadius() * part.cloud->size();
+        PointCoordinateType tMin = std::numeric_limits<PointCoordinateType>::max();
+        PointCoordinateType tMax = -std::numeric_limits<PointCoordinateType>::max();
+        for (unsigned i = 0; i < cloud->size(); ++i)
+        {
+            PointCoordinateType t = (*cloud->getPoint(i) - C).dot(axis);
+            tMin = std::min(tMin, t);
+            tMax = std::max(tMax, t);
+        }
+        ccGLMatrix trans = ccGLMatrix::FromToRotation(CCVector3(0, 0, 1), axis);
+        trans.setTranslation(C + axis * ((tMin + tMax) / 2));
+        prim = new ccCylinder(static_cast<PointCoordinateType>(radiusSum / cloud->size()), tMax - tMin, &trans);
+    }
+    if (prim)
+    {
+        prim->setName(guess->getName());
+        prim->setVisible(guess->isVisible());
+    }
+    return prim;
+}
+
+//! detection in tiles of about tilePointCount points, then merge of the shapes split by the tile borders
+/** executeRANSAC creates the shape entities (clouds, primitives), which is not thread safe (unique ids):
+    the tiles are processed one after the other, each tile cloud being created just before its detection.
+**/
+bool DetectRansacShapesTiled_(ccPointCloud* ccPC,
+                              const qRansacSD::RansacParams& param,
+                              unsigned tilePointCount,
+                              std::vector<RansacShape_>& shapes)
+{
+    //tiles: runs of consecutive octree cells (Morton order, spatially compact) with about tilePointCount points
+    CCCoreLib::DgmOctree octree(ccPC);
+    if (octree.build() <= 0)
+    {
+        CCTRACE("Failed to compute the octree! Not enough memory?");
+        return false;
+    }
+    unsigned char level = octree.findBestLevelForAGivenPopulationPerCell(std::max(tilePointCount / 8, 1u));
+    std::vector<CCCoreLib::DgmOctree::IndexAndCode> cells;
+    if (!octree.getCellCodesAndIndexes(level, cells, true))
+    {
+        CCTRACE("Not enough memory!");
+        return false;
+    }
+    const CCCoreLib::DgmOctree::cellsContainer& pointsAndCodes = octree.pointsAndTheirCellCodes();
+    const unsigned pointCount = static_cast<unsigned>(pointsAndCodes.size());
+    std::vector<unsigned> tileStarts; //index in pointsAndCodes of the first point of each tile, plus the end
+    {
+        unsigned tileSize = 0;
+        tileStarts.push_back(0);
+        for (size_t c = 0; c < cells.size(); ++c)
+        {
+            unsigned cellEnd = (c + 1 < cells.size() ? cells[c + 1].theIndex : pointCount);
+            tileSize += cellEnd - cells[c].theIndex;
+            if (tileSize >= tilePointCount || c + 1 == cells.size())
+            {
+                tileStarts.push_back(cellEnd);
+                tileSize = 0;
+            }
+        }
+    }
+    const size_t tileCount = tileStarts.size() - 1;
+    CCTRACE("level " << static_cast<int>(level) << " tiles: " << tileCount);
+
+    std::vector<RansacShape_> tileShapes;
+    //deletes the shapes already detected in the previous tiles (error)
+    auto releaseTileShapes = [&tileShapes]()
+    {
+        for (RansacShape_& shape : tileShapes)
+        {
+            delete shape.cloud;
+            delete shape.mesh;
+        }
+        tileShapes.clear();
+    };
+    std::vector<ccBBox> tileBoxes(tileCount);
+    CCCoreLib::ReferenceCloud tile(ccPC);
+    for (size_t t = 0; t < tileCount; ++t)
+    {
+        tile.clear();
+        if (!tile.reserve(tileStarts[t + 1] - tileStarts[t]))
+        {
+            CCTRACE("Not enough memory!");
+            releaseTileShapes();
+            return false;
+        }
+        for (unsigned j = tileStarts[t]; j < tileStarts[t + 1]; ++j)
+            tile.addPointIndex(pointsAndCodes[j].theIndex);
+        ccPointCloud* tileCloud = ccPC->partialClone(&tile);
+        if (!tileCloud)
+        {
+            CCTRACE("Not enough memory!");
+            releaseTileShapes();
+            return false;
+        }
+        tileCloud->setName(ccPC->getName());
+        tileBoxes[t] = tileCloud->getOwnBB();
+        size_t firstShape = tileShapes.size();
+        CollectRansacShapes_(qRansacSD::executeRANSAC(tileCloud, param, true), tileShapes);
+        for (size_t i = firstShape; i < tileShapes.size(); ++i)
+            tileShapes[i].tile = t;
+        delete tileCloud;
+    }
+
+    //merge the parts of a shape split by the tile borders (same primitive parameters, touching supports)
+    //candidates: shapes of the same primitive type, in the same or in neighbour tiles
+    std::vector<size_t> parent(tileShapes.size());
+    std::iota(parent.begin(), parent.end(), 0);
+    auto root = [&](size_t i)
+    {
+        while (parent[i] != i)
+            i = parent[i] = parent[parent[i]];
+        return i;
+    };
+    const PointCoordinateType margin = static_cast<PointCoordinateType>(2 * param.bitmapEpsilon + param.epsilon);
+    static const CC_CLASS_ENUM s_mergedTypes[] = { CC_TYPES::PLANE, CC_TYPES::SPHERE, CC_TYPES::CYLINDER };
+    std::vector<std::vector<size_t>> buckets(tileCount * 3); //shape indexes per (tile, primitive type)
+    for (size_t i = 0; i < tileShapes.size(); ++i)
+    {
+        if (!tileShapes[i].cloud || !tileShapes[i].mesh)
+            continue;
+        for (size_t k = 0; k < 3; ++k)
+        {
+            if (tileShapes[i].mesh->isA(s_mergedTypes[k]))
+            {
+                buckets[tileShapes[i].tile * 3 + k].push_back(i);
+                break;
+            }
+        }
+    }
+    std::vector<ccBBox> shapeBoxes(tileShapes.size());
+    for (size_t i = 0; i < tileShapes.size(); ++i)
+    {
+        if (tileShapes[i].cloud)
+            shapeBoxes[i] = tileShapes[i].cloud->getOwnBB();
+    }
+    for (size_t t = 0; t < tileCount; ++t)
+    {
+        for (size_t u = t; u < tileCount; ++u)
+        {
+            if (u != t && !RansacBoxesTouch_(tileBoxes[t], tileBoxes[u], margin))
+                continue;
+            for (size_t k = 0; k < 3; ++k)
+            {
+                const std::vector<size_t>& bucketT = buckets[t * 3 + k];
+                const std::vector<size_t>& bucketU = buckets[u * 3 + k];
+                for (size_t a = 0; a < bucketT.size(); ++a)
+                {
+                    size_t i = bucketT[a];
+                    for (size_t b = (u == t ? a + 1 : 0); b < bucketU.size(); ++b)
                     {
-                        ccHObject* grandChild = child->getChild(j);
-                        if (grandChild)
-                        {
-                            CCTRACE(grandChild->getName().toStdString() << " type: " << grandChild->getClassID());
-                            ccMesh* prim = ccHObjectCaster::ToMesh(grandChild);
-                            if (prim)
-                            {
-                                CCTRACE("mesh name: " << prim->getName().toStdString());
-                                meshes.push_back(prim);
-                                meshFound = true;
-                                child->detachAllChildren();
-                                break;
-                            }
-                        }
+                        size_t j = bucketU[b];
+                        if (root(i) == root(j))
+                            continue;
+                        if (RansacBoxesTouch_(shapeBoxes[i], shapeBoxes[j], margin)
+                            && RansacPrimitivesMatch_(tileShapes[i].mesh, tileShapes[j].mesh, param))
+                            parent[root(j)] = root(i);
                     }
-                    if (!meshFound)
-                        meshes.push_back(nullptr);
                 }
-                else meshes.push_back(nullptr);
-                ccPointCloud* pc = ccHObjectCaster::ToPointCloud(child);
-                CCTRACE("pc name:" << pc->getName().toStdString());
-                clouds.push_back(pc);
             }
         }
-        objsFound->detachAllChildren();
-        CCTRACE("found " << clouds.size() << " separate clouds");
+    }
+
+    std::vector<std::vector<RansacShape_>> groups(tileShapes.size());
+    std::vector<RansacShape_> leftOvers;
+    for (size_t i = 0; i < tileShapes.size(); ++i)
+    {
+        if (!tileShapes[i].cloud)
+            delete tileShapes[i].mesh;
+        else if (!tileShapes[i].mesh)
+            leftOvers.push_back(tileShapes[i]);
+        else
+            groups[root(i)].push_back(tileShapes[i]);
+    }
+    for (std::vector<RansacShape_>& group : groups)
+    {
+        if (group.empty())
+            continue;
+        std::sort(group.begin(), group.end(), [](const RansacShape_& a, const RansacShape_& b) { return a.cloud->size() > b.cloud->size(); });
+        RansacShape_ merged = group.front();
+        if (group.size() > 1)
+        {
+            for (size_t k = 1; k < group.size(); ++k)
+                *merged.cloud += group[k].cloud;
+            ccMesh* prim = RefitRansacPrimitive_(merged.mesh, merged.cloud, group);
+            for (size_t k = 1; k < group.size(); ++k)
+            {
+                delete group[k].cloud;
+                delete group[k].mesh;
+            }
+            if (prim)
+            {
+                delete merged.mesh;
+                merged.mesh = prim;
+            }
+            CCTRACE("merged " << group.size() << " parts of " << merged.mesh->getName().toStdString());
+        }
+        shapes.push_back(merged);
+    }
+    std::sort(shapes.begin(), shapes.end(), [](const RansacShape_& a, const RansacShape_& b) { return a.cloud->size() > b.cloud->size(); });
+    if (!leftOvers.empty())
+    {
+        RansacShape_ leftOver = leftOvers.front();
+        for (size_t k = 1; k < leftOvers.size(); ++k)
+        {
+            *leftOver.cloud += leftOvers[k].cloud;
+            delete leftOvers[k].cloud;
+        }
+        shapes.push_back(leftOver);
+    }
+    return true;
+}
+
+//! whole cloud or tiled detection
+std::vector<RansacShape_> DetectRansacShapes_(ccPointCloud* ccPC,
+                                              const qRansacSD::RansacParams& param,
+                                              unsigned tilePointCount)
+{
+    std::vector<RansacShape_> shapes;
+    if (tilePointCount > 0 && ccPC->size() > tilePointCount)
+    {
+        DetectRansacShapesTiled_(ccPC, param, tilePointCount, shapes);
     }
     else
     {
-        CCTRACE("Nothing found by RANSAC_SD!");
+        CollectRansacShapes_(qRansacSD::executeRANSAC(ccPC, param, true), shapes);
+    }
+    return shapes;
+}
+
+py::tuple computeRANSAC_SD(ccPointCloud* ccPC,
+                           const qRansacSD::RansacParams& param,
+                           unsigned tilePointCount = 0)
+{
+    CCTRACE("computeRANSAC_SD");
+    std::vector<RansacShape_> shapes = DetectRansacShapes_(ccPC, param, tilePointCount);
+    std::vector<ccMesh*> meshes;
+    std::vector<ccPointCloud*> clouds;
+    for (const RansacShape_& shape : shapes)
+    {
+        meshes.push_back(shape.mesh);
+        clouds.push_back(shape.cloud);
     }
     py::tuple res = py::make_tuple(meshes, clouds);
     return res;
 }
 
+//! primitive parameters table columns (see computeRANSAC_SD_labels)
+enum RansacTableColumns_
+{
+    RTC_TYPE = 0, RTC_COUNT, RTC_CX, RTC_CY, RTC_CZ, RTC_AX, RTC_AY, RTC_AZ, RTC_D, RTC_R1, RTC_R2, RTC_HEIGHT, RTC_COLUMNS
+};
+
+//! fills a row of the primitive parameters table, returns false for an unknown primitive
+bool FillRansacTableRow_(ccMesh* mesh, unsigned pointCount, double* row)
+{
+    std::fill(row, row + RTC_COLUMNS, 0.0);
+    row[RTC_COUNT] = pointCount;
+    CCVector3 C(0, 0, 0);
+    CCVector3 A(0, 0, 1);
+    ccGenericPrimitive* prim = ccHObjectCaster::ToPrimitive(mesh);
+    if (!prim)
+        return false;
+    if (!prim->isA(CC_TYPES::PLANE))
+    {
+        C = prim->getTransformation().getTranslationAsVec3D();
+        A = prim->getTransformation().getColumnAsVec3D(2);
+        A.normalize();
+    }
+    if (prim->isA(CC_TYPES::PLANE))
+    {
+        ccPlane* plane = static_cast<ccPlane*>(prim);
+        row[RTC_TYPE] = qRansacSD::RPT_PLANE;
+        C = plane->getCenter();
+        A = plane->getNormal();
+        row[RTC_D] = A.dot(C);
+    }
+    else if (prim->isA(CC_TYPES::SPHERE))
+    {
+        row[RTC_TYPE] = qRansacSD::RPT_SPHERE;
+        row[RTC_R1] = static_cast<ccSphere*>(prim)->getRadius();
+    }
+    else if (prim->isA(CC_TYPES::CYLINDER))
+    {
+        ccCylinder* cylinder = static_cast<ccCylinder*>(prim);
+        row[RTC_TYPE] = qRansacSD::RPT_CYLINDER;
+        row[RTC_R1] = cylinder->getBottomRadius();
+        row[RTC_HEIGHT] = cylinder->getHeight();
+    }
+    else if (prim->isA(CC_TYPES::CONE))
+    {
+        ccCone* cone = static_cast<ccCone*>(prim);
+        row[RTC_TYPE] = qRansacSD::RPT_CONE;
+        row[RTC_R1] = cone->getBottomRadius();
+        row[RTC_R2] = cone->getTopRadius();
+        row[RTC_HEIGHT] = cone->getHeight();
+    }
+    else if (prim->isA(CC_TYPES::TORUS))
+    {
+        ccTorus* torus = static_cast<ccTorus*>(prim);
+        row[RTC_TYPE] = qRansacSD::RPT_TORUS;
+        row[RTC_R1] = torus->getInsideRadius();
+        row[RTC_R2] = torus->getOutsideRadius();
+    }
+    else
+    {
+        return false;
+    }
+    row[RTC_CX] = C.x;
+    row[RTC_CY] = C.y;
+    row[RTC_CZ] = C.z;
+    row[RTC_AX] = A.x;
+    row[RTC_AY] = A.y;
+    row[RTC_AZ] = A.z;
+    return true;
+}
+
+py::tuple computeRANSAC_SD_labels(ccPointCloud* ccPC,
+                                  const qRansacSD::RansacParams& param,
+                                  unsigned tilePointCount = 0)
+{
+    CCTRACE("computeRANSAC_SD_labels");
+    //the shape clouds are partial clones of the input cloud: temporary scalar fields carry the original point indexes
+    //(two fields of 16 bits, exact with any ScalarType). executeRANSAC gives no reference to the input points,
+    //so the memory cost (two full size fields, copied in the shape clouds) is documented.
+    static const char* s_indexLowName = "RANSAC_SD index (low)";
+    static const char* s_indexHighName = "RANSAC_SD index (high)";
+    static const char* s_labelName = "Shape index";
+    const unsigned pointCount = ccPC->size();
+    auto removeIndexSFs = [ccPC]()
+    {
+        for (const char* name : { s_indexLowName, s_indexHighName })
+        {
+            int index = ccPC->getScalarFieldIndexByName(name);
+            if (index >= 0)
+                ccPC->deleteScalarField(index);
+        }
+    };
+    removeIndexSFs();
+    int lowIndex = ccPC->addScalarField(s_indexLowName);
+    int highIndex = ccPC->addScalarField(s_indexHighName);
+    if (lowIndex < 0 || highIndex < 0)
+    {
+        removeIndexSFs();
+        CCTRACE("Not enough memory!");
+        return py::make_tuple(-1, py::none());
+    }
+    CCCoreLib::ScalarField* lowSF = ccPC->getScalarField(lowIndex);
+    CCCoreLib::ScalarField* highSF = ccPC->getScalarField(highIndex);
+    for (unsigned i = 0; i < pointCount; ++i)
+    {
+        lowSF->setValue(i, static_cast<ScalarType>(i & 0xFFFF));
+        highSF->setValue(i, static_cast<ScalarType>(i >> 16));
+    }
+
+    qRansacSD::RansacParams detectionParam = param;
+    detectionParam.createCloudFromLeftOverPoints = false;
+    std::vector<RansacShape_> shapes = DetectRansacShapes_(ccPC, detectionParam, tilePointCount);
+    removeIndexSFs();
+
+    int labelIndex = ccPC->getScalarFieldIndexByName(s_labelName);
+    if (labelIndex < 0)
+        labelIndex = ccPC->addScalarField(s_labelName);
+    if (labelIndex < 0)
+    {
+        CCTRACE("Not enough memory!");
+    }
+    CCCoreLib::ScalarField* labelSF = (labelIndex >= 0 ? ccPC->getScalarField(labelIndex) : nullptr);
+    if (labelSF)
+        labelSF->fill(-1);
+
+    //one row per primitive, labels in parallel (the shapes are disjoint)
+    std::vector<RansacShape_> primitives;
+    for (const RansacShape_& shape : shapes)
+    {
+        if (shape.cloud && shape.mesh)
+            primitives.push_back(shape);
+    }
+    py::array_t<double> table({ primitives.size(), static_cast<size_t>(RTC_COLUMNS) });
+    double* tableData = table.mutable_data();
+    std::vector<char> valid(primitives.size(), 0);
+    auto labelShape = [&](size_t s)
+    {
+        ccPointCloud* shapeCloud = primitives[s].cloud;
+        valid[s] = FillRansacTableRow_(primitives[s].mesh, shapeCloud->size(), tableData + s * RTC_COLUMNS);
+        int low = shapeCloud->getScalarFieldIndexByName(s_indexLowName);
+        int high = shapeCloud->getScalarFieldIndexByName(s_indexHighName);
+        if (!labelSF || low < 0 || high < 0)
+            return;
+        const CCCoreLib::ScalarField* shapeLow = shapeCloud->getScalarField(low);
+        const CCCoreLib::ScalarField* shapeHigh = shapeCloud->getScalarField(high);
+        for (unsigned k = 0; k < shapeCloud->size(); ++k)
+        {
+            unsigned index = static_cast<unsigned>(shapeLow->getValue(k)) | (static_cast<unsigned>(shapeHigh->getValue(k)) << 16);
+            if (index < pointCount)
+                labelSF->setValue(index, static_cast<ScalarType>(s));
+        }
+    };
+#ifdef CC_CORE_LIB_USES_TBB
+    tbb::parallel_for(static_cast<size_t>(0), primitives.size(), labelShape);
+#else
+    for (size_t s = 0; s < primitives.size(); ++s)
+        labelShape(s);
+#endif
+    for (size_t s = 0; s < primitives.size(); ++s)
+    {
+        if (!valid[s])
+        {
+            CCTRACE("unknown primitive type for shape " << s);
+        }
+    }
+    for (RansacShape_& shape : shapes)
+    {
+        delete shape.mesh;
+        delete shape.cloud;
+    }
+    if (labelSF)
+        labelSF->computeMinAndMax();
+    CCTRACE("labelled " << primitives.size() << " primitives");
+    return py::make_tuple(labelIndex, table);
+}
+
 void setPrimEnabled(qRansacSD::RansacParams& self, qRansacSD::RANSAC_PRIMITIVE_TYPES rpt, bool isEnabled )
 {
     self.primEnabled[rpt] = isEnabled;
@@ -183,7 +698,13 @@ PYBIND11_MODULE(_RANSAC_SD, m5)
         .def("optimizeForCloud", optimizeForCloud, RANSAC_SD_RansacParams_optimizeForCloud_doc)
         ;
 
-    m5.def("computeRANSAC_SD", computeRANSAC_SD, RANSAC_SD_computeRANSAC_SD_doc);
+    m5.def("computeRANSAC_SD", computeRANSAC_SD,
+           py::arg("cloud"), py::arg("param"), py::arg("tilePointCount")=0,
+           RANSAC_SD_computeRANSAC_SD_doc);
+
+    m5.def("computeRANSAC_SD_labels", computeRANSAC_SD_labels,
+           py::arg("cloud"), py::arg("param"), py::arg("tilePointCount")=0,
+           RANSAC_SD_computeRANSAC_SD_labels_doc);
 
     m5.def("initTrace_RANSAC_SD", initTrace_RANSAC_SD, RANSAC_SD_initTrace_RANSAC_SD_doc);
 }
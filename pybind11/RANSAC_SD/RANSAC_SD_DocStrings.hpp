@@ -50,6 +50,55 @@ const char* RANSAC_SD_computeRANSAC_SD_doc=R"(
 RANSAC Shape Detection is a simple interface to the automatic shape detection algorithm
 proposed by Ruwen Schnabel et al. of Bonn university
 (Efficient RANSAC for Point-Cloud Shape Detection).
+
+With a tilePointCount, the cloud is split in spatially compact tiles of about tilePointCount points,
+the detection runs on the tiles one after the other (the plugin creates the shape entities, which is not thread safe),
+with a smaller problem per run, then the planes, spheres and cylinders split by the tile borders
+are merged (same parameters within epsilon and maxNormalDev_deg, touching supports) and their primitive is fitted again.
+The leftover points of all the tiles are gathered in a single cloud.
+Compute the normals of the cloud beforehand, to avoid computing them per tile.
+
+:param ccPointCloud cloud: the point cloud
+:param RansacParams param: the detection parameters
+:param int,optional tilePointCount: approximate number of points per tile, default 0 (no tiles)
+
+:return: a tuple (list of meshes, list of clouds): the primitives and their points
+         (the mesh is None for the leftover points)
+:rtype: tuple
+)";
+
+const char* RANSAC_SD_computeRANSAC_SD_labels_doc=R"(
+RANSAC Shape Detection with a compact output: instead of a cloud and a mesh per shape,
+a scalar field on the input cloud gives the index of the shape of each point (-1 for the leftover points),
+and a NumPy table gives the type and parameters of each primitive.
+The shape clouds and primitives created by the detection are deleted before returning.
+
+Memory: the plugin still creates a cloud per shape, copied from the input cloud with all its scalar fields.
+To find the shape points in the input cloud, two temporary scalar fields of the input cloud size
+("RANSAC_SD index (low)" and "RANSAC_SD index (high)") carry the point indexes and are copied in the shape clouds,
+i.e. about 2 scalar fields more on the input cloud, and the same again spread over the shape clouds, during the detection.
+They are removed before returning. Remove the unneeded scalar fields of the cloud beforehand to reduce the copies.
+
+The table has one row per shape, with the columns:
+
+ - 0: primitive type (:py:class:`RANSAC_PRIMITIVE_TYPES` value)
+ - 1: number of points of the shape
+ - 2-4: center (plane center, sphere center, cylinder / cone / torus base center)
+ - 5-7: plane normal, or axis of cylinder, cone and torus
+ - 8: plane equation d, as ax+by+cz=d with (a,b,c) the normal
+ - 9: radius (sphere, cylinder), bottom radius (cone), inside radius (torus)
+ - 10: top radius (cone), outside radius (torus)
+ - 11: height (cylinder, cone)
+
+The unused columns are 0.
+The tilePointCount parameter works as in :py:func:`computeRANSAC_SD`.
+
+:param ccPointCloud cloud: the point cloud
+:param RansacParams param: the detection parameters (createCloudFromLeftOverPoints is ignored)
+:param int,optional tilePointCount: approximate number of points per tile, default 0 (no tiles)
+
+:return: a tuple (index of the scalar field "Shape index", table of primitives float64 (nbShapes, 12))
+:rtype: tuple
 )";
 
 const char* RANSAC_SD_initTrace_RANSAC_SD_doc=R"(
@@ -22,7 +22,11 @@
 #include "cloudComPy.hpp"
 
 #include <QString>
+#include <QImage>
+#include <QThread>
 #include <vector>
+#include <algorithm>
+#include <cmath>
 
 #include <ccPointCloud.h>
 #include <ccPolyline.h>
@@ -34,6 +38,11 @@
 #include <distanceMapGenerationTool.h>
 
 #include <ccColorScalesManager.h>
+#include <Delaunay2dMesh.h>
+
+#ifdef CC_CORE_LIB_USES_TBB
+#include <tbb/parallel_for.h>
+#endif
 
 #include "pyccTrace.h"
 #include "SRA_DocStrings.hpp"
@@ -131,29 +140,241 @@ QSharedPointer<DistanceMapGenerationTool::Map> generateMap(
                                                 yMin, yMax, isConical, ccw, fillSt, fillOpt, nullptr);
 }
 
-ccPointCloud* exportMapAsCloudPy(
+//! merges the cells of a partial map into the accumulated map, following the fill strategy
+void MergeMapCells_(DistanceMapGenerationTool::Map& acc,
+                    const DistanceMapGenerationTool::Map& part,
+                    DistanceMapGenerationTool::FillStrategyType fillSt)
+{
+    for (size_t i = 0; i < acc.size(); ++i)
+    {
+        const DistanceMapGenerationTool::MapCell& src = part[i];
+        if (src.count == 0)
+            continue;
+        DistanceMapGenerationTool::MapCell& dst = acc[i];
+        if (dst.count == 0)
+        {
+            dst = src;
+            continue;
+        }
+        switch (fillSt)
+        {
+        case DistanceMapGenerationTool::FILL_STRAT_MIN_DIST:
+            dst.value = std::min(dst.value, src.value);
+            break;
+        case DistanceMapGenerationTool::FILL_STRAT_MAX_DIST:
+            dst.value = std::max(dst.value, src.value);
+            break;
+        default: //average, weighted by the cell populations
+            dst.value = (dst.value * dst.count + src.value * src.count) / (dst.count + src.count);
+            break;
+        }
+        dst.count += src.count;
+    }
+}
+
+//! fills the empty cells of a merged map (zero or linear interpolation on a 2D Delaunay mesh of the filled cells)
+void FillEmptyMapCells_(DistanceMapGenerationTool::Map& map, DistanceMapGenerationTool::EmptyCellFillOption fillOpt)
+{
+    const unsigned xSteps = map.xSteps;
+    const unsigned ySteps = map.ySteps;
+    if (fillOpt == DistanceMapGenerationTool::FILL_WITH_ZERO)
+    {
+        for (DistanceMapGenerationTool::MapCell& cell : map)
+        {
+            if (cell.count == 0)
+            {
+                cell.value = 0;
+                cell.count = 1;
+            }
+        }
+    }
+    else if (fillOpt == DistanceMapGenerationTool::FILL_INTERPOLATE)
+    {
+        std::vector<CCVector2> cellCenters;
+        std::vector<size_t> cellIndexes;
+        for (size_t i = 0; i < map.size(); ++i)
+        {
+            if (map[i].count == 0)
+                continue;
+            cellCenters.emplace_back(static_cast<PointCoordinateType>(i % xSteps) + 0.5f, static_cast<PointCoordinateType>(i / xSteps) + 0.5f);
+            cellIndexes.push_back(i);
+        }
+        std::string errorStr;
+        CCCoreLib::Delaunay2dMesh mesh;
+        if (cellCenters.size() < 3 || !mesh.buildMesh(cellCenters, 0, errorStr))
+        {
+            CCTRACE("[SRA] empty cells not interpolated " << errorStr);
+        }
+        else
+        {
+            std::vector<char> interpolated(map.size(), 0);
+            for (unsigned t = 0; t < mesh.size(); ++t)
+            {
+                const CCCoreLib::VerticesIndexes* tri = mesh.getTriangleVertIndexes(t);
+                const CCVector2& A = cellCenters[tri->i1];
+                const CCVector2& B = cellCenters[tri->i2];
+                const CCVector2& C = cellCenters[tri->i3];
+                double det = static_cast<double>(B.x - A.x) * (C.y - A.y) - static_cast<double>(C.x - A.x) * (B.y - A.y);
+                if (std::abs(det) < 1.0e-12)
+                    continue;
+                int iMin = static_cast<int>(std::floor(std::min({ A.x, B.x, C.x })));
+                int iMax = static_cast<int>(std::ceil(std::max({ A.x, B.x, C.x })));
+                int jMin = static_cast<int>(std::floor(std::min({ A.y, B.y, C.y })));
+                int jMax = static_cast<int>(std::ceil(std::max({ A.y, B.y, C.y })));
+                for (int j = std::max(jMin, 0); j < std::min(jMax, static_cast<int>(ySteps)); ++j)
+                {
+                    for (int i = std::max(iMin, 0); i < std::min(iMax, static_cast<int>(xSteps)); ++i)
+                    {
+                        size_t index = static_cast<size_t>(j) * xSteps + i;
+                        if (map[index].count != 0 || interpolated[index])
+                            continue;
+                        double px = i + 0.5;
+                        double py = j + 0.5;
+                        double l2 = ((px - A.x) * (C.y - A.y) - (C.x - A.x) * (py - A.y)) / det;
+                        double l3 = ((B.x - A.x) * (py - A.y) - (px - A.x) * (B.y - A.y)) / det;
+                        double l1 = 1.0 - l2 - l3;
+                        if (l1 < -1.0e-6 || l2 < -1.0e-6 || l3 < -1.0e-6)
+                            continue;
+                        map[index].value = l1 * map[cellIndexes[tri->i1]].value
+                                         + l2 * map[cellIndexes[tri->i2]].value
+                                         + l3 * map[cellIndexes[tri->i3]].value;
+                        interpolated[index] = 1;
+                    }
+                }
+            }
+            for (size_t i = 0; i < map.size(); ++i)
+                if (interpolated[i])
+                    map[i].count = 1;
+        }
+    }
+
+    bool first = true;
+    for (const DistanceMapGenerationTool::MapCell& cell : map)
+    {
+        if (cell.count == 0)
+            continue;
+        if (first)
+        {
+            map.minVal = map.maxVal = cell.value;
+            first = false;
+        }
+        else
+        {
+            map.minVal = std::min(map.minVal, cell.value);
+            map.maxVal = std::max(map.maxVal, cell.value);
+        }
+    }
+}
+
+//! projects the cloud on the map in parallel
+/** The cloud is split in chunks, each one projected by DistanceMapGenerationTool::CreateMap
+    in its own map (per thread accumulator, same geometry as the plugin), then the maps are merged
+    following the fill strategy and the empty cells are filled once, on the merged map.
+    The chunks (coordinates and values only) are created in the main thread, by bounded batches.
+    'chunkSize' forces the number of points per chunk (0 = automatic, at most 1M points per thread), and
+    'maxThreadCount' the number of threads (0 = all, 1 = the plugin single threaded generateMap).
+**/
+QSharedPointer<DistanceMapGenerationTool::Map> generateMapParallel(
     ccPointCloud* cloud,
     ccPolyline* profile,
     ccScalarField* sf,
-    double angStep_deg,
+    double angStep_rad,
+    bool ccw,
+    bool isConical,
     double yStep,
     double yMin,
     double yMax,
-    bool isConical = false,
-    bool ccw = false,
-    DistanceMapGenerationTool::FillStrategyType fillSt = DistanceMapGenerationTool::FillStrategyType::FILL_STRAT_AVG_DIST,
-    DistanceMapGenerationTool::EmptyCellFillOption fillOpt = DistanceMapGenerationTool::EmptyCellFillOption::FILL_INTERPOLATE,
-    double baseRadius = 1.0)
+    DistanceMapGenerationTool::FillStrategyType fillSt,
+    DistanceMapGenerationTool::EmptyCellFillOption fillOpt,
+    unsigned forcedChunkSize = 0,
+    int maxThreadCount = 0)
 {
-    double angStep_rad = angStep_deg * M_PI/180.0;
-    QSharedPointer<DistanceMapGenerationTool::Map> map = generateMap(cloud, profile, sf, angStep_rad,
-                                                                     ccw, isConical, yStep, yMin, yMax,
-                                                                     fillSt, fillOpt);
-    ccPointCloud* clmap = DistanceMapGenerationTool::ConvertMapToCloud(map,profile,baseRadius);
-    return clmap;
+    static const unsigned s_minChunkSize = 1 << 16;
+    static const unsigned s_maxChunkSize = 1 << 20;
+    const unsigned pointCount = (cloud ? cloud->size() : 0);
+    const unsigned threadCount = static_cast<unsigned>(maxThreadCount > 0 ? maxThreadCount : std::max(QThread::idealThreadCount(), 1));
+#ifdef CC_CORE_LIB_USES_TBB
+    const bool parallel = (threadCount > 1 && sf && pointCount >= 2 * (forcedChunkSize != 0 ? forcedChunkSize : s_minChunkSize));
+#else
+    const bool parallel = false;
+#endif
+    if (!parallel)
+    {
+        return generateMap(cloud, profile, sf, angStep_rad, ccw, isConical, yStep, yMin, yMax, fillSt, fillOpt);
+    }
+
+    DistanceMapGenerationTool::ProfileMetaData profileDesc;
+    if (!DistanceMapGenerationTool::GetPoylineMetaData(profile, profileDesc))
+    {
+        CCTRACE("Failed to get polyline meta data")
+        return QSharedPointer<DistanceMapGenerationTool::Map>(nullptr);
+    }
+    ccGLMatrix cloudToSurface = profileDesc.computeCloudToSurfaceOriginTrans();
+
+    const unsigned chunkSize = (forcedChunkSize != 0 ? forcedChunkSize : std::min(s_maxChunkSize, (pointCount + threadCount - 1) / threadCount));
+    const unsigned chunkCount = (pointCount + chunkSize - 1) / chunkSize;
+    QSharedPointer<DistanceMapGenerationTool::Map> merged;
+    for (unsigned batchStart = 0; batchStart < chunkCount; batchStart += threadCount)
+    {
+        const unsigned batchCount = std::min(threadCount, chunkCount - batchStart);
+
+        //entities are created in the main thread (unique ids)
+        std::vector<ccPointCloud*> chunkClouds(batchCount, nullptr);
+        std::vector<ccScalarField*> chunkSFs(batchCount, nullptr);
+        bool ok = true;
+        for (unsigned b = 0; b < batchCount && ok; ++b)
+        {
+            unsigned first = (batchStart + b) * chunkSize;
+            unsigned last = std::min(pointCount, first + chunkSize);
+            chunkClouds[b] = new ccPointCloud("SRA chunk");
+            chunkSFs[b] = new ccScalarField("SRA chunk values");
+            chunkSFs[b]->link();
+            ok = chunkClouds[b]->reserve(last - first) && chunkSFs[b]->reserveSafe(last - first);
+            for (unsigned n = first; n < last && ok; ++n)
+            {
+                chunkClouds[b]->addPoint(*cloud->getPoint(n));
+                chunkSFs[b]->addElement(sf->getValue(n));
+            }
+        }
+
+        std::vector<QSharedPointer<DistanceMapGenerationTool::Map>> chunkMaps(batchCount);
+        if (ok)
+        {
+            tbb::parallel_for(static_cast<unsigned>(0), batchCount, [&](unsigned b)
+            {
+                chunkMaps[b] = DistanceMapGenerationTool::CreateMap(chunkClouds[b], chunkSFs[b], cloudToSurface, profileDesc.revolDim,
+                                                                    angStep_rad, yStep, yMin, yMax, isConical, ccw,
+                                                                    fillSt, DistanceMapGenerationTool::LEAVE_EMPTY, nullptr);
+            });
+        }
+        for (unsigned b = 0; b < batchCount; ++b)
+        {
+            delete chunkClouds[b];
+            if (chunkSFs[b])
+                chunkSFs[b]->release();
+        }
+        if (!ok)
+        {
+            CCTRACE("Not enough memory!");
+            return QSharedPointer<DistanceMapGenerationTool::Map>(nullptr);
+        }
+
+        for (unsigned b = 0; b < batchCount; ++b)
+        {
+            if (!chunkMaps[b])
+                return QSharedPointer<DistanceMapGenerationTool::Map>(nullptr);
+            if (!merged)
+                merged = chunkMaps[b];
+            else
+                MergeMapCells_(*merged, *chunkMaps[b], fillSt);
+        }
+    }
+    if (merged)
+        FillEmptyMapCells_(*merged, fillOpt);
+    return merged;
 }
 
-ccMesh* exportMapAsMeshPy(
+QSharedPointer<DistanceMapGenerationTool::Map> createMapPy(
     ccPointCloud* cloud,
     ccPolyline* profile,
     ccScalarField* sf,
@@ -165,14 +386,42 @@ ccMesh* exportMapAsMeshPy(
     bool ccw = false,
     DistanceMapGenerationTool::FillStrategyType fillSt = DistanceMapGenerationTool::FillStrategyType::FILL_STRAT_AVG_DIST,
     DistanceMapGenerationTool::EmptyCellFillOption fillOpt = DistanceMapGenerationTool::EmptyCellFillOption::FILL_INTERPOLATE,
-    double baseRadius = 1.0,
-    ccColorScalesManager::DEFAULT_SCALES colScale = ccColorScalesManager::BGYR,
-    int colScaleSteps = 256)
+    unsigned chunkSize = 0,
+    int maxThreadCount = 0)
 {
     double angStep_rad = angStep_deg * M_PI/180.0;
-    QSharedPointer<DistanceMapGenerationTool::Map> map = generateMap(cloud, profile, sf, angStep_rad,
-                                                                     ccw, isConical, yStep, yMin, yMax,
-                                                                     fillSt, fillOpt);
+    QSharedPointer<DistanceMapGenerationTool::Map> map = generateMapParallel(cloud, profile, sf, angStep_rad,
+                                                                             ccw, isConical, yStep, yMin, yMax,
+                                                                             fillSt, fillOpt, chunkSize, maxThreadCount);
+    if (!map)
+    {
+        CCTRACE("Failed to generate the map! Not enough memory?");
+    }
+    return map;
+}
+
+ccPointCloud* convertMapToCloudPy(QSharedPointer<DistanceMapGenerationTool::Map> map,
+                                  ccPolyline* profile,
+                                  double baseRadius = 1.0)
+{
+    if (!map)
+    {
+        CCTRACE("invalid map");
+        return nullptr;
+    }
+    return DistanceMapGenerationTool::ConvertMapToCloud(map, profile, baseRadius);
+}
+
+ccMesh* convertMapToMeshPy(QSharedPointer<DistanceMapGenerationTool::Map> map,
+                           ccPolyline* profile,
+                           ccColorScalesManager::DEFAULT_SCALES colScale = ccColorScalesManager::BGYR,
+                           int colScaleSteps = 256)
+{
+    if (!map)
+    {
+        CCTRACE("invalid map");
+        return nullptr;
+    }
     //profile parameters
     DistanceMapGenerationTool::ProfileMetaData profileDesc;
     if (!DistanceMapGenerationTool::GetPoylineMetaData(profile, profileDesc))
@@ -196,8 +445,7 @@ ccMesh* exportMapAsMeshPy(
     ccMesh* mesh = DistanceMapGenerationTool::ConvertProfileToMesh(profile, cloudToProfile, map->counterclockwise, map->xSteps, mapImage);
     if (mesh)
     {
-        mesh->setDisplay_recursive(cloud->getDisplay());
-        mesh->setName(cloud->getName()+QString(".map(%1,%2)").arg(map->xSteps).arg(map->ySteps));
+        mesh->setName(QString("map(%1,%2)").arg(map->xSteps).arg(map->ySteps));
     }
     else
     {
@@ -206,6 +454,88 @@ ccMesh* exportMapAsMeshPy(
     return mesh;
 }
 
+bool convertMapToImagePy(QSharedPointer<DistanceMapGenerationTool::Map> map,
+                         const QString& filename,
+                         ccColorScalesManager::DEFAULT_SCALES colScale = ccColorScalesManager::BGYR,
+                         int colScaleSteps = 256)
+{
+    if (!map)
+    {
+        CCTRACE("invalid map");
+        return false;
+    }
+    ccColorScale::Shared colorScale = ccColorScalesManager::GetDefaultScale(colScale);
+    QImage mapImage = DistanceMapGenerationTool::ConvertMapToImage(map, colorScale, colScaleSteps);
+    if (mapImage.isNull())
+    {
+        CCTRACE("problem ConvertMapToImage");
+        return false;
+    }
+    if (!mapImage.save(filename))
+    {
+        CCTRACE("Failed to save image " << filename.toStdString());
+        return false;
+    }
+    return true;
+}
+
+//! map cell values (or counts) as a numpy array of shape (ySteps, xSteps)
+py::array mapToNpArray(const DistanceMapGenerationTool::Map& map, bool counts)
+{
+    py::array_t<double> grid({ static_cast<size_t>(map.ySteps), static_cast<size_t>(map.xSteps) });
+    double* data = grid.mutable_data();
+    size_t cellCount = std::min(map.size(), static_cast<size_t>(map.xSteps) * map.ySteps);
+    for (size_t i = 0; i < cellCount; ++i)
+        data[i] = (counts ? static_cast<double>(map[i].count) : map[i].value);
+    return grid;
+}
+
+ccPointCloud* exportMapAsCloudPy(
+    ccPointCloud* cloud,
+    ccPolyline* profile,
+    ccScalarField* sf,
+    double angStep_deg,
+    double yStep,
+    double yMin,
+    double yMax,
+    bool isConical = false,
+    bool ccw = false,
+    DistanceMapGenerationTool::FillStrategyType fillSt = DistanceMapGenerationTool::FillStrategyType::FILL_STRAT_AVG_DIST,
+    DistanceMapGenerationTool::EmptyCellFillOption fillOpt = DistanceMapGenerationTool::EmptyCellFillOption::FILL_INTERPOLATE,
+    double baseRadius = 1.0)
+{
+    QSharedPointer<DistanceMapGenerationTool::Map> map = createMapPy(cloud, profile, sf, angStep_deg, yStep, yMin, yMax,
+                                                                     isConical, ccw, fillSt, fillOpt);
+    return convertMapToCloudPy(map, profile, baseRadius);
+}
+
+ccMesh* exportMapAsMeshPy(
+    ccPointCloud* cloud,
+    ccPolyline* profile,
+    ccScalarField* sf,
+    double angStep_deg,
+    double yStep,
+    double yMin,
+    double yMax,
+    bool isConical = false,
+    bool ccw = false,
+    DistanceMapGenerationTool::FillStrategyType fillSt = DistanceMapGenerationTool::FillStrategyType::FILL_STRAT_AVG_DIST,
+    DistanceMapGenerationTool::EmptyCellFillOption fillOpt = DistanceMapGenerationTool::EmptyCellFillOption::FILL_INTERPOLATE,
+    double baseRadius = 1.0,
+    ccColorScalesManager::DEFAULT_SCALES colScale = ccColorScalesManager::BGYR,
+    int colScaleSteps = 256)
+{
+    QSharedPointer<DistanceMapGenerationTool::Map> map = createMapPy(cloud, profile, sf, angStep_deg, yStep, yMin, yMax,
+                                                                     isConical, ccw, fillSt, fillOpt);
+    ccMesh* mesh = convertMapToMeshPy(map, profile, colScale, colScaleSteps);
+    if (mesh)
+    {
+        mesh->setDisplay_recursive(cloud->getDisplay());
+        mesh->setName(cloud->getName()+QString(".map(%1,%2)").arg(map->xSteps).arg(map->ySteps));
+    }
+    return mesh;
+}
+
 PYBIND11_MODULE(_SRA, m8)
 {
     m8.doc() = SRA_doc;
@@ -248,6 +578,48 @@ PYBIND11_MODULE(_SRA, m8)
 
     m8.def("loadProfile", &loadProfilePy, SRA_qSRA_loadProfile_doc);
 
+    py::class_<DistanceMapGenerationTool::Map, QSharedPointer<DistanceMapGenerationTool::Map> >(m8, "SRAMap", SRA_SRAMap_doc)
+        .def_readonly("xSteps", &DistanceMapGenerationTool::Map::xSteps, SRA_SRAMap_xSteps_doc)
+        .def_readonly("xMin", &DistanceMapGenerationTool::Map::xMin, SRA_SRAMap_xMin_doc)
+        .def_readonly("xStep", &DistanceMapGenerationTool::Map::xStep, SRA_SRAMap_xStep_doc)
+        .def_readonly("ySteps", &DistanceMapGenerationTool::Map::ySteps, SRA_SRAMap_ySteps_doc)
+        .def_readonly("yMin", &DistanceMapGenerationTool::Map::yMin, SRA_SRAMap_yMin_doc)
+        .def_readonly("yStep", &DistanceMapGenerationTool::Map::yStep, SRA_SRAMap_yStep_doc)
+        .def_readonly("minVal", &DistanceMapGenerationTool::Map::minVal, SRA_SRAMap_minVal_doc)
+        .def_readonly("maxVal", &DistanceMapGenerationTool::Map::maxVal, SRA_SRAMap_maxVal_doc)
+        .def_readonly("conical", &DistanceMapGenerationTool::Map::conical, SRA_SRAMap_conical_doc)
+        .def_readonly("counterclockwise", &DistanceMapGenerationTool::Map::counterclockwise, SRA_SRAMap_counterclockwise_doc)
+        .def("toNpArray", [](const DistanceMapGenerationTool::Map& self) { return mapToNpArray(self, false); },
+             SRA_SRAMap_toNpArray_doc)
+        .def("countsToNpArray", [](const DistanceMapGenerationTool::Map& self) { return mapToNpArray(self, true); },
+             SRA_SRAMap_countsToNpArray_doc)
+        ;
+
+    m8.def("createMap", &createMapPy,
+           py::arg("cloud"), py::arg("profile"), py::arg("sf"),
+           py::arg("angStep_deg"), py::arg("yStep"), py::arg("yMin"), py::arg("yMax"),
+           py::arg("isConical")=false, py::arg("ccw")=false,
+           py::arg("fillSt")=DistanceMapGenerationTool::FillStrategyType::FILL_STRAT_AVG_DIST,
+           py::arg("fillOpt")=DistanceMapGenerationTool::EmptyCellFillOption::FILL_INTERPOLATE,
+           py::arg("chunkSize")=0, py::arg("maxThreadCount")=0,
+           SRA_createMap_doc);
+
+    m8.def("convertMapToCloud", &convertMapToCloudPy,
+           py::arg("map"), py::arg("profile"), py::arg("baseRadius")=1.0,
+           SRA_convertMapToCloud_doc);
+
+    m8.def("convertMapToMesh", &convertMapToMeshPy,
+           py::arg("map"), py::arg("profile"),
+           py::arg("colScale")=ccColorScalesManager::BGYR,
+           py::arg("colScaleSteps")=256,
+           SRA_convertMapToMesh_doc);
+
+    m8.def("convertMapToImage", &convertMapToImagePy,
+           py::arg("map"), py::arg("filename"),
+           py::arg("colScale")=ccColorScalesManager::BGYR,
+           py::arg("colScaleSteps")=256,
+           SRA_convertMapToImage_doc);
+
     m8.def("exportMapAsCloud", &exportMapAsCloudPy,
            py::arg("cloud"), py::arg("profile"), py::arg("sf"),
            py::arg("angStep_deg"), py::arg("yStep"), py::arg("yMin"), py::arg("yMax"),
@@ -106,6 +106,113 @@ Export the map of radial distances as a mesh.
 :rtype: ccMesh
 )";
 
+const char* SRA_createMap_doc=R"(
+Compute the map of radial distances once, to convert it later with
+:py:func:`convertMapToCloud`, :py:func:`convertMapToMesh`, :py:func:`convertMapToImage`
+or the :py:meth:`SRAMap.toNpArray` method, without projecting the cloud again
+(:py:func:`exportMapAsCloud` and :py:func:`exportMapAsMesh` compute the map at each call).
+
+Large clouds are projected in parallel: each thread projects a chunk of the cloud in its own map,
+the maps are merged according to the fill strategy, then the empty cells are filled once.
+The chunks (coordinates and values, at most 1M points per thread) are copied by batches.
+The empty cells filled with zero or interpolated get a count of 1.
+
+:param ccPointCloud cloud: the point cloud used in radial distances computation
+:param ccPoyline profile: the profile used in radial distances computation
+:param ccScalarField sf: the "Radial distances" scalar field computed with doComputeRadialDists
+:param double angStep_deg: the angle step of the map, in degrees
+:param double yStep: the axial step of the map
+:param double yMin: minimum axial value of the map
+:param double yMax: maximum axial value of the map
+:param bool,optional isConical: whether the projection is conical or cylindric, default False, i.e. cylindric projection
+:param bool,optional ccw: whether the rotation is counter clockwise or not, default False i.e. clockwise
+:param int,optional fillSt: fill strategy from cc.SRA.FillStrategyType, default cc.SRA.FILL_STRAT_AVG_DIST = average distance 
+:param int,optional fillOpt: fill option from cc.SRA.EmptyCellFillOption, default cc.SRA.FILL_INTERPOLATE = interpolation
+:param int,optional chunkSize: number of points per chunk, default 0 = automatic (at most 1M points per thread,
+                               clouds below 128k points are projected by the plugin in a single thread)
+:param int,optional maxThreadCount: number of threads, default 0 = all the available threads,
+                                    1 = the plugin single threaded projection
+
+:return: the map
+:rtype: SRAMap (None if problem)
+)";
+
+const char* SRA_convertMapToCloud_doc=R"(
+Convert a map of radial distances (see :py:func:`createMap`) to a point cloud.
+
+:param SRAMap map: the map
+:param ccPoyline profile: the profile used in the map computation
+:param double,optional baseRadius: default 1.0. The dimension of the map along angular axis will be 2*pi*baseRadius
+
+:return: a point cloud for the map
+:rtype: ccPointCloud
+)";
+
+const char* SRA_convertMapToMesh_doc=R"(
+Convert a map of radial distances (see :py:func:`createMap`) to a textured mesh.
+
+:param SRAMap map: the map
+:param ccPoyline profile: the profile used in the map computation
+:param int,optional colScale: from cc.SRA.colorScales default cc.SRA.DEFAULT_SCALES.BGYR
+:param int,optional colScaleSteps: number of steps in the colorScale, default 256
+
+:return: a mesh for the map
+:rtype: ccMesh
+)";
+
+const char* SRA_convertMapToImage_doc=R"(
+Convert a map of radial distances (see :py:func:`createMap`) to an image file.
+
+:param SRAMap map: the map
+:param string filename: the image file, the format is deduced from the suffix (png, jpg...)
+:param int,optional colScale: from cc.SRA.colorScales default cc.SRA.DEFAULT_SCALES.BGYR
+:param int,optional colScaleSteps: number of steps in the colorScale, default 256
+
+:return: success
+:rtype: bool
+)";
+
+const char* SRA_SRAMap_doc=R"(
+A map of radial distances, computed with :py:func:`createMap`.
+The map is a grid of xSteps (angular axis) by ySteps (revolution axis) cells.
+
+:ivar int xSteps: number of cells along the angular axis
+:ivar float xMin: minimum angle (radians)
+:ivar float xStep: angle step (radians)
+:ivar int ySteps: number of cells along the revolution axis
+:ivar float yMin: minimum axial value
+:ivar float yStep: axial step
+:ivar float minVal: minimum cell value
+:ivar float maxVal: maximum cell value
+:ivar bool conical: whether the projection is conical or cylindric
+:ivar bool counterclockwise: whether the rotation is counter clockwise
+)";
+
+const char* SRA_SRAMap_xSteps_doc=R"(number of cells along the angular axis)";
+const char* SRA_SRAMap_xMin_doc=R"(minimum angle (radians))";
+const char* SRA_SRAMap_xStep_doc=R"(angle step (radians))";
+const char* SRA_SRAMap_ySteps_doc=R"(number of cells along the revolution axis)";
+const char* SRA_SRAMap_yMin_doc=R"(minimum axial value)";
+const char* SRA_SRAMap_yStep_doc=R"(axial step)";
+const char* SRA_SRAMap_minVal_doc=R"(minimum cell value)";
+const char* SRA_SRAMap_maxVal_doc=R"(maximum cell value)";
+const char* SRA_SRAMap_conical_doc=R"(whether the projection is conical or cylindric)";
+const char* SRA_SRAMap_counterclockwise_doc=R"(whether the rotation is counter clockwise)";
+
+const char* SRA_SRAMap_toNpArray_doc=R"(
+Copy the cell values in a numpy array.
+
+:return: the cell values, array of shape (ySteps, xSteps)
+:rtype: numpy.array
+)";
+
+const char* SRA_SRAMap_countsToNpArray_doc=R"(
+Copy the number of points projected in each cell in a numpy array.
+
+:return: the cell counts, array of shape (ySteps, xSteps)
+:rtype: numpy.array
+)";
+
 const char* SRA_initTrace_SRA_doc=R"(
 Debug trace must be initialized for each Python module.
 
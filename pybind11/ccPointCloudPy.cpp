@@ -39,6 +39,7 @@
 #include <ccHObjectCaster.h>
 
 #include "PyScalarType.h"
+#include "pyCC.h"
 #include "ccPointCloudPy_DocStrings.hpp"
 
 #include <map>
@@ -364,17 +365,30 @@ bool convertNormalToDipDirSFs_py(ccPointCloud &self)
      return success;
 }
 
+ccPointCloud* crop_py(ccPointCloud &self, const ccBBox& box, bool inside = true)
+{
+    ccPointCloud* croppedCloud = nullptr;
+    CCCoreLib::ReferenceCloud* ref = CropCloud(&self, box, inside);
+    if (ref && (ref->size() != 0))
+    {
+        croppedCloud = self.partialClone(ref);
+    }
+    delete ref;
+    ref = nullptr;
+    return croppedCloud;
+}
+
 ccPointCloud* crop2D_py(ccPointCloud &self, const ccPolyline* poly, unsigned char orthoDim, bool inside = true)
 {
     ccPointCloud* croppedCloud = nullptr;
     CCTRACE("ortho dim " <<  orthoDim);
-    CCCoreLib::ReferenceCloud* ref = self.crop2D(poly, orthoDim, inside);
+    CCCoreLib::ReferenceCloud* ref = Crop2DCloud(&self, poly, orthoDim, inside);
     if (ref && (ref->size() != 0))
     {
         croppedCloud = self.partialClone(ref);
-        delete ref;
-        ref = nullptr;
     }
+    delete ref;
+    ref = nullptr;
     return croppedCloud;
 }
 
@@ -405,9 +419,9 @@ bool orientNormalsWithFM_py(ccPointCloud &self, unsigned char octreeLevel = 6)
     return self.orientNormalsWithFM(octreeLevel);
 }
 
-bool orientNormalsWithMST_py(ccPointCloud &self, unsigned char octreeLevel = 6)
+bool orientNormalsWithMST_py(ccPointCloud &self, unsigned char octreeLevel = 6, unsigned tilePointCount = 0)
 {
-    return self.orientNormalsWithMST(octreeLevel);
+    return OrientNormalsWithMSTParallel(&self, octreeLevel, tilePointCount);
 }
 
 py::tuple partialClone_py(ccPointCloud &self,
@@ -597,6 +611,8 @@ void export_ccPointCloud(py::module &m0)
         .def("convertNormalToRGB", &ccPointCloud::convertNormalToRGB, ccPointCloudPy_convertNormalToRGB_doc)
         .def("convertNormalToDipDirSFs", convertNormalToDipDirSFs_py, ccPointCloudPy_convertNormalToDipDirSFs_doc)
         .def("convertRGBToGreyScale", &ccPointCloud::convertRGBToGreyScale, ccPointCloudPy_convertRGBToGreyScale_doc)
+        .def("crop", &crop_py, py::arg("box"), py::arg("inside")=true,
+             py::return_value_policy::reference, ccPointCloudPy_crop_doc)
         .def("crop2D", &crop2D_py, py::return_value_policy::reference, ccPointCloudPy_crop2D_doc)
         .def("deleteAllScalarFields", &ccPointCloud::deleteAllScalarFields, ccPointCloudPy_deleteAllScalarFields_doc)
         .def("deleteScalarField", &ccPointCloud::deleteScalarField, ccPointCloudPy_deleteScalarField_doc)
@@ -635,7 +651,7 @@ void export_ccPointCloud(py::module &m0)
              py::arg("octreeLevel")=6,
              ccPointCloudPy_orientNormalsWithFM_doc)
         .def("orientNormalsWithMST", &orientNormalsWithMST_py,
-             py::arg("octreeLevel")=6,
+             py::arg("octreeLevel")=6, py::arg("tilePointCount")=0,
              ccPointCloudPy_orientNormalsWithMST_doc)
         .def("partialClone", &partialClone_py, ccPointCloudPy_partialClone_doc)
         .def("renameScalarField", &ccPointCloud::renameScalarField, ccPointCloudPy_renameScalarField_doc)
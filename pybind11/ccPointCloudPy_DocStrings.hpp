@@ -171,9 +171,28 @@ Cloud memory is reserved /resized automatically
 :param ndarray array: a Numpy array (nbPoints,3).
 )";
 
+const char* ccPointCloudPy_crop_doc= R"(
+Crop the point cloud using a box.
+
+The cloud octree is computed if missing, and kept with the cloud for the next crops
+(see :py:meth:`~.cloudComPy.ccGenericPointCloud.computeOctree`).
+Only the octree cells meeting the box are visited, and only the points of the cells crossing the box border are tested.
+
+:param ccBBox box: the box
+:param bool,optional inside: keep the points inside (default) or outside the box
+
+:return: the cropped cloud (None if empty). Points are copied, the original cloud is not modified.
+:rtype: ccPointCloud
+)";
+
 const char* ccPointCloudPy_crop2D_doc= R"(
 Crop the point cloud using a 2D polyline.
 
+The cloud octree is computed if missing, and kept with the cloud for the next crops
+(see :py:meth:`~.cloudComPy.ccGenericPointCloud.computeOctree`).
+Only the octree cells meeting the polyline bounding box are visited.
+To crop with many polylines, see :py:func:`~.cloudComPy.Crop2DMultiPolylines`.
+
 :param ccPolyline poly: polyline object
 :param int orthoDim: normal plane, value in (0, 1, 2) 0 = oY, 1 = oX, 2 = oZ
 :param bool inside: boolean
@@ -376,7 +395,13 @@ Orient normals with Minimum Spanning Tree method.
 
 See `Minimum spanning tree <https://en.wikipedia.org/wiki/Minimum_spanning_tree>`_.
 
-:param int,optional octreeLevel: octree level, default 6
+:param int,optional octreeLevel: number of neighbours of each point in the kNN graph (historical name), default 6
+:param int,optional tilePointCount: mean number of points of the tiles, default 0 (no tiling).
+       In tiled mode, the tiles are oriented independently, then their signs are reconciled along the seams.
+       This is recommended for very large clouds: the orientation of the tiles runs in parallel.
+
+The kNN graph and the minimum spanning tree (Boruvka algorithm) are computed in parallel.
+The first point of each connected part keeps its normal.
 
 :return: success
 :rtype: bool
@@ -99,6 +99,10 @@ struct ICPres
     double finalScale;
     double finalRMS;
     unsigned finalPointCount;
+    std::vector<unsigned> levelOctreeLevels;
+    std::vector<unsigned> levelPointCounts;
+    std::vector<double> levelRMS;
+    std::vector<double> levelDurations;
 };
 
 ICPres ICP_py(  ccHObject* data,
@@ -113,9 +117,12 @@ ICPres ICP_py(  ccHObject* data,
                 bool useDataSFAsWeights = false,
                 bool useModelSFAsWeights = false,
                 int transformationFilters = CCCoreLib::RegistrationTools::SKIP_NONE,
-                int maxThreadCount = 0)
+                int maxThreadCount = 0,
+                int pyramidLevels = 1,
+                ICP_OBJECTIVE objective = POINT_TO_POINT)
 {
     ICPres a;
+    std::vector<ICPLevelInfo> levels;
     ICP(data,
         model,
         a.transMat,
@@ -132,8 +139,78 @@ ICPres ICP_py(  ccHObject* data,
         useDataSFAsWeights,
         useModelSFAsWeights,
         transformationFilters,
-        maxThreadCount);
+        maxThreadCount,
+        pyramidLevels,
+        &levels,
+        objective);
     a.aligned = dynamic_cast<ccPointCloud*>(data);
+    for (const ICPLevelInfo& info : levels)
+    {
+        a.levelOctreeLevels.push_back(info.octreeLevel);
+        a.levelPointCounts.push_back(info.pointCount);
+        a.levelRMS.push_back(info.rms);
+        a.levelDurations.push_back(info.duration);
+    }
+    return a;
+}
+
+struct ICPMultiViewRes
+{
+    std::vector<unsigned> modelIndexes;
+    std::vector<unsigned> dataIndexes;
+    std::vector<bool> success;
+    std::vector<ccGLMatrixd> transMats;
+    std::vector<double> rms;
+    std::vector<unsigned> pointCounts;
+    std::vector<ccGLMatrixd> globalTransMats;
+};
+
+ICPMultiViewRes ICPMultiView_py(std::vector<ccPointCloud*> clouds,
+                                std::vector<std::pair<unsigned, unsigned>> pairs = {},
+                                double minRMSDecrease = 1.e-5,
+                                unsigned maxIterationCount = 20,
+                                unsigned randomSamplingLimit = 50000,
+                                bool removeFarthestPoints = false,
+                                CCCoreLib::ICPRegistrationTools::CONVERGENCE_TYPE method = CCCoreLib::ICPRegistrationTools::MAX_ITER_CONVERGENCE,
+                                double finalOverlapRatio = 1.0,
+                                int transformationFilters = CCCoreLib::RegistrationTools::SKIP_NONE,
+                                int maxThreadCount = 0,
+                                ICP_OBJECTIVE objective = POINT_TO_POINT,
+                                bool globalRefinement = true)
+{
+    ICPMultiViewRes a;
+    std::vector<ICPPairInfo> pairInfos;
+    for (const auto& p : pairs)
+    {
+        ICPPairInfo info;
+        info.modelIndex = p.first;
+        info.dataIndex = p.second;
+        pairInfos.push_back(info);
+    }
+    if (!ICPMultiView(clouds,
+                      pairInfos,
+                      globalRefinement ? &a.globalTransMats : nullptr,
+                      minRMSDecrease,
+                      maxIterationCount,
+                      randomSamplingLimit,
+                      removeFarthestPoints,
+                      method,
+                      finalOverlapRatio,
+                      transformationFilters,
+                      maxThreadCount,
+                      objective))
+    {
+        return a;
+    }
+    for (const ICPPairInfo& info : pairInfos)
+    {
+        a.modelIndexes.push_back(info.modelIndex);
+        a.dataIndexes.push_back(info.dataIndex);
+        a.success.push_back(info.success);
+        a.transMats.push_back(info.transMat);
+        a.rms.push_back(info.rms);
+        a.pointCounts.push_back(info.pointCount);
+    }
     return a;
 }
 
@@ -261,7 +338,8 @@ py::tuple ExtractSlicesAndContours_py
     bool multiPass = false,
     bool splitEnvelopes = false,
     bool projectOnBestFitPlane = false,
-    bool generateRandomColors = false)
+    bool generateRandomColors = false,
+    int maxThreadCount = 0)
 {
     std::vector<ccGenericPointCloud*> clouds;
     std::vector<ccGenericMesh*> meshes;
@@ -295,151 +373,11 @@ py::tuple ExtractSlicesAndContours_py
     ExtractSlicesAndContoursClone(clouds, meshes, clipBox, singleSliceMode, processDimensions, outputSlices,
                              extractEnvelopes, maxEdgeLength, envelType, outputEnvelopes,
                              extractLevelSet, levelSetGridStep, levelSetMinVertCount, levelSet,
-                             gap, multiPass, splitEnvelopes, projectOnBestFitPlane, false, generateRandomColors, nullptr);
+                             gap, multiPass, splitEnvelopes, projectOnBestFitPlane, false, generateRandomColors, nullptr, maxThreadCount);
     py::tuple res = py::make_tuple(outputSlices, outputEnvelopes, levelSet);
     return res;
 }
 
-struct ComponentIndexAndSize
-{
-    unsigned index;
-    unsigned size;
-
-    ComponentIndexAndSize(unsigned i, unsigned s) : index(i), size(s) {}
-
-    static bool DescendingCompOperator(const ComponentIndexAndSize& a, const ComponentIndexAndSize& b)
-    {
-        return a.size > b.size;
-    }
-};
-
-//! from MainWindow::createComponentsClouds
-std::tuple <std::vector<ccPointCloud*>, std::vector<ccPointCloud*>>
-createComponentsClouds_(ccGenericPointCloud* cloud,
-                        CCCoreLib::ReferenceCloudContainer& components,
-                        unsigned minPointsPerComponent,
-                        bool randomColors,
-                        bool sortBysize=true)
-{
-    CCTRACE("createComponentsClouds_ " << randomColors);
-    std::vector<ccPointCloud*> resultClouds;
-    std::vector<ccPointCloud*> residualClouds;
-    if (!cloud || components.empty())
-        return {resultClouds, residualClouds};
-
-    std::vector<ComponentIndexAndSize> sortedIndexes;
-    std::vector<ComponentIndexAndSize>* _sortedIndexes = nullptr;
-    if (sortBysize)
-    {
-        try
-        {
-            sortedIndexes.reserve(components.size());
-        }
-        catch (const std::bad_alloc&)
-        {
-            CCTRACE("[CreateComponentsClouds] Not enough memory to sort components by size!");
-            sortBysize = false;
-        }
-
-        if (sortBysize) //still ok?
-        {
-            unsigned compCount = static_cast<unsigned>(components.size());
-            for (unsigned i = 0; i < compCount; ++i)
-            {
-                sortedIndexes.emplace_back(i, components[i]->size());
-            }
-
-            ParallelSort(sortedIndexes.begin(), sortedIndexes.end(), ComponentIndexAndSize::DescendingCompOperator);
-
-            _sortedIndexes = &sortedIndexes;
-        }
-    }
-
-    //we create "real" point clouds for all input components
-    {
-        ccPointCloud* pc = cloud->isA(CC_TYPES::POINT_CLOUD) ? static_cast<ccPointCloud*>(cloud) : nullptr;
-        CCCoreLib::ReferenceCloud* refCloud = new CCCoreLib::ReferenceCloud(cloud);
-        ccPointCloud* residualCloud = nullptr;
-
-        //for each component
-        int nbComp =0;
-        for (size_t i = 0; i < components.size(); ++i)
-        {
-            CCCoreLib::ReferenceCloud* compIndexes = _sortedIndexes ? components[_sortedIndexes->at(i).index] : components[i];
-
-            //if it has enough points
-            if (compIndexes->size() >= minPointsPerComponent)
-            {
-                //we create a new entity
-                ccPointCloud* compCloud = (pc ? pc->partialClone(compIndexes) : ccPointCloud::From(compIndexes));
-                if (compCloud)
-                {
-                    //shall we colorize it with random color?
-                    if (randomColors)
-                    {
-                        ccColor::Rgb col = ccColor::Generator::Random();
-                        compCloud->setColor(col);
-                    }
-
-                    //'shift on load' information
-                    if (pc)
-                    {
-                        compCloud->copyGlobalShiftAndScale(*pc);
-                    }
-                    compCloud->setName(QString("CC#%1").arg(nbComp));
-
-                    //we add new CC to group
-                    resultClouds.push_back(compCloud);
-                    nbComp++;
-                }
-                else
-                {
-                    CCTRACE("[CreateComponentsClouds] Failed to create component " << nbComp << "(not enough memory)");
-                }
-            }
-            else
-            {
-                // regroup all small chunks in one entity
-                unsigned numberOfPoints = compIndexes->size();
-                for (unsigned i = 0; i < numberOfPoints; ++i)
-                {
-                    //add the point to the current component
-                    if (!refCloud->addPointIndex(i))
-                    {
-                        //not enough memory
-                        CCTRACE("not enough memory!");
-                        delete refCloud;
-                        refCloud = nullptr;
-                        break;
-                    }
-                }
-            }
-
-            delete compIndexes;
-            compIndexes = nullptr;
-        }
-
-        if (refCloud)
-        {
-            residualCloud = (pc ? pc->partialClone(refCloud) : ccPointCloud::From(refCloud));
-            residualClouds.push_back(residualCloud);
-            delete refCloud;
-            refCloud = nullptr;
-        }
-        components.clear();
-
-        if (nbComp == 0)
-        {
-            CCTRACE("No component was created! Check the minimum size...");
-        }
-        else
-        {
-            CCTRACE("[CreateComponentsClouds] " << nbComp << " component(s) were created from cloud " << cloud->getName().toStdString());
-        }
-    }
-    return {resultClouds, residualClouds};
-}
-
 py::tuple ExtractConnectedComponents_py(std::vector<ccHObject*> entities,
                                         int octreeLevel=8,
                                         int minComponentSize=100,
@@ -467,8 +405,6 @@ py::tuple ExtractConnectedComponents_py(std::vector<ccHObject*> entities,
     if (count == 0)
         return res;
 
-    bool randColors = randomColors;
-
     for ( ccGenericPointCloud *cloud : clouds )
     {
         if (cloud && cloud->isA(CC_TYPES::POINT_CLOUD))
@@ -476,93 +412,35 @@ py::tuple ExtractConnectedComponents_py(std::vector<ccHObject*> entities,
             CCTRACE("cloud");
             ccPointCloud* pc = static_cast<ccPointCloud*>(cloud);
 
-            ccOctree::Shared theOctree = cloud->getOctree();
-            if (!theOctree)
-            {
-                theOctree = cloud->computeOctree(nullptr);
-                if (!theOctree)
-                {
-                    CCTRACE("Couldn't compute octree for cloud " <<cloud->getName().toStdString());
-                    break;
-                }
-            }
-
-            //we create/activate CCs label scalar field
-            int sfIdx = pc->getScalarFieldIndexByName(CC_CONNECTED_COMPONENTS_DEFAULT_LABEL_NAME);
-            if (sfIdx < 0)
-            {
-                sfIdx = pc->addScalarField(CC_CONNECTED_COMPONENTS_DEFAULT_LABEL_NAME);
-            }
-            if (sfIdx < 0)
+            //the components are counted and filtered before creating any cloud
+            std::vector<ccPointCloud*> resultClouds;
+            ccPointCloud* residualCloud = nullptr;
+            int remainingComponents = std::max(maxNumberComponents - realComponentCount, 0);
+            int componentCount = ExtractConnectedComponentsClouds(pc,
+                                                                  static_cast<unsigned char>(octreeLevel),
+                                                                  static_cast<unsigned>(std::max(minComponentSize, 0)),
+                                                                  static_cast<unsigned>(remainingComponents),
+                                                                  randomColors,
+                                                                  resultClouds,
+                                                                  residualCloud);
+            if (componentCount < 0)
             {
-                CCTRACE("Couldn't allocate a new scalar field for computing CC labels! Try to free some memory ...");
+                CCTRACE("[ExtractConnectedComponents] Something went wrong while extracting CCs from cloud " << cloud->getName().toStdString());
                 break;
             }
-            pc->setCurrentScalarField(sfIdx);
-
-            //we try to label all CCs
-            CCTRACE("---");
-            CCCoreLib::ReferenceCloudContainer components;
-            int componentCount = CCCoreLib::AutoSegmentationTools::labelConnectedComponents(cloud,
-                                                                                        static_cast<unsigned char>(octreeLevel),
-                                                                                        false,
-                                                                                        nullptr,
-                                                                                        theOctree.data());
-
-            CCTRACE("---");
-            if (componentCount >= 0)
-            {
-                //if successful, we extract each CC (stored in "components")
-
-                pc->getCurrentInScalarField()->computeMinAndMax();
-                if (!CCCoreLib::AutoSegmentationTools::extractConnectedComponents(cloud, components))
-                {
-                    CCTRACE("[ExtractConnectedComponents] Something went wrong while extracting CCs from cloud " << cloud->getName().toStdString());
-                }
-                CCTRACE("---");
-
-                //safety test
-                {
-                    for (size_t i = 0; i < components.size(); ++i)
-                    {
-                        if (components[i]->size() >= minComponentSize)
-                        {
-                            ++realComponentCount;
-                        }
-                    }
-                }
-                CCTRACE("total components: " << componentCount << " with " << realComponentCount << " components of size > " << minComponentSize);
-
-                if (realComponentCount > maxNumberComponents)
-                {
-                    //too many components
-                    CCTRACE("Too many components: " << realComponentCount << " for a maximum of: " << maxNumberComponents);
-                    CCTRACE("Extraction incomplete, modify some parameters and retry");
-                    pc->deleteScalarField(sfIdx);
-                    res = py::make_tuple(nbCloudDone, resultComponents);
-                    return res;
-                }
-            }
-            else
+            if (componentCount > remainingComponents)
             {
-                CCTRACE("[ExtractConnectedComponents] Something went wrong while extracting CCs from cloud " << cloud->getName().toStdString());
+                //too many components
+                CCTRACE("Too many components: " << realComponentCount + componentCount << " for a maximum of: " << maxNumberComponents);
+                CCTRACE("Extraction incomplete, modify some parameters and retry");
+                break;
             }
+            realComponentCount += componentCount;
 
-            //we delete the CCs label scalar field (we don't need it anymore)
-            pc->deleteScalarField(sfIdx);
-            sfIdx = -1;
-
-            //we create "real" point clouds for all CCs
-            if (!components.empty())
-            {
-                std::vector<ccPointCloud*> resultClouds;
-                std::vector<ccPointCloud*> residualClouds;
-                std::tie(resultClouds, residualClouds) = createComponentsClouds_(cloud, components, minComponentSize, randColors, true);
-                for (ccPointCloud* cloud : resultClouds)
-                    resultComponents.push_back(cloud);
-                for (ccPointCloud* cloud : residualClouds)
-                    residualComponents.push_back(cloud);
-            }
+            for (ccPointCloud* comp : resultClouds)
+                resultComponents.push_back(comp);
+            if (residualCloud)
+                residualComponents.push_back(residualCloud);
             nbCloudDone++;
             CCTRACE("nbCloudDone: " << nbCloudDone);
         }
@@ -587,10 +465,24 @@ bool InterpolateScalarFieldsFrom_py(ccPointCloud* destCloud,
                                     ccPointCloud* srcCloud,
                                     std::vector<int> sfIndexes,
                                     const ccPointCloudInterpolator::Parameters& params,
-                                    unsigned char octreeLevel = 0)
+                                    unsigned char octreeLevel = 0,
+                                    bool interpolateColors = false,
+                                    int maxThreadCount = 0)
 {
     CCTRACE("InterpolateScalarFieldsFrom_py");
-    return ccPointCloudInterpolator::InterpolateScalarFieldsFrom(destCloud, srcCloud, sfIndexes, params, nullptr, octreeLevel);
+    return InterpolateScalarFieldsFromCloud(destCloud, srcCloud, sfIndexes, params, octreeLevel, interpolateColors, maxThreadCount);
+}
+
+bool InterpolateScalarFieldsFromMulti_py(std::vector<ccPointCloud*> destClouds,
+                                         ccPointCloud* srcCloud,
+                                         std::vector<int> sfIndexes,
+                                         const ccPointCloudInterpolator::Parameters& params,
+                                         unsigned char octreeLevel = 0,
+                                         bool interpolateColors = false,
+                                         int maxThreadCount = 0)
+{
+    CCTRACE("InterpolateScalarFieldsFromMulti_py");
+    return InterpolateScalarFieldsFromCloudMulti(destClouds, srcCloud, sfIndexes, params, octreeLevel, interpolateColors, maxThreadCount);
 }
 
 // from MainWindow::AddToRemoveList helper for MergePy
@@ -698,103 +590,39 @@ ccHObject* MergeEntitiesPy(std::vector<ccHObject*> entities,
         //we will remove the useless clouds/meshes later
         ccHObject::Container toBeRemoved;
 
-        ccPointCloud* firstCloud = nullptr;
-
-        //whether to generate the 'original cloud index' scalar field or not
-        CCCoreLib::ScalarField* ocIndexSF = nullptr;
-        size_t cloudIndex = 0;
-        int sfIdx = -1;
+        ccPointCloud* firstCloud = (deleteOriginalClouds ? clouds.front() : clouds.front()->cloneThis());
+        if (!firstCloud)
+        {
+            CCTRACE("Not enough memory!");
+            return nullptr;
+        }
 
-        for (size_t i = 0; i < clouds.size(); ++i)
+        //the other clouds are appended in one pass (single allocation, parallel copy)
+        std::vector<ccPointCloud*> otherClouds(clouds.begin() + 1, clouds.end());
+        if (!MergeCloudsInto(firstCloud, otherClouds, createSFcloudIndex))
         {
-            CCTRACE("cloud: " << i);
-            ccPointCloud* pc = clouds[i];
-            if (!firstCloud)
-            {
-                if (deleteOriginalClouds)
-                {
-                    firstCloud = pc;
-                }
-                else
-                {
-                    firstCloud = pc->cloneThis();
-                }
+            CCTRACE("Fusion failed! (not enough memory?)");
+            if (!deleteOriginalClouds)
+                delete firstCloud;
+            return nullptr;
+        }
+        CCTRACE("  new size: " << firstCloud->size());
 
-                if (createSFcloudIndex)
-                {
-                    sfIdx = firstCloud->getScalarFieldIndexByName(CC_ORIGINAL_CLOUD_INDEX_SF_NAME);
-                    if (sfIdx < 0)
-                    {
-                        sfIdx = firstCloud->addScalarField(CC_ORIGINAL_CLOUD_INDEX_SF_NAME);
-                    }
-                    if (sfIdx < 0)
-                    {
-                        CCTRACE("Couldn't allocate a new scalar field for storing the original cloud index! Try to free some memory ...");
-                        return nullptr;
-                    }
-                    else
-                    {
-                        ocIndexSF = firstCloud->getScalarField(sfIdx);
-                        ocIndexSF->fill(0);
-                        firstCloud->setCurrentDisplayedScalarField(sfIdx);
-                        CCTRACE("NumberOfScalarFields: " << firstCloud->getNumberOfScalarFields());
-                        CCTRACE("SF name: " << ocIndexSF->getName());
-                    }
-                }
-            }
-            else
+        if (deleteOriginalClouds)
+        {
+            for (ccPointCloud* pc : otherClouds)
             {
-                unsigned countBefore = firstCloud->size();
-                unsigned countAdded = pc->size();
-                if (deleteOriginalClouds)
-                    *firstCloud += pc;
+                ccHObject* toRemove = nullptr;
+                //if the entity to remove is inside a group with a unique child, we can remove the group as well
+                ccHObject* parent = pc->getParent();
+                if (parent && parent->isA(CC_TYPES::HIERARCHY_OBJECT) && parent->getChildrenNumber() == 1 ) //&& parent != firstCloudContext.parent)
+                    toRemove = parent;
                 else
-                    *firstCloud += pc->cloneThis();
-                CCTRACE("  new size: " << firstCloud->size());
-                //success?
-                if (firstCloud->size() == countBefore + countAdded)
-                {
-                    ccHObject* toRemove = nullptr;
-                    //if the entity to remove is inside a group with a unique child, we can remove the group as well
-                    ccHObject* parent = pc->getParent();
-                    if (parent && parent->isA(CC_TYPES::HIERARCHY_OBJECT) && parent->getChildrenNumber() == 1 ) //&& parent != firstCloudContext.parent)
-                        toRemove = parent;
-                    else
-                        toRemove = pc;
-
-                    if (deleteOriginalClouds)
-                        AddToRemoveListPy(toRemove, toBeRemoved);
-
-                    if (ocIndexSF)
-                    {
-                        CCTRACE("  ocIndexSF")
-                        ocIndexSF->resizeSafe(firstCloud->size());
-                        ScalarType index = static_cast<ScalarType>(++cloudIndex);
-                        for (unsigned i = 0; i < countAdded; ++i)
-                        {
-                            ocIndexSF->setValue(countBefore + i, index);
-                        }
-                        CCTRACE("  ocIndexSF")
-                    }
-                }
-                else
-                {
-                    CCTRACE("Fusion failed! (not enough memory?)");
-                    break;
-                }
-                pc = nullptr;
+                    toRemove = pc;
+                AddToRemoveListPy(toRemove, toBeRemoved);
             }
         }
 
-        if (ocIndexSF)
-        {
-            CCTRACE("SF computeMinAndMax SF: " << sfIdx);
-            CCTRACE("NumberOfScalarFields: " << firstCloud->getNumberOfScalarFields());
-            ocIndexSF->computeMinAndMax();
-            firstCloud->setCurrentDisplayedScalarField(sfIdx);
-            firstCloud->showSF(true);
-        }
-
         //something to remove?
         if (deleteOriginalClouds)
         {
@@ -896,6 +724,12 @@ PYBIND11_MODULE(_cloudComPy, m0)
         .value("NORMAL_CHANGE_RATE", NORMAL_CHANGE_RATE)
         .export_values();
 
+    py::enum_<ICP_OBJECTIVE>(m0, "ICP_OBJECTIVE")
+        .value("POINT_TO_POINT", POINT_TO_POINT)
+        .value("POINT_TO_PLANE", POINT_TO_PLANE)
+        .value("SYMMETRIC_POINT_TO_PLANE", SYMMETRIC_POINT_TO_PLANE)
+        .export_values();
+
     py::enum_<CCCoreLib::LOCAL_MODEL_TYPES>(m0, "LOCAL_MODEL_TYPES")
         .value("NO_MODEL", CCCoreLib::NO_MODEL )
         .value("LS", CCCoreLib::LS )
@@ -980,8 +814,14 @@ PYBIND11_MODULE(_cloudComPy, m0)
 
     m0.def("interpolateScalarFieldsFrom", &InterpolateScalarFieldsFrom_py,
            py::arg("destCloud"), py::arg("srcCloud"), py::arg("sfIndexes"), py::arg("params"), py::arg("octreeLevel")=0,
+           py::arg("interpolateColors")=false, py::arg("maxThreadCount")=0,
            cloudComPy_interpolateScalarFieldsFrom_doc);
 
+    m0.def("interpolateScalarFieldsFromMulti", &InterpolateScalarFieldsFromMulti_py,
+           py::arg("destClouds"), py::arg("srcCloud"), py::arg("sfIndexes"), py::arg("params"), py::arg("octreeLevel")=0,
+           py::arg("interpolateColors")=false, py::arg("maxThreadCount")=0,
+           cloudComPy_interpolateScalarFieldsFromMulti_doc);
+
     m0.def("loadPointCloud", &loadPointCloudPy,
            py::arg("filename"),
            py::arg("mode")=AUTO, py::arg("skip")=0, py::arg("x")=0, py::arg("y")=0, py::arg("z")=0, py::arg("extraData")="",
@@ -1049,6 +889,14 @@ PYBIND11_MODULE(_cloudComPy, m0)
 
     m0.def("filterBySFValue", &filterBySFValue, py::return_value_policy::reference, cloudComPy_filterBySFValue_doc);
 
+    m0.def("CropMultiBoxes", &CropCloudMultiBoxes,
+           py::arg("cloud"), py::arg("boxes"),
+           py::return_value_policy::reference, cloudComPy_CropMultiBoxes_doc);
+
+    m0.def("Crop2DMultiPolylines", &Crop2DCloudMultiPolylines,
+           py::arg("cloud"), py::arg("polylines"), py::arg("orthoDim"),
+           py::return_value_policy::reference, cloudComPy_Crop2DMultiPolylines_doc);
+
     m0.def("GetPointCloudRadius", &GetPointCloudRadius,
            py::arg("clouds"), py::arg("nodes")=12, cloudComPy_GetPointCloudRadius_doc);
 
@@ -1065,6 +913,14 @@ PYBIND11_MODULE(_cloudComPy, m0)
                       cloudComPy_ICPres_doc)
        .def_readwrite("finalPointCount", &ICPres::finalPointCount,
                       cloudComPy_ICPres_doc)
+       .def_readonly("levelOctreeLevels", &ICPres::levelOctreeLevels,
+                      cloudComPy_ICPres_doc)
+       .def_readonly("levelPointCounts", &ICPres::levelPointCounts,
+                      cloudComPy_ICPres_doc)
+       .def_readonly("levelRMS", &ICPres::levelRMS,
+                      cloudComPy_ICPres_doc)
+       .def_readonly("levelDurations", &ICPres::levelDurations,
+                      cloudComPy_ICPres_doc)
     ;
 
     m0.def("ICP", &ICP_py,
@@ -1073,14 +929,38 @@ PYBIND11_MODULE(_cloudComPy, m0)
            py::arg("useDataSFAsWeights")=false, py::arg("useModelSFAsWeights")=false,
            py::arg("transformationFilters")=CCCoreLib::RegistrationTools::SKIP_NONE,
            py::arg("maxThreadCount")=0,
+           py::arg("pyramidLevels")=1,
+           py::arg("objective")=POINT_TO_POINT,
            cloudComPy_ICP_doc);
 
+    py::class_<ICPMultiViewRes>(m0, "ICPMultiViewRes", cloudComPy_ICPMultiViewRes_doc)
+       .def_readonly("modelIndexes", &ICPMultiViewRes::modelIndexes, cloudComPy_ICPMultiViewRes_doc)
+       .def_readonly("dataIndexes", &ICPMultiViewRes::dataIndexes, cloudComPy_ICPMultiViewRes_doc)
+       .def_readonly("success", &ICPMultiViewRes::success, cloudComPy_ICPMultiViewRes_doc)
+       .def_readonly("transMats", &ICPMultiViewRes::transMats, cloudComPy_ICPMultiViewRes_doc)
+       .def_readonly("rms", &ICPMultiViewRes::rms, cloudComPy_ICPMultiViewRes_doc)
+       .def_readonly("pointCounts", &ICPMultiViewRes::pointCounts, cloudComPy_ICPMultiViewRes_doc)
+       .def_readonly("globalTransMats", &ICPMultiViewRes::globalTransMats, cloudComPy_ICPMultiViewRes_doc)
+       ;
+
+    m0.def("ICPMultiView", &ICPMultiView_py,
+           py::arg("clouds"), py::arg("pairs")=std::vector<std::pair<unsigned, unsigned>>(),
+           py::arg("minRMSDecrease")=1.e-5, py::arg("maxIterationCount")=20, py::arg("randomSamplingLimit")=50000,
+           py::arg("removeFarthestPoints")=false, py::arg("method")=CCCoreLib::ICPRegistrationTools::MAX_ITER_CONVERGENCE,
+           py::arg("finalOverlapRatio")=1.0,
+           py::arg("transformationFilters")=CCCoreLib::RegistrationTools::SKIP_NONE,
+           py::arg("maxThreadCount")=0,
+           py::arg("objective")=POINT_TO_POINT,
+           py::arg("globalRefinement")=true,
+           cloudComPy_ICPMultiView_doc);
+
     m0.def("computeNormals", &computeNormals,
            py::arg("selectedEntities"), py::arg("model")=CCCoreLib::LS,
            py::arg("useScanGridsForComputation")=true, py::arg("defaultRadius")=0.0, py::arg("minGridAngle_deg")=1.0,
            py::arg("orientNormals")=true, py::arg("useScanGridsForOrientation")=true,
            py::arg("useSensorsForOrientation")=true, py::arg("preferredOrientation")=ccNormalVectors::UNDEFINED,
            py::arg("orientNormalsMST")=true, py::arg("mstNeighbors")=6, py::arg("computePerVertexNormals")=true,
+           py::arg("adaptiveKnn")=0, py::arg("adaptiveRadius")=false, py::arg("exportScaleSF")=false,
            cloudComPy_computeNormals_doc);
 
     py::class_<ReportInfoVol>(m0, "ReportInfoVol", cloudComPy_ReportInfoVol_doc)
@@ -1129,6 +1009,7 @@ PYBIND11_MODULE(_cloudComPy, m0)
             py::arg("splitEnvelopes")=false,
             py::arg("projectOnBestFitPlane")=false,
             py::arg("generateRandomColors")=false,
+            py::arg("maxThreadCount")=0,
             cloudComPy_ExtractSlicesAndContours_doc);
 
     m0.def("MergeEntities", &MergeEntitiesPy,
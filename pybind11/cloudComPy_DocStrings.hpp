@@ -49,6 +49,37 @@ If only one cloud is given, the direction (X, Y or Z) defines the normal to the
 :rtype: bool
 )";
 
+const char* cloudComPy_CropMultiBoxes_doc= R"(
+Crop a point cloud with a list of boxes, with two parallel passes on the cloud (count, then dispatch).
+
+The boxes are indexed with a uniform grid, so each point is only tested against a few boxes:
+this is much faster than cropping the cloud box by box, for instance to cut a large cloud into tiles.
+The boxes may overlap (a point can be copied in several output clouds).
+
+:param ccPointCloud cloud: the cloud to crop
+:param list boxes: list of ccBBox
+
+:return: the list of cropped clouds, one per box (None if no point falls inside the box).
+         Points are copied, the original cloud is not modified.
+:rtype: list
+)";
+
+const char* cloudComPy_Crop2DMultiPolylines_doc= R"(
+Crop a point cloud with a list of 2D polylines, with two parallel passes on the cloud (count, then dispatch).
+
+Same as :py:meth:`~.cloudComPy.ccPointCloud.crop2D` for each polyline, but the polylines bounding boxes
+are indexed with a uniform grid, so each point is only tested against a few polylines.
+The polylines may overlap (a point can be copied in several output clouds).
+
+:param ccPointCloud cloud: the cloud to crop
+:param list polylines: list of ccPolyline
+:param int orthoDim: normal plane, value in (0, 1, 2) 0 = oY, 1 = oX, 2 = oZ
+
+:return: the list of cropped clouds, one per polyline (None if no point falls inside the polyline).
+         Points are copied, the original cloud is not modified.
+:rtype: list
+)";
+
 const char* cloudComPy_deleteEntity_doc= R"(
 Delete an entity and its children (mesh, cloud...)
 
@@ -70,6 +101,8 @@ This grid is deduced from the octree structure.
 By selecting on octree level you define how small is the minimum gap between two components.
 If n is the octree level and d the dimension of the clouds (Bounding box side),
 the gap is roughly d/2**n.
+The non empty cells are grouped in parallel, and the components are filtered by size before any cloud creation.
+The components of a cloud are sorted by decreasing size.
 
 :param list[ccPointCloud] clouds: the set of clouds
 :param int,optional octreeLevel: the octree level used to define the connection between nodes, default 8.
@@ -117,6 +150,8 @@ The contours are built via a rasterisation process.
                                                (if only one is defined) or on the best fit plane. Default False.
 :param boolean,optionalgenerateRandomColors: whether to define random colors per slice (will overwrite existing colors!)
                                              or not. Default False.
+:param int,optional maxThreadCount: max number of threads used to generate the contours of a slice, default 0 = all the available threads.
+                                    With 1, a single GDAL contour generator is used. The contours are the same, in the same order.
 
 :return: a tuple of 3 lists ([slices], [envelopes], [contours])
 :rtype: tuple
@@ -163,16 +198,38 @@ Parameters for scalar fields interpolation from a source cloud to a destination
 const char* cloudComPy_interpolateScalarFieldsFrom_doc=R"(
 Interpolate scalar fields from a source cloud to a destination cloud.
 
+A single neighbourhood search per destination point feeds all the scalar fields (and the colors).
+The destination points are processed in parallel.
+
 :param ccPointCloud destCloud: the cloud receiving the interpolatated scalar fields.
 :param ccPointCloud srcCloud: the source cloud containing the scalar fields to interpolate.
 :param list sfIndexes: the list of indexes of scalar fields in the source cloud, to interpolate.
 :param interpolatorParameters params: interpolation parameter structure
-:param int,optional octreeLevel: octree level, default 0
+:param int,optional octreeLevel: octree level, default 0 (automatic)
+:param bool,optional interpolateColors: interpolate also the colors of the source cloud, default `False`
+:param int,optional maxThreadCount: maximum number of threads, default 0 (all)
 
 :return: success
 :rtype: bool
 )";
 
+const char* cloudComPy_interpolateScalarFieldsFromMulti_doc=R"(
+Interpolate scalar fields from a source cloud to several destination clouds.
+
+The source octree is computed once. See :py:meth:`interpolateScalarFieldsFrom`.
+
+:param list destClouds: the clouds receiving the interpolatated scalar fields.
+:param ccPointCloud srcCloud: the source cloud containing the scalar fields to interpolate.
+:param list sfIndexes: the list of indexes of scalar fields in the source cloud, to interpolate.
+:param interpolatorParameters params: interpolation parameter structure
+:param int,optional octreeLevel: octree level, default 0 (automatic)
+:param bool,optional interpolateColors: interpolate also the colors of the source cloud, default `False`
+:param int,optional maxThreadCount: maximum number of threads, default 0 (all)
+
+:return: success (for all the destination clouds)
+:rtype: bool
+)";
+
 const char* cloudComPy_ICPres_doc=R"(
 Result values on ICP registration.
 
@@ -181,6 +238,11 @@ Result values on ICP registration.
 :ivar float finalScale: calculated scale if rescale required
 :ivar float finalRMS: final error (RMS)
 :ivar int finalPointCount: number of points used to compute the final RMS
+:ivar list levelOctreeLevels: per level of the resolution pyramid (coarse to fine),
+      the octree level used to subsample the data (0 for the full resolution level)
+:ivar list levelPointCounts: per level, the number of data points registered
+:ivar list levelRMS: per level, the final error (RMS)
+:ivar list levelDurations: per level, the registration time (seconds)
 )";
 
 const char* cloudComPy_ICP_doc=R"(
@@ -214,10 +276,69 @@ Applies ICP registration on two entities.
    - SKIP_TRANSLATION    = 56
 
 :param int,optional maxThreadCount: Maximum number of threads to use (default 0 = max)
+:param int,optional pyramidLevels: number of levels of the resolution pyramid (default 1 = single resolution).
+       With more than one level, the data is first registered on voxel subsampled versions of itself
+       (one point per octree cell, about 4 times more points at each level), coarse to fine,
+       each level starting from the transformation of the previous one, then at full resolution.
+       The convergence criteria apply to each level. The model octree is computed once for all the levels:
+       with POINT_TO_POINT, the levels use a linearized point-to-point solver on this octree,
+       except the full resolution level when the model is a mesh or with scale adjustment or weights (CCCoreLib ICP).
+:param ICP_OBJECTIVE,optional objective: objective function minimized at each iteration (default ICP_OBJECTIVE.POINT_TO_POINT).
+
+   - POINT_TO_POINT: distances between the data points and their nearest model points (CCCoreLib ICP)
+   - POINT_TO_PLANE: distances between the data points and the tangent planes of their nearest model points
+   - SYMMETRIC_POINT_TO_PLANE: symmetric objective, using both the data and the model normals
+
+   The point-to-plane objectives use the model normals (computed if missing) and usually converge in fewer iterations.
+   The data normals (symmetric objective) are computed by local plane fitting.
+   They do not support scale adjustment nor weights.
 
 :return: ICPres structure :py:class:`ICPres`
 )";
 
+const char* cloudComPy_ICPMultiView_doc=R"(
+Registers a set of overlapping clouds pair by pair, then optionally computes their global poses.
+
+The pairwise registrations run in parallel. The octree of each cloud (and its normals, with the point-to-plane objectives)
+and the sampling of its points are computed once, in parallel, whatever the number of pairs using the cloud.
+With POINT_TO_POINT, the pairs use the linearized point-to-point solver of the ICP pyramid on the shared model octree.
+The parameters have the same meaning as with :py:meth:`ICP`, except that there is no partial overlap preprocessing:
+the trimming by finalOverlapRatio is done at each iteration. The scale and the weights are not supported.
+
+:param list clouds: the clouds to register.
+:param list,optional pairs: list of tuples (model index, data index) to register (default: all the pairs of clouds
+       with overlapping bounding boxes).
+:param float,optional minRMSDecrease: The minimum error (RMS) reduction between two consecutive steps to continue process,
+       if CONVERGENCE_TYPE == MAX_ERROR_CONVERGENCE (default 1.e-5).
+:param int,optional maxIterationCount: Stop after this number of iterations,
+       if CONVERGENCE_TYPE == MAX_ITER_CONVERGENCE (default 20).
+:param int,optional randomSamplingLimit: Limit above which the data clouds are randomly resampled (default 50000).
+:param bool,optional removeFarthestPoints: If `True`, ignore the farthest points from the reference (default `False`).
+:param CONVERGENCE_TYPE,optional method: Mode of convergence (default CONVERGENCE_TYPE.MAX_ITER_CONVERGENCE).
+:param float,optional finalOverlapRatio: ratio of the closest pairs of points used at each iteration (default 1.0).
+:param TRANSFORMATION_FILTERS,optional transformationFilters: Filters to be applied on the transformations (default 0).
+:param int,optional maxThreadCount: Maximum number of threads to use (default 0 = max)
+:param ICP_OBJECTIVE,optional objective: objective function (default ICP_OBJECTIVE.POINT_TO_POINT, linearized solver).
+:param bool,optional globalRefinement: compute the global transformation of each cloud from the pairwise
+       registrations (pose graph relaxation, weighted by 1/RMS²). The first cloud of each connected set of pairs
+       is the reference (default `True`).
+
+:return: ICPMultiViewRes structure :py:class:`ICPMultiViewRes` (empty lists on invalid input or memory error)
+)";
+
+const char* cloudComPy_ICPMultiViewRes_doc=R"(
+Result of :py:meth:`ICPMultiView`.
+
+:ivar list modelIndexes: index of the model cloud of each pair
+:ivar list dataIndexes: index of the data cloud of each pair
+:ivar list success: registration status of each pair
+:ivar list transMats: :py:class:`ccGLMatrixd` transformation to apply to the data cloud of each pair to register it
+      on the model cloud
+:ivar list rms: final RMS of each pair
+:ivar list pointCounts: number of data points used at the last iteration of each pair
+:ivar list globalTransMats: :py:class:`ccGLMatrixd` transformation to apply to each cloud (empty without global refinement)
+)";
+
 const char* cloudComPy_initCC_doc= R"(
 Done at module init, should be done once before using plugins!)";
 
@@ -372,6 +493,12 @@ Usage: see ccPolyline doc.)";
 const char* cloudComPy_MergeEntities_doc= R"(
 Merge a list of point clouds, or a list of meshes.
 
+The clouds are merged in one pass: the union of the scalar fields and the total size are computed first,
+every buffer is allocated once, then the clouds are copied in parallel.
+Missing colors are set to white, missing scalar values to NaN.
+The clouds with sensors, scan grids, full waveform data, or a global shift different from the first cloud,
+are appended one by one, as in CloudCompare (their children and global shift are handled the same way).
+
 :param tuple entities: list of clouds or list of meshes (not mixed)
 :param bool,optional deleteOriginalClouds: whether to delete the original clouds or not, default false
                                            **WARNING** No automatic action on the Python side to disable the variables referencing deleted objects!
@@ -575,6 +702,10 @@ Get the scalar type used in cloudCompare under the form defined in Numpy: 'float
 const char* cloudComPy_computeNormals_doc= R"(
 Compute normals on a list of clouds and meshes.
 
+The octrees and the octree based normals of the clouds are computed concurrently.
+The scan grid normals and the orientations (grids, sensors, MST) are then computed cloud after cloud.
+Prefer one call with all the clouds to one call per cloud.
+
 :param selectedEntities: list of entities (clouds, meshes)
 :type selectedEntities: list of :py:class:`ccHObject`
 :param LOCAL_MODEL_TYPES,optional model: default = LOCAL_MODEL_TYPES.LS (Least Square best fitting plane)
@@ -588,6 +719,12 @@ Compute normals on a list of clouds and meshes.
 :param bool,optional orientNormalsMST: default `True`, use Minimum Spanning Tree
 :param int,optional mstNeighbors: default 6, for Minimum Spanning Tree
 :param bool,optional computePerVertexNormals: default `True`, apply on mesh, if `True`, compute on vertices, if `False`, compute on triangles
+:param int,optional adaptiveKnn: default 0, if > 0, the normals are computed with a per point scale instead of defaultRadius,
+       adapted to the local density: the plane is fitted on the adaptiveKnn nearest neighbours (the local model is ignored).
+:param bool,optional adaptiveRadius: default `False`, with adaptiveKnn > 0, use a density adaptive radius
+       (mean distance to the k-th neighbour around the point) instead of the k nearest neighbours.
+:param bool,optional exportScaleSF: default `False`, with adaptiveKnn > 0, export the scale used for each point
+       (distance to the farthest neighbour or radius) in a "Normal scale" scalar field.
 
 :return: success
 :rtype: bool)";
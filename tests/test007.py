@@ -92,6 +92,50 @@ print("cloud.size %s" % npts)
 if npts != 399968:
     raise RuntimeError
 
+#---cloudCrop2D04-begin
+cloud.computeOctree() # the octree is used to skip the cells outside the polyline bounding box
+cloudCropZ2 = cloud.crop2D(poly, 2, True)
+#---cloudCrop2D04-end
+if cloudCropZ2.size() != 189981:
+    raise RuntimeError
+
+#---cloudCrop2D05-begin
+crops = cc.Crop2DMultiPolylines(cloud, [poly, poly2], 2)
+#---cloudCrop2D05-end
+if len(crops) != 2:
+    raise RuntimeError
+if crops[0].size() != 189981 or crops[1].size() != 189981:
+    raise RuntimeError
+
+#---cloudCropBoxes01-begin
+bb = cloud.getOwnBB()
+bmin = bb.minCorner()
+bmax = bb.maxCorner()
+boxes = []
+for i in range(4):
+    for j in range(4):
+        x0 = bmin[0] + i*(bmax[0] - bmin[0])/4.
+        y0 = bmin[1] + j*(bmax[1] - bmin[1])/4.
+        x1 = bmin[0] + (i+1)*(bmax[0] - bmin[0])/4.
+        y1 = bmin[1] + (j+1)*(bmax[1] - bmin[1])/4.
+        boxes.append(cc.ccBBox((x0, y0, bmin[2]), (x1, y1, bmax[2]), True))
+tiles = cc.CropMultiBoxes(cloud, boxes)
+#---cloudCropBoxes01-end
+if len(tiles) != 16:
+    raise RuntimeError
+for k in range(16):
+    tile = cloud.crop(boxes[k])
+    ntile = tile.size() if tile is not None else 0
+    nmulti = tiles[k].size() if tiles[k] is not None else 0
+    if ntile != nmulti:
+        raise RuntimeError
+total = sum([t.size() for t in tiles if t is not None])
+if total < cloud.size():
+    raise RuntimeError
+cloudOut = cloud.crop(boxes[0], False)
+if cloudOut.size() + tiles[0].size() != cloud.size():
+    raise RuntimeError
+
 if poly.is2DMode():
     raise RuntimeError
 poly.set2DMode(True)
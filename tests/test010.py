@@ -85,6 +85,86 @@ if maxdist > 0.04:
 
 cc.SaveEntities([cloud1, cloud2, cloud2ref, cloud3], os.path.join(dataDir, "clouds3.bin"))
 
+#---ICP03-begin
+cloud4 = cloud2ref.cloneThis()
+cloud4.applyRigidTransformation(tr1)
+res=cc.ICP(data=cloud4, model=cloud1, minRMSDecrease=1.e-5,
+           maxIterationCount=20, randomSamplingLimit=50000, removeFarthestPoints=False,
+           method=cc.CONVERGENCE_TYPE.MAX_ITER_CONVERGENCE,
+           adjustScale=False, finalOverlapRatio=0.1, pyramidLevels=3)
+for i in range(len(res.levelRMS)):
+    print("level %d: octree level %d, %d points, RMS %g, %g s" % (i, res.levelOctreeLevels[i],
+          res.levelPointCounts[i], res.levelRMS[i], res.levelDurations[i]))
+cloud4.applyRigidTransformation(res.transMat)
+#---ICP03-end
+if len(res.levelRMS) != 3 or len(res.levelDurations) != 3:
+    raise RuntimeError
+if res.levelOctreeLevels[2] != 0 or res.levelPointCounts[0] >= res.levelPointCounts[1]:
+    raise RuntimeError
 
+cc.DistanceComputationTools.computeCloud2CloudDistances(cloud4, cloud2ref, params)
+sf = cloud4.getScalarField(cloud4.getNumberOfScalarFields()-1)
+if sf.getMax() > 0.04:
+    raise RuntimeError
 
-
+def runICP04(objective, maxIterationCount):
+    """ICP04 settings, returns the RMS"""
+    c = cloud2ref.cloneThis()
+    c.applyRigidTransformation(tr1)
+    r = cc.ICP(data=c, model=cloud1, minRMSDecrease=1.e-5,
+               maxIterationCount=maxIterationCount, randomSamplingLimit=50000, removeFarthestPoints=False,
+               method=cc.CONVERGENCE_TYPE.MAX_ITER_CONVERGENCE,
+               adjustScale=False, finalOverlapRatio=0.1, objective=objective)
+    return r.finalRMS
+
+def iterationsToReach(objective, targetRMS):
+    """smallest number of iterations (among a few) reaching a target RMS"""
+    for n in (1, 2, 3, 5, 8, 13, 20):
+        if runICP04(objective, n) <= targetRMS:
+            return n
+    return 1000
+
+# point-to-point reference, with the same settings
+rmsP2P = runICP04(cc.ICP_OBJECTIVE.POINT_TO_POINT, 20)
+targetRMS = 1.1 * rmsP2P
+iterP2P = iterationsToReach(cc.ICP_OBJECTIVE.POINT_TO_POINT, targetRMS)
+print("POINT_TO_POINT: RMS %g, %d iterations to reach %g" % (rmsP2P, iterP2P, targetRMS))
+
+#---ICP04-begin
+for objective in (cc.ICP_OBJECTIVE.POINT_TO_PLANE, cc.ICP_OBJECTIVE.SYMMETRIC_POINT_TO_PLANE):
+    cloud5 = cloud2ref.cloneThis()
+    cloud5.applyRigidTransformation(tr1)
+    res5=cc.ICP(data=cloud5, model=cloud1, minRMSDecrease=1.e-5,
+                maxIterationCount=20, randomSamplingLimit=50000, removeFarthestPoints=False,
+                method=cc.CONVERGENCE_TYPE.MAX_ITER_CONVERGENCE,
+                adjustScale=False, finalOverlapRatio=0.1, objective=objective)
+    print("%s: RMS %g, %g s" % (objective, res5.finalRMS, res5.levelDurations[0]))
+    cloud5.applyRigidTransformation(res5.transMat)
+#---ICP04-end
+    cc.DistanceComputationTools.computeCloud2CloudDistances(cloud5, cloud2ref, params)
+    sf = cloud5.getScalarField(cloud5.getNumberOfScalarFields()-1)
+    if sf.getMax() > 0.04:
+        raise RuntimeError
+    # the plane objectives must reach the point-to-point accuracy, in no more iterations
+    if res5.finalRMS > targetRMS:
+        raise RuntimeError
+    iterations = iterationsToReach(objective, targetRMS)
+    print("%s: %d iterations to reach %g" % (objective, iterations, targetRMS))
+    if iterations > iterP2P:
+        raise RuntimeError
+
+#---ICP05-begin
+cloud6 = cloud2ref.cloneThis()
+cloud6.applyRigidTransformation(tr1)
+res6 = cc.ICPMultiView([cloud1, cloud6], pairs=[(0, 1)], finalOverlapRatio=0.1,
+                       objective=cc.ICP_OBJECTIVE.POINT_TO_PLANE)
+for k in range(len(res6.success)):
+    print("pair (%d, %d): success %s, RMS %g" % (res6.modelIndexes[k], res6.dataIndexes[k], res6.success[k], res6.rms[k]))
+cloud6.applyRigidTransformation(cc.ccGLMatrix.fromDouble(res6.globalTransMats[1]))
+#---ICP05-end
+if len(res6.success) != 1 or not res6.success[0] or len(res6.globalTransMats) != 2:
+    raise RuntimeError
+cc.DistanceComputationTools.computeCloud2CloudDistances(cloud6, cloud2ref, params)
+sf = cloud6.getScalarField(cloud6.getNumberOfScalarFields()-1)
+if sf.getMax() > 0.04:
+    raise RuntimeError
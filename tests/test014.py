@@ -127,6 +127,16 @@ if not math.isclose(sfmax, -0.06670579, rel_tol=1e-06):
 if not math.isclose(sfmin, -0.9999990, rel_tol=1e-06):
     raise RuntimeError
 
+#---normals06-begin
+if not cloud.orientNormalsWithMST(tilePointCount=50000): # tiles oriented independently, then reconciled
+    raise RuntimeError
+#---normals06-end
+cloud.exportNormalToSF(False, False, True)
+sf = cloud.getScalarField(cloud.getScalarFieldDic()['Nz'])
+sf.computeMinAndMax()
+if sf.getMax() >= 0.:
+    raise RuntimeError
+
 #---meshNormals01-begin
 cloud1 = cc.loadPointCloud(getSampleCloud2(3.0,0, 0.1))
 cloud1.setName("cloud1")
@@ -139,3 +149,26 @@ res = cc.SaveEntities([cloud, cloud1, mesh1], os.path.join(dataDir, "cloudmesh.b
 if res != cc.CC_FILE_ERROR.CC_FERR_NO_ERROR:
     raise RuntimeError
 
+
+#---normals05-begin
+clouds = [cc.loadPointCloud(getSampleCloud(5.0)) for i in range(4)]
+cc.computeNormals(clouds) # the clouds are processed concurrently
+#---normals05-end
+for c in clouds:
+    if not c.hasNormals() or c.getOctree() is None:
+        raise RuntimeError
+    c.exportNormalToSF(False, False, True)
+    sf = c.getScalarField(c.getNumberOfScalarFields()-1)
+    meanvar = sf.computeMeanAndVariance()
+    if not math.isclose(meanvar[0], 0.74157232, rel_tol=1e-06):
+        raise RuntimeError
+
+#---normals07-begin
+cloud2 = cc.loadPointCloud(getSampleCloud(5.0))
+cc.computeNormals([cloud2], adaptiveKnn=12, adaptiveRadius=True, exportScaleSF=True)
+sfScale = cloud2.getScalarField(cloud2.getScalarFieldDic()['Normal scale'])
+#---normals07-end
+if not cloud2.hasNormals():
+    raise RuntimeError
+if sfScale.getMin() <= 0. or sfScale.getMax() > 1.:
+    raise RuntimeError
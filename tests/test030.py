@@ -94,6 +94,54 @@ if cc.isPluginM3C2():
 
     cc.SaveEntities([cloud, cloud1, cloud2], os.path.join(dataDir, "M3C2.bin"))
 
+#---computeM3C2_03-begin
+    params = cc.M3C2.M3C2guessParams([cloud,cloud1], True)
+    params.exportStdDevInfo = True
+    cloud3 = cc.M3C2.computeM3C2WithParams([cloud,cloud1], params)
+    cloud4 = cloud1.cloneThis()
+    cloud4.translate((0., 0., 0.1))
+    epochs = cc.M3C2.computeM3C2Batch(cloud, [cloud1, cloud4], params)
+#---computeM3C2_03-end
+
+    if cloud3 is None or len(epochs) != 2 or epochs[0] is None or epochs[1] is None:
+        raise RuntimeError
+    if params.searchScale <= 0 or params.normalScale <= 0:
+        raise RuntimeError
+    dic3 = cloud3.getScalarFieldDic()
+    if 'STD cloud1' not in dic3 or 'STD cloud2' not in dic3:
+        raise RuntimeError
+    sf3 = cloud3.getScalarField(dic3['M3C2 distance'])
+    if not math.isclose(sf3.getMax(), 0.71, rel_tol=0.01) or not math.isclose(sf3.getMin(), -0.70, rel_tol=0.01):
+        raise RuntimeError
+
+    # --- same parameters as the plugin run: the guess and the computation must match the plugin
+    paramsFile = cc.M3C2.M3C2Parameters()
+    if not paramsFile.loadFromFile(paramFilename):
+        raise RuntimeError
+    for name in ("searchScale", "searchDepth", "normalScale", "subsampleRadius"):
+        if not math.isclose(getattr(params, name), getattr(paramsFile, name), rel_tol=0.01):
+            raise RuntimeError
+    if params.normalPreferedOri != paramsFile.normalPreferedOri:
+        raise RuntimeError
+    cloud5 = cc.M3C2.computeM3C2WithParams([cloud,cloud1], paramsFile)
+    if cloud5 is None:
+        raise RuntimeError
+    sf5 = cloud5.getScalarField(cloud5.getScalarFieldDic()['M3C2 distance'])
+    if not math.isclose(sf5.getMax(), sf.getMax(), rel_tol=0.01) or not math.isclose(sf5.getMin(), sf.getMin(), rel_tol=0.01):
+        raise RuntimeError
+    mean5, var5 = sf5.computeMeanAndVariance()
+    meanPlugin, varPlugin = sf.computeMeanAndVariance()
+    if not math.isclose(mean5, meanPlugin, rel_tol=0.01, abs_tol=1.e-4):
+        raise RuntimeError
+    sfb0 = epochs[0].getScalarField(epochs[0].getScalarFieldDic()['M3C2 distance'])
+    if not math.isclose(sfb0.getMax(), sf3.getMax(), rel_tol=1.e-5):
+        raise RuntimeError
+    mean0, var0 = sfb0.computeMeanAndVariance()
+    sfb1 = epochs[1].getScalarField(epochs[1].getScalarFieldDic()['M3C2 distance'])
+    mean1, var1 = sfb1.computeMeanAndVariance()
+    if math.isclose(mean0, mean1, abs_tol=1.e-3):
+        raise RuntimeError
+
     npts = 1000000
     x = np.float32(-5 +10*np.random.random((npts)))
     y = np.float32(-5 +10*np.random.random((npts)))
@@ -158,4 +206,15 @@ if cc.isPluginM3C2():
     if not math.isclose(mean, 0.0682, rel_tol=0.01):
         raise RuntimeError
 
+    paramsPM = cc.M3C2.M3C2Parameters()
+    if not paramsPM.loadFromFile(paramFilename):
+        raise RuntimeError
+    cloud6 = cc.M3C2.computeM3C2WithParams([cloud,cloud1], paramsPM, sfs, scales)
+    if cloud6 is None:
+        raise RuntimeError
+    sf6 = cloud6.getScalarField(cloud6.getScalarFieldDic()['distance uncertainty'])
+    mean6,var6 = sf6.computeMeanAndVariance()
+    if not math.isclose(mean6, mean, rel_tol=0.01):
+        raise RuntimeError
+
     cc.SaveEntities([cloud, cloud1, cloud2], os.path.join(dataDir, "M3C2pm.bin"))
@@ -58,5 +58,23 @@ if cc.isPluginPCV():
 #---PCV04-end
     if cloud.getNumberOfScalarFields() != 2:
         raise RuntimeError
+    dic = cloud.getScalarFieldDic()
+    cloud.renameScalarField(dic["Illuminance (PCV)"], "IlluminanceGL")
+
+#---PCV05-begin
+    cc.PCV.computeShadeVIS([cloud], cpuEngine=True)
+#---PCV05-end
+    if cloud.getNumberOfScalarFields() != 3:
+        raise RuntimeError
+    dic = cloud.getScalarFieldDic()
+    sfCPU = cloud.getScalarField(dic["Illuminance (PCV)"])
+    sfGL = cloud.getScalarField(dic["IlluminanceGL"])
+    if sfCPU.getMin() < 0. or sfCPU.getMax() > 1.:
+        raise RuntimeError
+    # same rays, same orthographic framing, 1 pixel splats and about 1 pixel of depth tolerance in both engines:
+    # only the points at the depth test limit may differ
+    diff = abs(sfCPU.toNpArray() - sfGL.toNpArray()).mean()
+    if diff > 0.05:
+        raise RuntimeError
 
     cc.SaveEntities([cloud, dish, cln], os.path.join(dataDir, "PCV.bin"))
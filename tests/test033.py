@@ -29,6 +29,7 @@ os.environ["_CCTRACE_"]="ON" # only if you want C++ debug traces
 
 from gendata import getSampleCloud, dataDir
 import cloudComPy as cc
+import numpy as np
 
 #---HPR01-begin
 if cc.isPluginHPR():
@@ -44,3 +45,27 @@ if cc.isPluginHPR():
         raise RuntimeError
     
     cc.SaveEntities([cloudCut, cloudCut], os.path.join(dataDir, "HPR.bin"))
+
+    #---HPR03-begin
+    sfIndex, mask = cc.HPR.computeHPRVisibility(cloud, (0.,-15., 25.), numpyMask=True)
+    #---HPR03-end
+
+    if sfIndex < 0 or mask is None or mask.sum() != nbPts:
+        raise RuntimeError
+    visibility = cloud.getScalarField(sfIndex)
+    if visibility.getMax() != 1. or visibility.toNpArray().sum() != nbPts:
+        raise RuntimeError
+
+    #---HPR02-begin
+    viewPoints = np.array([(0., -15., 25.), (0., 15., 25.), (15., 0., 25.), (-15., 0., 25.)])
+    sfIndex, bitset = cc.HPR.computeHPRMulti(cloud, viewPoints)
+    masks = np.unpackbits(bitset, axis=1, count=cloud.size()).astype(bool)
+    #---HPR02-end
+
+    if sfIndex < 0 or bitset.shape != (4, (cloud.size() + 7) // 8):
+        raise RuntimeError
+    if not math.isclose(901000, masks[0].sum(), rel_tol = 1.e-2):
+        raise RuntimeError
+    counts = cloud.getScalarField(sfIndex).toNpArray()
+    if not np.array_equal(counts, masks.sum(axis=0)):
+        raise RuntimeError
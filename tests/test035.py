@@ -125,4 +125,33 @@ if cc.isPluginRANSAC_SD():
     
     cc.SaveEntities(shapes, os.path.join(dataDir, "ransac.bin"))
 
+    #---RANSACSD03-begin
+    params.supportPoints = 100
+    meshes2, clouds2 = cc.RANSAC_SD.computeRANSAC_SD(cloud, params, tilePointCount=1500)
+    #---RANSACSD03-end
 
+    radii = [m.getRadius() for m in meshes2 if m is not None and m.isA(cc.CC_TYPES.SPHERE)]
+    print("tiled detection, sphere radii:", radii)
+    for r in (1.0, 1.5, 2.0):
+        if not any(math.isclose(radius, r, rel_tol=3.e-2) for radius in radii):
+            raise RuntimeError
+    if len(meshes2) != len(clouds2):
+        raise RuntimeError
+
+    #---RANSACSD04-begin
+    sfIndex, table = cc.RANSAC_SD.computeRANSAC_SD_labels(cloud, params)
+    labels = cloud.getScalarField(sfIndex).toNpArray()
+    spheres = table[table[:, 0] == cc.RANSAC_SD.RANSAC_PRIMITIVE_TYPES.RPT_SPHERE.value]
+    print("sphere centers and radii:", spheres[:, [2, 3, 4, 9]])
+    #---RANSACSD04-end
+
+    if table.shape[1] != 12 or labels.size != cloud.size():
+        raise RuntimeError
+    for r in (1.0, 1.5, 2.0):
+        if not any(math.isclose(radius, r, rel_tol=3.e-2) for radius in spheres[:, 9]):
+            raise RuntimeError
+    for s in range(table.shape[0]):
+        if (labels == s).sum() != int(table[s, 1]):
+            raise RuntimeError
+    if labels.min() < -1 or labels.max() >= table.shape[0]:
+        raise RuntimeError
@@ -24,6 +24,7 @@
 import os
 import sys
 import math
+import time
 
 os.environ["_CCTRACE_"]="ON" # only if you want C++ debug traces
 
@@ -117,3 +118,31 @@ if (len(res[0]) !=21) or (len(res[1]) !=8) or (len(res[2]) !=20):
 shapes = res[0] + res[1] +res[2]
 cc.SaveEntities(shapes, os.path.join(dataDir, "slices4.bin"))
 
+# --- the contours of a slice are generated with a single GDAL generator (1 thread) or one generator per level (4 threads):
+#     the same polylines are expected, in the same order
+
+contours = []
+for threads in (1, 4):
+    res=cc.ExtractSlicesAndContours(entities=toslice, bbox=bbox, bboxTrans=tr0,
+                                    singleSliceMode=False, gap=0.5,
+                                    extractLevelSet=True, levelSetGridStep=0.05,
+                                    levelSetMinVertCount=100, maxThreadCount=threads)
+    contours.append(res[2])
+if len(contours[0]) != len(contours[1]):
+    raise RuntimeError
+for poly1, poly2 in zip(contours[0], contours[1]):
+    if poly1.size() != poly2.size():
+        raise RuntimeError
+    for i in range(poly1.size()):
+        if not isCoordEqual(poly1.getPoint(i), poly2.getPoint(i), tol=0.):
+            raise RuntimeError
+
+# --- envelopes on dense slices: the candidate points of the concave hull are searched with a grid
+
+cloudDense = sphere1.samplePoints(True, 10000)
+t0 = time.time()
+res=cc.ExtractSlicesAndContours(entities=[cloudDense], bbox=bbox, singleSliceMode=False,
+                                gap=0.5, extractEnvelopes=True, maxEdgeLength=0.1, envelopeType=2)
+print("duration dense envelopes:", time.time() - t0)
+if (len(res[0]) !=6) or (len(res[1]) !=6):
+    raise RuntimeError
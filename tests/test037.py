@@ -47,6 +47,15 @@ if res2[0] != 1: # the number of clouds in input
     raise RuntimeError
 if len(components) != 12:
     raise RuntimeError
+sizes = [comp.size() for comp in components]
+if sizes != sorted(sizes, reverse=True):
+    raise RuntimeError
+if sum(sizes) + sum([r.size() for r in res2[2]]) != clouds[0].size():
+    raise RuntimeError
+
+res3 = cc.ExtractConnectedComponents(clouds=clouds, octreeLevel=6, maxNumberComponents=5)
+if res3[0] != 0 or len(res3[1]) != 0: # too many components: nothing is created
+    raise RuntimeError
 
 cc.SaveEntities(components, os.path.join(dataDir, "components.bin"))
 
@@ -46,6 +46,19 @@ if cc.isPluginCSF():
     clouds2 = cc.CSF.computeCSF(cloud, csfRigidness=1, clothResolution=1.0, classThreshold=0.3)
     #---CSF02-end
 
+    #---CSF03-begin
+    sfIndex = cc.CSF.computeCSFClassification(cloud, tileSize=4.0, tileOverlap=1.0)
+    classes = cloud.getScalarField(sfIndex).toNpArray() # 2: ground, 1: off-ground
+    #---CSF03-end
+    if sfIndex < 0 or classes.size != cloud.size():
+        raise RuntimeError
+    nbGround = (classes == 2).sum()
+    print("tiled CSF, ground points:", nbGround)
+    if not math.isclose(nbGround, clouds[0].size(), rel_tol=3.e-2):
+        raise RuntimeError
+    if nbGround + (classes == 1).sum() != cloud.size():
+        raise RuntimeError
+
 for cloud in clouds2:
     clouds.append(cloud)
 res = cc.SaveEntities(clouds, os.path.join(dataDir, "CSF.bin"))
@@ -49,4 +49,24 @@ ret = cc.interpolateScalarFieldsFrom(cloud2, cloud1, sfIndexes, params)
 if not ret:
     raise RuntimeError
 
+#---interpolSF_02-begin
+cloud3 = cc.loadPointCloud(getSampleCloud(2.0))
+cloud4 = cc.loadPointCloud(getSampleCloud(3.0))
+params2 = cc.interpolatorParameters()
+params2.method = cc.INTERPOL_METHOD.K_NEAREST_NEIGHBORS
+params2.algos = cc.INTERPOL_ALGO.MEDIAN
+params2.knn = 6
+ret = cc.interpolateScalarFieldsFromMulti([cloud3, cloud4], cloud1, sfIndexes, params2, maxThreadCount=4)
+#---interpolSF_02-end
+if not ret:
+    raise RuntimeError
+for c in (cloud3, cloud4):
+    d = c.getScalarFieldDic()
+    if 'Coord. X' not in d or 'Coord. Z' not in d:
+        raise RuntimeError
+    sf = c.getScalarField(d['Coord. X'])
+    sfsrc = cloud1.getScalarField(dic['Coord. X'])
+    if sf.getMin() < sfsrc.getMin() or sf.getMax() > sfsrc.getMax():
+        raise RuntimeError
+
 cc.SaveEntities([cloud1, cloud2], os.path.join(dataDir, "interpolSF.bin"))
@@ -94,5 +94,71 @@ if cc.isPluginSRA():
     if meshmap.size() != 144000:
         raise RuntimeError
     
+#---SRA04-begin
+    sramap = cc.SRA.createMap(cl, poly, sf, 0.5, 0.01, 0., 10.)
+    clmap2 = cc.SRA.convertMapToCloud(sramap, poly, baseRadius=2)
+    meshmap2 = cc.SRA.convertMapToMesh(sramap, poly, colScale=cc.SRA.DEFAULT_SCALES.YELLOW_BROWN)
+    cc.SRA.convertMapToImage(sramap, os.path.join(dataDir, "revolMap.png"))
+    grid = sramap.toNpArray()
+#---SRA04-end
+    if clmap2.size() != clmap.size() or meshmap2.size() != meshmap.size():
+        raise RuntimeError
+    if grid.shape != (sramap.ySteps, sramap.xSteps) or grid.size != 720000:
+        raise RuntimeError
+    if not os.path.isfile(os.path.join(dataDir, "revolMap.png")):
+        raise RuntimeError
+
     res = cc.SaveEntities([cl,poly, clmap, meshmap], os.path.join(dataDir, "revol2.bin"))
 
+
+# --- the chunked parallel projection gives the same map as the plugin single threaded projection:
+#     small cloud, chunks forced to 1000 points (20 chunks on 4 threads), sparse map (many empty cells)
+
+if cc.isPluginSRA():
+    nsmall = 20000
+    theta = 2*np.pi*np.random.random((nsmall))
+    z = 10*np.random.random((nsmall))
+    r = 5+np.cos(z*np.pi/10) + 0.1*np.sin(2*2*np.pi*z + theta)
+    coords = np.column_stack((np.float32(r*np.cos(theta)), np.float32(r*np.sin(theta)), z))
+    small = cc.ccPointCloud("revolSmall")
+    small.coordsFromNPArray_copy(coords)
+    sra.doComputeRadialDists(small, poly)
+    sfSmall = small.getScalarField(small.getScalarFieldDic()['Radial distance'])
+
+    strategies = (cc.SRA.FILL_STRAT_MIN_DIST, cc.SRA.FILL_STRAT_AVG_DIST, cc.SRA.FILL_STRAT_MAX_DIST)
+    for fillSt in strategies:
+        # filled cells: same counts, same values (up to the rounding of the averages)
+        ref = cc.SRA.createMap(small, poly, sfSmall, 0.5, 0.1, 0., 10., fillSt=fillSt,
+                               fillOpt=cc.SRA.LEAVE_EMPTY, maxThreadCount=1)
+        par = cc.SRA.createMap(small, poly, sfSmall, 0.5, 0.1, 0., 10., fillSt=fillSt,
+                               fillOpt=cc.SRA.LEAVE_EMPTY, chunkSize=1000, maxThreadCount=4)
+        refCounts = ref.countsToNpArray()
+        if not np.array_equal(refCounts, par.countsToNpArray()):
+            raise RuntimeError
+        filled = refCounts > 0
+        if filled.all() or not filled.any():
+            raise RuntimeError
+        if not np.allclose(ref.toNpArray()[filled], par.toNpArray()[filled], rtol=1.e-5, atol=1.e-7):
+            raise RuntimeError
+
+        # empty cells filled with zero: exact
+        ref = cc.SRA.createMap(small, poly, sfSmall, 0.5, 0.1, 0., 10., fillSt=fillSt,
+                               fillOpt=cc.SRA.FILL_WITH_ZERO, maxThreadCount=1)
+        par = cc.SRA.createMap(small, poly, sfSmall, 0.5, 0.1, 0., 10., fillSt=fillSt,
+                               fillOpt=cc.SRA.FILL_WITH_ZERO, chunkSize=1000, maxThreadCount=4)
+        if not np.allclose(ref.toNpArray(), par.toNpArray(), rtol=1.e-5, atol=1.e-7):
+            raise RuntimeError
+
+        # interpolated empty cells: the distances are within [-0.1, 0.1], the interpolation may differ slightly
+        ref = cc.SRA.createMap(small, poly, sfSmall, 0.5, 0.1, 0., 10., fillSt=fillSt,
+                               fillOpt=cc.SRA.FILL_INTERPOLATE, maxThreadCount=1)
+        par = cc.SRA.createMap(small, poly, sfSmall, 0.5, 0.1, 0., 10., fillSt=fillSt,
+                               fillOpt=cc.SRA.FILL_INTERPOLATE, chunkSize=1000, maxThreadCount=4)
+        refGrid = ref.toNpArray()
+        parGrid = par.toNpArray()
+        if not np.allclose(refGrid[filled], parGrid[filled], rtol=1.e-5, atol=1.e-7):
+            raise RuntimeError
+        if not np.allclose(refGrid[~filled], parGrid[~filled], rtol=0., atol=0.01, equal_nan=True):
+            raise RuntimeError
+        if not math.isclose(ref.minVal, par.minVal, abs_tol=0.01) or not math.isclose(ref.maxVal, par.maxVal, abs_tol=0.01):
+            raise RuntimeError
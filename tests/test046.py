@@ -71,3 +71,34 @@ if cc.isPluginCanupo():
     res = cc.SaveEntities([cloud], os.path.join(dataDir, "cloudCanupo.bin"))
 #---Canupo002-end
 
+#---Canupo003-begin
+if cc.isPluginCanupo():
+    tiles = [cloud.cloneThis(), cloud.cloneThis()]
+    res = cc.Canupo.ClassifyBatch(tiles, os.path.join(dataExtDir,"vegetTidal.prm"),
+                                  coreSource=cc.Canupo.CORE_CLOUD_SOURCES.SUBSAMPLED, samplingDist=0.05)
+#---Canupo003-end
+    if res != [True, True]:
+        raise RuntimeError
+    for tile in tiles:
+        for i in range(tile.getChildrenNumber()): # no core point cloud created
+            if tile.getChild(i).isA(cc.CC_TYPES.POINT_CLOUD):
+                raise RuntimeError
+        if 'CANUPO.class' not in tile.getScalarFieldDic():
+            raise RuntimeError
+
+#---Canupo004-begin
+if cc.isPluginCanupo():
+    classifier = cc.Canupo.loadCanupoClassifier(os.path.join(dataExtDir,"vegetTidal.prm"))
+    print("scales:", classifier.scales, "classes:", classifier.classes())
+    for tile in tiles:
+        res = cc.Canupo.ClassifyWithClassifier(tile, classifier,
+                                               coreSource=cc.Canupo.CORE_CLOUD_SOURCES.SUBSAMPLED, samplingDist=0.05)
+#---Canupo004-end
+        if not res:
+            raise RuntimeError
+        dic = tile.getScalarFieldDic()
+        labels = tile.getScalarField(dic['CANUPO.class']).toNpArray()
+        if not set(labels.astype(int)).issubset(set(classifier.classes())):
+            raise RuntimeError
+    if cc.Canupo.loadCanupoClassifier(os.path.join(dataExtDir,"noSuchFile.prm")) is not None:
+        raise RuntimeError
@@ -25,6 +25,7 @@ import os
 import sys
 import math
 import requests
+import numpy as np
 
 os.environ["_CCTRACE_"]="ON" # only if you want C++ debug traces
 
@@ -48,6 +49,27 @@ cloud2 = cc.MergeEntities(res2, createSFcloudIndex=True)
 cloud3 = cc.MergeEntities(res2, deleteOriginalClouds=True)
 res = None
 #---extractCC01-end
+if cloud2.size() != cloud.size() or cloud3.size() != cloud.size():
+    raise RuntimeError
+sf = cloud2.getScalarField(cloud2.getScalarFieldDic()['Original cloud index'])
+if sf.getMin() != 0 or sf.getMax() != len(res2) - 1:
+    raise RuntimeError
+
+# clouds with different global shifts are appended as in CloudCompare
+shifted = [c.cloneThis() for c in res2[:3]]
+shifted[1].setGlobalShift(-1000., -2000., 0.)
+shifted[2].setGlobalShift(500., 0., -10.)
+ref = shifted[0].cloneThis()
+for c in shifted[1:]:
+    ref.fuse(c)
+cloud4 = cc.MergeEntities(shifted, createSFcloudIndex=True)
+if cloud4.size() != ref.size() or cloud4.getGlobalShift() != ref.getGlobalShift():
+    raise RuntimeError
+if not np.allclose(cloud4.toNpArrayCopy(), ref.toNpArrayCopy()):
+    raise RuntimeError
+sf = cloud4.getScalarField(cloud4.getScalarFieldDic()['Original cloud index'])
+if sf.getMin() != 0 or sf.getMax() != 2:
+    raise RuntimeError
 
 
 tr1 = cc.ccGLMatrix()